@@ -86,23 +86,52 @@ namespace pen
         int  size();
     };
 
+    struct ring_buffer_stats
+    {
+        u32 capacity = 0;   // slots in the block the producer is writing to
+        u32 size = 0;       // items put and not yet consumed
+        u32 high_water = 0; // most items outstanding at once
+        u32 grows = 0;      // times a full buffer linked a larger block
+        u32 stalls = 0;     // times put blocked at max capacity waiting for the consumer
+    };
+
     // lockless single producer single consumer - thread safe ring buffer
+    // when full the producer links a block of double the capacity and the consumer moves over once it has drained the
+    // old one. with a max capacity put blocks until the consumer catches up instead of growing past it, single threaded
+    // builds always grow. pointers returned from get or check are valid until the next call to get or check.
     template <typename T>
     struct ring_buffer
     {
-        T* data = nullptr;
-
-        a_u32               get_pos;
-        a_u32               put_pos;
-        std::atomic<size_t> _capacity;
+        struct block
+        {
+            T*                  data = nullptr;
+            u32                 capacity = 0;
+            a_u32               get_pos;
+            a_u32               put_pos;
+            std::atomic<block*> next;
+        };
+
+        block* _get_block = nullptr; // consumer
+        block* _put_block = nullptr; // producer
+        u32    _max_capacity = 0;
+        a_u32  _size;
+        a_u32  _high_water;
+        a_u32  _grows;
+        a_u32  _stalls;
 
         ring_buffer();
         ~ring_buffer();
 
-        void create(u32 capacity);
-        void put(const T& item);
-        T*   get();
-        T*   check();
+        void              create(u32 capacity, u32 max_capacity = 0); // 0 = grow without limit
+        bool              created();
+        void              put(const T& item);
+        bool              try_put(const T& item); // returns false if full, without growing or blocking
+        T*                get();
+        T*                check();
+        ring_buffer_stats stats();
+
+        static block* create_block(u32 capacity);
+        static void   release_block(block* b);
     };
 
     // lockless single producer multiple consumer - thread safe resource pool which will grow to accomodate contents
@@ -181,6 +210,31 @@ namespace pen
         T&     operator[](size_t slot);
     };
 
+    // single threaded - open addressing map of hash_id to u32 index with linear probing, for caches looked up by a hash
+    // of their state. the table is a power of 2 and doubles at 3/4 load, a key of 0 is kept aside as it marks empty slots
+    struct hash_index
+    {
+        hash_id* _keys = nullptr;
+        u32*     _values = nullptr;
+        u32      _capacity = 0;
+        u32      _size = 0;
+        bool     _has_zero = false;
+        u32      _zero_value = 0;
+
+        hash_index() = default;
+        ~hash_index();
+
+        // owns its tables, copies would double free them
+        hash_index(const hash_index&) = delete;
+        hash_index& operator=(const hash_index&) = delete;
+
+        bool find(hash_id key, u32& value) const;
+        void insert(hash_id key, u32 value); // replaces the value of an existing key
+        void clear();
+        u32  size() const;
+        void grow(u32 capacity);
+    };
+
     // function impls with always inline for fast data structs
     template <typename T>
     pen_inline void stack<T>::clear()
@@ -222,54 +276,169 @@ namespace pen
     template <typename T>
     pen_inline ring_buffer<T>::ring_buffer()
     {
-        get_pos = 0;
-        put_pos = 0;
-        _capacity = 0;
+        _size = 0;
+        _high_water = 0;
+        _grows = 0;
+        _stalls = 0;
     }
 
     template <typename T>
     pen_inline ring_buffer<T>::~ring_buffer()
     {
-        pen::memory_free(data);
+        while (_get_block)
+        {
+            block* next = _get_block->next;
+            release_block(_get_block);
+            _get_block = next;
+        }
     }
 
     template <typename T>
-    inline void ring_buffer<T>::create(u32 capacity)
+    inline typename ring_buffer<T>::block* ring_buffer<T>::create_block(u32 capacity)
     {
-        get_pos = 0;
-        put_pos = 0;
-        _capacity = capacity;
+        block* b = new block();
+        b->capacity = capacity;
+        b->get_pos = 0;
+        b->put_pos = 0;
+        b->next = nullptr;
 
-        data = (T*)pen::memory_alloc(sizeof(T) * _capacity.load());
-        memset(data, 0x0, sizeof(T) * _capacity.load());
+        b->data = (T*)pen::memory_alloc(sizeof(T) * capacity);
+        memset(b->data, 0x0, sizeof(T) * capacity);
+        return b;
     }
 
     template <typename T>
-    pen_inline void ring_buffer<T>::put(const T& item)
+    inline void ring_buffer<T>::release_block(block* b)
     {
-        data[put_pos] = item;
-        put_pos = (put_pos + 1) % _capacity;
+        pen::memory_free(b->data);
+        delete b;
     }
 
     template <typename T>
-    pen_inline T* ring_buffer<T>::get()
+    inline void ring_buffer<T>::create(u32 capacity, u32 max_capacity)
     {
-        u32 gp = get_pos;
-        if (gp == put_pos)
-            return nullptr;
+        while (_get_block)
+        {
+            block* next = _get_block->next;
+            release_block(_get_block);
+            _get_block = next;
+        }
+
+        // one slot is always empty to tell full from empty
+        if (capacity < 2)
+            capacity = 2;
 
-        get_pos = (get_pos + 1) % _capacity;
+        _get_block = create_block(capacity);
+        _put_block = _get_block;
+        _max_capacity = max_capacity;
+        _size = 0;
+        _high_water = 0;
+        _grows = 0;
+        _stalls = 0;
+    }
 
-        return &data[gp];
+    template <typename T>
+    pen_inline bool ring_buffer<T>::created()
+    {
+        return _put_block != nullptr;
+    }
+
+    template <typename T>
+    pen_inline bool ring_buffer<T>::try_put(const T& item)
+    {
+        // the slot before get_pos holds the item last returned to the consumer, a full block never writes over it
+        block* b = _put_block;
+        u32    pp = b->put_pos;
+        u32    np = (pp + 1) % b->capacity;
+        if (np == b->get_pos)
+            return false;
+
+        b->data[pp] = item;
+        b->put_pos = np;
+
+        u32 size = ++_size;
+        if (size > _high_water)
+            _high_water = size;
+
+        return true;
+    }
+
+    template <typename T>
+    inline void ring_buffer<T>::put(const T& item)
+    {
+        if (try_put(item))
+            return;
+
+        u32 capacity = _put_block->capacity * 2;
+        if (PEN_SINGLE_THREADED || _max_capacity == 0 || capacity <= _max_capacity)
+        {
+            // items in the full block are published before the link, so the consumer drains them before moving on
+            block* b = create_block(capacity);
+            _put_block->next = b;
+            _put_block = b;
+            ++_grows;
+
+            try_put(item);
+            return;
+        }
+
+        // backpressure
+        ++_stalls;
+        while (!try_put(item))
+            pen::thread_sleep_us(100);
     }
 
     template <typename T>
     pen_inline T* ring_buffer<T>::check()
     {
-        u32 gp = get_pos;
-        if (gp == put_pos)
+        block* b = _get_block;
+        if (!b)
             return nullptr;
-        return &data[gp];
+
+        for (;;)
+        {
+            u32 gp = b->get_pos;
+            if (gp != b->put_pos)
+                return &b->data[gp];
+
+            block* next = b->next;
+            if (!next)
+                return nullptr;
+
+            // the producer has moved on, anything it put here before linking is visible now
+            if (gp != b->put_pos)
+                return &b->data[gp];
+
+            _get_block = next;
+            release_block(b);
+            b = next;
+        }
+    }
+
+    template <typename T>
+    pen_inline T* ring_buffer<T>::get()
+    {
+        T* item = check();
+        if (!item)
+            return nullptr;
+
+        block* b = _get_block;
+        b->get_pos = (b->get_pos + 1) % b->capacity;
+        --_size;
+
+        return item;
+    }
+
+    template <typename T>
+    inline ring_buffer_stats ring_buffer<T>::stats()
+    {
+        ring_buffer_stats rs;
+        rs.capacity = _put_block ? _put_block->capacity : 0;
+        rs.size = _size;
+        rs.high_water = _high_water;
+        rs.grows = _grows;
+        rs.stalls = _stalls;
+        return rs;
     }
 
     template <typename T>
@@ -461,4 +630,94 @@ namespace pen
     {
         return _data[_fb][slot];
     }
+
+    inline hash_index::~hash_index()
+    {
+        clear();
+    }
+
+    pen_inline bool hash_index::find(hash_id key, u32& value) const
+    {
+        if (key == 0)
+        {
+            value = _zero_value;
+            return _has_zero;
+        }
+
+        if (_size == 0)
+            return false;
+
+        u32 mask = _capacity - 1;
+        for (u32 i = key & mask;; i = (i + 1) & mask)
+        {
+            if (_keys[i] == key)
+            {
+                value = _values[i];
+                return true;
+            }
+
+            if (_keys[i] == 0)
+                return false;
+        }
+    }
+
+    inline void hash_index::insert(hash_id key, u32 value)
+    {
+        if (key == 0)
+        {
+            _has_zero = true;
+            _zero_value = value;
+            return;
+        }
+
+        if ((_size + 1) * 4 > _capacity * 3)
+            grow(_capacity ? _capacity * 2 : 64);
+
+        u32 mask = _capacity - 1;
+        u32 i = key & mask;
+        while (_keys[i] != 0 && _keys[i] != key)
+            i = (i + 1) & mask;
+
+        if (_keys[i] == 0)
+            ++_size;
+
+        _keys[i] = key;
+        _values[i] = value;
+    }
+
+    inline void hash_index::grow(u32 capacity)
+    {
+        hash_id* keys = _keys;
+        u32*     values = _values;
+        u32      old_capacity = _capacity;
+
+        _capacity = capacity;
+        _size = 0;
+        _keys = (hash_id*)pen::memory_alloc(sizeof(hash_id) * capacity);
+        _values = (u32*)pen::memory_alloc(sizeof(u32) * capacity);
+        memset(_keys, 0x0, sizeof(hash_id) * capacity);
+
+        for (u32 i = 0; i < old_capacity; ++i)
+            if (keys[i] != 0)
+                insert(keys[i], values[i]);
+
+        pen::memory_free(keys);
+        pen::memory_free(values);
+    }
+
+    inline void hash_index::clear()
+    {
+        pen::memory_free(_keys);
+        pen::memory_free(_values);
+        _keys = nullptr;
+        _values = nullptr;
+        _capacity = 0;
+        _size = 0;
+        _has_zero = false;
+    }
+
+    pen_inline u32 hash_index::size() const
+    {
+        return _size + (_has_zero ? 1 : 0);
+    }
 } // namespace pen
@@ -7,6 +7,8 @@
 // Can read files and also enumerate file system and volumes as an fs_tree_node.
 // Make sure to free p_buffer yourself allocated from filesystem_read_file_to_buffer.
 // Make sure to call filesystem_enum_free_mem with your fs_tree_node once finished with it.
+// filesystem_map_file maps a file read only without copying it, pages are read on demand from the os page cache.
+// the mapping is not null terminated, make sure to call filesystem_unmap_file once finished with it.
 
 // Implemented with:
 //      win32 (windows)
@@ -26,8 +28,17 @@ namespace pen
         u32           num_children = 0;
     };
 
+    struct mapped_file
+    {
+        const void* data = nullptr;
+        size_t      size = 0;
+        void*       handle = nullptr; // platform specific
+    };
+
     bool       filesystem_file_exists(const c8* filename);
     pen_error  filesystem_read_file_to_buffer(const c8* filename, void** p_buffer, u32& buffer_size);
+    pen_error  filesystem_map_file(const c8* filename, mapped_file& mapping);
+    void       filesystem_unmap_file(mapped_file& mapping);
     pen_error  filesystem_getmtime(const c8* filename, u32& mtime_out);
     size_t     filesystem_getsize(const c8* filename);
     void       filesystem_toggle_hidden_files();
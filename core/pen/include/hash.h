@@ -47,9 +47,20 @@ namespace pen
 
     uint32_t hashMurmur2A(char* _data);
 
+    // constexpr murmur2a producing the same value as hashMurmur2A, string literals hash to compile time constants
+    // so PEN_HASH("literal") can be used in constant expressions, switch cases and static_assert
+    template <size_t N>
+    constexpr hash_id hash_id_of(const char (&_data)[N]);
+
+    template <size_t N>
+    hash_id hash_id_of(char (&_data)[N]);
+
+    template <typename Ty>
+    hash_id hash_id_of(const Ty& _data);
+
     typedef HashMurmur2A hash_murmur;
 } // namespace pen
 
 #define _hash_h
-#define PEN_HASH(V) pen::hashMurmur2A(V)
+#define PEN_HASH(V) pen::hash_id_of(V)
 #include "hash.inl"
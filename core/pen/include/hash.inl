@@ -164,4 +164,98 @@ namespace pen
     {
         return hashMurmur2A(s.c_str());
     }
+
+    // constexpr murmur2a, c++11 constexpr functions are a single return so the loops are recursive
+    constexpr uint32_t k_murmur_m = 0x5bd1e995;
+
+    constexpr uint32_t constexpr_murmur_mix_k(uint32_t _k)
+    {
+        return (_k ^ (_k >> 24)) * k_murmur_m;
+    }
+
+    constexpr uint32_t constexpr_murmur_mix(uint32_t _h, uint32_t _k)
+    {
+        return (_h * k_murmur_m) ^ constexpr_murmur_mix_k(_k * k_murmur_m);
+    }
+
+    constexpr uint32_t constexpr_murmur_byte(const char* _data, uint32_t _i)
+    {
+        return (uint32_t)(uint8_t)_data[_i];
+    }
+
+    constexpr uint32_t constexpr_murmur_word(const char* _data, uint32_t _i)
+    {
+        return constexpr_murmur_byte(_data, _i) | constexpr_murmur_byte(_data, _i + 1) << 8 |
+               constexpr_murmur_byte(_data, _i + 2) << 16 | constexpr_murmur_byte(_data, _i + 3) << 24;
+    }
+
+    constexpr uint32_t constexpr_murmur_tail(const char* _data, uint32_t _i, uint32_t _len)
+    {
+        return _i < _len ? constexpr_murmur_byte(_data, _i) << ((_i & 3) * 8) | constexpr_murmur_tail(_data, _i + 1, _len)
+                         : 0;
+    }
+
+    constexpr uint32_t constexpr_murmur_avalanche(uint32_t _h)
+    {
+        return _h ^ (_h >> 15);
+    }
+
+    constexpr uint32_t constexpr_murmur_final(uint32_t _h)
+    {
+        return constexpr_murmur_avalanche((_h ^ (_h >> 13)) * k_murmur_m);
+    }
+
+    constexpr uint32_t constexpr_murmur_end(uint32_t _h, uint32_t _tail, uint32_t _len)
+    {
+        return constexpr_murmur_final(constexpr_murmur_mix(constexpr_murmur_mix(_h, _tail), _len));
+    }
+
+    constexpr uint32_t constexpr_murmur_blocks(const char* _data, uint32_t _i, uint32_t _len, uint32_t _h)
+    {
+        return _i + 4 <= _len
+                   ? constexpr_murmur_blocks(_data, _i + 4, _len, constexpr_murmur_mix(_h, constexpr_murmur_word(_data, _i)))
+                   : constexpr_murmur_end(_h, constexpr_murmur_tail(_data, _i, _len), _len);
+    }
+
+    constexpr uint32_t constexpr_strlen(const char* _data, uint32_t _max, uint32_t _i = 0)
+    {
+        return _i < _max && _data[_i] ? constexpr_strlen(_data, _max, _i + 1) : _i;
+    }
+
+    template <size_t N>
+    constexpr hash_id hash_id_of(const char (&_data)[N])
+    {
+        // arrays may contain data after the terminator, so hash up to the first null like strlen
+        return constexpr_murmur_blocks(_data, 0, constexpr_strlen(_data, N), 0);
+    }
+
+    template <size_t N>
+    inline hash_id hash_id_of(char (&_data)[N])
+    {
+        return hashMurmur2A((const char*)_data);
+    }
+
+    template <typename Ty>
+    inline hash_id hash_id_of(const Ty& _data)
+    {
+        return hashMurmur2A(_data);
+    }
+
+    // values from the runtime hashMurmur2A, covering each tail length
+    static_assert(PEN_HASH("") == 0x00000000, "constexpr murmur2a does not match hashMurmur2A");
+    static_assert(PEN_HASH("a") == 0x0803888b, "constexpr murmur2a does not match hashMurmur2A");
+    static_assert(PEN_HASH("ab") == 0x618515af, "constexpr murmur2a does not match hashMurmur2A");
+    static_assert(PEN_HASH("abc") == 0x11589f67, "constexpr murmur2a does not match hashMurmur2A");
+    static_assert(PEN_HASH("abcd") == 0x5c193c47, "constexpr murmur2a does not match hashMurmur2A");
+    static_assert(PEN_HASH("abcde") == 0x3254454d, "constexpr murmur2a does not match hashMurmur2A");
+    static_assert(PEN_HASH("abcdef") == 0xe140bde4, "constexpr murmur2a does not match hashMurmur2A");
+    static_assert(PEN_HASH("abcdefg") == 0x362d0a55, "constexpr murmur2a does not match hashMurmur2A");
+    static_assert(PEN_HASH("main_colour") == 0x6c08ef5f, "constexpr murmur2a does not match hashMurmur2A");
+
+    // bytes >= 0x80 are read unsigned whatever the signedness of char
+    static_assert(PEN_HASH("\x80") == 0x9c3f87f9, "constexpr murmur2a does not match hashMurmur2A");
+    static_assert(PEN_HASH("\xff\xfe") == 0xb4462fbd, "constexpr murmur2a does not match hashMurmur2A");
+    static_assert(PEN_HASH("\xc3\xa9t\xc3\xa9") == 0x686a82e6, "constexpr murmur2a does not match hashMurmur2A");
+    static_assert(PEN_HASH("\x80\x81\x82\x83\x84\x85\x86\x87\x88") == 0xd8506534,
+                  "constexpr murmur2a does not match hashMurmur2A");
 } // namespace pen
@@ -0,0 +1,42 @@
+// renderer_null.h
+// Copyright 2014 - 2023 Alex Dixon.
+// License: https://github.com/polymonster/pmtech/blob/master/license.md
+
+// Headless renderer backend, selected with --renderer=null. It executes the full pen::direct api without a device,
+// allocating real handles and keeping cpu copies of buffer data, and counts the work submitted each frame so the
+// cpu side of rendering can be benchmarked deterministically on machines without a gpu.
+
+#pragma once
+
+#include "types.h"
+
+namespace pen
+{
+    struct null_renderer_stats
+    {
+        u64 frames = 0;
+        u64 draws = 0;     // draw, draw_indexed and draw_indexed_instanced calls
+        u64 instances = 0; // instances drawn by draw_indexed_instanced
+        u64 indices = 0;
+        u64 vertices = 0;
+        u64 dispatches = 0;
+        u64 clears = 0;
+        u64 state_changes = 0;           // shader, input layout, raster, blend, depth stencil, targets, viewport, scissor
+        u64 redundant_state_changes = 0; // state set to the value already bound
+        u64 buffer_binds = 0;            // vertex, index, constant and structured buffers
+        u64 redundant_buffer_binds = 0;
+        u64 texture_binds = 0;
+        u64 redundant_texture_binds = 0;
+        u64 buffer_updates = 0;
+        u64 bytes_uploaded = 0; // buffer updates plus initial buffer and texture data
+        u64 resources_created = 0;
+        u64 resources_released = 0;
+    };
+
+    // stats for the last presented frame, safe to call from the user thread
+    const null_renderer_stats& null_renderer_frame_stats();
+
+    // running totals since init or the last reset, these are not synchronised so read them on the render thread
+    const null_renderer_stats& null_renderer_total_stats();
+    void                       null_renderer_reset_stats();
+} // namespace pen
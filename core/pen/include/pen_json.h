@@ -45,6 +45,18 @@
 // you will need to create copies of the objects and then manually recursively write the objects
 // back upwards once you have written to a value (leaf).
 
+// json_doc / json_view are a read only alternative which does not allocate after load.
+// the document is tokenised once, subtree extents and key hashes are cached per token, so member lookup compares
+// hashes while skipping whole subtrees and views are just a document pointer and a token index.
+//
+// json_doc* doc = json_doc::load_from_file("filename");
+// json_view v = doc->root();
+// u32 value = v["key"].as_u32();
+// u32 same = v.find(PEN_HASH("key")).as_u32();
+// for (json_view member : v)
+//        printf(member.key().c_str());
+// json_doc::release(doc);
+
 #pragma once
 
 #include "hash.h"
@@ -130,6 +142,86 @@ namespace pen
         void         copy(json* dst, const json& other);
     };
 
+    class json_doc;
+
+    class json_view
+    {
+      public:
+        class iterator
+        {
+          public:
+            iterator(const json_doc* doc, s32 tok, u32 remaining, bool object);
+            json_view operator*() const;
+            iterator& operator++();
+            bool      operator!=(const iterator& other) const;
+
+          private:
+            const json_doc* m_doc;
+            s32             m_tok;
+            u32             m_remaining;
+            bool            m_object;
+        };
+
+        json_view() = default;
+        json_view(const json_doc* doc, s32 tok, s32 key_tok = -1);
+
+        jsmntype_t type() const;
+        bool       is_null() const;
+        u32        size() const;
+
+        json_view operator[](const c8* name) const;
+        json_view operator[](const u32 index) const;
+        json_view operator[](const s32 index) const;
+        json_view find(hash_id id_key) const;
+
+        iterator begin() const;
+        iterator end() const;
+
+        Str     key() const; // allocates
+        hash_id key_hash() const;
+        bool    eq(const c8* str) const;
+
+        Str     as_str(const c8* default_value = nullptr) const; // allocates
+        hash_id as_hash_id(hash_id default_value = 0) const;
+        u32     as_u32(u32 default_value = 0) const;
+        s32     as_s32(s32 default_value = 0) const;
+        bool    as_bool(bool default_value = false) const;
+        f32     as_f32(f32 default_value = 0.0f) const;
+        u32     as_u32_hex(u32 default_value = 0) const;
+        Str     as_filename(const c8* default_value = nullptr) const; // allocates
+        json    to_json() const;                                      // allocates, for passing to the json api
+
+      private:
+        const jsmntok_t* token() const;
+        bool             primitive(c8* buf, u32 buf_size) const;
+
+        const json_doc* m_doc = nullptr;
+        s32             m_tok = -1;
+        s32             m_key = -1;
+    };
+
+    class json_doc
+    {
+      public:
+        static json_doc* load_from_file(const c8* filename);
+        static json_doc* load(const c8* json_str);
+        static void      release(json_doc* doc);
+
+        json_view root() const;
+
+      private:
+        friend class json_view;
+
+        static json_doc* create(c8* data, u32 size);
+
+        c8*        m_data = nullptr;
+        u32        m_size = 0;
+        jsmntok_t* m_tokens = nullptr;
+        s32        m_num_tokens = 0;
+        s32*       m_next = nullptr;    // index of the token after each tokens subtree
+        hash_id*   m_hashes = nullptr;  // hash of each tokens text, used for object keys
+    };
+
     // inline functions
     inline Str to_str(const c8* val)
     {
@@ -41,6 +41,9 @@
 namespace pen
 {
     typedef void* render_ctx;
+    typedef void* cmd_list;
+    typedef void* cmd_capture;
+    struct ring_buffer_stats;
 
     struct renderer_info
     {
@@ -379,6 +382,8 @@ namespace pen
     bool renderer_dispatch();
     void renderer_test_run();
     void renderer_test_enable();
+    void renderer_async_shaders_enable(); // opt in from -async_shaders, apps query it to compile shaders on the task system
+    bool renderer_async_shaders_enabled();
 
     // public-api will buffer all commands for dispatch on dedicated thread
     void       renderer_new_frame();
@@ -445,6 +450,39 @@ namespace pen
     void       renderer_update_queries();
     void       renderer_get_present_time(f32& cpu_ms, f32& gpu_ms);
 
+    // cmd lists, while a list is begun on a thread the public-api calls made on that thread are recorded into it instead
+    // of the render thread command buffer. lists can be recorded on workers in parallel and are submitted in order by the
+    // user thread, which resets them. state, draw, dispatch and update commands can be recorded, resources must be
+    // created and released on the user thread.
+    cmd_list renderer_create_cmd_list();
+    void     renderer_release_cmd_list(cmd_list list);
+    void     renderer_begin_cmd_list(cmd_list list);
+    void     renderer_end_cmd_list();
+    void     renderer_submit_cmd_lists(cmd_list* lists, u32 num_lists);
+
+    // command stream capture and replay. capture must be enabled before renderer_init, it serialises every command and
+    // payload executed on the render thread for num_frames presents and writes them to filename. a loaded capture can be
+    // replayed a frame at a time in place of the user thread commands, between renderer_new_frame and consume, on any
+    // backend which shares the shader platform. the profile records per command type counts and times on the render
+    // thread and present to present frame times, it takes effect from the next new frame.
+    void        renderer_capture_enable(const c8* filename, u32 num_frames);
+    cmd_capture renderer_load_capture(const c8* filename);
+    void        renderer_release_capture(cmd_capture capture);
+    u32         renderer_capture_num_frames(cmd_capture capture);
+    void        renderer_replay_capture_frame(cmd_capture capture, u32 frame);
+    void        renderer_enable_cmd_profile(bool enable);
+    void        renderer_report_cmd_profile();
+
+    // command ring stats, the cmd buffer grows up to 8x max_renderer_commands when the render thread falls behind and
+    // then blocks the submitting thread until it catches up. the release buffer holds deferred releases and never blocks.
+    void renderer_cmd_buffer_stats(ring_buffer_stats& cmd, ring_buffer_stats& release);
+
+    // program cache, linked gl program binaries and the vulkan pipeline cache are written to filename at shutdown and
+    // reused on the next run to skip shader compilation and linking. when set after renderer_init the cache is loaded on
+    // the render thread in command order, so it must be set before any shaders are loaded. backends without program
+    // binaries ignore it.
+    void renderer_set_program_cache(const c8* filename);
+
     namespace direct
     {
         // Platform specific implementation, implements these function
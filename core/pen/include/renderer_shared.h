@@ -52,6 +52,15 @@ namespace pen
     size_t       _renderer_buffer_multi_update(stretchy_dynamic_buffer* buf, const void* data, size_t size);
     stretchy_dynamic_buffer* _renderer_get_stretchy_dynamic_buffer(u32 bind_flags);
 
+    // program cache, backends store linked programs or pipeline cache data as blobs by key. the file set with
+    // renderer_set_program_cache is loaded once, at initialise or when it is set, and written at shutdown if anything
+    // new was stored
+    void        _renderer_program_cache_open(const c8* filename);
+    void        _renderer_program_cache_load();
+    void        _renderer_program_cache_save();
+    const void* _renderer_program_cache_find(hash_id key, u32& size);
+    void        _renderer_program_cache_store(hash_id key, const void* data, u32 size);
+
     // thread safe utilities
     viewport _renderer_resolve_viewport_ratio(const viewport& v);
     rect     _renderer_resolve_scissor_ratio(const rect& r);
@@ -4,6 +4,7 @@
 
 // Minimalist cross platform thread wrapper api.
 // Includes functions to create jobs, threads, mutex and semaphore.
+// And a work stealing task system with a pool of workers sized to the core count, counters and parallel_for.
 
 #pragma once
 
@@ -18,6 +19,8 @@ namespace pen
     typedef void (*completion_callback)(void*);
     typedef void* (*dispatch_thread)(void*);
     typedef loop_t (*single_thread_update_func)();
+    typedef void (*task_func)(void*);
+    typedef void (*parallel_for_func)(u32 start, u32 end, void* user_data);
 
     // A Job is just a thread with some user data, a callback
     // and some syncronisation semaphores
@@ -59,10 +62,27 @@ namespace pen
         void* user_thread_params;
     };
 
+    // A task is a small unit of work executed by the task system worker threads, tasks are
+    // tracked by a counter which is incremented on submit and decremented when each task completes
+
+    struct task
+    {
+        task_func func = nullptr;
+        void*     user_data = nullptr;
+    };
+
+    struct task_counter
+    {
+        a_u32 value = {0};
+        a_u32 generation = {0}; // incremented each time the counter goes from complete to busy
+        a_u32 dependents = {0}; // batches from jobs_run_tasks_after still waiting on this counter
+    };
+
     // Threads
     thread* thread_create(dispatch_thread thread_func, u32 stack_size, void* thread_params, thread_start_flags flags);
     void    thread_sleep_ms(u32 milliseconds);
     void    thread_sleep_us(u32 microseconds);
+    u32     thread_get_hardware_concurrency();
 
     // Jobs
     bool jobs_terminate_all();
@@ -71,6 +91,23 @@ namespace pen
     void jobs_create_single_thread_update(single_thread_update_func func);
     void jobs_run_single_threaded();
 
+    // Tasks
+    // the task system is lazily created on first use with (cores - 1) workers, the calling thread helps out while waiting.
+    // with PEN_SINGLE_THREADED or 0 workers, tasks are executed inline on the calling thread.
+    // a dependency must stay alive until its batch is released, jobs_wait_for_counter on the dependency guarantees that.
+    // batches wait on the work in flight at submit, if the counter is reused they do not wait on the new work.
+    void jobs_init_task_system(u32 num_workers = 0); // 0 = hardware concurrency - 1
+    void jobs_shutdown_task_system();                // wakes and waits for the workers, called by jobs_terminate_all
+    u32  jobs_get_num_workers();
+    void jobs_run_tasks(const task* tasks, u32 count, task_counter* counter);
+    void jobs_run_tasks_after(const task_counter* dependency, const task* tasks, u32 count, task_counter* counter);
+    void jobs_wait_for_counter(task_counter* counter); // also waits for batches which depend on the counter
+    bool jobs_counter_complete(const task_counter* counter);
+
+    // splits [0, range) into chunks of grain size and calls fn(start, end, user_data) for each chunk across the workers
+    // returns once all chunks are complete.
+    void parallel_for(u32 range, u32 grain, parallel_for_func fn, void* user_data);
+
     // Mutex
     mutex* mutex_create();
     void   mutex_destroy(mutex* p_mutex);
@@ -1115,7 +1115,9 @@ namespace pen
         bd.CPUAccessFlags = to_d3d11_cpu_access_flags(params.cpu_access_flags);
         bd.ByteWidth = params.buffer_size;
 
-        if (bd.BindFlags & PEN_BIND_SHADER_WRITE)
+        // structured buffers, read only shader resources or rw
+        bool structured = params.stride && (params.bind_flags & (PEN_BIND_SHADER_WRITE | PEN_BIND_SHADER_RESOURCE));
+        if (structured)
         {
             bd.MiscFlags |= D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
             bd.StructureByteStride = params.stride;
@@ -1135,7 +1137,7 @@ namespace pen
             CHECK_CALL(s_device->CreateBuffer(&bd, nullptr, &_res_pool[resource_index].generic_buffer.buf));
         }
 
-        if (bd.BindFlags & PEN_BIND_SHADER_WRITE)
+        if (params.bind_flags & PEN_BIND_SHADER_WRITE)
         {
             // uav if we need it
             D3D11_UNORDERED_ACCESS_VIEW_DESC uav_desc = {};
@@ -1146,7 +1148,10 @@ namespace pen
 
             CHECK_CALL(s_device->CreateUnorderedAccessView(_res_pool[resource_index].generic_buffer.buf, &uav_desc,
                                                            &_res_pool[resource_index].generic_buffer.uav));
+        }
 
+        if (structured)
+        {
             // srv if we need it
             D3D11_SHADER_RESOURCE_VIEW_DESC srv_desc = {};
             srv_desc.ViewDimension = D3D11_SRV_DIMENSION_BUFFEREX;
@@ -132,7 +132,7 @@ namespace pen
 {
     void input_add_unicode_input(const c8* utf8)
     {
-        if (s_unicode_ring.data == nullptr)
+        if (!s_unicode_ring.created())
             s_unicode_ring.create(128);
 
         s_unicode_ring.put(Str(utf8));
@@ -7,7 +7,12 @@
 #include "renderer.h"
 #include "threads.h"
 
+#if !PEN_SINGLE_THREADED
+#include <thread>
+#endif
+
 #define MAX_THREADS 32 // lazy fixed sized array to avoid any thread saftey issues
+#define MAX_WORKERS 64 // task system workers, sized to hardware concurrency and clamped
 
 using namespace pen;
 
@@ -18,6 +23,307 @@ namespace
     single_thread_update_func* s_single_thread_funcs = nullptr;
 } // namespace
 
+#if !PEN_SINGLE_THREADED
+namespace
+{
+    struct task_entry
+    {
+        task          t;
+        task_counter* counter;
+    };
+
+    void execute_task(const task_entry& te)
+    {
+        te.t.func(te.t.user_data);
+        if (te.counter)
+            te.counter->value--;
+    }
+
+    // chase-lev work stealing deque, the owning thread pushes and pops from the bottom, thieves steal from the top.
+    struct task_deque
+    {
+        static const s64 k_capacity = 4096; // must be po2
+        static const s64 k_mask = k_capacity - 1;
+
+        std::atomic<s64> top = {0};
+        std::atomic<s64> bottom = {0};
+        task_entry       entries[k_capacity];
+
+        bool push(const task_entry& te)
+        {
+            s64 b = bottom.load(std::memory_order_relaxed);
+            s64 t = top.load(std::memory_order_acquire);
+            if (b - t >= k_capacity)
+                return false;
+
+            entries[b & k_mask] = te;
+            std::atomic_thread_fence(std::memory_order_release);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return true;
+        }
+
+        bool pop(task_entry& out)
+        {
+            s64 b = bottom.load(std::memory_order_relaxed) - 1;
+            bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            s64 t = top.load(std::memory_order_relaxed);
+
+            if (t > b)
+            {
+                // empty
+                bottom.store(b + 1, std::memory_order_relaxed);
+                return false;
+            }
+
+            out = entries[b & k_mask];
+            if (t != b)
+                return true;
+
+            // last item, race against thieves
+            bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+
+        bool steal(task_entry& out)
+        {
+            s64 t = top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            s64 b = bottom.load(std::memory_order_acquire);
+
+            if (t >= b)
+                return false;
+
+            out = entries[t & k_mask];
+            return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        }
+    };
+
+    // tasks submitted from threads which are not workers go into a shared locked queue
+    struct task_inject_queue
+    {
+        pen::mutex* mtx = nullptr;
+        task_entry* entries = nullptr;
+        u32         head = 0;
+        a_u32       count = {0};
+    };
+
+    // batches waiting on a dependency counter before they can be submitted, the generation of the dependency is
+    // snapshot so a counter which is reused and becomes busy again still releases batches waiting on the earlier work
+    struct task_pending_batch
+    {
+        task_counter* dependency;
+        u32           generation;
+        task*         tasks;
+        u32           count;
+        task_counter* counter;
+    };
+
+    struct task_system
+    {
+        a_u32               init_state = {0}; // 0 = uninit, 1 = initialising, 2 = ready, 3 = shut down
+        u32                 num_workers = 0;
+        task_deque*         deques = nullptr; // num_workers
+        task_inject_queue   inject;
+        pen::semaphore*     work_sem = nullptr;
+        pen::semaphore*     exit_sem = nullptr; // posted by each worker as it exits
+        pen::mutex*         pending_mtx = nullptr;
+        task_pending_batch* pending = nullptr;
+        a_u32               num_pending = {0};
+        a_u32               num_sleeping = {0};
+        a_u32               exit = {0};
+    };
+    task_system s_ts;
+
+    thread_local s32 t_worker_index = -1;
+    thread_local u32 t_steal_seed = 0;
+
+    void wake_workers(u32 count)
+    {
+        u32 sleeping = s_ts.num_sleeping;
+        u32 n = min(count, sleeping);
+        for (u32 i = 0; i < n; ++i)
+            semaphore_post(s_ts.work_sem, 1);
+    }
+
+    void inject_push(const task_entry& te)
+    {
+        mutex_lock(s_ts.inject.mtx);
+        sb_push(s_ts.inject.entries, te);
+        s_ts.inject.count++;
+        mutex_unlock(s_ts.inject.mtx);
+    }
+
+    bool inject_pop(task_entry& out)
+    {
+        if (s_ts.inject.count == 0)
+            return false;
+
+        bool found = false;
+        mutex_lock(s_ts.inject.mtx);
+        u32 num = sb_count(s_ts.inject.entries);
+        if (s_ts.inject.head < num)
+        {
+            out = s_ts.inject.entries[s_ts.inject.head++];
+            s_ts.inject.count--;
+            found = true;
+
+            // reset storage once drained so it does not grow unbounded
+            if (s_ts.inject.head == num)
+            {
+                stb__sbn(s_ts.inject.entries) = 0;
+                s_ts.inject.head = 0;
+            }
+        }
+        mutex_unlock(s_ts.inject.mtx);
+        return found;
+    }
+
+    void push_task(const task_entry& te)
+    {
+        if (t_worker_index >= 0)
+            if (s_ts.deques[t_worker_index].push(te))
+                return;
+
+        inject_push(te);
+    }
+
+    bool find_task(task_entry& out)
+    {
+        // own deque first
+        if (t_worker_index >= 0)
+            if (s_ts.deques[t_worker_index].pop(out))
+                return true;
+
+        if (inject_pop(out))
+            return true;
+
+        // steal from a random victim and sweep the rest
+        u32 nw = s_ts.num_workers;
+        if (nw == 0)
+            return false;
+
+        t_steal_seed = t_steal_seed * 1664525 + 1013904223;
+        u32 start = t_steal_seed % nw;
+        for (u32 i = 0; i < nw; ++i)
+        {
+            u32 victim = (start + i) % nw;
+            if ((s32)victim == t_worker_index)
+                continue;
+
+            if (s_ts.deques[victim].steal(out))
+                return true;
+        }
+
+        return false;
+    }
+
+    void release_pending_batches()
+    {
+        if (s_ts.num_pending == 0)
+            return;
+
+        task_pending_batch* ready = nullptr;
+
+        mutex_lock(s_ts.pending_mtx);
+        u32 num = sb_count(s_ts.pending);
+        for (s32 i = (s32)num - 1; i >= 0; --i)
+        {
+            task_counter* dep = s_ts.pending[i].dependency;
+            if (pen_atomic_load(dep->value) != 0 && pen_atomic_load(dep->generation) == s_ts.pending[i].generation)
+                continue;
+
+            sb_push(ready, s_ts.pending[i]);
+            s_ts.pending[i] = sb_last(s_ts.pending);
+            stb__sbn(s_ts.pending)--;
+            s_ts.num_pending--;
+
+            // last access to the dependency, waiters on it may return once this reaches 0
+            dep->dependents--;
+        }
+        mutex_unlock(s_ts.pending_mtx);
+
+        u32 nr = sb_count(ready);
+        for (u32 i = 0; i < nr; ++i)
+        {
+            for (u32 t = 0; t < ready[i].count; ++t)
+                push_task({ready[i].tasks[t], ready[i].counter});
+
+            wake_workers(ready[i].count);
+            pen::memory_free(ready[i].tasks);
+        }
+
+        sb_free(ready);
+    }
+
+    bool run_one_task()
+    {
+        task_entry te;
+        if (!find_task(te))
+            return false;
+
+        execute_task(te);
+        release_pending_batches();
+        return true;
+    }
+
+    void* worker_thread(void* params)
+    {
+        t_worker_index = (s32)(intptr_t)params;
+        t_steal_seed = (u32)t_worker_index + 1;
+
+        while (!s_ts.exit)
+        {
+            if (run_one_task())
+                continue;
+
+            // spin a little before sleeping to catch bursts of work
+            bool found = false;
+            for (u32 i = 0; i < 64; ++i)
+            {
+                std::this_thread::yield();
+                if (run_one_task())
+                {
+                    found = true;
+                    break;
+                }
+            }
+
+            if (found)
+                continue;
+
+            // check once more after registering as sleeping, so a submit which saw no sleepers is not missed
+            s_ts.num_sleeping++;
+            if (run_one_task())
+            {
+                s_ts.num_sleeping--;
+                continue;
+            }
+
+            semaphore_wait(s_ts.work_sem);
+            s_ts.num_sleeping--;
+        }
+
+        semaphore_post(s_ts.exit_sem, 1);
+        return nullptr;
+    }
+
+    bool task_system_ready()
+    {
+        if (s_ts.init_state == 2)
+            return true;
+
+        // after shutdown tasks execute inline
+        if (s_ts.init_state == 3)
+            return false;
+
+        jobs_init_task_system(0);
+        return s_ts.init_state == 2;
+    }
+} // namespace
+#endif
+
 namespace pen
 {
     pen::job* jobs_create_job(dispatch_thread thread_func, u32 stack_size, void* user_data, thread_start_flags flags,
@@ -63,6 +369,8 @@ namespace pen
             }
         }
 
+        // all jobs have exited so nothing else can submit tasks
+        jobs_shutdown_task_system();
         return true;
     }
 
@@ -79,4 +387,268 @@ namespace pen
             ((single_thread_update_func)s_single_thread_funcs[i])();
         }
     }
+
+#if PEN_SINGLE_THREADED
+    // no worker threads, everything executes inline on the calling thread
+    void jobs_init_task_system(u32 num_workers)
+    {
+    }
+
+    void jobs_shutdown_task_system()
+    {
+    }
+
+    u32 jobs_get_num_workers()
+    {
+        return 0;
+    }
+
+    void jobs_run_tasks(const task* tasks, u32 count, task_counter* counter)
+    {
+        for (u32 i = 0; i < count; ++i)
+            tasks[i].func(tasks[i].user_data);
+    }
+
+    void jobs_run_tasks_after(const task_counter* dependency, const task* tasks, u32 count, task_counter* counter)
+    {
+        // dependencies have always completed by the time they return
+        jobs_run_tasks(tasks, count, counter);
+    }
+
+    void jobs_wait_for_counter(task_counter* counter)
+    {
+    }
+
+    bool jobs_counter_complete(const task_counter* counter)
+    {
+        return true;
+    }
+
+    void parallel_for(u32 range, u32 grain, parallel_for_func fn, void* user_data)
+    {
+        if (range > 0)
+            fn(0, range, user_data);
+    }
+#else
+    void jobs_init_task_system(u32 num_workers)
+    {
+        u32 expected = 0;
+        if (!s_ts.init_state.compare_exchange_strong(expected, 1))
+        {
+            // another thread is initialising
+            while (s_ts.init_state == 1)
+                std::this_thread::yield();
+            return;
+        }
+
+        if (num_workers == 0)
+        {
+            u32 hc = thread_get_hardware_concurrency();
+            num_workers = hc > 1 ? hc - 1 : 0;
+        }
+        num_workers = min<u32>(num_workers, MAX_WORKERS);
+
+        s_ts.inject.mtx = mutex_create();
+        s_ts.pending_mtx = mutex_create();
+        s_ts.work_sem = semaphore_create(0, 0x7fffffff);
+        s_ts.exit_sem = semaphore_create(0, 0x7fffffff);
+        s_ts.deques = new task_deque[max<u32>(num_workers, 1)];
+        s_ts.num_workers = num_workers;
+
+        for (u32 i = 0; i < num_workers; ++i)
+            thread_create(worker_thread, 1024 * 1024, (void*)(intptr_t)i, e_thread_start_flags::detached);
+
+        s_ts.init_state = 2;
+    }
+
+    void jobs_shutdown_task_system()
+    {
+        u32 expected = 2;
+        if (!s_ts.init_state.compare_exchange_strong(expected, 3))
+        {
+            // never started, stop a later lazy init
+            expected = 0;
+            s_ts.init_state.compare_exchange_strong(expected, 3);
+            return;
+        }
+
+        // wake every worker and wait for them to leave the loop, the workers are detached so they signal as they exit
+        s_ts.exit = 1;
+        for (u32 i = 0; i < s_ts.num_workers; ++i)
+            semaphore_post(s_ts.work_sem, 1);
+
+        for (u32 i = 0; i < s_ts.num_workers; ++i)
+            semaphore_wait(s_ts.exit_sem);
+
+        u32 num_pending = sb_count(s_ts.pending);
+        for (u32 i = 0; i < num_pending; ++i)
+            pen::memory_free(s_ts.pending[i].tasks);
+
+        sb_free(s_ts.pending);
+        sb_free(s_ts.inject.entries);
+        delete[] s_ts.deques;
+        semaphore_destroy(s_ts.work_sem);
+        semaphore_destroy(s_ts.exit_sem);
+        mutex_destroy(s_ts.inject.mtx);
+        mutex_destroy(s_ts.pending_mtx);
+
+        s_ts.pending = nullptr;
+        s_ts.inject.entries = nullptr;
+        s_ts.deques = nullptr;
+        s_ts.num_workers = 0;
+    }
+
+    u32 jobs_get_num_workers()
+    {
+        if (!task_system_ready())
+            return 0;
+
+        return s_ts.num_workers;
+    }
+
+    void jobs_run_tasks(const task* tasks, u32 count, task_counter* counter)
+    {
+        if (!task_system_ready() || s_ts.num_workers == 0)
+        {
+            for (u32 i = 0; i < count; ++i)
+                tasks[i].func(tasks[i].user_data);
+            return;
+        }
+
+        // a counter becoming busy starts a new generation, batches waiting on the previous one are released
+        if (counter)
+            if (counter->value.fetch_add(count) == 0)
+                counter->generation++;
+
+        for (u32 i = 0; i < count; ++i)
+            push_task({tasks[i], counter});
+
+        wake_workers(count);
+    }
+
+    void jobs_run_tasks_after(const task_counter* dependency, const task* tasks, u32 count, task_counter* counter)
+    {
+        if (!dependency || jobs_counter_complete(dependency) || !task_system_ready() || s_ts.num_workers == 0)
+        {
+            // wait inline when there are no workers to defer to
+            if (dependency)
+                jobs_wait_for_counter((task_counter*)dependency);
+
+            jobs_run_tasks(tasks, count, counter);
+            return;
+        }
+
+        if (counter)
+            if (counter->value.fetch_add(count) == 0)
+                counter->generation++;
+
+        // waiters on the dependency do not return until the batch has been released, see jobs_wait_for_counter
+        task_counter* dep = (task_counter*)dependency;
+        dep->dependents++;
+
+        task_pending_batch batch;
+        batch.dependency = dep;
+        batch.generation = pen_atomic_load(dep->generation);
+        batch.tasks = (task*)pen::memory_alloc(sizeof(task) * count);
+        batch.count = count;
+        batch.counter = counter;
+        memcpy(batch.tasks, tasks, sizeof(task) * count);
+
+        mutex_lock(s_ts.pending_mtx);
+        sb_push(s_ts.pending, batch);
+        s_ts.num_pending++;
+        mutex_unlock(s_ts.pending_mtx);
+
+        // the dependency may have completed while we were adding
+        release_pending_batches();
+    }
+
+    void jobs_wait_for_counter(task_counter* counter)
+    {
+        while (counter->value != 0 || counter->dependents != 0)
+        {
+            // help out while we wait
+            if (!run_one_task())
+            {
+                release_pending_batches();
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    bool jobs_counter_complete(const task_counter* counter)
+    {
+        return pen_atomic_load(counter->value) == 0;
+    }
+
+    namespace
+    {
+        struct parallel_for_ctx
+        {
+            parallel_for_func fn;
+            void*             user_data;
+            u32               range;
+            u32               grain;
+            u32               num_chunks;
+            a_u32             next_chunk = {0};
+        };
+
+        void parallel_for_task(void* params)
+        {
+            parallel_for_ctx* ctx = (parallel_for_ctx*)params;
+
+            // grab chunks until the range is exhausted, this balances uneven chunk costs across workers
+            for (;;)
+            {
+                u32 c = ctx->next_chunk++;
+                if (c >= ctx->num_chunks)
+                    break;
+
+                u32 start = c * ctx->grain;
+                u32 end = min(start + ctx->grain, ctx->range);
+                ctx->fn(start, end, ctx->user_data);
+            }
+        }
+    } // namespace
+
+    void parallel_for(u32 range, u32 grain, parallel_for_func fn, void* user_data)
+    {
+        if (range == 0)
+            return;
+
+        grain = max<u32>(grain, 1);
+        u32 num_chunks = (range + grain - 1) / grain;
+
+        if (num_chunks == 1 || !task_system_ready() || s_ts.num_workers == 0)
+        {
+            fn(0, range, user_data);
+            return;
+        }
+
+        parallel_for_ctx ctx;
+        ctx.fn = fn;
+        ctx.user_data = user_data;
+        ctx.range = range;
+        ctx.grain = grain;
+        ctx.num_chunks = num_chunks;
+
+        // one task per helper, the calling thread takes a share too
+        static const u32 k_max_tasks = MAX_WORKERS;
+        u32              num_tasks = min<u32>(min<u32>(num_chunks - 1, s_ts.num_workers), k_max_tasks);
+
+        task tasks[k_max_tasks];
+        for (u32 i = 0; i < num_tasks; ++i)
+        {
+            tasks[i].func = parallel_for_task;
+            tasks[i].user_data = &ctx;
+        }
+
+        task_counter counter;
+        jobs_run_tasks(tasks, num_tasks, &counter);
+
+        parallel_for_task(&ctx);
+
+        jobs_wait_for_counter(&counter);
+    }
+#endif
 } // namespace pen
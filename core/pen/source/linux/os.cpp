@@ -1,7 +1,9 @@
 // os.cpp
 // Copyright 2014 - 2023 Alex Dixon.
 // License: https://github.com/polymonster/pmtech/blob/master/license.md
+#ifndef PEN_RENDERER_NULL
 #include "GL/glew.h"
+#endif
 
 #include "console.h"
 #include "hash.h"
@@ -21,9 +23,12 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+// the null renderer is headless and builds without gl or x11
+#ifndef PEN_RENDERER_NULL
 #include <GL/glx.h>
 #include <GL/glxext.h>
 #include <X11/Xlib.h>
+#endif
 
 using namespace pen;
 
@@ -31,6 +36,7 @@ using namespace pen;
 window_creation_params pen_window;
 pen::user_info         pen_user_info;
 
+#ifndef PEN_RENDERER_NULL
 // glx / gl stuff
 #define GLX_CONTEXT_MAJOR_VERSION_ARB 0x2091
 #define GLX_CONTEXT_MINOR_VERSION_ARB 0x2092
@@ -61,12 +67,15 @@ void pen_gl_swap_buffers()
 {
     glXSwapBuffers(_display, _window);
 }
+#endif
 
 namespace
 {
-    XIM          _xim;
-    XIC          _xic;
-    bool         _ctx_error_occured = false;
+#ifndef PEN_RENDERER_NULL
+    XIM  _xim;
+    XIC  _xic;
+    bool _ctx_error_occured = false;
+#endif
     window_frame _window_frame;
     bool         _invalidate_window_frame = false;
 
@@ -82,13 +91,32 @@ namespace
         pen_user_info.user_name = &homedir[6];
     }
 
+#ifndef PEN_RENDERER_NULL
     int ctx_error_handler(Display* dpy, XErrorEvent* ev)
     {
         PEN_LOG("CONTEXT ERROR %i", ev->error_code);
         _ctx_error_occured = true;
         return 0;
     }
+#endif
 
+    // -capture <filename> <num_frames>, -program_cache <filename>, -async_shaders
+    void parse_capture_args(int argc, char** argv)
+    {
+        for (int i = 1; i + 2 < argc; ++i)
+            if (strcmp(argv[i], "-capture") == 0)
+                pen::renderer_capture_enable(argv[i + 1], (u32)atoi(argv[i + 2]));
+
+        for (int i = 1; i + 1 < argc; ++i)
+            if (strcmp(argv[i], "-program_cache") == 0)
+                pen::renderer_set_program_cache(argv[i + 1]);
+
+        for (int i = 1; i < argc; ++i)
+            if (strcmp(argv[i], "-async_shaders") == 0)
+                pen::renderer_async_shaders_enable();
+    }
+
+#ifndef PEN_RENDERER_NULL
     int pen_run_windowed(int argc, char** argv)
     {
         Visual*              visual;
@@ -227,6 +255,8 @@ namespace
             }
         }
 
+        parse_capture_args(argc, argv);
+
         // inits renderer and loops in wait for jobs, calling os update
         renderer_init(nullptr, true, s_creation_params.max_renderer_commands);
 
@@ -238,6 +268,18 @@ namespace
 
         return s_error_code;
     }
+#else
+    int pen_run_headless(int argc, char** argv)
+    {
+        parse_capture_args(argc, argv);
+
+        // the null renderer needs no window or gl context, commands are executed on this thread
+        renderer_init(nullptr, true, s_creation_params.max_renderer_commands);
+
+        pen::jobs_terminate_all();
+        return s_error_code;
+    }
+#endif
 
     int pen_run_console_app()
     {
@@ -253,6 +295,7 @@ namespace
         return s_error_code;
     }
 
+#ifndef PEN_RENDERER_NULL
     s32 translate_mouse_button(s32 b)
     {
         static f32 mw = 0.0f;
@@ -509,6 +552,7 @@ namespace
 
         pen::input_gamepad_update();
     }
+#endif
 } // namespace
 
 int main(int argc, char* argv[])
@@ -527,7 +571,11 @@ int main(int argc, char* argv[])
 
     if (pc.flags & e_pen_create_flags::renderer)
     {
+#ifdef PEN_RENDERER_NULL
+        pen_run_headless(argc, argv);
+#else
         pen_run_windowed(argc, argv);
+#endif
     }
     else
     {
@@ -555,8 +603,10 @@ namespace pen
             init_jobs = true;
         }
 
+#ifndef PEN_RENDERER_NULL
         if (s_windowed)
             update_window();
+#endif
 
         // Check for terminate and poll terminated jobs
         if (s_pen_terminate_app)
@@ -581,7 +631,11 @@ namespace pen
 
     void* window_get_primary_display_handle()
     {
+#ifndef PEN_RENDERER_NULL
         return (void*)(intptr_t)_window;
+#else
+        return nullptr;
+#endif
     }
 
     void window_get_size(s32& width, s32& height)
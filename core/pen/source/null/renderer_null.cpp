@@ -0,0 +1,585 @@
+// renderer_null.cpp
+// Copyright 2014 - 2023 Alex Dixon.
+// License: https://github.com/polymonster/pmtech/blob/master/license.md
+
+#include "renderer_null.h"
+#include "console.h"
+#include "data_struct.h"
+#include "memory.h"
+#include "renderer.h"
+#include "renderer_shared.h"
+
+#include <algorithm>
+
+extern pen::window_creation_params pen_window;
+using namespace pen;
+
+namespace
+{
+    namespace e_null_resource
+    {
+        enum null_resource_t
+        {
+            none,
+            clear_state,
+            shader,
+            input_layout,
+            buffer,
+            texture,
+            render_target,
+            sampler,
+            raster_state,
+            blend_state,
+            depth_stencil_state
+        };
+    }
+
+    struct null_resource
+    {
+        u32 type;
+        u8* data; // cpu copy of buffer contents
+        u32 size;
+        u32 width;
+        u32 height;
+        u32 num_arrays;
+    };
+
+    static const u32 k_max_shader_types = 8;
+    static const u32 k_max_bind_units = 32;
+    static const u32 k_max_vertex_streams = 8;
+
+    // currently bound state, to count redundant changes
+    struct null_state
+    {
+        u32 shader[k_max_shader_types];
+        u32 input_layout;
+        u32 raster_state;
+        u32 blend_state;
+        u32 depth_stencil_state;
+        u32 stencil_ref;
+        u32 vertex_buffer[k_max_vertex_streams];
+        u32 vertex_offset[k_max_vertex_streams];
+        u32 index_buffer;
+        u32 constant_buffer[k_max_bind_units];
+        u32 structured_buffer[k_max_bind_units];
+        u32 texture[k_max_bind_units];
+        u32 sampler[k_max_bind_units];
+    };
+
+    res_pool<null_resource>              s_res_pool;
+    null_state                           s_state;
+    null_renderer_stats                  s_total;
+    multi_buffer<null_renderer_stats, 2> s_frame; // backbuffer is counted by the render thread, front is the last frame
+
+    void reset_state()
+    {
+        memset(&s_state, 0xff, sizeof(null_state));
+    }
+
+    null_renderer_stats& frame_stats()
+    {
+        return s_frame.backbuffer();
+    }
+
+    void create_resource(u32 resource_slot, u32 type)
+    {
+        null_resource res = {};
+        res.type = type;
+        s_res_pool.insert(res, resource_slot);
+
+        frame_stats().resources_created++;
+    }
+
+    void release_resource(u32 resource_slot)
+    {
+        null_resource& res = s_res_pool.get(resource_slot);
+        memory_free(res.data);
+        memset(&res, 0x0, sizeof(null_resource));
+
+        frame_stats().resources_released++;
+    }
+
+    // returns true if the value changed
+    bool track(u32& cur, u32 value)
+    {
+        bool changed = cur != value;
+        cur = value;
+        return changed;
+    }
+
+    void state_change(u32& cur, u32 value)
+    {
+        if (track(cur, value))
+            frame_stats().state_changes++;
+        else
+            frame_stats().redundant_state_changes++;
+    }
+
+    void buffer_bind(u32* cur, u32 value)
+    {
+        if (!cur || track(*cur, value))
+            frame_stats().buffer_binds++;
+        else
+            frame_stats().redundant_buffer_binds++;
+    }
+
+    void accumulate(null_renderer_stats& total, const null_renderer_stats& frame)
+    {
+        total.frames += frame.frames;
+        total.draws += frame.draws;
+        total.instances += frame.instances;
+        total.indices += frame.indices;
+        total.vertices += frame.vertices;
+        total.dispatches += frame.dispatches;
+        total.clears += frame.clears;
+        total.state_changes += frame.state_changes;
+        total.redundant_state_changes += frame.redundant_state_changes;
+        total.buffer_binds += frame.buffer_binds;
+        total.redundant_buffer_binds += frame.redundant_buffer_binds;
+        total.texture_binds += frame.texture_binds;
+        total.redundant_texture_binds += frame.redundant_texture_binds;
+        total.buffer_updates += frame.buffer_updates;
+        total.bytes_uploaded += frame.bytes_uploaded;
+        total.resources_created += frame.resources_created;
+        total.resources_released += frame.resources_released;
+    }
+} // namespace
+
+namespace pen
+{
+    a_u64 g_gpu_total;
+
+    const null_renderer_stats& null_renderer_frame_stats()
+    {
+        return s_frame.frontbuffer();
+    }
+
+    const null_renderer_stats& null_renderer_total_stats()
+    {
+        return s_total;
+    }
+
+    void null_renderer_reset_stats()
+    {
+        s_total = null_renderer_stats();
+    }
+
+    static renderer_info s_renderer_info;
+    const renderer_info& renderer_get_info()
+    {
+        s_renderer_info.api_version = "";
+        s_renderer_info.shader_version = "";
+        s_renderer_info.renderer = "Null";
+        s_renderer_info.vendor = "";
+        s_renderer_info.renderer_cmd = "-renderer null";
+        s_renderer_info.caps = PEN_CAPS_VUP | PEN_CAPS_COMPUTE | PEN_CAPS_DEPTH_CLAMP | PEN_CAPS_TEXTURE_CUBE_ARRAY |
+                               PEN_CAPS_TEXTURE_MULTISAMPLE | PEN_CAPS_TEX_FORMAT_BC1 | PEN_CAPS_TEX_FORMAT_BC2 |
+                               PEN_CAPS_TEX_FORMAT_BC3 | PEN_CAPS_TEX_FORMAT_BC4 | PEN_CAPS_TEX_FORMAT_BC5;
+        return s_renderer_info;
+    }
+
+    // pmfx loads shader info and techniques from the glsl data built for linux, shader code itself is never compiled
+    const c8* renderer_get_shader_platform()
+    {
+        return "glsl";
+    }
+
+    bool renderer_viewport_vup()
+    {
+        return true;
+    }
+
+    bool renderer_depth_0_to_1()
+    {
+        return false;
+    }
+
+    namespace direct
+    {
+        u32 renderer_initialise(void* params, u32 bb_res, u32 bb_depth_res)
+        {
+            s_res_pool.init(4096);
+            reset_state();
+
+            create_resource(bb_res, e_null_resource::render_target);
+            create_resource(bb_depth_res, e_null_resource::render_target);
+
+            PEN_LOG("[renderer] null renderer, %ix%i", pen_window.width, pen_window.height);
+            return 0;
+        }
+
+        void renderer_shutdown()
+        {
+        }
+
+        void renderer_sync()
+        {
+            // unused on this platform
+        }
+
+        void renderer_new_frame()
+        {
+            _renderer_new_frame();
+        }
+
+        void renderer_end_frame()
+        {
+            // unused on this platform
+        }
+
+        void renderer_retain()
+        {
+            // unused on this platform
+        }
+
+        void renderer_create_clear_state(const clear_state& cs, u32 resource_slot)
+        {
+            create_resource(resource_slot, e_null_resource::clear_state);
+        }
+
+        void renderer_clear(u32 clear_state_index, u32 colour_slice, u32 depth_slice)
+        {
+            frame_stats().clears++;
+        }
+
+        void renderer_clear_texture(u32 clear_state_index, u32 texture)
+        {
+            frame_stats().clears++;
+        }
+
+        void renderer_load_shader(const pen::shader_load_params& params, u32 resource_slot)
+        {
+            create_resource(resource_slot, e_null_resource::shader);
+        }
+
+        void renderer_set_shader(u32 shader_index, u32 shader_type)
+        {
+            if (shader_type < k_max_shader_types)
+                state_change(s_state.shader[shader_type], shader_index);
+        }
+
+        void renderer_create_input_layout(const input_layout_creation_params& params, u32 resource_slot)
+        {
+            create_resource(resource_slot, e_null_resource::input_layout);
+        }
+
+        void renderer_set_input_layout(u32 layout_index)
+        {
+            state_change(s_state.input_layout, layout_index);
+        }
+
+        void renderer_link_shader_program(const shader_link_params& params, u32 resource_slot)
+        {
+            create_resource(resource_slot, e_null_resource::shader);
+        }
+
+        void renderer_create_buffer(const buffer_creation_params& params, u32 resource_slot)
+        {
+            create_resource(resource_slot, e_null_resource::buffer);
+
+            null_resource& res = s_res_pool.get(resource_slot);
+            res.size = params.buffer_size;
+            res.data = (u8*)memory_calloc(1, params.buffer_size);
+
+            if (params.data)
+            {
+                memcpy(res.data, params.data, params.buffer_size);
+                frame_stats().bytes_uploaded += params.buffer_size;
+            }
+        }
+
+        void renderer_set_vertex_buffers(u32* buffer_indices, u32 num_buffers, u32 start_slot, const u32* strides,
+                                         const u32* offsets)
+        {
+            for (u32 i = 0; i < num_buffers; ++i)
+            {
+                u32 stream = start_slot + i;
+                if (stream >= k_max_vertex_streams)
+                {
+                    buffer_bind(nullptr, buffer_indices[i]);
+                    continue;
+                }
+
+                // rebinding at a new offset is not redundant
+                if (offsets[i] != s_state.vertex_offset[stream])
+                    s_state.vertex_buffer[stream] = PEN_INVALID_HANDLE;
+
+                s_state.vertex_offset[stream] = offsets[i];
+                buffer_bind(&s_state.vertex_buffer[stream], buffer_indices[i]);
+            }
+        }
+
+        void renderer_set_index_buffer(u32 buffer_index, u32 format, u32 offset)
+        {
+            buffer_bind(&s_state.index_buffer, buffer_index);
+        }
+
+        void renderer_set_constant_buffer(u32 buffer_index, u32 unit, u32 flags)
+        {
+            buffer_bind(unit < k_max_bind_units ? &s_state.constant_buffer[unit] : nullptr, buffer_index);
+        }
+
+        void renderer_set_structured_buffer(u32 buffer_index, u32 unit, u32 flags)
+        {
+            buffer_bind(unit < k_max_bind_units ? &s_state.structured_buffer[unit] : nullptr, buffer_index);
+        }
+
+        void renderer_update_buffer(u32 buffer_index, const void* data, u32 data_size, u32 offset)
+        {
+            null_resource& res = s_res_pool.get(buffer_index);
+            PEN_ASSERT(res.type == e_null_resource::buffer);
+            PEN_ASSERT(offset + data_size <= res.size);
+
+            if (res.data && offset + data_size <= res.size)
+                memcpy(res.data + offset, data, data_size);
+
+            frame_stats().buffer_updates++;
+            frame_stats().bytes_uploaded += data_size;
+        }
+
+        void renderer_create_texture(const texture_creation_params& tcp, u32 resource_slot)
+        {
+            create_resource(resource_slot, e_null_resource::texture);
+
+            texture_creation_params _tcp = _renderer_tcp_resolve_ratio(tcp);
+
+            null_resource& res = s_res_pool.get(resource_slot);
+            res.width = _tcp.width;
+            res.height = _tcp.height;
+            res.num_arrays = _tcp.num_arrays;
+
+            if (tcp.data)
+                frame_stats().bytes_uploaded += tcp.data_size;
+        }
+
+        void renderer_create_sampler(const sampler_creation_params& scp, u32 resource_slot)
+        {
+            create_resource(resource_slot, e_null_resource::sampler);
+        }
+
+        void renderer_set_texture(u32 texture_index, u32 sampler_index, u32 unit, u32 bind_flags)
+        {
+            if (unit >= k_max_bind_units)
+            {
+                frame_stats().texture_binds++;
+                return;
+            }
+
+            bool changed = track(s_state.texture[unit], texture_index);
+            changed |= track(s_state.sampler[unit], sampler_index);
+
+            if (changed)
+                frame_stats().texture_binds++;
+            else
+                frame_stats().redundant_texture_binds++;
+        }
+
+        void renderer_create_raster_state(const raster_state_creation_params& rscp, u32 resource_slot)
+        {
+            create_resource(resource_slot, e_null_resource::raster_state);
+        }
+
+        void renderer_set_raster_state(u32 raster_state_index)
+        {
+            state_change(s_state.raster_state, raster_state_index);
+        }
+
+        void renderer_set_viewport(const viewport& vp)
+        {
+            frame_stats().state_changes++;
+        }
+
+        void renderer_set_scissor_rect(const rect& r)
+        {
+            frame_stats().state_changes++;
+        }
+
+        void renderer_create_blend_state(const blend_creation_params& bcp, u32 resource_slot)
+        {
+            create_resource(resource_slot, e_null_resource::blend_state);
+        }
+
+        void renderer_set_blend_state(u32 blend_state_index)
+        {
+            state_change(s_state.blend_state, blend_state_index);
+        }
+
+        void renderer_create_depth_stencil_state(const depth_stencil_creation_params& dscp, u32 resource_slot)
+        {
+            create_resource(resource_slot, e_null_resource::depth_stencil_state);
+        }
+
+        void renderer_set_depth_stencil_state(u32 depth_stencil_state)
+        {
+            state_change(s_state.depth_stencil_state, depth_stencil_state);
+        }
+
+        void renderer_set_stencil_ref(u8 ref)
+        {
+            state_change(s_state.stencil_ref, ref);
+        }
+
+        void renderer_draw(u32 vertex_count, u32 start_vertex, u32 primitive_topology)
+        {
+            frame_stats().draws++;
+            frame_stats().vertices += vertex_count;
+        }
+
+        void renderer_draw_indexed(u32 index_count, u32 start_index, u32 base_vertex, u32 primitive_topology)
+        {
+            frame_stats().draws++;
+            frame_stats().indices += index_count;
+        }
+
+        void renderer_draw_indexed_instanced(u32 instance_count, u32 start_instance, u32 index_count, u32 start_index,
+                                             u32 base_vertex, u32 primitive_topology)
+        {
+            frame_stats().draws++;
+            frame_stats().instances += instance_count;
+            frame_stats().indices += (u64)index_count * instance_count;
+        }
+
+        void renderer_draw_auto()
+        {
+            frame_stats().draws++;
+        }
+
+        void renderer_dispatch_compute(uint3 grid, uint3 num_threads)
+        {
+            frame_stats().dispatches++;
+        }
+
+        void renderer_create_render_target(const texture_creation_params& tcp, u32 resource_slot, bool track)
+        {
+            create_resource(resource_slot, e_null_resource::render_target);
+
+            texture_creation_params _tcp = _renderer_tcp_resolve_ratio(tcp);
+
+            null_resource& res = s_res_pool.get(resource_slot);
+            res.width = _tcp.width;
+            res.height = _tcp.height;
+            res.num_arrays = _tcp.num_arrays;
+
+            if (track)
+                _renderer_track_managed_render_target(tcp, resource_slot);
+        }
+
+        void renderer_set_targets(const u32* const colour_targets, u32 num_colour_targets, u32 depth_target,
+                                  u32 colour_slice, u32 depth_slice)
+        {
+            frame_stats().state_changes++;
+        }
+
+        void renderer_set_resolve_targets(u32 colour_target, u32 depth_target)
+        {
+        }
+
+        void renderer_set_stream_out_target(u32 buffer_index)
+        {
+            frame_stats().state_changes++;
+        }
+
+        void renderer_resolve_target(u32 target, e_msaa_resolve_type type, resolve_resources res)
+        {
+        }
+
+        void renderer_read_back_resource(const resource_read_back_params& rrbp)
+        {
+            if (!rrbp.call_back_function)
+                return;
+
+            // buffers return their cpu copy, textures and targets have no contents so read back as zero
+            u32   data_size = rrbp.depth_pitch;
+            void* data = memory_calloc(1, data_size);
+
+            null_resource& res = s_res_pool.get(rrbp.resource_index);
+            if (res.type == e_null_resource::buffer && res.data)
+                memcpy(data, res.data, std::min<u32>(data_size, res.size));
+
+            rrbp.call_back_function(data, rrbp.row_pitch, rrbp.depth_pitch, rrbp.block_size);
+            memory_free(data);
+        }
+
+        void renderer_present()
+        {
+            null_renderer_stats& fs = frame_stats();
+            fs.frames = 1;
+            accumulate(s_total, fs);
+
+            s_frame.swap_buffers();
+            s_frame.backbuffer() = null_renderer_stats();
+
+            // state does not persist across frames on the real backends
+            reset_state();
+
+            _renderer_end_frame();
+        }
+
+        void renderer_push_perf_marker(const c8* name)
+        {
+        }
+
+        void renderer_pop_perf_marker()
+        {
+        }
+
+        void renderer_replace_resource(u32 dest, u32 src, e_renderer_resource type)
+        {
+            null_resource& d = s_res_pool.get(dest);
+            memory_free(d.data);
+            d = s_res_pool.get(src);
+            memset(&s_res_pool.get(src), 0x0, sizeof(null_resource));
+        }
+
+        void renderer_release_shader(u32 shader_index, u32 shader_type)
+        {
+            release_resource(shader_index);
+        }
+
+        void renderer_release_clear_state(u32 clear_state)
+        {
+            release_resource(clear_state);
+        }
+
+        void renderer_release_buffer(u32 buffer_index)
+        {
+            release_resource(buffer_index);
+        }
+
+        void renderer_release_texture(u32 texture_index)
+        {
+            release_resource(texture_index);
+        }
+
+        void renderer_release_sampler(u32 sampler)
+        {
+            release_resource(sampler);
+        }
+
+        void renderer_release_raster_state(u32 raster_state_index)
+        {
+            release_resource(raster_state_index);
+        }
+
+        void renderer_release_blend_state(u32 blend_state)
+        {
+            release_resource(blend_state);
+        }
+
+        void renderer_release_render_target(u32 render_target)
+        {
+            _renderer_untrack_managed_render_target(render_target);
+            release_resource(render_target);
+        }
+
+        void renderer_release_input_layout(u32 input_layout)
+        {
+            release_resource(input_layout);
+        }
+
+        void renderer_release_depth_stencil_state(u32 depth_stencil_state)
+        {
+            release_resource(depth_stencil_state);
+        }
+    } // namespace direct
+} // namespace pen
@@ -850,8 +850,9 @@ namespace
 
     struct resource_allocation
     {
-        u8     asigned_flag;
-        GLuint type;
+        u8      asigned_flag;
+        GLuint  type;
+        hash_id source_hash; // shaders, to key linked programs in the program cache
         union {
             clear_state_internal           clear_state;
             ::input_layout*                input_layout;
@@ -894,6 +895,7 @@ namespace
     active_state  s_live_state;
     viewport      s_current_vp;
     context_state s_ctx;
+    u32           s_program_cache_seed = 0; // program binaries are only valid for the driver which created them
 
     void _clear_resource_table()
     {
@@ -968,6 +970,9 @@ namespace
         GLuint program_id = CHECK_CALL(glCreateProgram());
         u32    so = 0;
 
+        hash_id program_key = 0;
+        bool    cached = false;
+
         if (params)
         {
             // this path is for a proper link with reflection info
@@ -975,6 +980,37 @@ namespace
             ps = _res_pool[params->pixel_shader].handle;
             so = _res_pool[params->stream_out_shader].handle;
 
+#ifndef PEN_GLES3
+            // restore the linked program binary from the program cache
+            HashMurmur2A hm;
+            hm.begin(s_program_cache_seed);
+            hm.add(_res_pool[params->vertex_shader].source_hash);
+            hm.add(_res_pool[params->pixel_shader].source_hash);
+            hm.add(_res_pool[params->stream_out_shader].source_hash);
+            for (u32 i = 0; i < params->num_stream_out_names; ++i)
+                hm.add(params->stream_out_names[i], (s32)strlen(params->stream_out_names[i]));
+            program_key = hm.end();
+
+            u32       blob_size = 0;
+            const u8* blob = (const u8*)_renderer_program_cache_find(program_key, blob_size);
+            if (blob && blob_size > sizeof(GLenum))
+            {
+                GLenum format;
+                memcpy(&format, blob, sizeof(GLenum));
+
+                // binaries from another driver version fail to load and are silently re-linked
+                glProgramBinary(program_id, format, blob + sizeof(GLenum), blob_size - sizeof(GLenum));
+                glGetError();
+
+                GLint status = GL_FALSE;
+                CHECK_CALL(glGetProgramiv(program_id, GL_LINK_STATUS, &status));
+                cached = status == GL_TRUE;
+            }
+
+            if (!cached)
+                CHECK_CALL(glProgramParameteri(program_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+#endif
+
             if (vs)
             {
                 CHECK_CALL(glAttachShader(program_id, vs));
@@ -1007,7 +1043,8 @@ namespace
             }
         }
 
-        CHECK_CALL(glLinkProgram(program_id));
+        if (!cached)
+            CHECK_CALL(glLinkProgram(program_id));
 
         // Check the program
         GLint result = GL_FALSE;
@@ -1034,6 +1071,26 @@ namespace
             ps = 0;
         }
 
+#ifndef PEN_GLES3
+        // store newly linked programs in the program cache, as the binary format followed by the binary
+        if (program_key && !cached && result == GL_TRUE)
+        {
+            GLint binary_size = 0;
+            CHECK_CALL(glGetProgramiv(program_id, GL_PROGRAM_BINARY_LENGTH, &binary_size));
+
+            if (binary_size > 0)
+            {
+                u8*    blob = (u8*)memory_alloc(sizeof(GLenum) + binary_size);
+                GLenum format = 0;
+                CHECK_CALL(glGetProgramBinary(program_id, binary_size, nullptr, &format, blob + sizeof(GLenum)));
+                memcpy(blob, &format, sizeof(GLenum));
+
+                _renderer_program_cache_store(program_key, blob, sizeof(GLenum) + binary_size);
+                memory_free(blob);
+            }
+        }
+#endif
+
         shader_program program;
         program.vs = vs;
         program.ps = ps;
@@ -1193,6 +1250,7 @@ namespace pen
             return;
 
         res.handle = CHECK_CALL(glCreateShader(internal_type));
+        res.source_hash = hashMurmur2A(params.byte_code, params.byte_code_size);
 
         CHECK_CALL(glShaderSource(res.handle, 1, (const c8**)&params.byte_code, (s32*)&params.byte_code_size));
         CHECK_CALL(glCompileShader(res.handle));
@@ -1274,6 +1332,12 @@ namespace pen
         u32 usage = to_gl_usage(params.usage_flags);
         u32 gl_bind = to_gl_bind_flags(params.bind_flags);
 
+#ifdef GL_SHADER_STORAGE_BUFFER
+        // structured buffers are shader storage buffers, requires gl 4.3
+        if (params.stride && (params.bind_flags & (PEN_BIND_SHADER_RESOURCE | PEN_BIND_SHADER_WRITE)))
+            gl_bind = GL_SHADER_STORAGE_BUFFER;
+#endif
+
         CHECK_CALL(glGenBuffers(1, &res.handle));
         CHECK_CALL(glBindBuffer(gl_bind, res.handle));
         CHECK_CALL(glBufferData(gl_bind, params.buffer_size, params.data, usage));
@@ -2472,7 +2536,12 @@ namespace pen
 
     void direct::renderer_set_structured_buffer(u32 buffer_index, u32 unit, u32 flags)
     {
-        PEN_ASSERT(0); // stubbed.. use metal on mac or d3d / vulkan on windows
+#ifdef GL_SHADER_STORAGE_BUFFER
+        GLuint handle = buffer_index ? _res_pool[buffer_index].handle : 0;
+        CHECK_CALL(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, unit, handle));
+#else
+        PEN_ASSERT(0); // stubbed.. requires gl 4.3, use metal on mac
+#endif
     }
 
     void direct::renderer_update_buffer(u32 buffer_index, const void* data, u32 data_size, u32 offset)
@@ -2783,6 +2852,10 @@ namespace pen
 
         s_renderer_info.renderer_cmd = "-renderer opengl";
 
+        // programs are cached per driver
+        s_program_cache_seed = PEN_HASH(str_gl_renderer.c_str()) ^ PEN_HASH(str_gl_version.c_str());
+        _renderer_program_cache_load();
+
         // gles base fbo is not 0
         glGetIntegerv(GL_FRAMEBUFFER_BINDING, &s_backbuffer_fbo);
         s_renderer_info.caps |= PEN_CAPS_VUP;
@@ -2809,6 +2882,8 @@ namespace pen
 
     void direct::renderer_shutdown()
     {
+        _renderer_program_cache_save();
+
         // todo device / stray resource shutdown
     }
 
@@ -590,6 +590,21 @@ namespace
                 }
             }
 
+            // -capture <filename> <num_frames>
+            for (int i = 1; i + 2 < argc; ++i)
+                if (strcmp(argv[i], "-capture") == 0)
+                    pen::renderer_capture_enable(argv[i + 1], (u32)atoi(argv[i + 2]));
+
+            // -program_cache <filename>
+            for (int i = 1; i + 1 < argc; ++i)
+                if (strcmp(argv[i], "-program_cache") == 0)
+                    pen::renderer_set_program_cache(argv[i + 1]);
+
+            // -async_shaders
+            for (int i = 1; i < argc; ++i)
+                if (strcmp(argv[i], "-async_shaders") == 0)
+                    pen::renderer_async_shaders_enable();
+
             [NSApplication sharedApplication];
 
             id dg = [app_delegate shared_delegate];
@@ -901,4 +901,353 @@ namespace pen
         set(name, fn);
     }
 
+    //------------------------------------------------------------------------------
+    // Read Only View API
+    //------------------------------------------------------------------------------
+    json_doc* json_doc::create(c8* data, u32 size)
+    {
+        // count tokens first so the token array is allocated once
+        jsmn_parser p;
+        jsmn_init(&p);
+        s32 num_tokens = jsmn_parse(&p, data, size, nullptr, 0);
+        if (num_tokens <= 0)
+        {
+            PEN_LOG("Failed to parse JSON: %d\n", num_tokens);
+            pen::memory_free(data);
+            return nullptr;
+        }
+
+        json_doc* doc = new json_doc();
+        doc->m_data = data;
+        doc->m_size = size;
+        doc->m_num_tokens = num_tokens;
+        doc->m_tokens = new jsmntok_t[num_tokens];
+        doc->m_next = new s32[num_tokens];
+        doc->m_hashes = new hash_id[num_tokens];
+
+        jsmn_init(&p);
+        jsmn_parse(&p, data, size, doc->m_tokens, num_tokens);
+
+        // tokens are in pre order, children always follow their parent so walk backwards to find subtree extents,
+        // keys contain their value as a child so skipping a key skips the whole member
+        for (s32 i = num_tokens - 1; i >= 0; --i)
+        {
+            const jsmntok_t& t = doc->m_tokens[i];
+
+            doc->m_hashes[i] = 0;
+
+            s32 j = i + 1;
+            for (s32 c = 0; c < t.size; ++c)
+            {
+                if (j >= num_tokens)
+                    break;
+
+                if (t.type == JSMN_OBJECT)
+                {
+                    const jsmntok_t& k = doc->m_tokens[j];
+                    doc->m_hashes[j] = pen::hashMurmur2A(data + k.start, k.end - k.start);
+                }
+
+                j = doc->m_next[j];
+            }
+
+            doc->m_next[i] = std::min<s32>(j, num_tokens);
+        }
+
+        return doc;
+    }
+
+    json_doc* json_doc::load_from_file(const c8* filename)
+    {
+        void* data = nullptr;
+        u32   size = 0;
+
+        pen_error err = pen::filesystem_read_file_to_buffer(filename, &data, size);
+        if (err != PEN_ERR_OK)
+        {
+            pen::memory_free(data);
+            return nullptr;
+        }
+
+        return create((c8*)data, size);
+    }
+
+    json_doc* json_doc::load(const c8* json_str)
+    {
+        u32 len = pen::string_length(json_str);
+        return create(pen::sub_string(json_str, len), len);
+    }
+
+    void json_doc::release(json_doc* doc)
+    {
+        if (!doc)
+            return;
+
+        delete[] doc->m_tokens;
+        delete[] doc->m_next;
+        delete[] doc->m_hashes;
+        pen::memory_free(doc->m_data);
+
+        delete doc;
+    }
+
+    json_view json_doc::root() const
+    {
+        return json_view(this, 0);
+    }
+
+    json_view::iterator::iterator(const json_doc* doc, s32 tok, u32 remaining, bool object)
+        : m_doc(doc), m_tok(tok), m_remaining(remaining), m_object(object)
+    {
+    }
+
+    json_view json_view::iterator::operator*() const
+    {
+        if (m_object)
+            return json_view(m_doc, m_tok + 1, m_tok);
+
+        return json_view(m_doc, m_tok);
+    }
+
+    json_view::iterator& json_view::iterator::operator++()
+    {
+        m_tok = m_doc->m_next[m_tok];
+        --m_remaining;
+        return *this;
+    }
+
+    bool json_view::iterator::operator!=(const iterator& other) const
+    {
+        return m_remaining != other.m_remaining;
+    }
+
+    json_view::json_view(const json_doc* doc, s32 tok, s32 key_tok) : m_doc(doc), m_tok(tok), m_key(key_tok)
+    {
+        if (!m_doc || m_tok >= m_doc->m_num_tokens)
+        {
+            m_doc = nullptr;
+            m_tok = -1;
+            m_key = -1;
+        }
+    }
+
+    const jsmntok_t* json_view::token() const
+    {
+        if (!m_doc || m_tok < 0)
+            return nullptr;
+
+        return &m_doc->m_tokens[m_tok];
+    }
+
+    jsmntype_t json_view::type() const
+    {
+        const jsmntok_t* t = token();
+        if (!t)
+            return JSMN_UNDEFINED;
+
+        return t->type;
+    }
+
+    bool json_view::is_null() const
+    {
+        return type() == JSMN_UNDEFINED;
+    }
+
+    u32 json_view::size() const
+    {
+        const jsmntok_t* t = token();
+        if (t && (t->type == JSMN_ARRAY || t->type == JSMN_OBJECT))
+            return t->size;
+
+        return 0;
+    }
+
+    json_view json_view::find(hash_id id_key) const
+    {
+        const jsmntok_t* t = token();
+        if (!t || t->type != JSMN_OBJECT)
+            return json_view();
+
+        s32 j = m_tok + 1;
+        for (s32 i = 0; i < t->size; ++i)
+        {
+            if (m_doc->m_hashes[j] == id_key && m_doc->m_tokens[j].size > 0)
+                return json_view(m_doc, j + 1, j);
+
+            j = m_doc->m_next[j];
+        }
+
+        return json_view();
+    }
+
+    json_view json_view::operator[](const c8* name) const
+    {
+        json_view v = find(PEN_HASH(name));
+
+        // guard against hash collisions
+        if (!v.is_null() && jsoneq(m_doc->m_data, &m_doc->m_tokens[v.m_key], name) != 0)
+            return json_view();
+
+        return v;
+    }
+
+    json_view json_view::operator[](const u32 index) const
+    {
+        const jsmntok_t* t = token();
+        if (!t || index >= size())
+            return json_view();
+
+        s32 j = m_tok + 1;
+        for (u32 i = 0; i < index; ++i)
+            j = m_doc->m_next[j];
+
+        if (t->type == JSMN_OBJECT)
+            return json_view(m_doc, j + 1, j);
+
+        return json_view(m_doc, j);
+    }
+
+    json_view json_view::operator[](const s32 index) const
+    {
+        return this->operator[]((u32)index);
+    }
+
+    json_view::iterator json_view::begin() const
+    {
+        return iterator(m_doc, m_tok + 1, size(), type() == JSMN_OBJECT);
+    }
+
+    json_view::iterator json_view::end() const
+    {
+        return iterator(m_doc, -1, 0, false);
+    }
+
+    Str json_view::key() const
+    {
+        Str k;
+        if (m_doc && m_key >= 0)
+        {
+            const jsmntok_t& t = m_doc->m_tokens[m_key];
+            k.append(m_doc->m_data + t.start, m_doc->m_data + t.end);
+        }
+        return k;
+    }
+
+    hash_id json_view::key_hash() const
+    {
+        if (!m_doc || m_key < 0)
+            return 0;
+
+        return m_doc->m_hashes[m_key];
+    }
+
+    bool json_view::eq(const c8* str) const
+    {
+        const jsmntok_t* t = token();
+        if (!t)
+            return false;
+
+        return jsoneq(m_doc->m_data, (jsmntok_t*)t, str) == 0;
+    }
+
+    bool json_view::primitive(c8* buf, u32 buf_size) const
+    {
+        const jsmntok_t* t = token();
+        if (!t || t->type != JSMN_PRIMITIVE)
+            return false;
+
+        u32 len = std::min<u32>(t->end - t->start, buf_size - 1);
+        memcpy(buf, m_doc->m_data + t->start, len);
+        buf[len] = '\0';
+        return true;
+    }
+
+    Str json_view::as_str(const c8* default_value) const
+    {
+        const jsmntok_t* t = token();
+        if (!t)
+            return default_value;
+
+        Str str;
+        str.append(m_doc->m_data + t->start, m_doc->m_data + t->end);
+        return str;
+    }
+
+    hash_id json_view::as_hash_id(hash_id default_value) const
+    {
+        const jsmntok_t* t = token();
+        if (!t)
+            return default_value;
+
+        return pen::hashMurmur2A(m_doc->m_data + t->start, t->end - t->start);
+    }
+
+    u32 json_view::as_u32(u32 default_value) const
+    {
+        c8 buf[32];
+        if (primitive(buf, sizeof(buf)))
+            return (u32)atoll(buf);
+
+        return default_value;
+    }
+
+    s32 json_view::as_s32(s32 default_value) const
+    {
+        c8 buf[32];
+        if (primitive(buf, sizeof(buf)))
+            return (s32)atoll(buf);
+
+        return default_value;
+    }
+
+    bool json_view::as_bool(bool default_value) const
+    {
+        const jsmntok_t* t = token();
+        if (!t || t->type != JSMN_PRIMITIVE)
+            return default_value;
+
+        c8 c = m_doc->m_data[t->start];
+        if (c == 't')
+            return true;
+        else if (c == 'f')
+            return false;
+
+        return default_value;
+    }
+
+    f32 json_view::as_f32(f32 default_value) const
+    {
+        c8 buf[64];
+        if (primitive(buf, sizeof(buf)))
+            return (f32)atof(buf);
+
+        return default_value;
+    }
+
+    u32 json_view::as_u32_hex(u32 default_value) const
+    {
+        c8 buf[32];
+        if (primitive(buf, sizeof(buf)))
+            return (u32)strtoul(buf, nullptr, 16);
+
+        return default_value;
+    }
+
+    Str json_view::as_filename(const c8* default_value) const
+    {
+        Str fn = as_str(default_value);
+        fn = str_replace_chars(fn, '@', ':');
+        fn = str_replace_chars(fn, '\\', '/');
+
+        return fn;
+    }
+
+    json json_view::to_json() const
+    {
+        if (is_null())
+            return json();
+
+        return json::load(as_str().c_str());
+    }
+
 } // namespace pen
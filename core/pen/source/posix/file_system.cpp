@@ -5,7 +5,9 @@
 #include <dirent.h>
 #include <fnmatch.h>
 #include <stdarg.h>
+#include <fcntl.h>
 #include <stdio.h>
+#include <sys/mman.h>
 #include <sys/mount.h>
 #include <sys/param.h>
 #include <sys/stat.h>
@@ -103,6 +105,56 @@ namespace pen
         return PEN_ERR_FILE_NOT_FOUND;
     }
 
+    pen_error filesystem_map_file(const c8* filename, mapped_file& mapping)
+    {
+        WRITE_FILE_DEPENDENCIES(filename);
+
+        const Str resource_name = os_path_for_resource(filename);
+
+        mapping = mapped_file();
+
+        s32 fd = open(resource_name.c_str(), O_RDONLY);
+        if (fd < 0)
+            return PEN_ERR_FILE_NOT_FOUND;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            close(fd);
+            return PEN_ERR_FAILED;
+        }
+
+        // empty files cannot be mapped, return a valid empty mapping
+        if (st.st_size == 0)
+        {
+            close(fd);
+            return PEN_ERR_OK;
+        }
+
+        void* data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        // the mapping keeps its own reference to the file
+        close(fd);
+
+        if (data == MAP_FAILED)
+            return PEN_ERR_FAILED;
+
+        // assets are parsed front to back, let the kernel read ahead
+        posix_madvise(data, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+
+        mapping.data = data;
+        mapping.size = (size_t)st.st_size;
+        return PEN_ERR_OK;
+    }
+
+    void filesystem_unmap_file(mapped_file& mapping)
+    {
+        if (mapping.data)
+            munmap((void*)mapping.data, mapping.size);
+
+        mapping = mapped_file();
+    }
+
     pen_error filesystem_enum_volumes(fs_tree_node& results)
     {
         static const c8* volumes_name = "Volumes";
@@ -2,6 +2,7 @@
 // Copyright 2014 - 2023 Alex Dixon.
 // License: https://github.com/polymonster/pmtech/blob/master/license.md
 
+#include <algorithm>
 #include <fstream>
 
 #include "console.h"
@@ -27,9 +28,9 @@ pen::resolve_resources             g_resolve_resources;
 using namespace pen;
 
 #if PEN_SINGLE_THREADED
-#define add_cmd(cmd) exec_cmd(cmd)
+#define submit_cmd(cmd) exec_cmd(cmd)
 #else
-#define add_cmd(cmd) _ctx->cmd_buffer.put(cmd)
+#define submit_cmd(cmd) _ctx->cmd_buffer.put(cmd)
 #endif
 
 namespace
@@ -92,9 +93,44 @@ namespace
         CMD_PUSH_PERF_MARKER,
         CMD_POP_PERF_MARKER,
         CMD_DISPATCH_COMPUTE,
-        CMD_SET_STENCIL_REF
+        CMD_SET_STENCIL_REF,
+        CMD_SET_PROGRAM_CACHE,
+        CMD_COUNT
     };
 
+    static const c8* k_cmd_names[] = {
+        "none",                        "new_frame",
+        "clear",                       "clear_texture",
+        "present",                     "load_shader",
+        "set_shader",                  "link_shader",
+        "create_input_layout",         "set_input_layout",
+        "create_buffer",               "set_vertex_buffer",
+        "set_index_buffer",            "draw",
+        "draw_indexed",                "draw_indexed_instanced",
+        "create_texture",              "release_shader",
+        "release_buffer",              "release_texture_2d",
+        "create_sampler",              "set_texture",
+        "create_raster_state",         "set_raster_state",
+        "set_viewport",                "set_scissor_rect",
+        "set_viewport_ratio",          "set_scissor_rect_ratio",
+        "release_raster_state",        "create_blend_state",
+        "set_blend_state",             "set_constant_buffer",
+        "set_structured_buffer",       "update_buffer",
+        "create_depth_stencil_state",  "set_depth_stencil_state",
+        "update_queries",              "create_render_target",
+        "set_targets",                 "release_blend_state",
+        "release_render_target",       "release_input_layout",
+        "release_sampler",             "release_program",
+        "release_clear_state",         "release_depth_stencil_state",
+        "create_so_shader",            "set_so_target",
+        "resolve_target",              "draw_auto",
+        "map_resource",                "replace_resource",
+        "create_clear_state",          "push_perf_marker",
+        "pop_perf_marker",             "dispatch_compute",
+        "set_stencil_ref",             "set_program_cache"
+    };
+    static_assert(PEN_ARRAY_SIZE(k_cmd_names) == CMD_COUNT, "k_cmd_names must match the commands enum");
+
     struct set_shader_cmd
     {
         u32 shader_index;
@@ -201,10 +237,22 @@ namespace
         uint3 num_threads;
     };
 
+    namespace e_payload_flags
+    {
+        enum payload_flags_t
+        {
+            frame_arena = 1,   // payload was bump allocated from a frame arena and must not be freed
+            cmd_list = 1 << 1, // payload is at payload_offset in the recording cmd list until it is submitted
+            replay = 1 << 2    // payload points into a loaded capture which owns it
+        };
+    }
+
     struct renderer_cmd
     {
         u32 command_index;
         u32 resource_slot;
+        u32 payload_flags = 0;
+        u32 payload_offset = 0;
         u64 frame_index;
 
         union {
@@ -244,6 +292,26 @@ namespace
         renderer_cmd(){};
     };
 
+    // command payloads are bump allocated from the current frame arena on the user thread. renderer_new_frame retires
+    // the arena and CMD_NEW_FRAME releases it on the render thread once every command which used it has executed.
+    // payloads which do not fit, or arrive while the next arena is still in flight, fall back to the heap and the arena
+    // grows to the high water mark when it is next reset.
+    static const u32    k_num_frame_arenas = 3;
+    static const size_t k_frame_arena_min_size = 1024 * 1024;
+    static const size_t k_frame_arena_align = 16;
+
+    // cmd_buffer grows to this many times max_commands, past that the user thread waits for the render thread
+    static const u32 k_max_cmd_buffer_growth = 8;
+
+    struct frame_arena
+    {
+        u8*    data = nullptr;
+        size_t size = 0;
+        size_t pos = 0;
+        size_t requested = 0; // includes payloads which overflowed to the heap
+        a_u32  in_flight = {0};
+    };
+
     // front end render_ctx
     struct fe_render_ctx
     {
@@ -257,10 +325,77 @@ namespace
         ring_buffer<renderer_cmd> release_cmd_buffer;
         u32*                      free_slots = nullptr;
         a_s32                     wait;
+        frame_arena               arenas[k_num_frame_arenas];
+        u32                       arena_index = 0;
+        bool                      arena_valid = true; // false while the current arena is still in flight
+        u32                       cmd_buffer_grows = 0;
     };
     static fe_render_ctx* _ctx;
     static render_ctx     _main_ctx;
 
+    // commands recorded on any thread, submitted to the render thread in order from the user thread
+    struct cmd_list_data
+    {
+        renderer_cmd* cmds = nullptr;
+        u8*           payload = nullptr;
+    };
+    thread_local cmd_list_data* t_cmd_list = nullptr;
+
+    // command stream capture. commands are serialised on the render thread as they execute, each payload follows its
+    // command as a size prefixed blob. every entry is 16 byte aligned so a loaded capture can be replayed in place.
+    static const u32 k_capture_magic = 0x444d4350; // PCMD
+    static const u32 k_capture_version = 1;
+    static const u32 k_capture_align = 16;
+
+    struct capture_header
+    {
+        u32 magic;
+        u32 version;
+        u32 cmd_size; // captures are only compatible with builds which share the renderer_cmd layout
+        u32 num_frames;
+        u32 num_cmds;
+        u32 width;
+        u32 height;
+        u32 reserved;
+    };
+
+    struct capture_stream
+    {
+        u8*  data = nullptr; // stretchy buffer when writing, the loaded file when reading
+        u32  pos = 0;
+        u32  size = 0;
+        bool writing = false;
+    };
+
+    struct capture_state
+    {
+        capture_stream stream;
+        Str            filename;
+        u32            frames_remaining = 0;
+        u32            num_frames = 0;
+        u32            num_cmds = 0;
+    };
+    static capture_state s_capture;
+
+    struct cmd_capture_data
+    {
+        void*         file = nullptr;
+        renderer_cmd* cmds = nullptr;
+        u32*          frame_end = nullptr; // one past the present of each frame
+    };
+
+    // per command type execution counts and times, enabled from the user thread and latched at new frame
+    struct cmd_profile
+    {
+        a_u32 requested = {0};
+        bool  enabled = false;
+        u64   count[CMD_COUNT];
+        f64   time_ns[CMD_COUNT];
+        f64   last_present_ns = 0.0;
+        f32*  frame_ms = nullptr;
+    };
+    static cmd_profile s_profile;
+
 } // namespace
 
 namespace pen
@@ -276,13 +411,317 @@ namespace pen
         gpu_ms = (f64)g_gpu_total / 1000.0 / 1000.0;
     }
 
+    void* payload_alloc(renderer_cmd& cmd, size_t size)
+    {
+        size_t aligned_size = (size + k_frame_arena_align - 1) & ~(k_frame_arena_align - 1);
+
+        // the list payload may move as it grows, commands keep an offset which is resolved on submit
+        if (t_cmd_list)
+        {
+            cmd.payload_flags |= e_payload_flags::cmd_list;
+            cmd.payload_offset = sb_count(t_cmd_list->payload);
+            return sb_add(t_cmd_list->payload, (int)aligned_size);
+        }
+
+        frame_arena& arena = _ctx->arenas[_ctx->arena_index];
+        arena.requested += aligned_size;
+
+        if (_ctx->arena_valid && arena.pos + aligned_size <= arena.size)
+        {
+            void* mem = arena.data + arena.pos;
+            arena.pos += aligned_size;
+            cmd.payload_flags |= e_payload_flags::frame_arena;
+            return mem;
+        }
+
+        return memory_alloc(size);
+    }
+
+    void payload_free(const renderer_cmd& cmd, void* mem)
+    {
+        if (!(cmd.payload_flags & (e_payload_flags::frame_arena | e_payload_flags::replay)))
+            memory_free(mem);
+    }
+
+    // user thread, returns the index of the retired arena to pass to the render thread with CMD_NEW_FRAME
+    u32 frame_arena_retire()
+    {
+        u32 retired = _ctx->arena_index;
+        _ctx->arenas[retired].in_flight = 1;
+
+        _ctx->arena_index = (retired + 1) % k_num_frame_arenas;
+        frame_arena& arena = _ctx->arenas[_ctx->arena_index];
+
+        // the render thread is more than k_num_frame_arenas frames behind, use the heap until the next frame
+        _ctx->arena_valid = !pen_atomic_load(arena.in_flight);
+        if (!_ctx->arena_valid)
+            return retired;
+
+        if (arena.requested > arena.size || !arena.data)
+        {
+            size_t new_size = arena.size ? arena.size : k_frame_arena_min_size;
+            while (new_size < arena.requested)
+                new_size *= 2;
+
+            memory_free_align(arena.data);
+            arena.data = (u8*)memory_alloc_align(new_size, k_frame_arena_align);
+            arena.size = new_size;
+        }
+
+        arena.pos = 0;
+        arena.requested = 0;
+        return retired;
+    }
+
+    // render thread, all commands which allocated from the arena have executed
+    void frame_arena_release(u32 index)
+    {
+        _ctx->arenas[index].in_flight = 0;
+    }
+
+    // user thread, copies a recorded payload into the frame arena
+    void relocate_payload(renderer_cmd& cmd, const u8* list_payload)
+    {
+        const u8* src = list_payload + cmd.payload_offset;
+        cmd.payload_flags = 0;
+
+        switch (cmd.command_index)
+        {
+            case CMD_UPDATE_BUFFER:
+                cmd.update_buffer.data = payload_alloc(cmd, cmd.update_buffer.data_size);
+                memcpy(cmd.update_buffer.data, src, cmd.update_buffer.data_size);
+                break;
+
+            case CMD_SET_VERTEX_BUFFER:
+            {
+                u32  num_buffers = cmd.set_vertex_buffer.num_buffers;
+                u32* payload = (u32*)payload_alloc(cmd, sizeof(u32) * num_buffers * 3);
+                memcpy(payload, src, sizeof(u32) * num_buffers * 3);
+                cmd.set_vertex_buffer.buffer_indices = payload;
+                cmd.set_vertex_buffer.strides = payload + num_buffers;
+                cmd.set_vertex_buffer.offsets = payload + num_buffers * 2;
+            }
+            break;
+
+            default:
+                PEN_ASSERT_MSG(0, "command payload can not be recorded into a cmd list");
+                break;
+        }
+    }
+
+    // appends size bytes of src when writing, returns a pointer to the next entry when reading
+    void* capture_data(capture_stream& s, const void* src, u32 size)
+    {
+        u32 aligned_size = (size + k_capture_align - 1) & ~(k_capture_align - 1);
+
+        if (s.writing)
+        {
+            u8* dst = sb_add(s.data, (int)aligned_size);
+            memcpy(dst, src, size);
+            memset(dst + size, 0, aligned_size - size);
+            return dst;
+        }
+
+        PEN_ASSERT(s.pos + aligned_size <= s.size);
+        void* mem = s.data + s.pos;
+        s.pos += aligned_size;
+        return mem;
+    }
+
+    // writes the size bytes at ptr, or patches ptr to point at the blob inside the loaded capture
+    template <typename T>
+    void capture_blob(capture_stream& s, T*& ptr, u32 size)
+    {
+        u32 blob_size = s.writing && ptr ? size : 0;
+        blob_size = *(u32*)capture_data(s, &blob_size, sizeof(u32));
+
+        void* blob = blob_size ? capture_data(s, ptr, blob_size) : nullptr;
+        if (!s.writing)
+            ptr = (T*)blob;
+    }
+
+    template <typename T>
+    void capture_string(capture_stream& s, T*& str)
+    {
+        capture_blob(s, str, s.writing && str ? string_length(str) + 1 : 0);
+    }
+
+    // symmetrical so the same code writes and loads each payload
+    void capture_payloads(capture_stream& s, renderer_cmd& cmd)
+    {
+        switch (cmd.command_index)
+        {
+            case CMD_LOAD_SHADER:
+            {
+                shader_load_params& sl = cmd.shader_load;
+                capture_blob(s, sl.byte_code, sl.byte_code_size);
+                capture_blob(s, sl.so_decl_entries, sizeof(stream_out_decl_entry) * sl.so_num_entries);
+                if (sl.so_decl_entries)
+                    for (u32 i = 0; i < sl.so_num_entries; ++i)
+                        capture_string(s, sl.so_decl_entries[i].semantic_name);
+            }
+            break;
+
+            case CMD_LINK_SHADER:
+            {
+                shader_link_params& lp = cmd.link_params;
+                capture_blob(s, lp.constants, sizeof(constant_layout_desc) * lp.num_constants);
+                if (lp.constants)
+                    for (u32 i = 0; i < lp.num_constants; ++i)
+                        capture_string(s, lp.constants[i].name);
+
+                capture_blob(s, lp.stream_out_names, sizeof(c8*) * lp.num_stream_out_names);
+                if (lp.stream_out_names)
+                    for (u32 i = 0; i < lp.num_stream_out_names; ++i)
+                        capture_string(s, lp.stream_out_names[i]);
+            }
+            break;
+
+            case CMD_CREATE_INPUT_LAYOUT:
+            {
+                input_layout_creation_params& il = cmd.create_input_layout;
+                capture_blob(s, il.vs_byte_code, il.vs_byte_code_size);
+                capture_blob(s, il.input_layout, sizeof(input_layout_desc) * il.num_elements);
+                if (il.input_layout)
+                    for (u32 i = 0; i < il.num_elements; ++i)
+                        capture_string(s, il.input_layout[i].semantic_name);
+            }
+            break;
+
+            case CMD_CREATE_BUFFER:
+                capture_blob(s, cmd.create_buffer.data, cmd.create_buffer.buffer_size);
+                break;
+
+            case CMD_SET_VERTEX_BUFFER:
+            {
+                set_vertex_buffer_cmd& vb = cmd.set_vertex_buffer;
+                capture_blob(s, vb.buffer_indices, sizeof(u32) * vb.num_buffers * 3);
+                vb.strides = vb.buffer_indices + vb.num_buffers; // strides and offsets share the allocation
+                vb.offsets = vb.buffer_indices + vb.num_buffers * 2;
+            }
+            break;
+
+            case CMD_CREATE_TEXTURE:
+                capture_blob(s, cmd.create_texture.data, cmd.create_texture.data_size);
+                break;
+
+            case CMD_CREATE_RENDER_TARGET:
+                cmd.create_render_target.data = nullptr;
+                break;
+
+            case CMD_CREATE_BLEND_STATE:
+                capture_blob(s, cmd.create_blend_state.render_targets,
+                             sizeof(render_target_blend) * cmd.create_blend_state.num_render_targets);
+                break;
+
+            case CMD_UPDATE_BUFFER:
+                capture_blob(s, cmd.update_buffer.data, cmd.update_buffer.data_size);
+                break;
+
+            case CMD_CREATE_DEPTH_STENCIL_STATE:
+                capture_blob(s, cmd.p_create_depth_stencil_state, sizeof(depth_stencil_creation_params));
+                break;
+
+            case CMD_PUSH_PERF_MARKER:
+            case CMD_SET_PROGRAM_CACHE:
+                capture_string(s, cmd.name);
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    void capture_end()
+    {
+        capture_header header = {k_capture_magic,      k_capture_version, sizeof(renderer_cmd), s_capture.num_frames,
+                                 s_capture.num_cmds,   pen_window.width,  pen_window.height,     0};
+
+        std::ofstream ofs(s_capture.filename.c_str(), std::ofstream::binary);
+        ofs.write((const c8*)&header, sizeof(capture_header));
+        ofs.write((const c8*)s_capture.stream.data, sb_count(s_capture.stream.data));
+        ofs.close();
+
+        PEN_LOG("captured %i frames, %i commands to %s\n", s_capture.num_frames, s_capture.num_cmds,
+                s_capture.filename.c_str());
+
+        sb_free(s_capture.stream.data);
+        s_capture.stream.data = nullptr;
+    }
+
+    // render thread, called before the command executes and frees its payloads
+    void capture_cmd(const renderer_cmd& cmd)
+    {
+        switch (cmd.command_index)
+        {
+            // new frame carries a front end arena index and read backs a callback, the replay issues its own
+            case CMD_NEW_FRAME:
+            case CMD_MAP_RESOURCE:
+                return;
+            default:
+                break;
+        }
+
+        renderer_cmd cap = cmd;
+        cap.payload_flags = 0;
+        cap.payload_offset = 0;
+
+        capture_data(s_capture.stream, &cap, sizeof(renderer_cmd));
+        capture_payloads(s_capture.stream, cap);
+        s_capture.num_cmds++;
+
+        if (cmd.command_index == CMD_PRESENT)
+        {
+            s_capture.num_frames++;
+            if (--s_capture.frames_remaining == 0)
+                capture_end();
+        }
+    }
+
+    // render thread, at new frame so a frame is either fully profiled or not at all
+    void profile_new_frame()
+    {
+        bool enable = pen_atomic_load(s_profile.requested);
+        if (enable && !s_profile.enabled)
+        {
+            memset(s_profile.count, 0, sizeof(s_profile.count));
+            memset(s_profile.time_ns, 0, sizeof(s_profile.time_ns));
+            if (s_profile.frame_ms)
+                stb__sbn(s_profile.frame_ms) = 0;
+
+            s_profile.last_present_ns = get_time_ns();
+        }
+
+        s_profile.enabled = enable;
+    }
+
+    void profile_cmd(u32 command_index, f64 start_ns)
+    {
+        f64 end_ns = get_time_ns();
+        s_profile.count[command_index]++;
+        s_profile.time_ns[command_index] += end_ns - start_ns;
+
+        if (command_index == CMD_PRESENT)
+        {
+            sb_push(s_profile.frame_ms, (f32)((end_ns - s_profile.last_present_ns) / 1000.0 / 1000.0));
+            s_profile.last_present_ns = end_ns;
+        }
+    }
+
     void exec_cmd(const renderer_cmd& cmd)
     {
         //PEN_LOG("CMD %i", cmd.command_index);
 
+        if (s_capture.frames_remaining)
+            capture_cmd(cmd);
+
+        f64 start_ns = s_profile.enabled ? get_time_ns() : 0.0;
+
         switch (cmd.command_index)
         {
             case CMD_NEW_FRAME:
+                frame_arena_release(cmd.command_data_index);
+                profile_new_frame();
                 new_frame_internal();
                 break;
             case CMD_CLEAR:
@@ -300,8 +739,8 @@ namespace pen
 
             case CMD_LOAD_SHADER:
                 direct::renderer_load_shader(cmd.shader_load, cmd.resource_slot);
-                memory_free(cmd.shader_load.byte_code);
-                memory_free(cmd.shader_load.so_decl_entries);
+                payload_free(cmd, cmd.shader_load.byte_code);
+                payload_free(cmd, cmd.shader_load.so_decl_entries);
                 break;
 
             case CMD_SET_SHADER:
@@ -311,18 +750,18 @@ namespace pen
             case CMD_LINK_SHADER:
                 direct::renderer_link_shader_program(cmd.link_params, cmd.resource_slot);
                 for (u32 i = 0; i < cmd.link_params.num_constants; ++i)
-                    memory_free(cmd.link_params.constants[i].name);
-                memory_free(cmd.link_params.constants);
+                    payload_free(cmd, cmd.link_params.constants[i].name);
+                payload_free(cmd, cmd.link_params.constants);
                 if (cmd.link_params.stream_out_names)
                     for (u32 i = 0; i < cmd.link_params.num_stream_out_names; ++i)
-                        memory_free(cmd.link_params.stream_out_names[i]);
-                memory_free(cmd.link_params.stream_out_names);
+                        payload_free(cmd, cmd.link_params.stream_out_names[i]);
+                payload_free(cmd, cmd.link_params.stream_out_names);
                 break;
 
             case CMD_CREATE_INPUT_LAYOUT:
                 direct::renderer_create_input_layout(cmd.create_input_layout, cmd.resource_slot);
-                memory_free(cmd.create_input_layout.vs_byte_code);
-                memory_free(cmd.create_input_layout.input_layout);
+                payload_free(cmd, cmd.create_input_layout.vs_byte_code);
+                payload_free(cmd, cmd.create_input_layout.input_layout);
                 break;
 
             case CMD_SET_INPUT_LAYOUT:
@@ -331,16 +770,14 @@ namespace pen
 
             case CMD_CREATE_BUFFER:
                 direct::renderer_create_buffer(cmd.create_buffer, cmd.resource_slot);
-                memory_free(cmd.create_buffer.data);
+                payload_free(cmd, cmd.create_buffer.data);
                 break;
 
             case CMD_SET_VERTEX_BUFFER:
                 direct::renderer_set_vertex_buffers(cmd.set_vertex_buffer.buffer_indices, cmd.set_vertex_buffer.num_buffers,
                                                     cmd.set_vertex_buffer.start_slot, cmd.set_vertex_buffer.strides,
                                                     cmd.set_vertex_buffer.offsets);
-                memory_free(cmd.set_vertex_buffer.buffer_indices);
-                memory_free(cmd.set_vertex_buffer.strides);
-                memory_free(cmd.set_vertex_buffer.offsets);
+                payload_free(cmd, cmd.set_vertex_buffer.buffer_indices); // strides and offsets share the allocation
                 break;
 
             case CMD_SET_INDEX_BUFFER:
@@ -366,7 +803,7 @@ namespace pen
 
             case CMD_CREATE_TEXTURE:
                 direct::renderer_create_texture(cmd.create_texture, cmd.resource_slot);
-                memory_free(cmd.create_texture.data);
+                payload_free(cmd, cmd.create_texture.data);
                 break;
 
             case CMD_CREATE_SAMPLER:
@@ -420,7 +857,7 @@ namespace pen
 
             case CMD_CREATE_BLEND_STATE:
                 direct::renderer_create_blend_state(cmd.create_blend_state, cmd.resource_slot);
-                memory_free(cmd.create_blend_state.render_targets);
+                payload_free(cmd, cmd.create_blend_state.render_targets);
                 break;
 
             case CMD_SET_BLEND_STATE:
@@ -440,12 +877,12 @@ namespace pen
             case CMD_UPDATE_BUFFER:
                 direct::renderer_update_buffer(cmd.update_buffer.buffer_index, cmd.update_buffer.data,
                                                cmd.update_buffer.data_size, cmd.update_buffer.offset);
-                memory_free(cmd.update_buffer.data);
+                payload_free(cmd, cmd.update_buffer.data);
                 break;
 
             case CMD_CREATE_DEPTH_STENCIL_STATE:
                 direct::renderer_create_depth_stencil_state(*cmd.p_create_depth_stencil_state, cmd.resource_slot);
-                memory_free(cmd.p_create_depth_stencil_state);
+                payload_free(cmd, cmd.p_create_depth_stencil_state);
                 break;
 
             case CMD_SET_DEPTH_STENCIL_STATE:
@@ -530,7 +967,17 @@ namespace pen
             case CMD_SET_STENCIL_REF:
                 direct::renderer_set_stencil_ref(cmd.stencil_ref);
                 break;
+
+            case CMD_SET_PROGRAM_CACHE:
+                _renderer_program_cache_open(cmd.name);
+                _renderer_program_cache_load();
+                payload_free(cmd, cmd.name);
+                break;
         }
+
+        // present includes the deferred releases executed in end_frame_internal
+        if (s_profile.enabled)
+            profile_cmd(cmd.command_index, start_ns);
     }
 
     //
@@ -544,6 +991,8 @@ namespace pen
 
     void renderer_consume_cmd_buffer()
     {
+        PEN_ASSERT(!t_cmd_list);
+
 #if !PEN_SINGLE_THREADED
         while (_ctx->wait > 0)
             pen::thread_sleep_ms(1);
@@ -558,6 +1007,14 @@ namespace pen
         direct::renderer_sync();
         _ctx->wait++;
 #endif
+
+        u32 grows = _ctx->cmd_buffer.stats().grows;
+        if (grows != _ctx->cmd_buffer_grows)
+        {
+            _ctx->cmd_buffer_grows = grows;
+            PEN_LOG("[warning] renderer cmd_buffer grew to %u commands, increase max_renderer_commands\n",
+                    _ctx->cmd_buffer.stats().capacity);
+        }
     }
 
     void renderer_consume_cmd_buffer_non_blocking()
@@ -730,7 +1187,9 @@ namespace pen
     render_ctx renderer_create_context(u32 max_commands)
     {
         fe_render_ctx* new_ctx = new fe_render_ctx();
-        new_ctx->cmd_buffer.create(max_commands);
+        new_ctx->cmd_buffer.create(max_commands, max_commands * k_max_cmd_buffer_growth);
+
+        // release commands are only consumed after a few frames, blocking on them would stall the render thread
         new_ctx->release_cmd_buffer.create(1024);
         new_ctx->present_timer = timer_create();
         timer_start(new_ctx->present_timer);
@@ -766,6 +1225,7 @@ namespace pen
 
     // graphics test
     static bool s_run_test = false;
+    static bool s_async_shaders = false;
     static void renderer_test_read_complete(void* data, u32 row_pitch, u32 depth_pitch, u32 block_size)
     {
         // get reference image
@@ -863,6 +1323,16 @@ namespace pen
         s_run_test = true;
     }
 
+    void renderer_async_shaders_enable()
+    {
+        s_async_shaders = true;
+    }
+
+    bool renderer_async_shaders_enabled()
+    {
+        return s_async_shaders;
+    }
+
     void renderer_test_run()
     {
         if (!s_run_test)
@@ -901,6 +1371,224 @@ namespace pen
     // allow shared context for hot loaded dll
     //
 
+    void add_cmd(const renderer_cmd& cmd)
+    {
+        if (t_cmd_list)
+        {
+            sb_push(t_cmd_list->cmds, cmd);
+            return;
+        }
+
+        submit_cmd(cmd);
+    }
+
+    void add_release_cmd(const renderer_cmd& cmd)
+    {
+        PEN_ASSERT_MSG(!t_cmd_list, "resources must be released on the user thread, not recorded into a cmd list");
+        _ctx->release_cmd_buffer.put(cmd);
+    }
+
+    u32 next_resource_slot()
+    {
+        PEN_ASSERT_MSG(!t_cmd_list, "resources must be created on the user thread, not recorded into a cmd list");
+        return slot_resources_get_next(&_ctx->renderer_slot_resources);
+    }
+
+    //
+    // cmd lists
+    //
+
+    cmd_list renderer_create_cmd_list()
+    {
+        return (cmd_list) new cmd_list_data();
+    }
+
+    void renderer_release_cmd_list(cmd_list list)
+    {
+        cmd_list_data* cl = (cmd_list_data*)list;
+        sb_free(cl->cmds);
+        sb_free(cl->payload);
+        delete cl;
+    }
+
+    void renderer_begin_cmd_list(cmd_list list)
+    {
+        PEN_ASSERT_MSG(!t_cmd_list, "a cmd list is already being recorded on this thread");
+        t_cmd_list = (cmd_list_data*)list;
+    }
+
+    void renderer_end_cmd_list()
+    {
+        t_cmd_list = nullptr;
+    }
+
+    void renderer_submit_cmd_lists(cmd_list* lists, u32 num_lists)
+    {
+        PEN_ASSERT_MSG(!t_cmd_list, "cmd lists must be submitted from the user thread outside of recording");
+
+        for (u32 l = 0; l < num_lists; ++l)
+        {
+            cmd_list_data* cl = (cmd_list_data*)lists[l];
+
+            u32 num_cmds = sb_count(cl->cmds);
+            for (u32 i = 0; i < num_cmds; ++i)
+            {
+                renderer_cmd& cmd = cl->cmds[i];
+                if (cmd.payload_flags & e_payload_flags::cmd_list)
+                    relocate_payload(cmd, cl->payload);
+
+                submit_cmd(cmd);
+            }
+
+            // keep the allocations for the next frame
+            if (cl->cmds)
+                stb__sbn(cl->cmds) = 0;
+            if (cl->payload)
+                stb__sbn(cl->payload) = 0;
+        }
+    }
+
+    //
+    // capture and replay
+    //
+
+    void renderer_capture_enable(const c8* filename, u32 num_frames)
+    {
+        PEN_LOG("renderer capture enabled for %i frames.\n", num_frames);
+        s_capture.filename = filename;
+        s_capture.frames_remaining = num_frames;
+        s_capture.num_frames = 0;
+        s_capture.num_cmds = 0;
+        s_capture.stream.writing = true;
+    }
+
+    cmd_capture renderer_load_capture(const c8* filename)
+    {
+        void* file = nullptr;
+        u32   file_size = 0;
+        if (pen::filesystem_read_file_to_buffer(filename, &file, file_size) != PEN_ERR_OK)
+        {
+            PEN_LOG("failed to open capture %s\n", filename);
+            return nullptr;
+        }
+
+        capture_header* header = (capture_header*)file;
+        if (file_size < sizeof(capture_header) || header->magic != k_capture_magic ||
+            header->version != k_capture_version || header->cmd_size != sizeof(renderer_cmd))
+        {
+            PEN_LOG("%s is not a compatible command capture\n", filename);
+            memory_free(file);
+            return nullptr;
+        }
+
+        if (header->width != pen_window.width || header->height != pen_window.height)
+            PEN_LOG("capture was made at %ix%i, replaying at %ix%i\n", header->width, header->height, pen_window.width,
+                    pen_window.height);
+
+        cmd_capture_data* cap = new cmd_capture_data();
+        cap->file = file;
+
+        capture_stream s;
+        s.data = (u8*)file;
+        s.pos = sizeof(capture_header);
+        s.size = file_size;
+
+        for (u32 i = 0; i < header->num_cmds; ++i)
+        {
+            renderer_cmd cmd;
+            memcpy(&cmd, capture_data(s, nullptr, sizeof(renderer_cmd)), sizeof(renderer_cmd));
+            capture_payloads(s, cmd);
+            cmd.payload_flags = e_payload_flags::replay;
+
+            sb_push(cap->cmds, cmd);
+            if (cmd.command_index == CMD_PRESENT)
+                sb_push(cap->frame_end, sb_count(cap->cmds));
+        }
+
+        return (cmd_capture)cap;
+    }
+
+    void renderer_release_capture(cmd_capture capture)
+    {
+        cmd_capture_data* cap = (cmd_capture_data*)capture;
+        sb_free(cap->cmds);
+        sb_free(cap->frame_end);
+        memory_free(cap->file);
+        delete cap;
+    }
+
+    u32 renderer_capture_num_frames(cmd_capture capture)
+    {
+        cmd_capture_data* cap = (cmd_capture_data*)capture;
+        return sb_count(cap->frame_end);
+    }
+
+    void renderer_replay_capture_frame(cmd_capture capture, u32 frame)
+    {
+        PEN_ASSERT(!t_cmd_list);
+
+        cmd_capture_data* cap = (cmd_capture_data*)capture;
+        PEN_ASSERT(frame < (u32)sb_count(cap->frame_end));
+
+        u32 start = frame > 0 ? cap->frame_end[frame - 1] : 0;
+        for (u32 i = start; i < cap->frame_end[frame]; ++i)
+            submit_cmd(cap->cmds[i]);
+    }
+
+    void renderer_enable_cmd_profile(bool enable)
+    {
+        s_profile.requested = enable ? 1 : 0;
+    }
+
+    void renderer_report_cmd_profile()
+    {
+        u32 num_frames = sb_count(s_profile.frame_ms);
+        PEN_LOG("render thread command profile over %i frames\n", num_frames);
+
+        f64 total_ns = 0.0;
+        u64 total_count = 0;
+        for (u32 i = 0; i < CMD_COUNT; ++i)
+        {
+            if (!s_profile.count[i])
+                continue;
+
+            f64 ns = s_profile.time_ns[i];
+            f64 mcmds_per_sec = ns > 0.0 ? (f64)s_profile.count[i] / ns * 1000.0 : 0.0;
+            PEN_LOG("%-28s %10llu cmds %10.3f ms %10.1f ns/cmd %10.3f mcmds/s\n", k_cmd_names[i],
+                    (unsigned long long)s_profile.count[i], ns / 1000.0 / 1000.0, ns / (f64)s_profile.count[i],
+                    mcmds_per_sec);
+
+            total_ns += ns;
+            total_count += s_profile.count[i];
+        }
+
+        PEN_LOG("%-28s %10llu cmds %10.3f ms\n", "total", (unsigned long long)total_count, total_ns / 1000.0 / 1000.0);
+
+        if (!num_frames)
+            return;
+
+        f32* sorted = nullptr;
+        sb_add(sorted, (s32)num_frames);
+        memcpy(sorted, s_profile.frame_ms, sizeof(f32) * num_frames);
+        std::sort(sorted, sorted + num_frames);
+
+        f64 sum = 0.0;
+        for (u32 i = 0; i < num_frames; ++i)
+            sum += sorted[i];
+
+        auto percentile = [&](f32 p) { return sorted[std::min<u32>((u32)(p * num_frames), num_frames - 1)]; };
+        PEN_LOG("frame ms: avg %.3f p50 %.3f p90 %.3f p99 %.3f max %.3f\n", sum / num_frames, percentile(0.5f),
+                percentile(0.9f), percentile(0.99f), sorted[num_frames - 1]);
+
+        sb_free(sorted);
+    }
+
+    void renderer_cmd_buffer_stats(ring_buffer_stats& cmd, ring_buffer_stats& release)
+    {
+        cmd = _ctx->cmd_buffer.stats();
+        release = _ctx->release_cmd_buffer.stats();
+    }
+
     void renderer_set_current_ctx(render_ctx ctx)
     {
         _ctx = (fe_render_ctx*)ctx;
@@ -917,8 +1605,11 @@ namespace pen
 
     void renderer_new_frame()
     {
+        PEN_ASSERT(!t_cmd_list);
+
         renderer_cmd cmd;
         cmd.command_index = CMD_NEW_FRAME;
+        cmd.command_data_index = frame_arena_retire();
         add_cmd(cmd);
     }
 
@@ -982,7 +1673,7 @@ namespace pen
             memcpy(cmd.shader_load.so_decl_entries, params.so_decl_entries, entries_size);
         }
 
-        u32 resource_slot = slot_resources_get_next(&_ctx->renderer_slot_resources);
+        u32 resource_slot = next_resource_slot();
         cmd.resource_slot = resource_slot;
 
         add_cmd(cmd);
@@ -1032,7 +1723,7 @@ namespace pen
             }
         }
 
-        u32 resource_slot = slot_resources_get_next(&_ctx->renderer_slot_resources);
+        u32 resource_slot = next_resource_slot();
         cmd.resource_slot = resource_slot;
 
         add_cmd(cmd);
@@ -1072,7 +1763,7 @@ namespace pen
 
         memcpy(cmd.create_input_layout.input_layout, params.input_layout, input_layouts_size);
 
-        u32 resource_slot = slot_resources_get_next(&_ctx->renderer_slot_resources);
+        u32 resource_slot = next_resource_slot();
         cmd.resource_slot = resource_slot;
 
         add_cmd(cmd);
@@ -1100,11 +1791,11 @@ namespace pen
         if (params.data)
         {
             // make a copy of the buffers data
-            cmd.create_buffer.data = memory_alloc(params.buffer_size);
+            cmd.create_buffer.data = payload_alloc(cmd, params.buffer_size);
             memcpy(cmd.create_buffer.data, params.data, params.buffer_size);
         }
 
-        u32 resource_slot = slot_resources_get_next(&_ctx->renderer_slot_resources);
+        u32 resource_slot = next_resource_slot();
         cmd.resource_slot = resource_slot;
 
         add_cmd(cmd);
@@ -1127,9 +1818,10 @@ namespace pen
         cmd.set_vertex_buffer.start_slot = start_slot;
         cmd.set_vertex_buffer.num_buffers = num_buffers;
 
-        cmd.set_vertex_buffer.buffer_indices = (u32*)memory_alloc(sizeof(u32) * num_buffers);
-        cmd.set_vertex_buffer.strides = (u32*)memory_alloc(sizeof(u32) * num_buffers);
-        cmd.set_vertex_buffer.offsets = (u32*)memory_alloc(sizeof(u32) * num_buffers);
+        u32* payload = (u32*)payload_alloc(cmd, sizeof(u32) * num_buffers * 3);
+        cmd.set_vertex_buffer.buffer_indices = payload;
+        cmd.set_vertex_buffer.strides = payload + num_buffers;
+        cmd.set_vertex_buffer.offsets = payload + num_buffers * 2;
 
         for (u32 i = 0; i < num_buffers; ++i)
         {
@@ -1208,7 +1900,7 @@ namespace pen
 
         memcpy(&cmd.create_render_target, (void*)&tcp, sizeof(texture_creation_params));
 
-        u32 resource_slot = slot_resources_get_next(&_ctx->renderer_slot_resources);
+        u32 resource_slot = next_resource_slot();
         cmd.resource_slot = resource_slot;
 
         add_cmd(cmd);
@@ -1247,7 +1939,7 @@ namespace pen
             cmd.create_texture.data = nullptr;
         }
 
-        u32 resource_slot = slot_resources_get_next(&_ctx->renderer_slot_resources);
+        u32 resource_slot = next_resource_slot();
         cmd.resource_slot = resource_slot;
 
         add_cmd(cmd);
@@ -1263,7 +1955,7 @@ namespace pen
 
         memcpy(&cmd.create_sampler, (void*)&scp, sizeof(sampler_creation_params));
 
-        u32 resource_slot = slot_resources_get_next(&_ctx->renderer_slot_resources);
+        u32 resource_slot = next_resource_slot();
         cmd.resource_slot = resource_slot;
 
         add_cmd(cmd);
@@ -1293,7 +1985,7 @@ namespace pen
 
         memcpy(&cmd.create_raster_state, (void*)&rscp, sizeof(raster_state_creation_params));
 
-        u32 resource_slot = slot_resources_get_next(&_ctx->renderer_slot_resources);
+        u32 resource_slot = next_resource_slot();
         cmd.resource_slot = resource_slot;
 
         add_cmd(cmd);
@@ -1359,7 +2051,7 @@ namespace pen
 
         memcpy(cmd.create_blend_state.render_targets, (void*)bcp.render_targets, render_target_modes_size);
 
-        u32 resource_slot = slot_resources_get_next(&_ctx->renderer_slot_resources);
+        u32 resource_slot = next_resource_slot();
         cmd.resource_slot = resource_slot;
 
         add_cmd(cmd);
@@ -1416,7 +2108,7 @@ namespace pen
         cmd.update_buffer.buffer_index = buffer_index;
         cmd.update_buffer.data_size = data_size;
         cmd.update_buffer.offset = offset;
-        cmd.update_buffer.data = memory_alloc(data_size);
+        cmd.update_buffer.data = payload_alloc(cmd, data_size);
         memcpy(cmd.update_buffer.data, data, data_size);
 
         add_cmd(cmd);
@@ -1433,7 +2125,7 @@ namespace pen
 
         memcpy(cmd.p_create_depth_stencil_state, &dscp, sizeof(depth_stencil_creation_params));
 
-        u32 resource_slot = slot_resources_get_next(&_ctx->renderer_slot_resources);
+        u32 resource_slot = next_resource_slot();
         cmd.resource_slot = resource_slot;
 
         add_cmd(cmd);
@@ -1488,7 +2180,7 @@ namespace pen
         cmd.set_shader.shader_index = shader_index;
         cmd.set_shader.shader_type = shader_type;
 
-        _ctx->release_cmd_buffer.put(cmd);
+        add_release_cmd(cmd);
     }
 
     void renderer_release_buffer(u32 buffer_index)
@@ -1500,7 +2192,7 @@ namespace pen
         cmd.resource_slot = buffer_index;
         cmd.command_data_index = buffer_index;
 
-        _ctx->release_cmd_buffer.put(cmd);
+        add_release_cmd(cmd);
     }
 
     void renderer_release_texture(u32 texture_index)
@@ -1512,7 +2204,7 @@ namespace pen
         cmd.command_data_index = texture_index;
         cmd.frame_index = pen::_renderer_frame_index();
 
-        _ctx->release_cmd_buffer.put(cmd);
+        add_release_cmd(cmd);
     }
 
     void renderer_release_blend_state(u32 blend_state)
@@ -1524,7 +2216,7 @@ namespace pen
         cmd.resource_slot = blend_state;
         cmd.command_data_index = blend_state;
 
-        _ctx->release_cmd_buffer.put(cmd);
+        add_release_cmd(cmd);
     }
 
     void renderer_release_render_target(u32 render_target)
@@ -1536,7 +2228,7 @@ namespace pen
         cmd.resource_slot = render_target;
         cmd.command_data_index = render_target;
 
-        _ctx->release_cmd_buffer.put(cmd);
+        add_release_cmd(cmd);
     }
 
     void renderer_release_clear_state(u32 clear_state)
@@ -1548,7 +2240,7 @@ namespace pen
         cmd.resource_slot = clear_state;
         cmd.command_data_index = clear_state;
 
-        _ctx->release_cmd_buffer.put(cmd);
+        add_release_cmd(cmd);
     }
 
     void renderer_release_input_layout(u32 input_layout)
@@ -1560,7 +2252,7 @@ namespace pen
         cmd.resource_slot = input_layout;
         cmd.command_data_index = input_layout;
 
-        _ctx->release_cmd_buffer.put(cmd);
+        add_release_cmd(cmd);
     }
 
     void renderer_release_sampler(u32 sampler)
@@ -1572,7 +2264,7 @@ namespace pen
         cmd.resource_slot = sampler;
         cmd.command_data_index = sampler;
 
-        _ctx->release_cmd_buffer.put(cmd);
+        add_release_cmd(cmd);
     }
 
     void renderer_release_depth_stencil_state(u32 depth_stencil_state)
@@ -1584,7 +2276,7 @@ namespace pen
         cmd.resource_slot = depth_stencil_state;
         cmd.command_data_index = depth_stencil_state;
 
-        _ctx->release_cmd_buffer.put(cmd);
+        add_release_cmd(cmd);
     }
 
     void renderer_release_raster_state(u32 raster_state_index)
@@ -1595,7 +2287,7 @@ namespace pen
         cmd.resource_slot = raster_state_index;
         cmd.command_data_index = raster_state_index;
 
-        _ctx->release_cmd_buffer.put(cmd);
+        add_release_cmd(cmd);
     }
 
     void renderer_set_stream_out_target(u32 buffer_index)
@@ -1666,7 +2358,7 @@ namespace pen
     {
         renderer_cmd cmd;
 
-        u32 resource_slot = slot_resources_get_next(&_ctx->renderer_slot_resources);
+        u32 resource_slot = next_resource_slot();
 
         cmd.command_index = CMD_CREATE_CLEAR_STATE;
         cmd.clear_state_params = cs;
@@ -1687,6 +2379,27 @@ namespace pen
         add_cmd(cmd);
     }
 
+    void renderer_set_program_cache(const c8* filename)
+    {
+        // before the renderer is initialised the backend loads the cache as it starts up
+        if (!_ctx)
+        {
+            _renderer_program_cache_open(filename);
+            return;
+        }
+
+        renderer_cmd cmd;
+
+        cmd.command_index = CMD_SET_PROGRAM_CACHE;
+
+        u32 len = string_length(filename);
+        cmd.name = (c8*)memory_alloc(len + 1);
+        memcpy(cmd.name, filename, len);
+        cmd.name[len] = '\0';
+
+        add_cmd(cmd);
+    }
+
     void renderer_push_perf_marker(const c8* name)
     {
         renderer_cmd cmd;
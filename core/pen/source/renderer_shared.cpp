@@ -1,9 +1,15 @@
 #include "renderer_shared.h"
+#include "console.h"
 #include "data_struct.h"
+#include "file_system.h"
 #include "os.h"
 #include "pen.h"
 #include "types.h"
 
+#include "str/Str.h"
+
+#include <fstream>
+
 extern pen::window_creation_params pen_window;
 
 using namespace pen;
@@ -31,6 +37,36 @@ namespace
     };
     renderer_shared s_shared_ctx;
 
+    // program cache file: header, then per entry key, size and size bytes of blob
+    static const u32 k_program_cache_magic = 0x43525050; // 'PPRC'
+    static const u32 k_program_cache_version = 1;
+
+    struct program_cache_entry
+    {
+        hash_id key;
+        u32     size;
+        u8*     data;
+    };
+
+    struct program_cache
+    {
+        Str                  filename;
+        program_cache_entry* entries = nullptr;
+        bool                 dirty = false;
+        bool                 loaded = false;
+    };
+    program_cache s_program_cache;
+
+    program_cache_entry* _program_cache_find_entry(hash_id key)
+    {
+        u32 num = sb_count(s_program_cache.entries);
+        for (u32 i = 0; i < num; ++i)
+            if (s_program_cache.entries[i].key == key)
+                return &s_program_cache.entries[i];
+
+        return nullptr;
+    }
+
     void _commit_stretchy_dynamic_buffer(pen::stretchy_dynamic_buffer* buf)
     {
         // update buffer and reset
@@ -306,4 +342,132 @@ namespace pen
         _r.bottom = h * r.bottom;
         direct::renderer_set_scissor_rect(_r);
     }
+
+    void _renderer_program_cache_open(const c8* filename)
+    {
+        // the first file set is kept, entries stored so far are written to it at shutdown
+        if (!s_program_cache.filename.empty())
+            return;
+
+        s_program_cache.filename = filename;
+    }
+
+    void _renderer_program_cache_load()
+    {
+        if (s_program_cache.filename.empty() || s_program_cache.loaded)
+            return;
+
+        s_program_cache.loaded = true;
+
+        void* file = nullptr;
+        u32   file_size = 0;
+        if (pen::filesystem_read_file_to_buffer(s_program_cache.filename.c_str(), &file, file_size) != PEN_ERR_OK)
+        {
+            pen::memory_free(file);
+            return;
+        }
+
+        const u8* p = (const u8*)file;
+        const u8* end = p + file_size;
+
+        u32 header[3] = {0};
+        if (file_size >= sizeof(header))
+            memcpy(header, p, sizeof(header));
+
+        if (header[0] != k_program_cache_magic || header[1] != k_program_cache_version)
+        {
+            PEN_LOG("program cache %s is out of date, it will be rebuilt\n", s_program_cache.filename.c_str());
+            pen::memory_free(file);
+            return;
+        }
+
+        p += sizeof(header);
+        for (u32 i = 0; i < header[2]; ++i)
+        {
+            program_cache_entry e;
+            if (p + sizeof(e.key) + sizeof(e.size) > end)
+                break;
+
+            memcpy(&e.key, p, sizeof(e.key));
+            p += sizeof(e.key);
+            memcpy(&e.size, p, sizeof(e.size));
+            p += sizeof(e.size);
+
+            if (p + e.size > end)
+                break;
+
+            e.data = (u8*)pen::memory_alloc(e.size);
+            memcpy(e.data, p, e.size);
+            p += e.size;
+
+            sb_push(s_program_cache.entries, e);
+        }
+
+        PEN_LOG("loaded %i programs from program cache %s\n", sb_count(s_program_cache.entries),
+                s_program_cache.filename.c_str());
+
+        pen::memory_free(file);
+    }
+
+    const void* _renderer_program_cache_find(hash_id key, u32& size)
+    {
+        program_cache_entry* e = _program_cache_find_entry(key);
+        if (!e)
+        {
+            size = 0;
+            return nullptr;
+        }
+
+        size = e->size;
+        return e->data;
+    }
+
+    void _renderer_program_cache_store(hash_id key, const void* data, u32 size)
+    {
+        if (s_program_cache.filename.empty() || !data || size == 0)
+            return;
+
+        program_cache_entry* e = _program_cache_find_entry(key);
+        if (!e)
+        {
+            program_cache_entry ne = {key, 0, nullptr};
+            sb_push(s_program_cache.entries, ne);
+            e = &s_program_cache.entries[sb_count(s_program_cache.entries) - 1];
+        }
+
+        pen::memory_free(e->data);
+        e->data = (u8*)pen::memory_alloc(size);
+        e->size = size;
+        memcpy(e->data, data, size);
+
+        s_program_cache.dirty = true;
+    }
+
+    void _renderer_program_cache_save()
+    {
+        if (s_program_cache.filename.empty() || !s_program_cache.dirty)
+            return;
+
+        std::ofstream ofs(s_program_cache.filename.c_str(), std::ofstream::binary);
+        if (!ofs.is_open())
+        {
+            PEN_LOG("failed to write program cache %s\n", s_program_cache.filename.c_str());
+            return;
+        }
+
+        u32 num_entries = sb_count(s_program_cache.entries);
+        u32 header[3] = {k_program_cache_magic, k_program_cache_version, num_entries};
+        ofs.write((const c8*)header, sizeof(header));
+
+        for (u32 i = 0; i < num_entries; ++i)
+        {
+            const program_cache_entry& e = s_program_cache.entries[i];
+            ofs.write((const c8*)&e.key, sizeof(e.key));
+            ofs.write((const c8*)&e.size, sizeof(e.size));
+            ofs.write((const c8*)e.data, e.size);
+        }
+
+        ofs.close();
+        s_program_cache.dirty = false;
+    }
 } // namespace pen
@@ -31,6 +31,10 @@ namespace
     // conversion functions
     VkBufferUsageFlags to_vk_buffer_usage(u32 pen_bind_flags)
     {
+        // structured buffers
+        if (pen_bind_flags & (PEN_BIND_SHADER_RESOURCE | PEN_BIND_SHADER_WRITE))
+            return VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
         switch (pen_bind_flags)
         {
             case PEN_BIND_VERTEX_BUFFER:
@@ -381,6 +385,26 @@ namespace
         SUBMIT_COMPUTE = 1 << 1
     };
 
+    // persistently mapped pages small dynamic buffers sub allocate from on update, one ring per frame in flight which is
+    // reset once that frames fence has been waited on. pages are only added, a frame which runs out keeps the extra page.
+    struct upload_page
+    {
+        VkBuffer       buf = VK_NULL_HANDLE;
+        VkDeviceMemory mem = VK_NULL_HANDLE;
+        u8*            data = nullptr;
+        u32            size = 0;
+        u32            pos = 0;
+    };
+
+    struct upload_ring
+    {
+        upload_page* pages = nullptr;
+        u32          page = 0;
+    };
+
+    static const u32 k_upload_page_size = 4 * 1024 * 1024;
+    static const u32 k_upload_max_buffer_size = 64 * 1024; // larger dynamic buffers keep a mapped copy per frame
+
     // vulkan internals
     struct vulkan_context
     {
@@ -412,7 +436,12 @@ namespace
         VkFence                          compute_fences[NBB];
         VkPhysicalDeviceMemoryProperties mem_properties;
         VkDescriptorPool                 descriptor_pool[NBB];
+        VkPipelineCache                  pipeline_cache = VK_NULL_HANDLE; // persisted in the program cache
         u32                              submit_flags = 0;
+        upload_ring                      upload_rings[NBB]; // indexed by ii, protected by fences[ii]
+        u64                              upload_frame = 0;
+        u32                              upload_align = 256;
+        u32                              max_dynamic_uniform_buffers = 8;
     };
     vulkan_context _ctx;
 
@@ -445,7 +474,7 @@ namespace
         VkAttachmentReference* colour_attachments = nullptr;
         VkAttachmentReference* depth_attachments = nullptr;
     };
-    hash_id*       s_pass_cache_hash = nullptr;
+    hash_index     s_pass_cache_lookup; // pass state hash to index in s_pass_cache
     vk_pass_cache* s_pass_cache = nullptr;
 
     struct vk_pipeline_cache
@@ -454,7 +483,7 @@ namespace
         VkDescriptorSetLayout descriptor_set_layout = VK_NULL_HANDLE;
         VkPipelineLayout      pipeline_layout = VK_NULL_HANDLE;
     };
-    hash_id*           s_pipeline_cache_hash = nullptr;
+    hash_index         s_pipeline_cache_lookup; // pipeline state hash to index in s_pipeline_cache
     vk_pipeline_cache* s_pipeline_cache = nullptr;
 
     enum e_shd
@@ -476,6 +505,8 @@ namespace
         u32                       frame;
     };
 
+    static const u32 k_max_dynamic_offsets = 32;
+
     struct pen_state
     {
         // hashes
@@ -505,6 +536,9 @@ namespace
         VkVertexInputBindingDescription* vertex_input_bindings = nullptr;
         VkDescriptorSetLayout            descriptor_set_layout;
         u32                              descriptor_set_index;
+        VkDescriptorSet                  descriptor_set = VK_NULL_HANDLE;
+        u32                              dynamic_offsets[k_max_dynamic_offsets];
+        u32                              num_dynamic_offsets = 0;
         u32                              pipeline_index = -1;
         // resource readbacks must wait until cmd buf completion
         read_back_request* read_back_requests = nullptr;
@@ -533,23 +567,37 @@ namespace
     {
         VkBuffer       buf[NBB];
         VkDeviceMemory mem[NBB];
+        u8*            mapped[NBB]; // persistently mapped per frame copies of large dynamic buffers
+        u8*            shadow;      // cpu copy of small dynamic buffers which live in the upload ring
+        VkBuffer       ring_buf;
+        u32            ring_offset;
+        u64            ring_frame;
         u32            size;
         bool           dynamic;
 
-        VkBuffer& get_buffer()
+        void upload();
+
+        VkBuffer get_buffer()
         {
+            // ring allocations only last a frame, buffers which were not updated this frame are copied forward
+            if (shadow)
+            {
+                if (ring_frame != _ctx.upload_frame)
+                    upload();
+
+                return ring_buf;
+            }
+
             if (dynamic)
                 return buf[_ctx.ii];
 
             return buf[0];
         }
 
-        VkDeviceMemory& get_mem()
+        // byte offset into get_buffer, valid after calling it
+        u32 get_offset()
         {
-            if (dynamic)
-                return mem[_ctx.ii];
-
-            return mem[0];
+            return shadow ? ring_offset : 0;
         }
     };
 
@@ -604,6 +652,55 @@ namespace
         return hh.end();
     }
 
+    // the driver validates the header of the initial data and ignores data from another device or driver version
+    static const hash_id k_vk_pipeline_cache_key = PEN_HASH("vk_pipeline_cache");
+
+    void create_pipeline_cache()
+    {
+        _renderer_program_cache_load();
+
+        u32         data_size = 0;
+        const void* data = _renderer_program_cache_find(k_vk_pipeline_cache_key, data_size);
+
+        VkPipelineCacheCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        info.initialDataSize = data_size;
+        info.pInitialData = data;
+
+        CHECK_CALL(vkCreatePipelineCache(_ctx.device, &info, nullptr, &_ctx.pipeline_cache));
+    }
+
+    // created with the first pipeline so a program cache set after initialise can seed it
+    VkPipelineCache get_pipeline_cache()
+    {
+        if (!_ctx.pipeline_cache)
+            create_pipeline_cache();
+
+        return _ctx.pipeline_cache;
+    }
+
+    void destroy_pipeline_cache()
+    {
+        if (!_ctx.pipeline_cache)
+            return;
+
+        size_t data_size = 0;
+        vkGetPipelineCacheData(_ctx.device, _ctx.pipeline_cache, &data_size, nullptr);
+
+        if (data_size > 0)
+        {
+            void* data = pen::memory_alloc(data_size);
+            vkGetPipelineCacheData(_ctx.device, _ctx.pipeline_cache, &data_size, data);
+            _renderer_program_cache_store(k_vk_pipeline_cache_key, data, (u32)data_size);
+            pen::memory_free(data);
+        }
+
+        _renderer_program_cache_save();
+
+        vkDestroyPipelineCache(_ctx.device, _ctx.pipeline_cache, nullptr);
+        _ctx.pipeline_cache = VK_NULL_HANDLE;
+    }
+
     void destroy_caches()
     {
         // render passes
@@ -622,9 +719,8 @@ namespace
         }
 
         sb_free(s_pass_cache);
-        sb_free(s_pass_cache_hash);
         s_pass_cache = nullptr;
-        s_pass_cache_hash = nullptr;
+        s_pass_cache_lookup.clear();
 
         // pipelines
         pc = sb_count(s_pipeline_cache);
@@ -636,9 +732,8 @@ namespace
         }
 
         sb_free(s_pipeline_cache);
-        sb_free(s_pipeline_cache_hash);
         s_pipeline_cache = nullptr;
-        s_pipeline_cache_hash = nullptr;
+        s_pipeline_cache_lookup.clear();
     }
 
     void destory_swapchain()
@@ -867,6 +962,7 @@ namespace
         VkDescriptorPoolSize pool_sizes[] = {{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, size},
                                              {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, size},
                                              {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, size},
+                                             {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, size},
                                              {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, size}};
 
         u32 max_sets = 0;
@@ -1217,6 +1313,96 @@ namespace
         return 0;
     }
 
+    upload_page create_upload_page(u32 size)
+    {
+        upload_page page;
+        page.size = size;
+
+        VkBufferCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        info.size = size;
+        info.usage =
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+        info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        CHECK_CALL(vkCreateBuffer(_ctx.device, &info, nullptr, &page.buf));
+
+        VkMemoryRequirements req;
+        vkGetBufferMemoryRequirements(_ctx.device, page.buf, &req);
+
+        VkMemoryAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        alloc_info.allocationSize = req.size;
+        alloc_info.memoryTypeIndex =
+            get_mem_type(req.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+        CHECK_CALL(vkAllocateMemory(_ctx.device, &alloc_info, nullptr, &page.mem));
+        CHECK_CALL(vkBindBufferMemory(_ctx.device, page.buf, page.mem, 0));
+        CHECK_CALL(vkMapMemory(_ctx.device, page.mem, 0, VK_WHOLE_SIZE, 0, (void**)&page.data));
+
+        return page;
+    }
+
+    void reset_upload_ring(upload_ring& ring)
+    {
+        u32 num_pages = sb_count(ring.pages);
+        for (u32 i = 0; i < num_pages; ++i)
+            ring.pages[i].pos = 0;
+
+        ring.page = 0;
+    }
+
+    void destroy_upload_rings()
+    {
+        for (u32 r = 0; r < NBB; ++r)
+        {
+            upload_ring& ring = _ctx.upload_rings[r];
+
+            u32 num_pages = sb_count(ring.pages);
+            for (u32 i = 0; i < num_pages; ++i)
+            {
+                vkDestroyBuffer(_ctx.device, ring.pages[i].buf, nullptr);
+                vkFreeMemory(_ctx.device, ring.pages[i].mem, nullptr);
+            }
+
+            sb_free(ring.pages);
+            ring.pages = nullptr;
+        }
+    }
+
+    u8* upload_ring_alloc(u32 size, VkBuffer& buf, u32& offset)
+    {
+        upload_ring& ring = _ctx.upload_rings[_ctx.ii];
+
+        // upload_align is a power of 2, it satisfies uniform, vertex and index offset alignment
+        u32 aligned_size = (size + _ctx.upload_align - 1) & ~(_ctx.upload_align - 1);
+
+        u32 num_pages = sb_count(ring.pages);
+        for (; ring.page < num_pages; ++ring.page)
+        {
+            upload_page& page = ring.pages[ring.page];
+            if (page.pos + size <= page.size)
+                break;
+        }
+
+        if (ring.page == num_pages)
+            sb_push(ring.pages, create_upload_page(aligned_size > k_upload_page_size ? aligned_size : k_upload_page_size));
+
+        upload_page& page = ring.pages[ring.page];
+        buf = page.buf;
+        offset = page.pos;
+        page.pos += aligned_size;
+
+        return page.data + offset;
+    }
+
+    void vulkan_buffer::upload()
+    {
+        u8* dst = upload_ring_alloc(size, ring_buf, ring_offset);
+        memcpy(dst, shadow, size);
+        ring_frame = _ctx.upload_frame;
+    }
+
     void end_render_pass()
     {
         if (!_state.pass)
@@ -1297,15 +1483,12 @@ namespace
             return;
 
         // check in pass hashes
-        u32 pcc = sb_count(s_pass_cache);
-        for (u32 i = 0; i < pcc; ++i)
+        u32 pc_idx = 0;
+        if (s_pass_cache_lookup.find(ph, pc_idx))
         {
-            if (s_pass_cache_hash[i] == ph)
-            {
-                // found exisiting
-                begin_pass_from_cache(s_pass_cache[i], ph);
-                return;
-            }
+            // found exisiting
+            begin_pass_from_cache(s_pass_cache[pc_idx], ph);
+            return;
         }
 
         // begin building a new pipeline
@@ -1436,9 +1619,9 @@ namespace
         sb_free(attachment_img_view);
 
         // add new pass into pass cache
-        u32 pc_idx = sb_count(s_pass_cache);
+        pc_idx = sb_count(s_pass_cache);
         sb_push(s_pass_cache, vk_pass_cache());
-        sb_push(s_pass_cache_hash, ph);
+        s_pass_cache_lookup.insert(ph, pc_idx);
         vk_pass_cache& vk_pc = s_pass_cache[pc_idx];
         vk_pc.pass = pass;
 
@@ -1471,6 +1654,24 @@ namespace
         begin_pass_from_cache(vk_pc, ph);
     }
 
+    // the descriptor set layout is created from the bound slots, constant buffers can be dynamic or plain so pipelines
+    // are keyed on it as well as the shaders and states
+    hash_id binding_layout_hash()
+    {
+        HashMurmur2A hh;
+        hh.begin();
+
+        u32 num_bindings = sb_count(_state.bindings);
+        for (u32 i = 0; i < num_bindings; ++i)
+        {
+            hh.add(_state.bindings[i].slot);
+            hh.add((u32)_state.bindings[i].descriptor_type);
+            hh.add(_state.bindings[i].stage);
+        }
+
+        return hh.end();
+    }
+
     void create_pipeline_layout(VkPipelineLayout& pipeline_layout, VkDescriptorSetLayout& descriptor_set_layout)
     {
         // layout
@@ -1521,6 +1722,7 @@ namespace
         hh.add(_state.input_layout);
         hh.add(_state.raster);
         hh.add(_state.depth_stencil_state);
+        hh.add(binding_layout_hash());
         hash_id ph = hh.end();
 
         // already bound
@@ -1528,15 +1730,12 @@ namespace
             return;
 
         // check in pipeline hashes
-        u32 plc = sb_count(s_pipeline_cache);
-        for (u32 i = 0; i < plc; ++i)
+        u32 idx = 0;
+        if (s_pipeline_cache_lookup.find(ph, idx))
         {
-            if (s_pipeline_cache_hash[i] == ph)
-            {
-                // found exisiting
-                bind_pipeline_from_cache(s_pipeline_cache[i], VK_PIPELINE_BIND_POINT_GRAPHICS, ph, i);
-                return;
-            }
+            // found exisiting
+            bind_pipeline_from_cache(s_pipeline_cache[idx], VK_PIPELINE_BIND_POINT_GRAPHICS, ph, idx);
+            return;
         }
 
         // create new pipeline
@@ -1683,15 +1882,15 @@ namespace
         info.basePipelineHandle = VK_NULL_HANDLE;
 
         VkPipeline pipeline;
-        CHECK_CALL(vkCreateGraphicsPipelines(_ctx.device, VK_NULL_HANDLE, 1, &info, nullptr, &pipeline));
+        CHECK_CALL(vkCreateGraphicsPipelines(_ctx.device, get_pipeline_cache(), 1, &info, nullptr, &pipeline));
 
         vk_pipeline_cache new_pipeline;
         new_pipeline.pipeline = pipeline;
         new_pipeline.pipeline_layout = pipeline_layout;
         new_pipeline.descriptor_set_layout = descriptor_set_layout;
 
-        u32 idx = sb_count(s_pipeline_cache);
-        sb_push(s_pipeline_cache_hash, ph);
+        idx = sb_count(s_pipeline_cache);
+        s_pipeline_cache_lookup.insert(ph, idx);
         sb_push(s_pipeline_cache, new_pipeline);
 
         bind_pipeline_from_cache(s_pipeline_cache[idx], VK_PIPELINE_BIND_POINT_GRAPHICS, ph, idx);
@@ -1706,6 +1905,7 @@ namespace
         HashMurmur2A hh;
         hh.begin();
         hh.add(_state.shader[e_shd::compute]);
+        hh.add(binding_layout_hash());
         hash_id ph = hh.end();
 
         // already bound
@@ -1713,15 +1913,12 @@ namespace
             return;
 
         // check in pipeline hashes
-        u32 plc = sb_count(s_pipeline_cache);
-        for (u32 i = 0; i < plc; ++i)
+        u32 idx = 0;
+        if (s_pipeline_cache_lookup.find(ph, idx))
         {
-            if (s_pipeline_cache_hash[i] == ph)
-            {
-                // found exisiting
-                bind_pipeline_from_cache(s_pipeline_cache[i], VK_PIPELINE_BIND_POINT_COMPUTE, ph, i);
-                return;
-            }
+            // found exisiting
+            bind_pipeline_from_cache(s_pipeline_cache[idx], VK_PIPELINE_BIND_POINT_COMPUTE, ph, idx);
+            return;
         }
 
         // layout
@@ -1740,15 +1937,15 @@ namespace
         info.stage = compute_shader_info;
 
         VkPipeline pipeline;
-        CHECK_CALL(vkCreateComputePipelines(_ctx.device, VK_NULL_HANDLE, 1, &info, nullptr, &pipeline));
+        CHECK_CALL(vkCreateComputePipelines(_ctx.device, get_pipeline_cache(), 1, &info, nullptr, &pipeline));
 
         vk_pipeline_cache new_pipeline;
         new_pipeline.pipeline = pipeline;
         new_pipeline.pipeline_layout = pipeline_layout;
         new_pipeline.descriptor_set_layout = descriptor_set_layout;
 
-        u32 idx = sb_count(s_pipeline_cache);
-        sb_push(s_pipeline_cache_hash, ph);
+        idx = sb_count(s_pipeline_cache);
+        s_pipeline_cache_lookup.insert(ph, idx);
         sb_push(s_pipeline_cache, new_pipeline);
 
         bind_pipeline_from_cache(s_pipeline_cache[idx], VK_PIPELINE_BIND_POINT_COMPUTE, ph, idx);
@@ -1761,9 +1958,56 @@ namespace
         if (nb == 0)
             return;
 
-        hash_id h = sb_hash(_state.bindings);
+        // constant buffers in the upload ring move on every update. dynamic ones only change their offset so the set is
+        // reused, offsets are passed in binding order and the rest are written into the set
+        u32 dynamic_slots[k_max_dynamic_offsets];
+        u32 dynamic_offsets[k_max_dynamic_offsets];
+        u32 num_dynamic = 0;
+
+        HashMurmur2A hh;
+        hh.begin();
+        hh.add(sb_hash(_state.bindings));
+        for (u32 i = 0; i < nb; ++i)
+        {
+            pen_binding& pb = _state.bindings[i];
+            if (pb.descriptor_type != VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER &&
+                pb.descriptor_type != VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC)
+                continue;
+
+            vulkan_buffer& vb = _res_pool.get(pb.index).buffer;
+            hh.add(vb.get_buffer());
+
+            if (pb.descriptor_type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
+            {
+                hh.add(vb.get_offset());
+                continue;
+            }
+
+            PEN_ASSERT(num_dynamic < k_max_dynamic_offsets);
+            u32 j = num_dynamic++;
+            for (; j > 0 && dynamic_slots[j - 1] > pb.slot; --j)
+            {
+                dynamic_slots[j] = dynamic_slots[j - 1];
+                dynamic_offsets[j] = dynamic_offsets[j - 1];
+            }
+            dynamic_slots[j] = pb.slot;
+            dynamic_offsets[j] = vb.get_offset();
+        }
+        hash_id h = hh.end();
+
         if (h == _state.hdescriptors)
+        {
+            if (num_dynamic == _state.num_dynamic_offsets &&
+                memcmp(dynamic_offsets, _state.dynamic_offsets, num_dynamic * sizeof(u32)) == 0)
+                return;
+
+            memcpy(_state.dynamic_offsets, dynamic_offsets, num_dynamic * sizeof(u32));
+            _state.num_dynamic_offsets = num_dynamic;
+
+            vkCmdBindDescriptorSets(cmd_buf, bind_point, _state.pipeline_layout, 0, 1, &_state.descriptor_set, num_dynamic,
+                                    dynamic_offsets);
             return;
+        }
 
         // allocate a descriptor set
         VkDescriptorSet             descriptor_set = 0;
@@ -1797,11 +2041,13 @@ namespace
             switch (pb.descriptor_type)
             {
                 case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+                case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+                case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
                 {
                     vulkan_buffer& vb = _res_pool.get(pb.index).buffer;
 
                     buf_info.buffer = vb.get_buffer();
-                    buf_info.offset = 0;
+                    buf_info.offset = pb.descriptor_type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC ? 0 : vb.get_offset();
                     buf_info.range = vb.size;
 
                     descriptor_write.pBufferInfo = &buf_info;
@@ -1836,8 +2082,12 @@ namespace
             vkUpdateDescriptorSets(_ctx.device, 1, &descriptor_write, 0, nullptr);
         }
 
-        vkCmdBindDescriptorSets(cmd_buf, bind_point, _state.pipeline_layout, 0, 1, &descriptor_set, 0, nullptr);
+        vkCmdBindDescriptorSets(cmd_buf, bind_point, _state.pipeline_layout, 0, 1, &descriptor_set, num_dynamic,
+                                dynamic_offsets);
 
+        memcpy(_state.dynamic_offsets, dynamic_offsets, num_dynamic * sizeof(u32));
+        _state.num_dynamic_offsets = num_dynamic;
+        _state.descriptor_set = descriptor_set;
         _state.hdescriptors = h;
     }
 } // namespace
@@ -1895,6 +2145,11 @@ namespace pen
                 _ctx.submit_flags = 0;
             }
 
+            // the gpu is done with this image's uploads, buffers from older frames are copied forward when next bound
+            reset_upload_ring(_ctx.upload_rings[_ctx.ii]);
+            _ctx.upload_frame++;
+            _state.hdescriptors = 0;
+
             CHECK_CALL(vkBeginCommandBuffer(_ctx.cmd_bufs[_ctx.ii], &begin_info));
 
             _ctx.submit_flags |= SUBMIT_GRAPHICS;
@@ -1942,6 +2197,15 @@ namespace pen
 
             create_device_surface_swapchain(params);
 
+            VkPhysicalDeviceProperties props;
+            vkGetPhysicalDeviceProperties(_ctx.physical_device, &props);
+
+            u32 align = (u32)props.limits.minUniformBufferOffsetAlignment;
+            _ctx.upload_align = align > 16 ? align : 16;
+            _ctx.max_dynamic_uniform_buffers = props.limits.maxDescriptorSetUniformBuffersDynamic;
+            if (_ctx.max_dynamic_uniform_buffers > k_max_dynamic_offsets)
+                _ctx.max_dynamic_uniform_buffers = k_max_dynamic_offsets;
+
             new_frame(0);
 
             return 0;
@@ -1956,6 +2220,8 @@ namespace pen
                 vkDestroyDescriptorPool(_ctx.device, _ctx.descriptor_pool[i], nullptr);
 
             destroy_caches();
+            destroy_pipeline_cache();
+            destroy_upload_rings();
             destory_swapchain();
 
             vkDestroyCommandPool(_ctx.device, _ctx.cmd_pool, nullptr);
@@ -2087,6 +2353,15 @@ namespace pen
             _res_pool.insert({}, resource_slot);
             vulkan_buffer& res = _res_pool.get(resource_slot).buffer;
             res.size = params.buffer_size;
+            res.shadow = nullptr;
+            res.ring_buf = VK_NULL_HANDLE;
+            res.ring_offset = 0;
+            res.ring_frame = (u64)-1;
+
+            for (u32 i = 0; i < NBB; ++i)
+                res.mapped[i] = nullptr;
+
+            VkBufferUsageFlags usage = to_vk_buffer_usage(params.bind_flags);
 
             u32 c = 1;
             res.dynamic = false;
@@ -2094,13 +2369,27 @@ namespace pen
             {
                 res.dynamic = true;
                 c = NBB;
+
+                // small vertex, index and constant buffers are sub allocated from the upload ring on each update
+                if (params.buffer_size <= k_upload_max_buffer_size && usage != VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
+                {
+                    res.shadow = (u8*)pen::memory_alloc(params.buffer_size);
+                    if (params.data)
+                        memcpy(res.shadow, params.data, params.buffer_size);
+                    else
+                        memset(res.shadow, 0x0, params.buffer_size);
+
+                    return;
+                }
             }
 
             for (u32 i = 0; i < c; ++i)
             {
-                _create_buffer_internal(to_vk_buffer_usage(params.bind_flags),
-                                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                _create_buffer_internal(usage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
                                         params.data, params.buffer_size, res.buf[i], res.mem[i]);
+
+                if (res.dynamic)
+                    CHECK_CALL(vkMapMemory(_ctx.device, res.mem[i], 0, VK_WHOLE_SIZE, 0, (void**)&res.mapped[i]));
             }
         }
 
@@ -2117,8 +2406,9 @@ namespace pen
             static VkDeviceSize _offsets[8];
             for (u32 i = 0; i < num_buffers; ++i)
             {
-                _bufs[i] = _res_pool.get(buffer_indices[i]).buffer.get_buffer();
-                _offsets[i] = offsets[i];
+                vulkan_buffer& vb = _res_pool.get(buffer_indices[i]).buffer;
+                _bufs[i] = vb.get_buffer();
+                _offsets[i] = offsets[i] + vb.get_offset();
 
                 VkVertexInputBindingDescription vb;
                 vb.binding = i;
@@ -2133,8 +2423,18 @@ namespace pen
 
         void renderer_set_index_buffer(u32 buffer_index, u32 format, u32 offset)
         {
-            VkBuffer buf = _res_pool.get(buffer_index).buffer.get_buffer();
-            vkCmdBindIndexBuffer(_ctx.cmd_bufs[_ctx.ii], buf, offset, to_vk_index_type(format));
+            vulkan_buffer& vb = _res_pool.get(buffer_index).buffer;
+            VkBuffer       buf = vb.get_buffer();
+            vkCmdBindIndexBuffer(_ctx.cmd_bufs[_ctx.ii], buf, offset + vb.get_offset(), to_vk_index_type(format));
+        }
+
+        inline VkDescriptorType _binding_class(VkDescriptorType type)
+        {
+            // a constant buffer slot replaces the previous buffer whether it was bound dynamic or not
+            if (type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC)
+                return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+
+            return type;
         }
 
         inline void _set_binding(const pen_binding& b)
@@ -2142,7 +2442,8 @@ namespace pen
             u32 num = sb_count(_state.bindings);
             for (u32 i = 0; i < num; ++i)
             {
-                if (_state.bindings[i].slot == b.slot && _state.bindings[i].descriptor_type == b.descriptor_type)
+                if (_state.bindings[i].slot == b.slot &&
+                    _binding_class(_state.bindings[i].descriptor_type) == _binding_class(b.descriptor_type))
                 {
                     _state.bindings[i] = b;
                     return;
@@ -2157,6 +2458,16 @@ namespace pen
             if (buffer_index == 0)
                 return;
 
+            // ring buffers bind with a dynamic offset, past the device limit the offset is written into the set instead
+            u32 num_dynamic = 0;
+            u32 nb = sb_count(_state.bindings);
+            for (u32 i = 0; i < nb; ++i)
+            {
+                if (_state.bindings[i].descriptor_type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC &&
+                    _state.bindings[i].slot != unit)
+                    ++num_dynamic;
+            }
+
             pen_binding b;
             b.descriptor_type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
             b.stage = to_vk_stage(flags);
@@ -2164,11 +2475,26 @@ namespace pen
             b.slot = unit;
             b.bind_flags = flags;
 
+            if (_res_pool.get(buffer_index).buffer.shadow && num_dynamic < _ctx.max_dynamic_uniform_buffers)
+                b.descriptor_type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+
             _set_binding(b);
         }
 
         void renderer_set_structured_buffer(u32 buffer_index, u32 unit, u32 flags)
         {
+            if (buffer_index == 0)
+                return;
+
+            // structured buffers share d3d style t registers with textures
+            pen_binding b;
+            b.descriptor_type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            b.stage = to_vk_stage(flags);
+            b.index = buffer_index;
+            b.slot = unit + GLSL_TEXTURE_BINDING_OFFSET;
+            b.bind_flags = flags;
+
+            _set_binding(b);
         }
 
         void renderer_update_buffer(u32 buffer_index, const void* data, u32 data_size, u32 offset)
@@ -2176,12 +2502,27 @@ namespace pen
             if (data_size == 0)
                 return;
 
-            VkDeviceMemory mem = _res_pool.get(buffer_index).buffer.get_mem();
+            vulkan_buffer& vb = _res_pool.get(buffer_index).buffer;
+            PEN_ASSERT(offset + data_size <= vb.size);
+
+            if (vb.shadow)
+            {
+                // a new copy in this frames ring, draws already recorded keep reading the previous one
+                memcpy(vb.shadow + offset, data, (size_t)data_size);
+                vb.upload();
+                return;
+            }
+
+            if (vb.dynamic)
+            {
+                memcpy(vb.mapped[_ctx.ii] + offset, data, (size_t)data_size);
+                return;
+            }
 
             void* map_data;
-            vkMapMemory(_ctx.device, mem, 0, data_size, 0, &map_data);
+            vkMapMemory(_ctx.device, vb.mem[0], offset, data_size, 0, &map_data);
             memcpy(map_data, data, (size_t)data_size);
-            vkUnmapMemory(_ctx.device, mem);
+            vkUnmapMemory(_ctx.device, vb.mem[0]);
         }
 
         void renderer_create_texture(const texture_creation_params& tcp, u32 resource_slot)
@@ -2727,7 +3068,14 @@ namespace pen
         void renderer_release_buffer(u32 buffer_index)
         {
             vulkan_buffer& buf = _res_pool.get(buffer_index).buffer;
-            u32            c = buf.dynamic ? NBB : 1;
+            if (buf.shadow)
+            {
+                pen::memory_free(buf.shadow);
+                buf.shadow = nullptr;
+                return;
+            }
+
+            u32 c = buf.dynamic ? NBB : 1;
 
             for (u32 i = 0; i < c; ++i)
             {
@@ -122,6 +122,66 @@ namespace pen
         return PEN_ERR_FILE_NOT_FOUND;
     }
 
+    pen_error filesystem_map_file(const c8* filename, mapped_file& mapping)
+    {
+        mapping = mapped_file();
+
+        c8* windir_filename = swap_slashes(filename);
+
+        HANDLE file = CreateFileA(windir_filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                  FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+        pen::memory_free(windir_filename);
+
+        if (file == INVALID_HANDLE_VALUE)
+            return PEN_ERR_FILE_NOT_FOUND;
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size))
+        {
+            CloseHandle(file);
+            return PEN_ERR_FAILED;
+        }
+
+        // empty files cannot be mapped, return a valid empty mapping
+        if (size.QuadPart == 0)
+        {
+            CloseHandle(file);
+            return PEN_ERR_OK;
+        }
+
+        HANDLE file_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+        // the mapping keeps its own reference to the file
+        CloseHandle(file);
+
+        if (!file_mapping)
+            return PEN_ERR_FAILED;
+
+        void* data = MapViewOfFile(file_mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!data)
+        {
+            CloseHandle(file_mapping);
+            return PEN_ERR_FAILED;
+        }
+
+        mapping.data = data;
+        mapping.size = (size_t)size.QuadPart;
+        mapping.handle = file_mapping;
+        return PEN_ERR_OK;
+    }
+
+    void filesystem_unmap_file(mapped_file& mapping)
+    {
+        if (mapping.data)
+            UnmapViewOfFile(mapping.data);
+
+        if (mapping.handle)
+            CloseHandle((HANDLE)mapping.handle);
+
+        mapping = mapped_file();
+    }
+
     pen_error filesystem_enum_volumes(fs_tree_node& tree)
     {
         DWORD drive_bit_mask = GetLogicalDrives();
@@ -2,6 +2,7 @@
 // Copyright 2014 - 2023 Alex Dixon.
 // License: https://github.com/polymonster/pmtech/blob/master/license.md
 
+#include <stdio.h>
 #include <windows.h>
 
 #include "os.h"
@@ -149,6 +150,30 @@ namespace
             pen::renderer_test_enable();
         }
 
+        // -capture <filename> <num_frames>
+        s32 capture_arg = pen::str_find(str_cmd, "-capture");
+        if (capture_arg != -1)
+        {
+            c8  capture_file[256];
+            u32 capture_frames = 0;
+            if (sscanf(lpCmdLine + capture_arg, "-capture %255s %u", capture_file, &capture_frames) == 2)
+                pen::renderer_capture_enable(capture_file, capture_frames);
+        }
+
+        // -program_cache <filename>
+        s32 program_cache_arg = pen::str_find(str_cmd, "-program_cache");
+        if (program_cache_arg != -1)
+        {
+            c8 program_cache_file[256];
+            if (sscanf(lpCmdLine + program_cache_arg, "-program_cache %255s", program_cache_file) == 1)
+                pen::renderer_set_program_cache(program_cache_file);
+        }
+
+        if (pen::str_find(str_cmd, "-async_shaders") != -1)
+        {
+            pen::renderer_async_shaders_enable();
+        }
+
         window_params wp;
         wp.cmdshow = nCmdShow;
         wp.hinstance = hInstance;
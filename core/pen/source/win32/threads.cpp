@@ -127,4 +127,11 @@ namespace pen
         // windows cannot sleep micros
         PEN_ASSERT(0);
     }
+
+    u32 thread_get_hardware_concurrency()
+    {
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        return info.dwNumberOfProcessors > 0 ? (u32)info.dwNumberOfProcessors : 1;
+    }
 } // namespace pen
@@ -9,6 +9,7 @@
 #include "input.h"
 #include "os.h"
 #include "renderer.h"
+#include "timer.h"
 
 #include "maths/maths.h"
 
@@ -307,6 +308,7 @@ namespace put
         wvp.view_direction = vec4f(inv_view.get_row(2).xyz, p_camera->far_plane);
         wvp.view_matrix_inverse = inv_view;
         wvp.view_projection_inverse = mat::inverse4x4(wvp.view_projection);
+        wvp.view_time = vec4f((f32)pen::get_time_ms(), 0.0f, 0.0f, 0.0f);
 
         pen::renderer_update_buffer(p_camera->cbuffer, &wvp, sizeof(camera_cbuffer));
 
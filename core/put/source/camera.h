@@ -36,6 +36,7 @@ namespace put
         mat4  view_matrix_inverse;
         vec4f view_position;
         vec4f view_direction;
+        vec4f view_time; // x = time ms
     };
 
     struct frustum
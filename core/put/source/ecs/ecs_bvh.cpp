@@ -0,0 +1,694 @@
+// ecs_bvh.cpp
+// Copyright 2014 - 2023 Alex Dixon.
+// License: https://github.com/polymonster/pmtech/blob/master/license.md
+
+#include "ecs/ecs_bvh.h"
+#include "ecs/ecs_cull.h"
+#include "ecs/ecs_scene.h"
+
+#include "data_struct.h"
+
+#include <float.h>
+
+namespace put
+{
+    namespace ecs
+    {
+        namespace
+        {
+            // the tree is kept balanced with rotations, so this comfortably covers millions of leaves
+            const u32 k_max_stack = 256;
+
+            namespace e_overlap
+            {
+                enum overlap_t
+                {
+                    outside,
+                    intersect,
+                    inside
+                };
+            }
+
+            pen_inline bool is_leaf(const bvh_node& node)
+            {
+                return node.left == -1;
+            }
+
+            pen_inline s32 max_height(s32 a, s32 b)
+            {
+                return a > b ? a : b;
+            }
+
+            pen_inline f32 surface_area(const vec3f& min, const vec3f& max)
+            {
+                vec3f d = max - min;
+                return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+            }
+
+            pen_inline bool contains(const bvh_node& node, const vec3f& min, const vec3f& max)
+            {
+                return node.min.x <= min.x && node.min.y <= min.y && node.min.z <= min.z && node.max.x >= max.x &&
+                       node.max.y >= max.y && node.max.z >= max.z;
+            }
+
+            pen_inline bool overlaps(const vec3f& amin, const vec3f& amax, const vec3f& bmin, const vec3f& bmax)
+            {
+                return amin.x <= bmax.x && amax.x >= bmin.x && amin.y <= bmax.y && amax.y >= bmin.y && amin.z <= bmax.z &&
+                       amax.z >= bmin.z;
+            }
+
+            s32 alloc_node(ecs_bvh& bvh)
+            {
+                s32 index = bvh.free_list;
+                if (index != -1)
+                {
+                    bvh.free_list = bvh.nodes[index].parent;
+                }
+                else
+                {
+                    index = (s32)sb_count(bvh.nodes);
+                    sb_push(bvh.nodes, bvh_node());
+                }
+
+                bvh.nodes[index] = bvh_node();
+                return index;
+            }
+
+            void free_node(ecs_bvh& bvh, s32 index)
+            {
+                bvh.nodes[index].parent = bvh.free_list;
+                bvh.nodes[index].height = -1;
+                bvh.free_list = index;
+            }
+
+            void fix_node(ecs_bvh& bvh, s32 index)
+            {
+                bvh_node&       node = bvh.nodes[index];
+                const bvh_node& l = bvh.nodes[node.left];
+                const bvh_node& r = bvh.nodes[node.right];
+
+                node.min = min_union(l.min, r.min);
+                node.max = max_union(l.max, r.max);
+                node.height = 1 + max_height(l.height, r.height);
+            }
+
+            void replace_child(ecs_bvh& bvh, s32 parent, s32 old_child, s32 new_child)
+            {
+                if (parent == -1)
+                {
+                    bvh.root = new_child;
+                    return;
+                }
+
+                if (bvh.nodes[parent].left == old_child)
+                    bvh.nodes[parent].left = new_child;
+                else
+                    bvh.nodes[parent].right = new_child;
+            }
+
+            // rotates the taller grandchild up if a is imbalanced, returns the new root of the subtree
+            s32 balance(ecs_bvh& bvh, s32 a)
+            {
+                bvh_node* nodes = bvh.nodes;
+                bvh_node& A = nodes[a];
+
+                if (is_leaf(A) || A.height < 2)
+                    return a;
+
+                s32       b = A.left;
+                s32       c = A.right;
+                bvh_node& B = nodes[b];
+                bvh_node& C = nodes[c];
+
+                s32 bf = C.height - B.height;
+
+                // rotate c up
+                if (bf > 1)
+                {
+                    s32 f = C.left;
+                    s32 g = C.right;
+
+                    C.left = a;
+                    C.parent = A.parent;
+                    A.parent = c;
+                    replace_child(bvh, C.parent, a, c);
+
+                    // the taller of c's children stays with c, the other moves to a
+                    if (nodes[f].height > nodes[g].height)
+                    {
+                        C.right = f;
+                        A.right = g;
+                        nodes[g].parent = a;
+                    }
+                    else
+                    {
+                        C.right = g;
+                        A.right = f;
+                        nodes[f].parent = a;
+                    }
+
+                    fix_node(bvh, a);
+                    fix_node(bvh, c);
+                    return c;
+                }
+
+                // rotate b up
+                if (bf < -1)
+                {
+                    s32 d = B.left;
+                    s32 e = B.right;
+
+                    B.left = a;
+                    B.parent = A.parent;
+                    A.parent = b;
+                    replace_child(bvh, B.parent, a, b);
+
+                    if (nodes[d].height > nodes[e].height)
+                    {
+                        B.right = d;
+                        A.left = e;
+                        nodes[e].parent = a;
+                    }
+                    else
+                    {
+                        B.right = e;
+                        A.left = d;
+                        nodes[d].parent = a;
+                    }
+
+                    fix_node(bvh, a);
+                    fix_node(bvh, b);
+                    return b;
+                }
+
+                return a;
+            }
+
+            void refit_ancestors(ecs_bvh& bvh, s32 index)
+            {
+                while (index != -1)
+                {
+                    index = balance(bvh, index);
+                    fix_node(bvh, index);
+                    index = bvh.nodes[index].parent;
+                }
+            }
+
+            f32 insertion_cost(const bvh_node& child, const vec3f& min, const vec3f& max)
+            {
+                f32 area = surface_area(min_union(child.min, min), max_union(child.max, max));
+                if (is_leaf(child))
+                    return area;
+
+                return area - surface_area(child.min, child.max);
+            }
+
+            void insert_leaf(ecs_bvh& bvh, s32 leaf)
+            {
+                if (bvh.root == -1)
+                {
+                    bvh.root = leaf;
+                    bvh.nodes[leaf].parent = -1;
+                    return;
+                }
+
+                // find the cheapest sibling by surface area heuristic
+                vec3f lmin = bvh.nodes[leaf].min;
+                vec3f lmax = bvh.nodes[leaf].max;
+
+                s32 index = bvh.root;
+                while (!is_leaf(bvh.nodes[index]))
+                {
+                    const bvh_node& node = bvh.nodes[index];
+
+                    f32 area = surface_area(node.min, node.max);
+                    f32 combined = surface_area(min_union(node.min, lmin), max_union(node.max, lmax));
+
+                    // cost of creating a new parent here, and the cost pushed down onto the children if we descend
+                    f32 cost = 2.0f * combined;
+                    f32 inheritance = 2.0f * (combined - area);
+
+                    f32 cost_left = insertion_cost(bvh.nodes[node.left], lmin, lmax) + inheritance;
+                    f32 cost_right = insertion_cost(bvh.nodes[node.right], lmin, lmax) + inheritance;
+
+                    if (cost < cost_left && cost < cost_right)
+                        break;
+
+                    index = cost_left < cost_right ? node.left : node.right;
+                }
+
+                // alloc may grow the node buffer, so only hold indices across it
+                s32 sibling = index;
+                s32 old_parent = bvh.nodes[sibling].parent;
+                s32 new_parent = alloc_node(bvh);
+
+                bvh.nodes[new_parent].parent = old_parent;
+                bvh.nodes[new_parent].left = sibling;
+                bvh.nodes[new_parent].right = leaf;
+                bvh.nodes[sibling].parent = new_parent;
+                bvh.nodes[leaf].parent = new_parent;
+                replace_child(bvh, old_parent, sibling, new_parent);
+
+                refit_ancestors(bvh, new_parent);
+            }
+
+            void remove_leaf(ecs_bvh& bvh, s32 leaf)
+            {
+                if (leaf == bvh.root)
+                {
+                    bvh.root = -1;
+                    return;
+                }
+
+                s32 parent = bvh.nodes[leaf].parent;
+                s32 grand_parent = bvh.nodes[parent].parent;
+                s32 sibling = bvh.nodes[parent].left == leaf ? bvh.nodes[parent].right : bvh.nodes[parent].left;
+
+                // sibling takes the parents place
+                replace_child(bvh, grand_parent, parent, sibling);
+                bvh.nodes[sibling].parent = grand_parent;
+                free_node(bvh, parent);
+
+                refit_ancestors(bvh, grand_parent);
+            }
+
+            void gather_leaves(const ecs_bvh& bvh, s32 root, u32** entities_out)
+            {
+                s32 stack[k_max_stack];
+                u32 sp = 0;
+                stack[sp++] = root;
+
+                while (sp > 0)
+                {
+                    const bvh_node& node = bvh.nodes[stack[--sp]];
+                    if (is_leaf(node))
+                    {
+                        sb_push(*entities_out, node.entity);
+                        continue;
+                    }
+
+                    PEN_ASSERT(sp + 2 <= k_max_stack);
+                    stack[sp++] = node.left;
+                    stack[sp++] = node.right;
+                }
+            }
+
+            // walks the tree with test returning e_overlap, subtrees entirely inside are gathered without further tests
+            // and leaves are tested against the entities tight bounds rather than the fat leaf aabb
+            template <typename T>
+            void query(const ecs_scene* scene, s32 root, const T& test, u32** entities_out)
+            {
+                const ecs_bvh& bvh = scene->bvh;
+                if (root == -1)
+                    root = bvh.root;
+
+                if (root == -1)
+                    return;
+
+                s32 stack[k_max_stack];
+                u32 sp = 0;
+                stack[sp++] = root;
+
+                while (sp > 0)
+                {
+                    s32             index = stack[--sp];
+                    const bvh_node& node = bvh.nodes[index];
+
+                    if (is_leaf(node))
+                    {
+                        const cmp_pos_extent& pe = scene->pos_extent[node.entity];
+                        if (test(pe.pos.xyz - pe.extent.xyz, pe.pos.xyz + pe.extent.xyz) != e_overlap::outside)
+                            sb_push(*entities_out, node.entity);
+
+                        continue;
+                    }
+
+                    u32 overlap = test(node.min, node.max);
+                    if (overlap == e_overlap::outside)
+                        continue;
+
+                    if (overlap == e_overlap::inside)
+                    {
+                        gather_leaves(bvh, index, entities_out);
+                        continue;
+                    }
+
+                    PEN_ASSERT(sp + 2 <= k_max_stack);
+                    stack[sp++] = node.left;
+                    stack[sp++] = node.right;
+                }
+            }
+
+            struct frustum_test
+            {
+                vec3f n[6];
+                vec3f abs_n[6];
+                f32   pd[6];
+
+                frustum_test(const frustum& f)
+                {
+                    for (u32 p = 0; p < 6; ++p)
+                    {
+                        n[p] = f.n[p];
+                        abs_n[p] = vec3f(fabsf(f.n[p].x), fabsf(f.n[p].y), fabsf(f.n[p].z));
+                        pd[p] = maths::plane_distance(f.p[p], f.n[p]);
+                    }
+                }
+
+                u32 operator()(const vec3f& min, const vec3f& max) const
+                {
+                    vec3f pos = (min + max) * 0.5f;
+                    vec3f extent = (max - min) * 0.5f;
+
+                    u32 result = e_overlap::inside;
+                    for (u32 p = 0; p < 6; ++p)
+                    {
+                        // same plane test as frustum_cull_aabb, with the far corner to detect fully inside
+                        f32 d = dot(pos, n[p]) + pd[p];
+                        f32 r = dot(extent, abs_n[p]);
+
+                        if (d - r > 0.0f)
+                            return e_overlap::outside;
+
+                        if (d + r > 0.0f)
+                            result = e_overlap::intersect;
+                    }
+
+                    return result;
+                }
+            };
+
+            struct sphere_test
+            {
+                vec3f pos;
+                f32   radius;
+
+                u32 operator()(const vec3f& min, const vec3f& max) const
+                {
+                    vec3f cp = max_union(min, min_union(max, pos));
+                    if (mag2(cp - pos) > radius * radius)
+                        return e_overlap::outside;
+
+                    return e_overlap::intersect;
+                }
+            };
+
+            struct aabb_test
+            {
+                vec3f min;
+                vec3f max;
+
+                u32 operator()(const vec3f& bmin, const vec3f& bmax) const
+                {
+                    if (!overlaps(min, max, bmin, bmax))
+                        return e_overlap::outside;
+
+                    if (contains_box(bmin, bmax))
+                        return e_overlap::inside;
+
+                    return e_overlap::intersect;
+                }
+
+                bool contains_box(const vec3f& bmin, const vec3f& bmax) const
+                {
+                    return min.x <= bmin.x && min.y <= bmin.y && min.z <= bmin.z && max.x >= bmax.x && max.y >= bmax.y &&
+                           max.z >= bmax.z;
+                }
+            };
+
+            struct ray_test
+            {
+                vec3f r0;
+                vec3f inv_rv;
+
+                ray_test(const vec3f& origin, const vec3f& rv)
+                {
+                    r0 = origin;
+                    inv_rv = vec3f(1.0f / rv.x, 1.0f / rv.y, 1.0f / rv.z);
+                }
+
+                // slab test, returns entry distance along the ray or -1 for a miss
+                f32 distance(const vec3f& min, const vec3f& max) const
+                {
+                    f32 tmin = 0.0f;
+                    f32 tmax = FLT_MAX;
+
+                    for (u32 i = 0; i < 3; ++i)
+                    {
+                        f32 t1 = (min[i] - r0[i]) * inv_rv[i];
+                        f32 t2 = (max[i] - r0[i]) * inv_rv[i];
+
+                        if (t1 > t2)
+                        {
+                            f32 t = t1;
+                            t1 = t2;
+                            t2 = t;
+                        }
+
+                        tmin = t1 > tmin ? t1 : tmin;
+                        tmax = t2 < tmax ? t2 : tmax;
+
+                        if (tmin > tmax)
+                            return -1.0f;
+                    }
+
+                    return tmin;
+                }
+
+                u32 operator()(const vec3f& min, const vec3f& max) const
+                {
+                    if (distance(min, max) < 0.0f)
+                        return e_overlap::outside;
+
+                    return e_overlap::intersect;
+                }
+            };
+        } // namespace
+
+        void bvh_clear(ecs_bvh& bvh)
+        {
+            sb_free(bvh.nodes);
+            sb_free(bvh.entity_leaf);
+            bvh.nodes = nullptr;
+            bvh.entity_leaf = nullptr;
+            bvh.root = -1;
+            bvh.free_list = -1;
+            bvh.num_leaves = 0;
+        }
+
+        void bvh_update(ecs_scene* scene)
+        {
+            ecs_bvh& bvh = scene->bvh;
+
+            // new entities are not in the tree yet
+            u32 ne = (u32)scene->num_entities;
+            u32 nl = sb_count(bvh.entity_leaf);
+            if (nl < ne)
+            {
+                s32* leaves = sb_add(bvh.entity_leaf, ne - nl);
+                for (u32 i = 0; i < ne - nl; ++i)
+                    leaves[i] = -1;
+            }
+
+            // same set as filter_entities_scalar, hidden entities stay in the tree and are rejected by the caller
+            u64 accept_entities = e_cmp::allocated | e_cmp::geometry | e_cmp::material;
+            u64 reject_entities = e_cmp::sub_instance;
+
+            for (u32 n = 0; n < ne; ++n)
+            {
+                s32  leaf = bvh.entity_leaf[n];
+                bool member = (scene->entities[n] & accept_entities) == accept_entities;
+                if (scene->entities[n] & reject_entities)
+                    member = false;
+
+                if (!member)
+                {
+                    if (leaf != -1)
+                    {
+                        remove_leaf(bvh, leaf);
+                        free_node(bvh, leaf);
+                        bvh.entity_leaf[n] = -1;
+                        bvh.num_leaves--;
+                    }
+                    continue;
+                }
+
+                const cmp_pos_extent& pe = scene->pos_extent[n];
+                vec3f                 tmin = pe.pos.xyz - pe.extent.xyz;
+                vec3f                 tmax = pe.pos.xyz + pe.extent.xyz;
+
+                if (leaf != -1)
+                {
+                    // still inside the fat aabb, nothing to do
+                    if (contains(bvh.nodes[leaf], tmin, tmax))
+                        continue;
+
+                    remove_leaf(bvh, leaf);
+                }
+                else
+                {
+                    leaf = alloc_node(bvh);
+                    bvh.nodes[leaf].entity = n;
+                    bvh.entity_leaf[n] = leaf;
+                    bvh.num_leaves++;
+                }
+
+                vec3f pad = pe.extent.xyz * bvh.margin + vec3f(0.01f);
+                bvh.nodes[leaf].min = tmin - pad;
+                bvh.nodes[leaf].max = tmax + pad;
+
+                insert_leaf(bvh, leaf);
+            }
+        }
+
+        u32 bvh_subtrees(const ecs_bvh& bvh, s32* roots_out, u32 max_roots)
+        {
+            if (bvh.root == -1 || max_roots == 0)
+                return 0;
+
+            u32 num_roots = 0;
+            roots_out[num_roots++] = bvh.root;
+
+            // split the tallest subtree, which replaces one root with its 2 children
+            while (num_roots < max_roots)
+            {
+                s32 tallest = -1;
+                s32 height = 0;
+                for (u32 i = 0; i < num_roots; ++i)
+                {
+                    if (bvh.nodes[roots_out[i]].height > height)
+                    {
+                        height = bvh.nodes[roots_out[i]].height;
+                        tallest = i;
+                    }
+                }
+
+                if (tallest == -1)
+                    break;
+
+                const bvh_node& node = bvh.nodes[roots_out[tallest]];
+                roots_out[tallest] = node.left;
+                roots_out[num_roots++] = node.right;
+            }
+
+            return num_roots;
+        }
+
+        void bvh_query_frustum(const ecs_scene* scene, const camera* cam, u32** entities_out, s32 root)
+        {
+            const ecs_bvh& bvh = scene->bvh;
+            if (root == -1)
+                root = bvh.root;
+
+            if (root == -1)
+                return;
+
+            // leaves of partially visible nodes are batched for the simd cull, per thread to allow concurrent views
+            static thread_local u32* candidates = nullptr;
+            if (candidates)
+                stb__sbn(candidates) = 0;
+
+            frustum_test test(cam->camera_frustum);
+
+            s32 stack[k_max_stack];
+            u32 sp = 0;
+            stack[sp++] = root;
+
+            while (sp > 0)
+            {
+                s32             index = stack[--sp];
+                const bvh_node& node = bvh.nodes[index];
+
+                if (is_leaf(node))
+                {
+                    sb_push(candidates, node.entity);
+                    continue;
+                }
+
+                u32 overlap = test(node.min, node.max);
+                if (overlap == e_overlap::outside)
+                    continue;
+
+                if (overlap == e_overlap::inside)
+                {
+                    gather_leaves(bvh, index, entities_out);
+                    continue;
+                }
+
+                PEN_ASSERT(sp + 2 <= k_max_stack);
+                stack[sp++] = node.left;
+                stack[sp++] = node.right;
+            }
+
+            frustum_cull_aabb(scene, cam, candidates, sb_count(candidates), entities_out);
+        }
+
+        void bvh_query_sphere(const ecs_scene* scene, const vec3f& pos, f32 radius, u32** entities_out, s32 root)
+        {
+            sphere_test test;
+            test.pos = pos;
+            test.radius = radius;
+            query(scene, root, test, entities_out);
+        }
+
+        void bvh_query_aabb(const ecs_scene* scene, const vec3f& min, const vec3f& max, u32** entities_out, s32 root)
+        {
+            aabb_test test;
+            test.min = min;
+            test.max = max;
+            query(scene, root, test, entities_out);
+        }
+
+        void bvh_query_ray(const ecs_scene* scene, const vec3f& r0, const vec3f& rv, u32** entities_out, s32 root)
+        {
+            query(scene, root, ray_test(r0, rv), entities_out);
+        }
+
+        s32 bvh_ray_cast(const ecs_scene* scene, const vec3f& r0, const vec3f& rv, f32* t_out)
+        {
+            const ecs_bvh& bvh = scene->bvh;
+            if (bvh.root == -1)
+                return -1;
+
+            ray_test test(r0, rv);
+
+            s32 closest = -1;
+            f32 closest_t = FLT_MAX;
+
+            s32 stack[k_max_stack];
+            u32 sp = 0;
+            stack[sp++] = bvh.root;
+
+            while (sp > 0)
+            {
+                const bvh_node& node = bvh.nodes[stack[--sp]];
+
+                // prune anything which starts further than the closest hit so far
+                f32 t = test.distance(node.min, node.max);
+                if (t < 0.0f || t > closest_t)
+                    continue;
+
+                if (is_leaf(node))
+                {
+                    const cmp_pos_extent& pe = scene->pos_extent[node.entity];
+                    f32 te = test.distance(pe.pos.xyz - pe.extent.xyz, pe.pos.xyz + pe.extent.xyz);
+                    if (te >= 0.0f && te < closest_t)
+                    {
+                        closest_t = te;
+                        closest = (s32)node.entity;
+                    }
+                    continue;
+                }
+
+                PEN_ASSERT(sp + 2 <= k_max_stack);
+                stack[sp++] = node.left;
+                stack[sp++] = node.right;
+            }
+
+            if (t_out)
+                *t_out = closest_t;
+
+            return closest;
+        }
+    } // namespace ecs
+} // namespace put
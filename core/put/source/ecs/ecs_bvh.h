@@ -0,0 +1,61 @@
+// ecs_bvh.h
+// Copyright 2014 - 2023 Alex Dixon.
+// License: https://github.com/polymonster/pmtech/blob/master/license.md
+
+// Dynamic aabb tree over the renderable entities pos_extent, maintained incrementally by update_scene.
+// Leaves store a fattened aabb so small movements do not touch the tree, entities which move outside their
+// fat aabb are removed and re-inserted, and the tree is rebalanced with rotations on the way back up.
+
+#pragma once
+
+#include "camera.h"
+#include "types.h"
+
+#include "maths/maths.h"
+
+namespace put
+{
+    namespace ecs
+    {
+        struct ecs_scene;
+
+        struct bvh_node
+        {
+            vec3f min;
+            vec3f max;
+            s32   parent = -1; // next free node when on the free list
+            s32   left = -1;   // -1 for leaves
+            s32   right = -1;
+            s32   height = 0;
+            u32   entity = 0;
+        };
+
+        struct ecs_bvh
+        {
+            bvh_node* nodes = nullptr;       // stretchy buffer of nodes, indices are stable
+            s32*      entity_leaf = nullptr; // leaf node index per entity or -1 if the entity is not in the tree
+            s32       root = -1;
+            s32       free_list = -1;
+            u32       num_leaves = 0;
+            f32       margin = 0.1f; // leaves are fattened by this fraction of their extent
+        };
+
+        // syncs the tree with entities that were added, removed or moved outside their fat aabb
+        void bvh_update(ecs_scene* scene);
+        void bvh_clear(ecs_bvh& bvh);
+
+        // split the tree into at most max_roots subtrees which together cover all leaves, to distribute queries over workers
+        u32 bvh_subtrees(const ecs_bvh& bvh, s32* roots_out, u32 max_roots);
+
+        // queries append entities whose tight bounds intersect to the stretchy buffer entities_out,
+        // pass root to query a subtree or -1 for the whole tree. frustum queries accept subtrees entirely inside and
+        // pass the leaves of intersecting nodes through the simd frustum_cull_aabb
+        void bvh_query_frustum(const ecs_scene* scene, const camera* cam, u32** entities_out, s32 root = -1);
+        void bvh_query_sphere(const ecs_scene* scene, const vec3f& pos, f32 radius, u32** entities_out, s32 root = -1);
+        void bvh_query_aabb(const ecs_scene* scene, const vec3f& min, const vec3f& max, u32** entities_out, s32 root = -1);
+        void bvh_query_ray(const ecs_scene* scene, const vec3f& r0, const vec3f& rv, u32** entities_out, s32 root = -1);
+
+        // returns the entity with the closest bounds hit along the ray or -1
+        s32 bvh_ray_cast(const ecs_scene* scene, const vec3f& r0, const vec3f& rv, f32* t_out = nullptr);
+    } // namespace ecs
+} // namespace put
@@ -8,6 +8,10 @@
 #include <xmmintrin.h>
 #endif
 
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
+
 using namespace ::pen;
 
 namespace put
@@ -18,12 +22,12 @@ namespace put
         // scalar float implementation
         //
 
-        void frustum_cull_aabb_scalar(const ecs_scene* scene, const camera* cam, u32* entities_in, u32** entities_out)
+        void frustum_cull_aabb_scalar(const ecs_scene* scene, const camera* cam, const u32* entities_in, u32 num_entities,
+                                      u32** entities_out)
         {
             const frustum& frust = cam->camera_frustum;
 
-            u32 n = sb_count(entities_in);
-            for (u32 i = 0; i < n; ++i)
+            for (u32 i = 0; i < num_entities; ++i)
             {
                 u32 e = entities_in[i];
 
@@ -50,12 +54,12 @@ namespace put
             }
         }
 
-        void frustum_cull_sphere_scalar(const ecs_scene* scene, const camera* cam, u32* entities_in, u32** entities_out)
+        void frustum_cull_sphere_scalar(const ecs_scene* scene, const camera* cam, const u32* entities_in, u32 num_entities,
+                                        u32** entities_out)
         {
             const frustum& camera_frustum = cam->camera_frustum;
 
-            u32 n = sb_count(entities_in);
-            for (u32 i = 0; i < n; ++i)
+            for (u32 i = 0; i < num_entities; ++i)
             {
                 u32 e = entities_in[i];
 
@@ -81,6 +85,44 @@ namespace put
             }
         }
 
+        void write_bounds(ecs_scene* scene, u32 e, const vec3f& pos, const vec3f& extent)
+        {
+            cmp_bounding_volume& bv = scene->bounding_volumes[e];
+            bv.transformed_min_extents = pos - extent;
+            bv.transformed_max_extents = pos + extent;
+            bv.radius = mag(extent);
+
+            // pos extent for faster aabb and sphere culling
+            cmp_pos_extent& pe = scene->pos_extent[e];
+            pe.pos.xyz = pos;
+            pe.extent.xyz = extent;
+            pe.extent.w = bv.radius;
+        }
+
+        void transform_bounds_scalar(ecs_scene* scene, const u32* entities, u32 count)
+        {
+            for (u32 i = 0; i < count; ++i)
+            {
+                u32         e = entities[i];
+                const f32*  m = &scene->world_matrices[e].m[0];
+                const vec3f& lmin = scene->bounding_volumes[e].min_extents;
+                const vec3f& lmax = scene->bounding_volumes[e].max_extents;
+
+                vec3f c = (lmin + lmax) * 0.5f;
+                vec3f x = (lmax - lmin) * 0.5f;
+
+                vec3f pos, extent;
+                for (u32 r = 0; r < 3; ++r)
+                {
+                    const f32* row = &m[r * 4];
+                    pos[r] = row[0] * c.x + row[1] * c.y + row[2] * c.z + row[3];
+                    extent[r] = fabsf(row[0]) * x.x + fabsf(row[1]) * x.y + fabsf(row[2]) * x.z;
+                }
+
+                write_bounds(scene, e, pos, extent);
+            }
+        }
+
         void filter_entities_scalar(const ecs_scene* scene, u32** entities_out)
         {
             u32 accept_entities = e_cmp::geometry | e_cmp::material;
@@ -104,20 +146,73 @@ namespace put
             }
         }
 
+        // acos(x) for x in [0, 1] as sqrt(1 - x) * poly(x), abramowitz and stegun 4.4.46, error < 2e-8
+        static const f32 k_acos_coeffs[8] = {-0.0012624911f, 0.0066700901f, -0.0170881256f, 0.0308918810f,
+                                             -0.0501743046f, 0.0889789874f, -0.2145988016f, 1.5707963050f};
+
+        // sin(x) for x in [0, pi/2] as x * poly(x * x), taylor series to x^11, error < 6e-8
+        static const f32 k_sin_coeffs[6] = {-1.0f / 39916800.0f, 1.0f / 362880.0f, -1.0f / 5040.0f,
+                                            1.0f / 120.0f,        -1.0f / 6.0f,     1.0f};
+
+        // quaternions closer than this are lerped, the result is normalised in both cases
+        static const f32 k_slerp_lerp_threshold = 0.9995f;
+
+        void slerp_soa_scalar(const f32* a, const f32* b, const f32* t, f32* out, u32 count, u32 stride)
+        {
+            for (u32 i = 0; i < count; ++i)
+            {
+                f32 qa[4], qb[4];
+                for (u32 c = 0; c < 4; ++c)
+                {
+                    qa[c] = a[c * stride + i];
+                    qb[c] = b[c * stride + i];
+                }
+
+                // shortest arc
+                f32 d = qa[0] * qb[0] + qa[1] * qb[1] + qa[2] * qb[2] + qa[3] * qb[3];
+                f32 sign = d < 0.0f ? -1.0f : 1.0f;
+                d *= sign;
+
+                f32 w0 = 1.0f - t[i];
+                f32 w1 = t[i];
+                if (d < k_slerp_lerp_threshold)
+                {
+                    f32 theta = acosf(d);
+                    f32 inv_sin = 1.0f / sqrtf(1.0f - d * d);
+                    w0 = sinf(w0 * theta) * inv_sin;
+                    w1 = sinf(w1 * theta) * inv_sin;
+                }
+                w1 *= sign;
+
+                f32 r[4];
+                f32 len2 = 0.0f;
+                for (u32 c = 0; c < 4; ++c)
+                {
+                    r[c] = qa[c] * w0 + qb[c] * w1;
+                    len2 += r[c] * r[c];
+                }
+
+                f32 inv_len = 1.0f / sqrtf(len2);
+                for (u32 c = 0; c < 4; ++c)
+                    out[c * stride + i] = r[c] * inv_len;
+            }
+        }
+
+        void lerp_soa_scalar(const f32* a, const f32* b, const f32* t, f32* out, u32 count)
+        {
+            for (u32 i = 0; i < count; ++i)
+                out[i] = (1.0f - t[i]) * a[i] + t[i] * b[i];
+        }
+
         //
         // sse2 128 implementation
         //
 #if __SSE__ || __AVX__
-        void frustum_cull_aabb_simd128(const ecs_scene* scene, const camera* cam, u32* entities_in, u32** entities_out)
+        void frustum_cull_aabb_simd128(const ecs_scene* scene, const camera* cam, const u32* entities_in, u32 num_entities,
+                                       u32** entities_out)
         {
             const frustum& frust = cam->camera_frustum;
 
-            // pad to 4
-            u32 xn = sb_count(entities_in);
-            u32 yn = PEN_ALIGN(xn, 4);
-            for (u32 i = 0; i < yn - xn; ++i)
-                sb_push(entities_in, entities_in[0]);
-
             // sphere radius and position
             __m128 posx;
             __m128 posy;
@@ -158,12 +253,11 @@ namespace put
                 sfz[p] = _mm_set1_ps(sgn(frust.n[p].z) * -1.0f);
             }
 
-            u32 n = sb_count(entities_in);
-            for (u32 i = 0; i < n; i += 4)
+            for (u32 i = 0; i < num_entities; i += 4)
             {
-                // unpack entities
+                // unpack entities, the tail is padded by repeating the last entity
                 for (u32 j = 0; j < 4; ++j)
-                    e[j] = entities_in[i + j];
+                    e[j] = entities_in[min(i + j, num_entities - 1)];
 
                 auto& p0 = scene->pos_extent[e[0]].pos;
                 auto& p1 = scene->pos_extent[e[1]].pos;
@@ -203,27 +297,22 @@ namespace put
                     r = _mm_fmadd_ps(dpz, pnz[p], r);
 
                     // if(r > -pd) inside = false
-                    __m128 ge = _mm_cmpge_ps(r, pd_neg[p]);
+                    __m128 ge = _mm_cmpgt_ps(r, pd_neg[p]);
                     inside = _mm_add_ps(ge, inside);
                 }
 
-                _mm_store_ps(result, inside);
+                _mm_storeu_ps(result, inside);
                 for (u32 j = 0; j < 4; ++j)
-                    if (!result[j])
+                    if (!result[j] && i + 3 - j < num_entities)
                         sb_push(*entities_out, e[3 - j]);
             }
         }
 
-        void frustum_cull_sphere_simd128(const ecs_scene* scene, const camera* cam, u32* entities_in, u32** entities_out)
+        void frustum_cull_sphere_simd128(const ecs_scene* scene, const camera* cam, const u32* entities_in, u32 num_entities,
+                                         u32** entities_out)
         {
             const frustum& frust = cam->camera_frustum;
 
-            // pad to 4
-            u32 xn = sb_count(entities_in);
-            u32 yn = PEN_ALIGN(xn, 4);
-            for (u32 i = 0; i < yn - xn; ++i)
-                sb_push(entities_in, entities_in[0]);
-
             // sphere radius and position
             __m128 radius;
             __m128 posx;
@@ -251,12 +340,11 @@ namespace put
                 pd[p] = _mm_set1_ps(ppd);
             }
 
-            u32 n = sb_count(entities_in);
-            for (u32 i = 0; i < n; i += 4)
+            for (u32 i = 0; i < num_entities; i += 4)
             {
-                // unpack entities
+                // unpack entities, the tail is padded by repeating the last entity
                 for (u32 j = 0; j < 4; ++j)
-                    e[j] = entities_in[i + j];
+                    e[j] = entities_in[min(i + j, num_entities - 1)];
 
                 // load entities values
                 auto& p0 = scene->pos_extent[e[0]].pos;
@@ -285,32 +373,190 @@ namespace put
                     dd = _mm_fmadd_ps(posz, pnz[p], dd);
 
                     // compare if dd is greater than radius, if so we are outside
-                    __m128 ge = _mm_cmpge_ps(dd, radius);
+                    __m128 ge = _mm_cmpgt_ps(dd, radius);
                     inside = _mm_add_ps(ge, inside);
                 }
 
-                _mm_store_ps(result, inside);
+                _mm_storeu_ps(result, inside);
                 for (u32 j = 0; j < 4; ++j)
-                    if (!result[j])
+                    if (!result[j] && i + 3 - j < num_entities)
                         sb_push(*entities_out, e[3 - j]);
             }
         }
+
+        void transform_bounds_simd128(ecs_scene* scene, const u32* entities, u32 count)
+        {
+            const __m128 half = _mm_set1_ps(0.5f);
+            const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+            f32 px[4], py[4], pz[4], ex[4], ey[4], ez[4];
+
+            u32 n4 = count & ~3;
+            for (u32 i = 0; i < n4; i += 4)
+            {
+                const u32* e = &entities[i];
+
+                // gather aabb into soa, lanes are reversed by _mm_set_ps
+                const cmp_bounding_volume& b0 = scene->bounding_volumes[e[0]];
+                const cmp_bounding_volume& b1 = scene->bounding_volumes[e[1]];
+                const cmp_bounding_volume& b2 = scene->bounding_volumes[e[2]];
+                const cmp_bounding_volume& b3 = scene->bounding_volumes[e[3]];
+
+                __m128 minx = _mm_set_ps(b0.min_extents.x, b1.min_extents.x, b2.min_extents.x, b3.min_extents.x);
+                __m128 miny = _mm_set_ps(b0.min_extents.y, b1.min_extents.y, b2.min_extents.y, b3.min_extents.y);
+                __m128 minz = _mm_set_ps(b0.min_extents.z, b1.min_extents.z, b2.min_extents.z, b3.min_extents.z);
+                __m128 maxx = _mm_set_ps(b0.max_extents.x, b1.max_extents.x, b2.max_extents.x, b3.max_extents.x);
+                __m128 maxy = _mm_set_ps(b0.max_extents.y, b1.max_extents.y, b2.max_extents.y, b3.max_extents.y);
+                __m128 maxz = _mm_set_ps(b0.max_extents.z, b1.max_extents.z, b2.max_extents.z, b3.max_extents.z);
+
+                // centre and half extent
+                __m128 cx = _mm_mul_ps(_mm_add_ps(minx, maxx), half);
+                __m128 cy = _mm_mul_ps(_mm_add_ps(miny, maxy), half);
+                __m128 cz = _mm_mul_ps(_mm_add_ps(minz, maxz), half);
+                __m128 hx = _mm_mul_ps(_mm_sub_ps(maxx, minx), half);
+                __m128 hy = _mm_mul_ps(_mm_sub_ps(maxy, miny), half);
+                __m128 hz = _mm_mul_ps(_mm_sub_ps(maxz, minz), half);
+
+                const f32* m0 = &scene->world_matrices[e[0]].m[0];
+                const f32* m1 = &scene->world_matrices[e[1]].m[0];
+                const f32* m2 = &scene->world_matrices[e[2]].m[0];
+                const f32* m3 = &scene->world_matrices[e[3]].m[0];
+
+                f32* pos_out[3] = {px, py, pz};
+                f32* ext_out[3] = {ex, ey, ez};
+
+                for (u32 r = 0; r < 3; ++r)
+                {
+                    u32    o = r * 4;
+                    __m128 r0 = _mm_set_ps(m0[o + 0], m1[o + 0], m2[o + 0], m3[o + 0]);
+                    __m128 r1 = _mm_set_ps(m0[o + 1], m1[o + 1], m2[o + 1], m3[o + 1]);
+                    __m128 r2 = _mm_set_ps(m0[o + 2], m1[o + 2], m2[o + 2], m3[o + 2]);
+                    __m128 r3 = _mm_set_ps(m0[o + 3], m1[o + 3], m2[o + 3], m3[o + 3]);
+
+                    // pos = m * centre
+                    __m128 p = _mm_fmadd_ps(r0, cx, r3);
+                    p = _mm_fmadd_ps(r1, cy, p);
+                    p = _mm_fmadd_ps(r2, cz, p);
+
+                    // extent = abs(m) * half extent
+                    __m128 x = _mm_mul_ps(_mm_and_ps(r0, abs_mask), hx);
+                    x = _mm_fmadd_ps(_mm_and_ps(r1, abs_mask), hy, x);
+                    x = _mm_fmadd_ps(_mm_and_ps(r2, abs_mask), hz, x);
+
+                    _mm_storeu_ps(pos_out[r], p);
+                    _mm_storeu_ps(ext_out[r], x);
+                }
+
+                for (u32 j = 0; j < 4; ++j)
+                {
+                    u32 l = 3 - j;
+                    write_bounds(scene, e[j], vec3f(px[l], py[l], pz[l]), vec3f(ex[l], ey[l], ez[l]));
+                }
+            }
+
+            transform_bounds_scalar(scene, &entities[n4], count - n4);
+        }
+        inline __m128 acos_poly_simd128(__m128 x)
+        {
+            __m128 p = _mm_set1_ps(k_acos_coeffs[0]);
+            for (u32 i = 1; i < 8; ++i)
+                p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(k_acos_coeffs[i]));
+
+            __m128 one_minus_x = _mm_max_ps(_mm_sub_ps(_mm_set1_ps(1.0f), x), _mm_setzero_ps());
+            return _mm_mul_ps(p, _mm_sqrt_ps(one_minus_x));
+        }
+
+        inline __m128 sin_poly_simd128(__m128 x)
+        {
+            __m128 x2 = _mm_mul_ps(x, x);
+            __m128 p = _mm_set1_ps(k_sin_coeffs[0]);
+            for (u32 i = 1; i < 6; ++i)
+                p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(k_sin_coeffs[i]));
+
+            return _mm_mul_ps(p, x);
+        }
+
+        void slerp_soa_simd128(const f32* a, const f32* b, const f32* t, f32* out, u32 count, u32 stride)
+        {
+            const __m128 one = _mm_set1_ps(1.0f);
+            const __m128 eps = _mm_set1_ps(1e-12f);
+            const __m128 sign_mask = _mm_set1_ps(-0.0f);
+            const __m128 threshold = _mm_set1_ps(k_slerp_lerp_threshold);
+
+            u32 n4 = count & ~3;
+            for (u32 i = 0; i < n4; i += 4)
+            {
+                __m128 qa[4], qb[4];
+                for (u32 c = 0; c < 4; ++c)
+                {
+                    qa[c] = _mm_loadu_ps(&a[c * stride + i]);
+                    qb[c] = _mm_loadu_ps(&b[c * stride + i]);
+                }
+
+                // shortest arc, flip the sign of b's weight where the dot is negative
+                __m128 d = _mm_mul_ps(qa[0], qb[0]);
+                for (u32 c = 1; c < 4; ++c)
+                    d = _mm_add_ps(d, _mm_mul_ps(qa[c], qb[c]));
+
+                __m128 sign = _mm_and_ps(d, sign_mask);
+                d = _mm_xor_ps(d, sign);
+
+                // slerp weights, lanes which are nearly parallel keep the lerp weights
+                __m128 w1 = _mm_loadu_ps(&t[i]);
+                __m128 w0 = _mm_sub_ps(one, w1);
+
+                __m128 theta = acos_poly_simd128(d);
+                __m128 inv_sin = _mm_div_ps(one, _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(one, _mm_mul_ps(d, d)), eps)));
+                __m128 s0 = _mm_mul_ps(sin_poly_simd128(_mm_mul_ps(w0, theta)), inv_sin);
+                __m128 s1 = _mm_mul_ps(sin_poly_simd128(_mm_mul_ps(w1, theta)), inv_sin);
+
+                __m128 use_slerp = _mm_cmplt_ps(d, threshold);
+                w0 = _mm_or_ps(_mm_and_ps(use_slerp, s0), _mm_andnot_ps(use_slerp, w0));
+                w1 = _mm_or_ps(_mm_and_ps(use_slerp, s1), _mm_andnot_ps(use_slerp, w1));
+                w1 = _mm_xor_ps(w1, sign);
+
+                __m128 r[4];
+                __m128 len2 = _mm_setzero_ps();
+                for (u32 c = 0; c < 4; ++c)
+                {
+                    r[c] = _mm_add_ps(_mm_mul_ps(qa[c], w0), _mm_mul_ps(qb[c], w1));
+                    len2 = _mm_add_ps(len2, _mm_mul_ps(r[c], r[c]));
+                }
+
+                __m128 inv_len = _mm_div_ps(one, _mm_sqrt_ps(len2));
+                for (u32 c = 0; c < 4; ++c)
+                    _mm_storeu_ps(&out[c * stride + i], _mm_mul_ps(r[c], inv_len));
+            }
+
+            slerp_soa_scalar(a + n4, b + n4, t + n4, out + n4, count - n4, stride);
+        }
+
+        void lerp_soa_simd128(const f32* a, const f32* b, const f32* t, f32* out, u32 count)
+        {
+            const __m128 one = _mm_set1_ps(1.0f);
+
+            u32 n4 = count & ~3;
+            for (u32 i = 0; i < n4; i += 4)
+            {
+                __m128 tt = _mm_loadu_ps(&t[i]);
+                __m128 r = _mm_mul_ps(_mm_sub_ps(one, tt), _mm_loadu_ps(&a[i]));
+                r = _mm_add_ps(r, _mm_mul_ps(tt, _mm_loadu_ps(&b[i])));
+                _mm_storeu_ps(&out[i], r);
+            }
+
+            lerp_soa_scalar(a + n4, b + n4, t + n4, out + n4, count - n4);
+        }
 #endif
 
         //
         // avx 256 implementation
         //
 #if __AVX2__
-        void frustum_cull_sphere_simd256(const ecs_scene* scene, const camera* cam, u32* entities_in, u32** entities_out)
+        void frustum_cull_sphere_simd256(const ecs_scene* scene, const camera* cam, const u32* entities_in, u32 num_entities,
+                                         u32** entities_out)
         {
             const frustum& frust = cam->camera_frustum;
 
-            // pad to 8
-            u32 xn = sb_count(entities_in);
-            u32 yn = PEN_ALIGN(xn, 8);
-            for (u32 i = 0; i < yn - xn; ++i)
-                sb_push(entities_in, entities_in[0]);
-
             // splat constants
             __m256 zero = _mm256_set1_ps(0.0f);
 
@@ -341,12 +587,11 @@ namespace put
                 pd[p] = _mm256_set1_ps(ppd);
             }
 
-            u32 n = sb_count(entities_in);
-            for (u32 i = 0; i < n; i += 8)
+            for (u32 i = 0; i < num_entities; i += 8)
             {
-                // unpack entities
+                // unpack entities, the tail is padded by repeating the last entity
                 for (u32 j = 0; j < 8; ++j)
-                    e[j] = entities_in[i + j];
+                    e[j] = entities_in[min(i + j, num_entities - 1)];
 
                 // load entities values
                 auto& p0 = scene->pos_extent[e[0]].pos;
@@ -387,23 +632,18 @@ namespace put
                     inside = _mm256_add_ps(diff, inside);
                 }
 
-                _mm256_store_ps(result, inside);
+                _mm256_storeu_ps(result, inside);
                 for (u32 j = 0; j < 8; ++j)
-                    if (!result[j])
+                    if (!result[j] && i + 7 - j < num_entities)
                         sb_push(*entities_out, e[7 - j]);
             }
         }
 
-        void frustum_cull_aabb_simd256(const ecs_scene* scene, const camera* cam, u32* entities_in, u32** entities_out)
+        void frustum_cull_aabb_simd256(const ecs_scene* scene, const camera* cam, const u32* entities_in, u32 num_entities,
+                                       u32** entities_out)
         {
             const frustum& frust = cam->camera_frustum;
 
-            // pad to 8
-            u32 xn = sb_count(entities_in);
-            u32 yn = PEN_ALIGN(xn, 8);
-            for (u32 i = 0; i < yn - xn; ++i)
-                sb_push(entities_in, entities_in[0]);
-
             // splat constants
             __m256 zero = _mm256_set1_ps(0.0f);
 
@@ -447,13 +687,11 @@ namespace put
                 sfz[p] = _mm256_set1_ps(sgn(frust.n[p].z) * -1.0f);
             }
 
-            // n is number of entities + padding for alignment
-            u32 n = sb_count(entities_in);
-            for (u32 i = 0; i < n; i += 8)
+            for (u32 i = 0; i < num_entities; i += 8)
             {
-                // unpack entities
+                // unpack entities, the tail is padded by repeating the last entity
                 for (u32 j = 0; j < 8; ++j)
-                    e[j] = entities_in[i + j];
+                    e[j] = entities_in[min(i + j, num_entities - 1)];
 
                 // load entities values
                 auto& p0 = scene->pos_extent[e[0]].pos;
@@ -506,40 +744,577 @@ namespace put
                     inside = _mm256_add_ps(diff, inside);
                 }
 
-                _mm256_store_ps(result, inside);
+                _mm256_storeu_ps(result, inside);
                 for (u32 j = 0; j < 8; ++j)
-                    if (!result[j])
+                    if (!result[j] && i + 7 - j < num_entities)
                         sb_push(*entities_out, e[7 - j]);
             }
         }
+        void transform_bounds_simd256(ecs_scene* scene, const u32* entities, u32 count)
+        {
+            const __m256 half = _mm256_set1_ps(0.5f);
+            const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+
+            f32 px[8], py[8], pz[8], ex[8], ey[8], ez[8];
+            f32 ld[8];
+
+            u32 n8 = count & ~7;
+            for (u32 i = 0; i < n8; i += 8)
+            {
+                const u32* e = &entities[i];
+
+                // gather aabb into soa, lanes are reversed by _mm256_set_ps
+                __m256 cx, cy, cz, hx, hy, hz;
+                {
+                    __m256 mn[3], mx[3];
+                    for (u32 a = 0; a < 3; ++a)
+                    {
+                        for (u32 j = 0; j < 8; ++j)
+                            ld[7 - j] = scene->bounding_volumes[e[j]].min_extents[a];
+                        mn[a] = _mm256_loadu_ps(ld);
+
+                        for (u32 j = 0; j < 8; ++j)
+                            ld[7 - j] = scene->bounding_volumes[e[j]].max_extents[a];
+                        mx[a] = _mm256_loadu_ps(ld);
+                    }
+
+                    // centre and half extent
+                    cx = _mm256_mul_ps(_mm256_add_ps(mn[0], mx[0]), half);
+                    cy = _mm256_mul_ps(_mm256_add_ps(mn[1], mx[1]), half);
+                    cz = _mm256_mul_ps(_mm256_add_ps(mn[2], mx[2]), half);
+                    hx = _mm256_mul_ps(_mm256_sub_ps(mx[0], mn[0]), half);
+                    hy = _mm256_mul_ps(_mm256_sub_ps(mx[1], mn[1]), half);
+                    hz = _mm256_mul_ps(_mm256_sub_ps(mx[2], mn[2]), half);
+                }
+
+                f32* pos_out[3] = {px, py, pz};
+                f32* ext_out[3] = {ex, ey, ez};
+
+                for (u32 r = 0; r < 3; ++r)
+                {
+                    __m256 row[4];
+                    for (u32 c = 0; c < 4; ++c)
+                    {
+                        for (u32 j = 0; j < 8; ++j)
+                            ld[7 - j] = scene->world_matrices[e[j]].m[r * 4 + c];
+                        row[c] = _mm256_loadu_ps(ld);
+                    }
+
+                    // pos = m * centre
+                    __m256 p = _mm256_fmadd_ps(row[0], cx, row[3]);
+                    p = _mm256_fmadd_ps(row[1], cy, p);
+                    p = _mm256_fmadd_ps(row[2], cz, p);
+
+                    // extent = abs(m) * half extent
+                    __m256 x = _mm256_mul_ps(_mm256_and_ps(row[0], abs_mask), hx);
+                    x = _mm256_fmadd_ps(_mm256_and_ps(row[1], abs_mask), hy, x);
+                    x = _mm256_fmadd_ps(_mm256_and_ps(row[2], abs_mask), hz, x);
+
+                    _mm256_storeu_ps(pos_out[r], p);
+                    _mm256_storeu_ps(ext_out[r], x);
+                }
+
+                for (u32 j = 0; j < 8; ++j)
+                {
+                    u32 l = 7 - j;
+                    write_bounds(scene, e[j], vec3f(px[l], py[l], pz[l]), vec3f(ex[l], ey[l], ez[l]));
+                }
+            }
+
+            transform_bounds_scalar(scene, &entities[n8], count - n8);
+        }
+        inline __m256 acos_poly_simd256(__m256 x)
+        {
+            __m256 p = _mm256_set1_ps(k_acos_coeffs[0]);
+            for (u32 i = 1; i < 8; ++i)
+                p = _mm256_fmadd_ps(p, x, _mm256_set1_ps(k_acos_coeffs[i]));
+
+            __m256 one_minus_x = _mm256_max_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), x), _mm256_setzero_ps());
+            return _mm256_mul_ps(p, _mm256_sqrt_ps(one_minus_x));
+        }
+
+        inline __m256 sin_poly_simd256(__m256 x)
+        {
+            __m256 x2 = _mm256_mul_ps(x, x);
+            __m256 p = _mm256_set1_ps(k_sin_coeffs[0]);
+            for (u32 i = 1; i < 6; ++i)
+                p = _mm256_fmadd_ps(p, x2, _mm256_set1_ps(k_sin_coeffs[i]));
+
+            return _mm256_mul_ps(p, x);
+        }
+
+        void slerp_soa_simd256(const f32* a, const f32* b, const f32* t, f32* out, u32 count, u32 stride)
+        {
+            const __m256 one = _mm256_set1_ps(1.0f);
+            const __m256 eps = _mm256_set1_ps(1e-12f);
+            const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+            const __m256 threshold = _mm256_set1_ps(k_slerp_lerp_threshold);
+
+            u32 n8 = count & ~7;
+            for (u32 i = 0; i < n8; i += 8)
+            {
+                __m256 qa[4], qb[4];
+                for (u32 c = 0; c < 4; ++c)
+                {
+                    qa[c] = _mm256_loadu_ps(&a[c * stride + i]);
+                    qb[c] = _mm256_loadu_ps(&b[c * stride + i]);
+                }
+
+                // shortest arc, flip the sign of b's weight where the dot is negative
+                __m256 d = _mm256_mul_ps(qa[0], qb[0]);
+                for (u32 c = 1; c < 4; ++c)
+                    d = _mm256_fmadd_ps(qa[c], qb[c], d);
+
+                __m256 sign = _mm256_and_ps(d, sign_mask);
+                d = _mm256_xor_ps(d, sign);
+
+                // slerp weights, lanes which are nearly parallel keep the lerp weights
+                __m256 w1 = _mm256_loadu_ps(&t[i]);
+                __m256 w0 = _mm256_sub_ps(one, w1);
+
+                __m256 theta = acos_poly_simd256(d);
+                __m256 sin_theta = _mm256_sqrt_ps(_mm256_max_ps(_mm256_fnmadd_ps(d, d, one), eps));
+                __m256 inv_sin = _mm256_div_ps(one, sin_theta);
+                __m256 s0 = _mm256_mul_ps(sin_poly_simd256(_mm256_mul_ps(w0, theta)), inv_sin);
+                __m256 s1 = _mm256_mul_ps(sin_poly_simd256(_mm256_mul_ps(w1, theta)), inv_sin);
+
+                __m256 use_slerp = _mm256_cmp_ps(d, threshold, _CMP_LT_OQ);
+                w0 = _mm256_blendv_ps(w0, s0, use_slerp);
+                w1 = _mm256_blendv_ps(w1, s1, use_slerp);
+                w1 = _mm256_xor_ps(w1, sign);
+
+                __m256 r[4];
+                __m256 len2 = _mm256_setzero_ps();
+                for (u32 c = 0; c < 4; ++c)
+                {
+                    r[c] = _mm256_fmadd_ps(qb[c], w1, _mm256_mul_ps(qa[c], w0));
+                    len2 = _mm256_fmadd_ps(r[c], r[c], len2);
+                }
+
+                __m256 inv_len = _mm256_div_ps(one, _mm256_sqrt_ps(len2));
+                for (u32 c = 0; c < 4; ++c)
+                    _mm256_storeu_ps(&out[c * stride + i], _mm256_mul_ps(r[c], inv_len));
+            }
+
+            slerp_soa_scalar(a + n8, b + n8, t + n8, out + n8, count - n8, stride);
+        }
+
+        void lerp_soa_simd256(const f32* a, const f32* b, const f32* t, f32* out, u32 count)
+        {
+            const __m256 one = _mm256_set1_ps(1.0f);
+
+            u32 n8 = count & ~7;
+            for (u32 i = 0; i < n8; i += 8)
+            {
+                __m256 tt = _mm256_loadu_ps(&t[i]);
+                __m256 r = _mm256_mul_ps(_mm256_sub_ps(one, tt), _mm256_loadu_ps(&a[i]));
+                r = _mm256_fmadd_ps(tt, _mm256_loadu_ps(&b[i]), r);
+                _mm256_storeu_ps(&out[i], r);
+            }
+
+            lerp_soa_scalar(a + n8, b + n8, t + n8, out + n8, count - n8);
+        }
 #endif
         //
         // Arm neon simd 128 implementation
         //
 
 #ifdef __ARM_NEON__
-        void frustum_cull_aabb_simd128(const ecs_scene* scene, const camera* cam, u32* entities_in, u32** entities_out)
+        void frustum_cull_aabb_simd128(const ecs_scene* scene, const camera* cam, const u32* entities_in, u32 num_entities,
+                                       u32** entities_out)
         {
+            const frustum& frust = cam->camera_frustum;
+
+            // plane normal, distance and sign flip
+            float32x4_t pnx[6];
+            float32x4_t pny[6];
+            float32x4_t pnz[6];
+            float32x4_t pd_neg[6];
+            float32x4_t sfx[6];
+            float32x4_t sfy[6];
+            float32x4_t sfz[6];
+
+            f32 ld[4];
+            u32 result[4];
+            u32 e[4];
+
+            // load camera planes
+            for (s32 p = 0; p < 6; ++p)
+            {
+                f32 ppd = maths::plane_distance(frust.p[p], frust.n[p]);
+                pnx[p] = vdupq_n_f32(frust.n[p].x);
+                pny[p] = vdupq_n_f32(frust.n[p].y);
+                pnz[p] = vdupq_n_f32(frust.n[p].z);
+                pd_neg[p] = vdupq_n_f32(-ppd);
+
+                sfx[p] = vdupq_n_f32(sgn(frust.n[p].x) * -1.0f);
+                sfy[p] = vdupq_n_f32(sgn(frust.n[p].y) * -1.0f);
+                sfz[p] = vdupq_n_f32(sgn(frust.n[p].z) * -1.0f);
+            }
+
+            for (u32 i = 0; i < num_entities; i += 4)
+            {
+                // unpack entities, the tail is padded by repeating the last entity
+                for (u32 j = 0; j < 4; ++j)
+                    e[j] = entities_in[min(i + j, num_entities - 1)];
+
+                float32x4_t pos[3], ext[3];
+                for (u32 a = 0; a < 3; ++a)
+                {
+                    for (u32 j = 0; j < 4; ++j)
+                        ld[j] = scene->pos_extent[e[j]].pos[a];
+                    pos[a] = vld1q_f32(ld);
+
+                    for (u32 j = 0; j < 4; ++j)
+                        ld[j] = scene->pos_extent[e[j]].extent[a];
+                    ext[a] = vld1q_f32(ld);
+                }
+
+                uint32x4_t outside = vdupq_n_u32(0);
+
+                for (s32 p = 0; p < 6; ++p)
+                {
+                    // pos + extent * sign_flip
+                    float32x4_t dpx = vmlaq_f32(pos[0], ext[0], sfx[p]);
+                    float32x4_t dpy = vmlaq_f32(pos[1], ext[1], sfy[p]);
+                    float32x4_t dpz = vmlaq_f32(pos[2], ext[2], sfz[p]);
+
+                    // dot(pos + extent * sign_flip, frust.n[p]);
+                    float32x4_t r = vmulq_f32(dpx, pnx[p]);
+                    r = vmlaq_f32(r, dpy, pny[p]);
+                    r = vmlaq_f32(r, dpz, pnz[p]);
+
+                    // if(r > -pd) inside = false
+                    outside = vorrq_u32(outside, vcgtq_f32(r, pd_neg[p]));
+                }
+
+                vst1q_u32(result, outside);
+                for (u32 j = 0; j < 4; ++j)
+                    if (!result[j] && i + j < num_entities)
+                        sb_push(*entities_out, e[j]);
+            }
         }
 
-        void frustum_cull_sphere_simd128(const ecs_scene* scene, const camera* cam, u32* entities_in, u32** entities_out)
+        void frustum_cull_sphere_simd128(const ecs_scene* scene, const camera* cam, const u32* entities_in, u32 num_entities,
+                                         u32** entities_out)
         {
+            const frustum& frust = cam->camera_frustum;
+
+            // plane normal and distance
+            float32x4_t pnx[6];
+            float32x4_t pny[6];
+            float32x4_t pnz[6];
+            float32x4_t pd[6];
+
+            f32 ld[4];
+            u32 result[4];
+            u32 e[4];
+
+            // load camera planes
+            for (s32 p = 0; p < 6; ++p)
+            {
+                pnx[p] = vdupq_n_f32(frust.n[p].x);
+                pny[p] = vdupq_n_f32(frust.n[p].y);
+                pnz[p] = vdupq_n_f32(frust.n[p].z);
+                pd[p] = vdupq_n_f32(maths::plane_distance(frust.p[p], frust.n[p]));
+            }
+
+            for (u32 i = 0; i < num_entities; i += 4)
+            {
+                // unpack entities, the tail is padded by repeating the last entity
+                for (u32 j = 0; j < 4; ++j)
+                    e[j] = entities_in[min(i + j, num_entities - 1)];
+
+                float32x4_t pos[3];
+                for (u32 a = 0; a < 3; ++a)
+                {
+                    for (u32 j = 0; j < 4; ++j)
+                        ld[j] = scene->pos_extent[e[j]].pos[a];
+                    pos[a] = vld1q_f32(ld);
+                }
+
+                for (u32 j = 0; j < 4; ++j)
+                    ld[j] = scene->pos_extent[e[j]].extent.w;
+                float32x4_t radius = vld1q_f32(ld);
+
+                uint32x4_t outside = vdupq_n_u32(0);
+
+                for (s32 p = 0; p < 6; ++p)
+                {
+                    // dot product with plane normal and also add plane distance
+                    float32x4_t dd = vmlaq_f32(pd[p], pos[0], pnx[p]);
+                    dd = vmlaq_f32(dd, pos[1], pny[p]);
+                    dd = vmlaq_f32(dd, pos[2], pnz[p]);
+
+                    // if dd is greater than radius we are outside
+                    outside = vorrq_u32(outside, vcgtq_f32(dd, radius));
+                }
+
+                vst1q_u32(result, outside);
+                for (u32 j = 0; j < 4; ++j)
+                    if (!result[j] && i + j < num_entities)
+                        sb_push(*entities_out, e[j]);
+            }
+        }
+
+        void transform_bounds_simd128(ecs_scene* scene, const u32* entities, u32 count)
+        {
+            const float32x4_t half = vdupq_n_f32(0.5f);
+
+            f32 px[4], py[4], pz[4], ex[4], ey[4], ez[4];
+            f32 ld[4];
+
+            u32 n4 = count & ~3;
+            for (u32 i = 0; i < n4; i += 4)
+            {
+                const u32* e = &entities[i];
+
+                // gather aabb into soa
+                float32x4_t mn[3], mx[3];
+                for (u32 a = 0; a < 3; ++a)
+                {
+                    for (u32 j = 0; j < 4; ++j)
+                        ld[j] = scene->bounding_volumes[e[j]].min_extents[a];
+                    mn[a] = vld1q_f32(ld);
+
+                    for (u32 j = 0; j < 4; ++j)
+                        ld[j] = scene->bounding_volumes[e[j]].max_extents[a];
+                    mx[a] = vld1q_f32(ld);
+                }
+
+                // centre and half extent
+                float32x4_t cx = vmulq_f32(vaddq_f32(mn[0], mx[0]), half);
+                float32x4_t cy = vmulq_f32(vaddq_f32(mn[1], mx[1]), half);
+                float32x4_t cz = vmulq_f32(vaddq_f32(mn[2], mx[2]), half);
+                float32x4_t hx = vmulq_f32(vsubq_f32(mx[0], mn[0]), half);
+                float32x4_t hy = vmulq_f32(vsubq_f32(mx[1], mn[1]), half);
+                float32x4_t hz = vmulq_f32(vsubq_f32(mx[2], mn[2]), half);
+
+                f32* pos_out[3] = {px, py, pz};
+                f32* ext_out[3] = {ex, ey, ez};
+
+                for (u32 r = 0; r < 3; ++r)
+                {
+                    float32x4_t row[4];
+                    for (u32 c = 0; c < 4; ++c)
+                    {
+                        for (u32 j = 0; j < 4; ++j)
+                            ld[j] = scene->world_matrices[e[j]].m[r * 4 + c];
+                        row[c] = vld1q_f32(ld);
+                    }
+
+                    // pos = m * centre
+                    float32x4_t p = vmlaq_f32(row[3], row[0], cx);
+                    p = vmlaq_f32(p, row[1], cy);
+                    p = vmlaq_f32(p, row[2], cz);
+
+                    // extent = abs(m) * half extent
+                    float32x4_t x = vmulq_f32(vabsq_f32(row[0]), hx);
+                    x = vmlaq_f32(x, vabsq_f32(row[1]), hy);
+                    x = vmlaq_f32(x, vabsq_f32(row[2]), hz);
+
+                    vst1q_f32(pos_out[r], p);
+                    vst1q_f32(ext_out[r], x);
+                }
+
+                for (u32 j = 0; j < 4; ++j)
+                    write_bounds(scene, e[j], vec3f(px[j], py[j], pz[j]), vec3f(ex[j], ey[j], ez[j]));
+            }
+
+            transform_bounds_scalar(scene, &entities[n4], count - n4);
+        }
+        // reciprocal square root estimate refined with two newton raphson steps
+        inline float32x4_t rsqrt_simd128(float32x4_t x)
+        {
+            float32x4_t e = vrsqrteq_f32(x);
+            e = vmulq_f32(vrsqrtsq_f32(vmulq_f32(x, e), e), e);
+            e = vmulq_f32(vrsqrtsq_f32(vmulq_f32(x, e), e), e);
+            return e;
+        }
+
+        inline float32x4_t acos_poly_simd128(float32x4_t x)
+        {
+            float32x4_t p = vdupq_n_f32(k_acos_coeffs[0]);
+            for (u32 i = 1; i < 8; ++i)
+                p = vmlaq_f32(vdupq_n_f32(k_acos_coeffs[i]), p, x);
+
+            float32x4_t one_minus_x = vmaxq_f32(vsubq_f32(vdupq_n_f32(1.0f), x), vdupq_n_f32(1e-12f));
+            return vmulq_f32(p, vmulq_f32(one_minus_x, rsqrt_simd128(one_minus_x)));
+        }
+
+        inline float32x4_t sin_poly_simd128(float32x4_t x)
+        {
+            float32x4_t x2 = vmulq_f32(x, x);
+            float32x4_t p = vdupq_n_f32(k_sin_coeffs[0]);
+            for (u32 i = 1; i < 6; ++i)
+                p = vmlaq_f32(vdupq_n_f32(k_sin_coeffs[i]), p, x2);
+
+            return vmulq_f32(p, x);
+        }
+
+        void slerp_soa_simd128(const f32* a, const f32* b, const f32* t, f32* out, u32 count, u32 stride)
+        {
+            const float32x4_t one = vdupq_n_f32(1.0f);
+            const float32x4_t zero = vdupq_n_f32(0.0f);
+            const float32x4_t eps = vdupq_n_f32(1e-12f);
+            const float32x4_t threshold = vdupq_n_f32(k_slerp_lerp_threshold);
+
+            u32 n4 = count & ~3;
+            for (u32 i = 0; i < n4; i += 4)
+            {
+                float32x4_t qa[4], qb[4];
+                for (u32 c = 0; c < 4; ++c)
+                {
+                    qa[c] = vld1q_f32(&a[c * stride + i]);
+                    qb[c] = vld1q_f32(&b[c * stride + i]);
+                }
+
+                // shortest arc, flip the sign of b's weight where the dot is negative
+                float32x4_t d = vmulq_f32(qa[0], qb[0]);
+                for (u32 c = 1; c < 4; ++c)
+                    d = vmlaq_f32(d, qa[c], qb[c]);
+
+                uint32x4_t negative = vcltq_f32(d, zero);
+                d = vabsq_f32(d);
+
+                // slerp weights, lanes which are nearly parallel keep the lerp weights
+                float32x4_t w1 = vld1q_f32(&t[i]);
+                float32x4_t w0 = vsubq_f32(one, w1);
+
+                float32x4_t theta = acos_poly_simd128(d);
+                float32x4_t inv_sin = rsqrt_simd128(vmaxq_f32(vmlsq_f32(one, d, d), eps));
+                float32x4_t s0 = vmulq_f32(sin_poly_simd128(vmulq_f32(w0, theta)), inv_sin);
+                float32x4_t s1 = vmulq_f32(sin_poly_simd128(vmulq_f32(w1, theta)), inv_sin);
+
+                uint32x4_t use_slerp = vcltq_f32(d, threshold);
+                w0 = vbslq_f32(use_slerp, s0, w0);
+                w1 = vbslq_f32(use_slerp, s1, w1);
+                w1 = vbslq_f32(negative, vnegq_f32(w1), w1);
+
+                float32x4_t r[4];
+                float32x4_t len2 = zero;
+                for (u32 c = 0; c < 4; ++c)
+                {
+                    r[c] = vmlaq_f32(vmulq_f32(qa[c], w0), qb[c], w1);
+                    len2 = vmlaq_f32(len2, r[c], r[c]);
+                }
+
+                float32x4_t inv_len = rsqrt_simd128(len2);
+                for (u32 c = 0; c < 4; ++c)
+                    vst1q_f32(&out[c * stride + i], vmulq_f32(r[c], inv_len));
+            }
+
+            slerp_soa_scalar(a + n4, b + n4, t + n4, out + n4, count - n4, stride);
+        }
+
+        void lerp_soa_simd128(const f32* a, const f32* b, const f32* t, f32* out, u32 count)
+        {
+            const float32x4_t one = vdupq_n_f32(1.0f);
+
+            u32 n4 = count & ~3;
+            for (u32 i = 0; i < n4; i += 4)
+            {
+                float32x4_t tt = vld1q_f32(&t[i]);
+                float32x4_t r = vmulq_f32(vsubq_f32(one, tt), vld1q_f32(&a[i]));
+                r = vmlaq_f32(r, tt, vld1q_f32(&b[i]));
+                vst1q_f32(&out[i], r);
+            }
+
+            lerp_soa_scalar(a + n4, b + n4, t + n4, out + n4, count - n4);
         }
 #endif
-        void frustum_cull_simd_init()
+        namespace
+        {
+            typedef void (*transform_bounds_func)(ecs_scene* scene, const u32* entities, u32 count);
+            typedef void (*frustum_cull_func)(const ecs_scene* scene, const camera* cam, const u32* entities_in,
+                                              u32 num_entities, u32** entities_out);
+
+            typedef void (*slerp_soa_func)(const f32* a, const f32* b, const f32* t, f32* out, u32 count, u32 stride);
+            typedef void (*lerp_soa_func)(const f32* a, const f32* b, const f32* t, f32* out, u32 count);
+
+            transform_bounds_func s_transform_bounds = transform_bounds_scalar;
+            frustum_cull_func     s_frustum_cull_aabb = frustum_cull_aabb_scalar;
+            frustum_cull_func     s_frustum_cull_sphere = frustum_cull_sphere_scalar;
+            slerp_soa_func        s_slerp_soa = slerp_soa_scalar;
+            lerp_soa_func         s_lerp_soa = lerp_soa_scalar;
+
+            bool cpu_supports(const char* feature)
+            {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+                if (strcmp(feature, "avx2") == 0)
+                    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+                if (strcmp(feature, "fma") == 0)
+                    return __builtin_cpu_supports("fma");
+                return false;
+#else
+                // msvc builds with /arch:AVX2 so the compiled in instruction sets are supported
+                return true;
+#endif
+            }
+        } // namespace
+
+        void simd_init()
+        {
+            // pick the widest path compiled in and supported by the cpu we are running on
+            s_transform_bounds = transform_bounds_scalar;
+            s_frustum_cull_aabb = frustum_cull_aabb_scalar;
+            s_frustum_cull_sphere = frustum_cull_sphere_scalar;
+            s_slerp_soa = slerp_soa_scalar;
+            s_lerp_soa = lerp_soa_scalar;
+#if __AVX2__
+            if (cpu_supports("avx2"))
+            {
+                s_transform_bounds = transform_bounds_simd256;
+                s_frustum_cull_aabb = frustum_cull_aabb_simd256;
+                s_frustum_cull_sphere = frustum_cull_sphere_simd256;
+                s_slerp_soa = slerp_soa_simd256;
+                s_lerp_soa = lerp_soa_simd256;
+                return;
+            }
+#endif
+#if __SSE__ || __AVX__
+            if (cpu_supports("fma"))
+            {
+                s_transform_bounds = transform_bounds_simd128;
+                s_frustum_cull_aabb = frustum_cull_aabb_simd128;
+                s_frustum_cull_sphere = frustum_cull_sphere_simd128;
+                s_slerp_soa = slerp_soa_simd128;
+                s_lerp_soa = lerp_soa_simd128;
+            }
+#elif defined(__ARM_NEON__)
+            s_transform_bounds = transform_bounds_simd128;
+            s_frustum_cull_aabb = frustum_cull_aabb_simd128;
+            s_frustum_cull_sphere = frustum_cull_sphere_simd128;
+            s_slerp_soa = slerp_soa_simd128;
+            s_lerp_soa = lerp_soa_simd128;
+#endif
+        }
+
+        void transform_bounds(ecs_scene* scene, const u32* entities, u32 count)
+        {
+            s_transform_bounds(scene, entities, count);
+        }
+
+        void frustum_cull_aabb(const ecs_scene* scene, const camera* cam, const u32* entities_in, u32 num_entities,
+                               u32** entities_out)
+        {
+            s_frustum_cull_aabb(scene, cam, entities_in, num_entities, entities_out);
+        }
+
+        void frustum_cull_sphere(const ecs_scene* scene, const camera* cam, const u32* entities_in, u32 num_entities,
+                                 u32** entities_out)
         {
+            s_frustum_cull_sphere(scene, cam, entities_in, num_entities, entities_out);
         }
 
-        void frustum_cull_aabb(const ecs_scene* scene, const camera* cam, u32* entities_in, u32** entities_out)
+        void slerp_soa(const f32* a, const f32* b, const f32* t, f32* out, u32 count, u32 stride)
         {
-            frustum_cull_aabb_scalar(scene, cam, entities_in, entities_out);
-            //frustum_cull_aabb_simd256(scene, cam, entities_in, entities_out);
+            s_slerp_soa(a, b, t, out, count, stride);
         }
 
-        void frustum_cull_sphere(const ecs_scene* scene, const camera* cam, u32* entities_in, u32** entities_out)
+        void lerp_soa(const f32* a, const f32* b, const f32* t, f32* out, u32 count)
         {
-            frustum_cull_sphere_scalar(scene, cam, entities_in, entities_out);
-            //frustum_cull_sphere_simd256(scene, cam, entities_in, entities_out);
+            s_lerp_soa(a, b, t, out, count);
         }
 
         void debug_culling()
@@ -555,7 +1330,7 @@ namespace put
             {
                 u32* debug_entities = nullptr;
                 dbg::add_frustum(dc.camera_frustum.corners[0], dc.camera_frustum.corners[1]);
-                frustum_cull_aabb_scalar(scene, &dc, filtered_entities, &debug_entities);
+                frustum_cull_aabb_scalar(scene, &dc, filtered_entities, sb_count(filtered_entities), &debug_entities);
                 
                 for(u32 i = 0; i < 6; ++i)
                     dbg::add_line(dc.camera_frustum.p[i], dc.camera_frustum.p[i] + dc.camera_frustum.n[i], vec4f::magenta());
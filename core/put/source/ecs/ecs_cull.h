@@ -13,12 +13,30 @@ namespace put
         void simd_init();
 
         // frustum_cull_xxx_scalar versions scalar float cross platform implementations,
+        // visible entities from entities_in are appended to the stretchy buffer entities_out
         void filter_entities_scalar(const ecs_scene* scene, u32** filtered_entities_out);
-        void frustum_cull_aabb_scalar(const ecs_scene* scene, const camera* cam, u32* entities_in, u32** entities_out);
-        void frustum_cull_sphere_scalar(const ecs_scene* scene, const camera* cam, u32* entities_in, u32** entities_out);
+        void frustum_cull_aabb_scalar(const ecs_scene* scene, const camera* cam, const u32* entities_in, u32 num_entities,
+                                      u32** entities_out);
+        void frustum_cull_sphere_scalar(const ecs_scene* scene, const camera* cam, const u32* entities_in, u32 num_entities,
+                                        u32** entities_out);
 
         // frustum_cull_xxx functions are replaced by simd where available and fall back to scalar if no simd is available
-        void frustum_cull_aabb(const ecs_scene* scene, const camera* cam, u32* entities_in, u32** entities_out);
-        void frustum_cull_sphere(const ecs_scene* scene, const camera* cam, u32* entities_in, u32** entities_out);
+        void frustum_cull_aabb(const ecs_scene* scene, const camera* cam, const u32* entities_in, u32 num_entities,
+                               u32** entities_out);
+        void frustum_cull_sphere(const ecs_scene* scene, const camera* cam, const u32* entities_in, u32 num_entities,
+                                 u32** entities_out);
+
+        // transforms local aabb's by world matrices using centre / abs(matrix) * extent, writes transformed extents,
+        // radius and pos_extent for the entities in the list. transform_bounds uses the fastest simd path available.
+        void transform_bounds_scalar(ecs_scene* scene, const u32* entities, u32 count);
+        void transform_bounds(ecs_scene* scene, const u32* entities, u32 count);
+
+        // blend count quaternions or floats in soa form with a weight per lane, out may alias a. quaternion components are
+        // stored stride floats apart, x at a[i], y at a[stride + i] and so on. slerp takes the shortest arc, lerps nearly
+        // parallel quaternions and normalises the result. the simd paths evaluate 4 or 8 lanes at a time.
+        void slerp_soa_scalar(const f32* a, const f32* b, const f32* t, f32* out, u32 count, u32 stride);
+        void slerp_soa(const f32* a, const f32* b, const f32* t, f32* out, u32 count, u32 stride);
+        void lerp_soa_scalar(const f32* a, const f32* b, const f32* t, f32* out, u32 count);
+        void lerp_soa(const f32* a, const f32* b, const f32* t, f32* out, u32 count);
     } // namespace ecs
 } // namespace put
@@ -241,6 +241,9 @@ namespace put
         {
             create_geometry_primitives();
 
+            // animation lod is measured from the main camera once anim_lod.enabled is set
+            scene->anim_lod.camera = cam;
+
             bool auto_load_last_scene = dev_ui::get_program_preference("load_last_scene").as_bool();
             Str  last_loaded_scene = dev_ui::get_program_preference_filename("last_loaded_scene");
             if (auto_load_last_scene && last_loaded_scene.length() > 0)
@@ -384,7 +387,7 @@ namespace put
                     clone_entity(scene, scene->selection_list[i], nn++, start, e_clone_mode::move, vec3f::zero(), "");
             }
 
-            scene->flags |= e_scene_flags::invalidate_scene_tree;
+            scene->flags |= e_scene_flags::invalidate_scene_tree | e_scene_flags::invalidate_hierarchy;
         }
 
         void clear_selection(ecs_scene* scene)
@@ -398,7 +401,7 @@ namespace put
             }
 
             sb_clear(scene->selection_list);
-            scene->flags |= e_scene_flags::invalidate_scene_tree;
+            scene->flags |= e_scene_flags::invalidate_scene_tree | e_scene_flags::invalidate_hierarchy;
         }
 
         void add_selection(ecs_scene* scene, u32 index, u32 select_mode)
@@ -468,7 +471,7 @@ namespace put
 
             initialise_free_list(scene);
 
-            scene->flags |= e_scene_flags::invalidate_scene_tree;
+            scene->flags |= e_scene_flags::invalidate_scene_tree | e_scene_flags::invalidate_hierarchy;
         }
 
         void enumerate_selection_ui(const ecs_scene* scene, bool* opened)
@@ -569,7 +572,23 @@ namespace put
                         pm = e_select_mode::add;
                     }
 
-                    for (s32 node = 0; node < scene->num_entities; ++node)
+                    // the scene bvh gathers candidates from the entities it holds, which have geometry and a material
+                    static camera select_cam;
+                    for (s32 i = 0; i < 6; ++i)
+                    {
+                        select_cam.camera_frustum.n[i] = n[i];
+                        select_cam.camera_frustum.p[i] = p[i];
+                    }
+
+                    static u32* candidates = nullptr;
+                    if (candidates)
+                        stb__sbn(candidates) = 0;
+
+                    bvh_query_frustum(scene, &select_cam, &candidates);
+
+                    // geometry without a material and sub instances are not in the bvh
+                    u32 num_leaves = sb_count(scene->bvh.entity_leaf);
+                    for (u32 node = 0; node < scene->num_entities; ++node)
                     {
                         if (!(scene->entities[node] & e_cmp::allocated))
                             continue;
@@ -577,6 +596,17 @@ namespace put
                         if (!(scene->entities[node] & e_cmp::geometry))
                             continue;
 
+                        if (node < num_leaves && scene->bvh.entity_leaf[node] != -1)
+                            continue;
+
+                        sb_push(candidates, node);
+                    }
+
+                    u32 num_candidates = sb_count(candidates);
+                    for (u32 ci = 0; ci < num_candidates; ++ci)
+                    {
+                        u32 node = candidates[ci];
+
                         bool selected = true;
                         for (s32 i = 0; i < 6; ++i)
                         {
@@ -2340,6 +2370,7 @@ namespace put
                     {
                         s32 s = selected_index;
                         scene->world_matrices[s] = mat4::create_identity();
+                        scene->state_flags[s] |= e_state::transform_dirty;
                     }
                 }
                 else
@@ -2518,6 +2549,34 @@ namespace put
                         ImGui::Text("%s: %i", dumps[i].display_name, dumps[i].count);
                 }
 
+                if (ImGui::CollapsingHeader("Animation LOD"))
+                {
+                    anim_lod_params& lod = scene->anim_lod;
+                    ImGui::Checkbox("Enabled", &lod.enabled);
+
+                    for (u32 b = 0; b < k_anim_lod_bands; ++b)
+                    {
+                        ImGui::PushID(b);
+                        ImGui::Text("Band %i", b);
+                        ImGui::Indent();
+                        ImGui::InputFloat("Min Screen Size", &lod.bands[b].min_screen_size);
+                        ImGui::InputInt("Update Interval", (s32*)&lod.bands[b].update_interval);
+                        ImGui::InputInt("Max Joint Depth", (s32*)&lod.bands[b].max_joint_depth);
+                        lod.bands[b].update_interval = std::max<s32>((s32)lod.bands[b].update_interval, 1);
+                        lod.bands[b].max_joint_depth = std::max<s32>((s32)lod.bands[b].max_joint_depth, 0);
+                        ImGui::Unindent();
+                        ImGui::PopID();
+                    }
+
+                    const anim_lod_stats& stats = scene->anim_stats;
+                    for (u32 b = 0; b < k_anim_lod_bands; ++b)
+                        ImGui::Text("Band %i Rigs: %i", b, stats.rigs[b]);
+
+                    ImGui::Text("Evaluated: %i", stats.evaluated);
+                    ImGui::Text("Interpolated: %i", stats.interpolated);
+                    ImGui::Text("Joints Evaluated: %i / %i", stats.joints_evaluated, stats.joints_total);
+                }
+
                 if (ImGui::CollapsingHeader("Entities"))
                 {
                     ImGui::BeginChild("Entities", ImVec2(0, 300), true);
@@ -2714,6 +2773,9 @@ namespace put
 
             ecs_scene* scene = view.scene;
 
+            // the widget edits transforms while rendering, after update_scene has kicked culling
+            wait_for_scene_jobs(scene);
+
             viewport vp = _renderer_resolve_viewport_ratio(*view.viewport);
             vec2i    vpi = vec2i(vp.width, vp.height);
 
@@ -2,6 +2,7 @@
 // Copyright 2014 - 2023 Alex Dixon.
 // License: https://github.com/polymonster/pmtech/blob/master/license.md
 
+#include "ecs/ecs_cull.h"
 #include "ecs/ecs_resources.h"
 #include "ecs/ecs_utilities.h"
 
@@ -33,6 +34,13 @@ namespace
     static const u32 k_matrix_floats = 16;
     static const u32 k_extent_floats = 3;
 
+    // compressed pma files start with 'PMAC' in place of the version number
+    static const u32 k_compressed_pma_magic = 0x43414d50;
+    static const u32 k_compressed_pma_version = 1;
+    static const f32 k_u16_max = 65535.0f;
+    static const f32 k_u15_max = 32767.0f;
+    static const f32 k_sqrt2 = 1.41421356f;
+
     namespace e_pmm_transform
     {
         enum pmm_transform_t
@@ -60,8 +68,9 @@ namespace
         u32              num_geometry = 0;
         u32              num_materials = 0;
         u8*              data_start = nullptr;
-        void*            file_data = nullptr;
+        const void*      file_data = nullptr;
         u32              file_size = 0;
+        pen::mapped_file file;
         std::vector<u32> scene_offsets;
         std::vector<u32> material_offsets;
         std::vector<Str> material_names;
@@ -119,16 +128,21 @@ namespace
     std::vector<material_resource*> s_material_resources;
     std::vector<animation_resource> s_animation_resources;
 
-    bool parse_pmm_contents(const c8* filename, pmm_contents& contents)
+    // maps a pmm file and parses the sub resource offsets, returns an error message on failure.
+    // does not log or touch shared state so it can be called from worker threads.
+    const c8* parse_pmm_contents(const c8* filename, pmm_contents& contents)
     {
-        // read in file from disk
-        pen_error err = pen::filesystem_read_file_to_buffer(filename, &contents.file_data, contents.file_size);
-        if (err != PEN_ERR_OK || contents.file_size == 0)
+        // map file from disk, sub resources are parsed directly from the mapping
+        pen_error err = pen::filesystem_map_file(filename, contents.file);
+        if (err != PEN_ERR_OK || contents.file.size == 0)
         {
-            dev_ui::log_level(dev_ui::console_level::error, "[error] load pmm - failed to find file: %s", filename);
-            return false;
+            pen::filesystem_unmap_file(contents.file);
+            return "failed to find file";
         }
 
+        contents.file_data = contents.file.data;
+        contents.file_size = (u32)contents.file.size;
+
         // start reading file
         const u32* p_u32reader = (u32*)contents.file_data;
 
@@ -159,7 +173,7 @@ namespace
 
         // start of sub resource data
         contents.data_start = (u8*)p_u32reader;
-        return true;
+        return nullptr;
     }
 
     bool parse_pmm_geometry(pmm_contents& contents, std::vector<pmm_geometry>& geom)
@@ -250,11 +264,26 @@ namespace
         return true;
     }
 
-    void load_pmm_geometry(const c8* filename, pmm_contents& contents)
+    // frees the submesh cpu buffers of parsed geometry which was not passed on to create_pmm_geometry
+    void release_pmm_geometry(std::vector<pmm_geometry>& geom)
+    {
+        for (auto& g : geom)
+        {
+            for (auto& sm : g.submeshes)
+            {
+                pen::memory_free(sm.vertex_data);
+                pen::memory_free(sm.pos_data);
+                pen::memory_free(sm.pos_index_data);
+                pen::memory_free(sm.index_data);
+                pen::memory_free(sm.joint_data);
+            }
+        }
+        geom.clear();
+    }
+
+    // creates geometry resources from parsed geometry, ownership of the submesh cpu buffers moves to the resources
+    void create_pmm_geometry(const c8* filename, pmm_contents& contents, std::vector<pmm_geometry>& geom)
     {
-        std::vector<pmm_geometry> geom;
-        parse_pmm_geometry(contents, geom);
-        
         u32 first_bone_offset = -1;
 
         for (u32 g = 0; g < contents.num_geometry; ++g)
@@ -311,11 +340,10 @@ namespace
                     bone_offset -= first_bone_offset;
                     
                     p_geometry->p_skin = (cmp_skin*)pen::memory_alloc(sizeof(cmp_skin));
-                    p_geometry->p_skin->bone_cbuffer = PEN_INVALID_HANDLE;
                     p_geometry->p_skin->bind_shape_matrix = sm.bind_shape_matrix;
                     p_geometry->p_skin->bone_offset = bone_offset;
                     p_geometry->p_skin->num_joints = sm.num_joint_floats / k_matrix_floats;
-                    memset(p_geometry->p_skin->joint_bind_matrices, 0x0, sizeof(p_geometry->p_skin->joint_bind_matrices));
+                    p_geometry->p_skin->joint_bind_matrices = (mat4*)pen::memory_alloc(sm.joint_data_size);
                     memcpy(p_geometry->p_skin->joint_bind_matrices, sm.joint_data, sm.joint_data_size);
                 }
 
@@ -1363,7 +1391,8 @@ namespace put
             permutation_flags_from_vertex_class(permutation, geometry->vertex_shader_class);
 
             // technique / permutation
-            material->technique_index = pmfx::get_technique_index_perm(material->shader, resource->id_technique, permutation);
+            material->technique_index =
+                pmfx::get_technique_index_perm_async(material->shader, resource->id_technique, permutation);
             PEN_ASSERT(is_valid(material->technique_index));
 
             // material / technique constant buffers
@@ -1427,50 +1456,97 @@ namespace put
             }
         }
 
-        anim_handle load_pma(const c8* filename)
+        void load_compressed_pma(const u32* p_u32reader, animation_resource& anim)
         {
-            Str pd = put::dev_ui::get_program_preference_filename("project_dir");
+            u32 version = *p_u32reader++;
+            PEN_ASSERT(version == k_compressed_pma_version);
+            PEN_UNUSED(version);
 
-            Str stipped_filename = pen::str_replace_string(filename, pd.c_str(), "");
+            compressed_anim* clip = new compressed_anim();
+            clip->num_channels = *p_u32reader++;
+            clip->num_keys = *p_u32reader++;
+            clip->length = *(f32*)p_u32reader++;
+            clip->channels = new compressed_anim_channel[clip->num_channels];
 
-            hash_id filename_hash = PEN_HASH(stipped_filename.c_str());
+            // channels only carry the target for binding, the keys live in the clip
+            anim.num_channels = clip->num_channels;
+            anim.channels = new animation_channel[clip->num_channels];
+            anim.length = clip->length;
 
-            // search for existing
-            s32 num_anims = s_animation_resources.size();
-            for (s32 i = 0; i < num_anims; ++i)
+            for (u32 c = 0; c < clip->num_channels; ++c)
             {
-                if (s_animation_resources[i].id_name == filename_hash)
+                animation_channel& channel = anim.channels[c];
+
+                channel.target_name = read_parsable_string(&p_u32reader);
+                channel.target = PEN_HASH(channel.target_name.c_str());
+                channel.num_frames = 0;
+                channel.times = nullptr;
+                channel.matrices = nullptr;
+                channel.interpolation = nullptr;
+                for (u32 o = 0; o < 3; ++o)
                 {
-                    return (anim_handle)i;
+                    channel.offset[o] = nullptr;
+                    channel.scale[o] = nullptr;
+                    channel.rotation[o] = nullptr;
+                }
+
+                compressed_anim_channel& cc = clip->channels[c];
+                cc.flags = *p_u32reader++;
+
+                for (u32 t = 0; t < e_anim_track::COUNT; ++t)
+                {
+                    anim_track& track = cc.tracks[t];
+                    track.first_key = *p_u32reader++;
+                    track.num_keys = *p_u32reader++;
+                    track.mask = *p_u32reader++;
+                    memcpy(track.range_min, p_u32reader, sizeof(f32) * 3);
+                    p_u32reader += 3;
+                    memcpy(track.range_extent, p_u32reader, sizeof(f32) * 3);
+                    p_u32reader += 3;
                 }
             }
 
-            void* anim_file;
-            u32   anim_file_size;
+            // key arrays are padded to 4 bytes
+            u32 nk = clip->num_keys;
+            clip->key_times = new u16[nk];
+            memcpy(clip->key_times, p_u32reader, nk * sizeof(u16));
+            p_u32reader += (nk * sizeof(u16) + 3) / 4;
 
-            pen_error err = pen::filesystem_read_file_to_buffer(filename, &anim_file, anim_file_size);
+            clip->key_data = new u16[nk * 3];
+            memcpy(clip->key_data, p_u32reader, nk * 3 * sizeof(u16));
 
-            if (err != PEN_ERR_OK || anim_file_size == 0)
+            anim.compressed = clip;
+        }
+
+        // parses the pma file into new_animation without touching the resource list, so it can run on a worker thread
+        bool parse_pma(const c8* filename, animation_resource& new_animation)
+        {
+            pen::mapped_file anim_file;
+            pen_error        err = pen::filesystem_map_file(filename, anim_file);
+
+            if (err != PEN_ERR_OK || anim_file.size == 0)
             {
                 // TODO error dialog
-                return PEN_INVALID_HANDLE;
+                pen::filesystem_unmap_file(anim_file);
+                return false;
             }
 
-            const u32* p_u32reader = (u32*)anim_file;
+            const u32* p_u32reader = (const u32*)anim_file.data;
 
             u32 version = *p_u32reader++;
 
             if (version < 1)
             {
-                pen::memory_free(anim_file);
-                return PEN_INVALID_HANDLE;
+                pen::filesystem_unmap_file(anim_file);
+                return false;
             }
 
-            s_animation_resources.push_back(animation_resource());
-            animation_resource& new_animation = s_animation_resources.back();
-
-            new_animation.name = stipped_filename;
-            new_animation.id_name = filename_hash;
+            if (version == k_compressed_pma_magic)
+            {
+                load_compressed_pma(p_u32reader, new_animation);
+                pen::filesystem_unmap_file(anim_file);
+                return true;
+            }
 
             u32 num_channels = *p_u32reader++;
 
@@ -1652,7 +1728,7 @@ namespace put
             }
 
             // free file mem
-            pen::memory_free(anim_file);
+            pen::filesystem_unmap_file(anim_file);
 
             // bake animations into soa.
 
@@ -1745,6 +1821,35 @@ namespace put
                 }
             }
 
+            return true;
+        }
+
+        anim_handle load_pma(const c8* filename)
+        {
+            Str pd = put::dev_ui::get_program_preference_filename("project_dir");
+
+            Str stipped_filename = pen::str_replace_string(filename, pd.c_str(), "");
+
+            hash_id filename_hash = PEN_HASH(stipped_filename.c_str());
+
+            // search for existing
+            s32 num_anims = s_animation_resources.size();
+            for (s32 i = 0; i < num_anims; ++i)
+            {
+                if (s_animation_resources[i].id_name == filename_hash)
+                {
+                    return (anim_handle)i;
+                }
+            }
+
+            animation_resource new_animation = animation_resource();
+            new_animation.name = stipped_filename;
+            new_animation.id_name = filename_hash;
+
+            if (!parse_pma(filename, new_animation))
+                return PEN_INVALID_HANDLE;
+
+            s_animation_resources.push_back(new_animation);
             return (anim_handle)s_animation_resources.size() - 1;
         }
 
@@ -1794,8 +1899,12 @@ namespace put
         void optimise_pmm(const c8* input_filename, const c8* output_filename)
         {
             pmm_contents contents;
-            if (!parse_pmm_contents(input_filename, contents))
+            const c8*    error = parse_pmm_contents(input_filename, contents);
+            if (error)
+            {
+                dev_ui::log_level(dev_ui::console_level::error, "[error] optimise pmm - %s: %s", error, input_filename);
                 return;
+            }
 
             std::vector<pmm_geometry> geom;
             parse_pmm_geometry(contents, geom);
@@ -2009,31 +2118,381 @@ namespace put
             ofs.close();
 
             // cleanup memory
-            for (auto& g : geom)
+            release_pmm_geometry(geom);
+            pen::filesystem_unmap_file(contents.file);
+        }
+
+        void encode_anim_key(const anim_track& track, u32 track_index, const f32* v, u16* key)
+        {
+            if (track_index == e_anim_track::rotate)
             {
-                for (auto& sm : g.submeshes)
+                // smallest three, the largest component is dropped and rebuilt from the unit length at decode time
+                u32 largest = 0;
+                for (u32 i = 1; i < 4; ++i)
+                    if (fabsf(v[i]) > fabsf(v[largest]))
+                        largest = i;
+
+                // q and -q are the same rotation so the dropped component is always positive, the rest are +/- 1/sqrt2
+                f32 sign = v[largest] < 0.0f ? -1.0f : 1.0f;
+                u32 k = 0;
+                for (u32 i = 0; i < 4; ++i)
                 {
-                    pen::memory_free(sm.vertex_data);
-                    pen::memory_free(sm.pos_data);
-                    pen::memory_free(sm.pos_index_data);
-                    pen::memory_free(sm.index_data);
-                    pen::memory_free(sm.joint_data);
+                    if (i == largest)
+                        continue;
+
+                    f32 n = min(max(v[i] * sign * k_sqrt2 * 0.5f + 0.5f, 0.0f), 1.0f);
+                    key[k++] = (u16)(n * k_u15_max + 0.5f);
+                }
+
+                // index of the dropped component in the top bits of the first 2 values
+                key[0] |= (largest & 1) << 15;
+                key[1] |= (largest >> 1) << 15;
+            }
+            else
+            {
+                for (u32 i = 0; i < 3; ++i)
+                {
+                    f32 n = 0.0f;
+                    if (track.range_extent[i] > 0.0f)
+                        n = min(max((v[i] - track.range_min[i]) / track.range_extent[i], 0.0f), 1.0f);
+
+                    key[i] = (u16)(n * k_u16_max + 0.5f);
                 }
             }
-            pen::memory_free(contents.file_data);
         }
 
-        void optimise_pma(const c8* input_filename, const c8* output_filename)
+        void decode_anim_key(const anim_track& track, u32 track_index, const u16* key, f32* out)
         {
+            if (track_index == e_anim_track::rotate)
+            {
+                u32 largest = (key[0] >> 15) | ((key[1] >> 15) << 1);
+                f32 len2 = 0.0f;
+                u32 k = 0;
+                for (u32 i = 0; i < 4; ++i)
+                {
+                    if (i == largest)
+                        continue;
+
+                    f32 c = ((f32)(key[k++] & 0x7fff) / k_u15_max * 2.0f - 1.0f) / k_sqrt2;
+                    out[i] = c;
+                    len2 += c * c;
+                }
 
-            // todo
+                out[largest] = sqrtf(max(1.0f - len2, 0.0f));
+            }
+            else
+            {
+                for (u32 i = 0; i < 3; ++i)
+                    out[i] = track.range_min[i] + (f32)key[i] / k_u16_max * track.range_extent[i];
+            }
         }
 
-        s32 load_pmm(const c8* filename, ecs_scene* scene, u32 load_flags)
+        f32 anim_key_error(u32 track_index, const f32* a, const f32* b)
         {
-            // pmm contains scene node, material, and geometry resources
-            pmm_contents contents;
-            parse_pmm_contents(filename, contents);
+            if (track_index == e_anim_track::rotate)
+            {
+                // angle between the rotations from the chord between the quaternions, acos of the dot cant resolve
+                // small angles once the inputs are a few ulps from unit length
+                f32 d0 = 0.0f;
+                f32 d1 = 0.0f;
+                for (u32 i = 0; i < 4; ++i)
+                {
+                    d0 += (a[i] - b[i]) * (a[i] - b[i]);
+                    d1 += (a[i] + b[i]) * (a[i] + b[i]);
+                }
+
+                f32 chord = sqrtf(min(d0, d1));
+                return 4.0f * asinf(min(chord * 0.5f, 1.0f));
+            }
+
+            f32 e = 0.0f;
+            for (u32 i = 0; i < 3; ++i)
+                e = max(e, fabsf(a[i] - b[i]));
+
+            return e;
+        }
+
+        void interpolate_anim_key(u32 track_index, const f32* a, const f32* b, f32 t, f32* out)
+        {
+            if (track_index == e_anim_track::rotate)
+            {
+                slerp_soa_scalar(a, b, &t, out, 1, 1);
+                return;
+            }
+
+            f32 t3[3] = {t, t, t};
+            lerp_soa_scalar(a, b, t3, out, 3);
+        }
+
+        // quantises the source keys of a track then greedily drops keys which can be rebuilt from their neighbours within
+        // tolerance. the error is measured against the dequantised neighbours so it includes the quantisation error.
+        void compress_anim_track(anim_track& track, u32 track_index, const f32* times, const f32* values, u32 num_src,
+                                 f32 tolerance, bool strip_identity, u16** key_times, u16** key_data)
+        {
+            static const f32 k_identity[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+            u32              stride = track_index == e_anim_track::rotate ? 4 : 3;
+
+            // range reduce translate and scale
+            if (track_index != e_anim_track::rotate)
+            {
+                for (u32 i = 0; i < 3; ++i)
+                {
+                    f32 mn = FLT_MAX;
+                    f32 mx = -FLT_MAX;
+                    for (u32 k = 0; k < num_src; ++k)
+                    {
+                        mn = min(mn, values[k * stride + i]);
+                        mx = max(mx, values[k * stride + i]);
+                    }
+
+                    track.range_min[i] = mn;
+                    track.range_extent[i] = mx - mn;
+                }
+            }
+
+            u16* qkeys = new u16[num_src * 3];
+            f32* dq = new f32[num_src * stride];
+            u16* qtimes = new u16[num_src];
+            for (u32 k = 0; k < num_src; ++k)
+            {
+                encode_anim_key(track, track_index, &values[k * stride], &qkeys[k * 3]);
+                decode_anim_key(track, track_index, &qkeys[k * 3], &dq[k * stride]);
+                qtimes[k] = (u16)(min(max(times[k], 0.0f), k_u16_max) + 0.5f);
+            }
+
+            // constant tracks keep a single key
+            bool constant = true;
+            for (u32 k = 1; k < num_src && constant; ++k)
+                constant = anim_key_error(track_index, &dq[0], &values[k * stride]) <= tolerance;
+
+            u32 first_key = sb_count(*key_times);
+            track.first_key = first_key;
+
+            if (constant)
+            {
+                // static tracks which match what the runtime does without the track are stripped
+                if (!(strip_identity && anim_key_error(track_index, &dq[0], k_identity) <= tolerance))
+                {
+                    sb_push(*key_times, qtimes[0]);
+                    for (u32 i = 0; i < 3; ++i)
+                        sb_push(*key_data, qkeys[i]);
+                }
+            }
+            else
+            {
+                f32 v[4];
+                u32 i = 0;
+                for (;;)
+                {
+                    sb_push(*key_times, qtimes[i]);
+                    for (u32 e = 0; e < 3; ++e)
+                        sb_push(*key_data, qkeys[i * 3 + e]);
+
+                    if (i == num_src - 1)
+                        break;
+
+                    // extend the span from i as far as every source key inside it stays within tolerance
+                    u32 j = i + 1;
+                    for (; j + 1 < num_src; ++j)
+                    {
+                        u32 end = j + 1;
+                        f32 span = (f32)qtimes[end] - (f32)qtimes[i];
+
+                        bool within = true;
+                        for (u32 k = i + 1; k < end && within; ++k)
+                        {
+                            f32 t = span > 0.0f ? ((f32)qtimes[k] - (f32)qtimes[i]) / span : 0.0f;
+                            interpolate_anim_key(track_index, &dq[i * stride], &dq[end * stride], t, v);
+                            within = anim_key_error(track_index, v, &values[k * stride]) <= tolerance;
+                        }
+
+                        if (!within)
+                            break;
+                    }
+
+                    i = j;
+                }
+            }
+
+            track.num_keys = sb_count(*key_times) - first_key;
+
+            delete[] qkeys;
+            delete[] dq;
+            delete[] qtimes;
+        }
+
+        bool compress_animation(const animation_resource& anim, compressed_anim& out, const anim_compression_params& params)
+        {
+            if (anim.compressed || !anim.channels)
+                return false;
+
+            out.num_channels = anim.num_channels;
+            out.length = anim.length;
+            out.channels = new compressed_anim_channel[anim.num_channels];
+
+            u16* key_times = nullptr;
+            u16* key_data = nullptr;
+            f32* times = nullptr;
+            f32* values = nullptr;
+
+            f32 time_scale = anim.length > 0.0f ? k_u16_max / anim.length : 0.0f;
+            f32 tolerance[] = {params.translation_tolerance, params.scale_tolerance, params.rotation_tolerance};
+
+            for (u32 c = 0; c < anim.num_channels; ++c)
+            {
+                const animation_channel& channel = anim.channels[c];
+                compressed_anim_channel& cc = out.channels[c];
+
+                u32 nf = channel.num_frames;
+                if (nf == 0 || !channel.times)
+                    continue;
+
+                cc.flags = channel.matrices ? e_anim_flags::baked_quaternion : 0;
+
+                if (times)
+                {
+                    stb__sbn(times) = 0;
+                    stb__sbn(values) = 0;
+                }
+                sb_add(times, nf);
+                sb_add(values, nf * 4);
+
+                for (u32 t = 0; t < nf; ++t)
+                    times[t] = channel.times[t] * time_scale;
+
+                for (u32 tr = 0; tr < e_anim_track::COUNT; ++tr)
+                {
+                    anim_track& track = cc.tracks[tr];
+
+                    if (tr == e_anim_track::rotate)
+                    {
+                        if (!channel.rotation[0])
+                            continue;
+
+                        // euler channels are concatenated the same way the sampler concatenates them
+                        track.mask = 0xf;
+                        for (u32 t = 0; t < nf; ++t)
+                        {
+                            quat q = channel.rotation[0][t];
+                            for (u32 r = 1; r < 3; ++r)
+                                if (channel.rotation[r])
+                                    q = channel.rotation[r][t] * q;
+
+                            for (u32 i = 0; i < 4; ++i)
+                                values[t * 4 + i] = q.v[i];
+                        }
+                    }
+                    else
+                    {
+                        f32* const* src = tr == e_anim_track::translate ? channel.offset : channel.scale;
+
+                        track.mask = 0;
+                        for (u32 i = 0; i < 3; ++i)
+                            if (src[i])
+                                track.mask |= 1 << i;
+
+                        if (!track.mask)
+                            continue;
+
+                        for (u32 t = 0; t < nf; ++t)
+                            for (u32 i = 0; i < 3; ++i)
+                                values[t * 3 + i] = src[i] ? src[i][t] : 0.0f;
+                    }
+
+                    // an identity rotation only matches a missing track when it is applied on top of the bind pose
+                    bool strip = tr == e_anim_track::rotate && !(cc.flags & e_anim_flags::baked_quaternion);
+                    compress_anim_track(track, tr, times, values, nf, tolerance[tr], strip, &key_times, &key_data);
+                }
+            }
+
+            out.num_keys = sb_count(key_times);
+            out.key_times = new u16[out.num_keys];
+            out.key_data = new u16[out.num_keys * 3];
+            if (out.num_keys)
+            {
+                memcpy(out.key_times, key_times, out.num_keys * sizeof(u16));
+                memcpy(out.key_data, key_data, out.num_keys * 3 * sizeof(u16));
+            }
+
+            sb_free(key_times);
+            sb_free(key_data);
+            sb_free(times);
+            sb_free(values);
+
+            return true;
+        }
+
+        void release_compressed_animation(compressed_anim& clip)
+        {
+            delete[] clip.channels;
+            delete[] clip.key_times;
+            delete[] clip.key_data;
+            clip = compressed_anim();
+        }
+
+        void optimise_pma(const c8* input_filename, const c8* output_filename, const anim_compression_params& params)
+        {
+            anim_handle h = load_pma(input_filename);
+            if (!is_valid(h))
+            {
+                PEN_LOG("error: failed to load %s", input_filename);
+                return;
+            }
+
+            animation_resource* anim = get_animation_resource(h);
+
+            compressed_anim clip;
+            if (!compress_animation(*anim, clip, params))
+            {
+                PEN_LOG("error: %s is already compressed", input_filename);
+                return;
+            }
+
+            std::ofstream ofs(output_filename, std::ofstream::binary);
+            ofs.write((const c8*)&k_compressed_pma_magic, sizeof(u32));
+            ofs.write((const c8*)&k_compressed_pma_version, sizeof(u32));
+            ofs.write((const c8*)&clip.num_channels, sizeof(u32));
+            ofs.write((const c8*)&clip.num_keys, sizeof(u32));
+            ofs.write((const c8*)&clip.length, sizeof(f32));
+
+            for (u32 c = 0; c < clip.num_channels; ++c)
+            {
+                write_parsable_string_u32(anim->channels[c].target_name, ofs);
+                ofs.write((const c8*)&clip.channels[c].flags, sizeof(u32));
+
+                for (u32 t = 0; t < e_anim_track::COUNT; ++t)
+                {
+                    const anim_track& track = clip.channels[c].tracks[t];
+                    ofs.write((const c8*)&track.first_key, sizeof(u32));
+                    ofs.write((const c8*)&track.num_keys, sizeof(u32));
+                    ofs.write((const c8*)&track.mask, sizeof(u32));
+                    ofs.write((const c8*)&track.range_min[0], sizeof(f32) * 3);
+                    ofs.write((const c8*)&track.range_extent[0], sizeof(f32) * 3);
+                }
+            }
+
+            // keys, each array padded to 4 bytes
+            static const u16 pad = 0;
+            ofs.write((const c8*)clip.key_times, clip.num_keys * sizeof(u16));
+            if (clip.num_keys & 1)
+                ofs.write((const c8*)&pad, sizeof(u16));
+
+            ofs.write((const c8*)clip.key_data, clip.num_keys * 3 * sizeof(u16));
+            if (clip.num_keys & 1)
+                ofs.write((const c8*)&pad, sizeof(u16));
+
+            ofs.close();
+
+            release_compressed_animation(clip);
+        }
+
+        // instantiates parsed pmm contents, releasing the file mapping
+        s32 load_pmm_contents(const c8* filename, ecs_scene* scene, u32 load_flags, pmm_contents& contents,
+                              std::vector<pmm_geometry>& geom)
+        {
+            // streamed models are added after update_scene has kicked culling
+            if (scene)
+                wait_for_scene_jobs(scene);
 
             // load material resources
             if (load_flags & e_pmm_load_flags::material)
@@ -2047,7 +2506,7 @@ namespace put
 
             // load geometry resources
             if (load_flags & e_pmm_load_flags::geometry)
-                load_pmm_geometry(filename, contents);
+                create_pmm_geometry(filename, contents, geom);
 
             // load nodes.. we need to do this last because they depend on the material and geometry resources.
             s32 root = PEN_INVALID_HANDLE;
@@ -2064,16 +2523,185 @@ namespace put
                 // invalidate trees to rebuild
                 if (contents.num_scene > 0)
                     if (scene)
-                        scene->flags |= e_scene_flags::invalidate_scene_tree;
+                        scene->flags |= e_scene_flags::invalidate_scene_tree | e_scene_flags::invalidate_hierarchy;
             }
 
-            pen::memory_free(contents.file_data);
+            pen::filesystem_unmap_file(contents.file);
             return root;
         }
 
+        s32 load_pmm(const c8* filename, ecs_scene* scene, u32 load_flags)
+        {
+            // pmm contains scene node, material, and geometry resources
+            pmm_contents contents;
+            const c8*    error = parse_pmm_contents(filename, contents);
+            if (error)
+            {
+                dev_ui::log_level(dev_ui::console_level::error, "[error] load pmm - %s: %s", error, filename);
+                return PEN_INVALID_HANDLE;
+            }
+
+            std::vector<pmm_geometry> geom;
+            if (load_flags & e_pmm_load_flags::geometry)
+                parse_pmm_geometry(contents, geom);
+
+            return load_pmm_contents(filename, scene, load_flags, contents, geom);
+        }
+
+        namespace
+        {
+            struct pmm_stream
+            {
+                Str                       filename;
+                ecs_scene*                scene;
+                u32                       load_flags;
+                pmm_contents              contents;
+                std::vector<pmm_geometry> geom;
+                bool                      finalised = false;
+                const c8*                 error = nullptr; // logged on the main thread in release
+            };
+
+            bool pmm_stream_load(void* data)
+            {
+                pmm_stream* ps = (pmm_stream*)data;
+                ps->error = parse_pmm_contents(ps->filename.c_str(), ps->contents);
+                if (ps->error)
+                    return false;
+
+                if (ps->load_flags & e_pmm_load_flags::geometry)
+                    if (!parse_pmm_geometry(ps->contents, ps->geom))
+                        return false;
+
+                return true;
+            }
+
+            u32 pmm_stream_finalise(void* data)
+            {
+                pmm_stream* ps = (pmm_stream*)data;
+                ps->finalised = true;
+                return (u32)load_pmm_contents(ps->filename.c_str(), ps->scene, ps->load_flags, ps->contents, ps->geom);
+            }
+
+            void pmm_stream_release(void* data)
+            {
+                // failed or cancelled streams still own the parsed geometry and the mapping
+                pmm_stream* ps = (pmm_stream*)data;
+
+                if (ps->error)
+                    dev_ui::log_level(dev_ui::console_level::error, "[error] load pmm - %s: %s", ps->error,
+                                      ps->filename.c_str());
+
+                if (!ps->finalised)
+                {
+                    release_pmm_geometry(ps->geom);
+                    pen::filesystem_unmap_file(ps->contents.file);
+                }
+                delete ps;
+            }
+
+            struct pma_stream
+            {
+                Str                filename;
+                animation_resource anim;
+                bool               parsed = false;
+                bool               finalised = false;
+                s32                existing = PEN_INVALID_HANDLE;
+            };
+
+            s32 find_animation_resource(hash_id id_name)
+            {
+                s32 num_anims = s_animation_resources.size();
+                for (s32 i = 0; i < num_anims; ++i)
+                    if (s_animation_resources[i].id_name == id_name)
+                        return i;
+
+                return PEN_INVALID_HANDLE;
+            }
+
+            bool pma_stream_load(void* data)
+            {
+                pma_stream* ps = (pma_stream*)data;
+                ps->parsed = parse_pma(ps->filename.c_str(), ps->anim);
+                return ps->parsed;
+            }
+
+            u32 pma_stream_finalise(void* data)
+            {
+                // the same clip may have been loaded or streamed while this one was in flight
+                pma_stream* ps = (pma_stream*)data;
+                s32         existing = find_animation_resource(ps->anim.id_name);
+                if (existing != PEN_INVALID_HANDLE)
+                    return (u32)existing;
+
+                ps->finalised = true;
+                s_animation_resources.push_back(ps->anim);
+                return (u32)s_animation_resources.size() - 1;
+            }
+
+            void pma_stream_release(void* data)
+            {
+                // animation resources are never released, a clip parsed before cancellation is kept for the next request
+                pma_stream* ps = (pma_stream*)data;
+                if (ps->parsed && !ps->finalised)
+                    pma_stream_finalise(data);
+
+                delete ps;
+            }
+        } // namespace
+
+        u32 stream_pmm(const c8* filename, ecs_scene* scene, u32 load_flags, u32 priority, stream_callback cb,
+                       void* user_data)
+        {
+            pmm_stream* ps = new pmm_stream();
+            ps->filename = filename;
+            ps->scene = scene;
+            ps->load_flags = load_flags;
+
+            stream_request_params params;
+            params.load = pmm_stream_load;
+            params.finalise = pmm_stream_finalise;
+            params.release = pmm_stream_release;
+            params.data = ps;
+            params.priority = priority;
+            params.callback = cb;
+            params.user_data = user_data;
+
+            return stream_request(params);
+        }
+
+        u32 stream_pma(const c8* filename, u32 priority, stream_callback cb, void* user_data)
+        {
+            Str pd = put::dev_ui::get_program_preference_filename("project_dir");
+
+            pma_stream* ps = new pma_stream();
+            ps->filename = filename;
+            ps->anim = animation_resource();
+            ps->anim.name = pen::str_replace_string(filename, pd.c_str(), "");
+            ps->anim.id_name = PEN_HASH(ps->anim.name.c_str());
+
+            stream_request_params params;
+            params.load = pma_stream_load;
+            params.finalise = pma_stream_finalise;
+            params.release = pma_stream_release;
+            params.data = ps;
+            params.priority = priority;
+            params.callback = cb;
+            params.user_data = user_data;
+
+            // already loaded clips skip the worker and resolve to the existing handle on the next update
+            if (find_animation_resource(ps->anim.id_name) != PEN_INVALID_HANDLE)
+                params.load = nullptr;
+
+            return stream_request(params);
+        }
+
         s32 load_pmv(const c8* filename, ecs_scene* scene)
         {
-            pen::json pmv = pen::json::load_from_file(filename);
+            pen::json_doc* doc = pen::json_doc::load_from_file(filename);
+            if (!doc)
+                return PEN_INVALID_HANDLE;
+
+            pen::json_view pmv = doc->root();
 
             Str volume_texture_filename = pmv["filename"].as_str();
             u32 volume_texture = put::load_texture(volume_texture_filename.c_str());
@@ -2082,6 +2710,8 @@ namespace put
 
             hash_id id_type = pmv["volume_type"].as_hash_id();
 
+            pen::json_doc::release(doc);
+
             static volume_instance vi[] = {
                 {PEN_HASH("volume_texture"), PEN_HASH("volume_texture"), PEN_HASH("clamp_point"), e_cmp::volume},
 
@@ -5,6 +5,7 @@
 #pragma once
 
 #include "ecs/ecs_scene.h"
+#include "loader.h"
 
 namespace put
 {
@@ -143,13 +144,60 @@ namespace put
             f32**         data = nullptr; // [frame][sampler offset]
         };
 
+        namespace e_anim_track
+        {
+            enum anim_track_t
+            {
+                translate,
+                scale,
+                rotate,
+                COUNT
+            };
+        }
+
+        // compressed clips store each track as a contiguous run of keys, reduced to the keys needed to stay within the
+        // compression tolerances. a key is a u16 time normalised to the clip length and 3 u16 values, range reduced xyz
+        // for translate and scale or a smallest three quaternion for rotate. euler rotations are composed offline.
+        struct anim_track
+        {
+            u32 first_key = 0;
+            u32 num_keys = 0; // 0 for stripped tracks, 1 for constant tracks
+            u32 mask = 0;     // components present in the source, xyz for translate and scale
+            f32 range_min[3] = {0.0f, 0.0f, 0.0f};
+            f32 range_extent[3] = {0.0f, 0.0f, 0.0f};
+        };
+
+        struct compressed_anim_channel
+        {
+            anim_track tracks[e_anim_track::COUNT];
+            u32        flags = 0;
+        };
+
+        struct compressed_anim
+        {
+            u32                      num_channels = 0;
+            u32                      num_keys = 0;
+            f32                      length = 0.0f;
+            compressed_anim_channel* channels = nullptr;
+            u16*                     key_times = nullptr;
+            u16*                     key_data = nullptr; // [key][3]
+        };
+
+        struct anim_compression_params
+        {
+            f32 translation_tolerance = 0.001f; // source units
+            f32 scale_tolerance = 0.0001f;
+            f32 rotation_tolerance = 0.0005f; // radians
+        };
+
         struct anim_sampler
         {
-            u32 pos;
-            u32 joint;
-            u32 flags;
-            f32 cur_t;
-            f32 prev_t;
+            u32 pos = 0;
+            u32 joint = PEN_INVALID_HANDLE;
+            u32 flags = 0;
+            f32 cur_t = 0.0f;
+            f32 prev_t = 0.0f;
+            u32 key[e_anim_track::COUNT] = {0, 0, 0}; // track cursors for compressed anims
         };
 
         struct anim_target
@@ -161,15 +209,16 @@ namespace put
 
         struct anim_instance
         {
-            u32            flags = 0;
-            soa_anim       soa;
-            f32            time = 0.0f;
-            f32            length = 0.0f; // length in time
-            anim_target*   targets = nullptr;
-            cmp_transform* joints = nullptr;
-            anim_sampler*  samplers = nullptr;
-            vec3f          root_translation;
-            vec3f          root_delta = vec3f::zero();
+            u32              flags = 0;
+            soa_anim         soa;
+            compressed_anim* compressed = nullptr;
+            f32              time = 0.0f;
+            f32              length = 0.0f; // length in time
+            anim_target*     targets = nullptr;
+            cmp_transform*   joints = nullptr;
+            anim_sampler*    samplers = nullptr;
+            vec3f            root_translation;
+            vec3f            root_delta = vec3f::zero();
         };
 
         struct animation_channel
@@ -199,7 +248,8 @@ namespace put
             f32 length;
             Str name;
 
-            soa_anim soa;
+            soa_anim         soa;
+            compressed_anim* compressed = nullptr; // raw channel data and soa are not loaded for compressed anims
         };
 
         struct pmm_renderable // resouce may contain full vb and position only
@@ -274,8 +324,27 @@ namespace put
         s32 load_pma(const c8* model_scene_name);
         s32 load_pmv(const c8* filename, ecs_scene* scene);
 
+        // asynchronous versions of load_pmm / load_pma, the files are parsed on worker threads and the resources are
+        // created by put::stream_update, the resource reported for a stream is the root node or anim handle
+        u32 stream_pmm(const c8* filename, ecs_scene* scene, u32 load_flags = e_pmm_load_flags::all,
+                       u32 priority = e_stream_priority::normal, stream_callback cb = nullptr, void* user_data = nullptr);
+        u32 stream_pma(const c8* filename, u32 priority = e_stream_priority::normal, stream_callback cb = nullptr,
+                       void* user_data = nullptr);
+
         void optimise_pmm(const c8* input_filename, const c8* output_filename);
-        void optimise_pma(const c8* input_filename, const c8* output_filename);
+        void optimise_pma(const c8* input_filename, const c8* output_filename,
+                          const anim_compression_params& params = anim_compression_params());
+
+        // compresses an anim loaded from an uncompressed pma, returns false if the anim has no source channels
+        bool compress_animation(const animation_resource& anim, compressed_anim& out,
+                                const anim_compression_params& params = anim_compression_params());
+        void release_compressed_animation(compressed_anim& clip);
+
+        // decodes a key of track into out, 3 floats for translate and scale, quaternion xyzw for rotate
+        void decode_anim_key(const anim_track& track, u32 track_index, const u16* key, f32* out);
+
+        // max component error for translate and scale, angle in radians between rotations
+        f32 anim_key_error(u32 track_index, const f32* a, const f32* b);
 
         void instantiate_rigid_body(ecs_scene* scene, u32 entity_index);
         void instantiate_compound_rigid_body(ecs_scene* scene, u32 parent, u32* children, u32 num_children);
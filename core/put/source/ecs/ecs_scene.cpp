@@ -2,6 +2,7 @@
 // Copyright 2014 - 2023 Alex Dixon.
 // License: https://github.com/polymonster/pmtech/blob/master/license.md
 
+#include <algorithm>
 #include <fstream>
 #include <functional>
 
@@ -119,8 +120,15 @@ namespace put
                 PEN_ASSERT(0);
         }
 
+        void wait_for_scene_jobs(ecs_scene* scene)
+        {
+            pen::jobs_wait_for_counter(&scene->cull_counter);
+        }
+
         void resize_scene_buffers(ecs_scene* scene, s32 size)
         {
+            wait_for_scene_jobs(scene);
+
             u32 new_size = scene->soa_size + size;
 
             for (u32 i = 0; i < scene->num_components; ++i)
@@ -177,6 +185,8 @@ namespace put
 
         void zero_entity_components(ecs_scene* scene, u32 node_index)
         {
+            wait_for_scene_jobs(scene);
+
             for (u32 i = 0; i < scene->num_components; ++i)
             {
                 generic_cmp_array& cmp = scene->get_component_array(i);
@@ -196,11 +206,6 @@ namespace put
 
             if (is_valid(scene->cbuffer[node_index]))
                 pen::renderer_release_buffer(scene->cbuffer[node_index]);
-                
-            // delete skinng buffers, sub_geomtry share their parents
-            if(!(scene->entities[node_index] & e_cmp::sub_geometry))
-                if (is_valid_non_null(scene->bone_cbuffer[node_index]))
-                    pen::renderer_release_buffer(scene->cbuffer[node_index]);
 
             // zero
             zero_entity_components(scene, node_index);
@@ -208,6 +213,8 @@ namespace put
 
         void delete_entity_first_pass(ecs_scene* scene, u32 node_index)
         {
+            wait_for_scene_jobs(scene);
+
             // constraints must be freed or removed before we delete rigidbodies using them
             if (is_valid(scene->physics_handles[node_index]) && (scene->entities[node_index] & e_cmp::constraint))
                 physics::release_entity(scene->physics_handles[node_index]);
@@ -239,6 +246,8 @@ namespace put
 
         void clear_scene(ecs_scene* scene)
         {
+            wait_for_scene_jobs(scene);
+
             free_scene_buffers(scene);
             resize_scene_buffers(scene);
         }
@@ -256,6 +265,8 @@ namespace put
 
         void swap_entities(ecs_scene* scene, u32 a, s32 b)
         {
+            wait_for_scene_jobs(scene);
+
             u32 temp = get_new_entity(scene);
             entity_cpy(scene, temp, a);
             entity_cpy(scene, a, b);
@@ -274,11 +285,51 @@ namespace put
                     scene->parents[i] = a;
             }
 
+            scene->flags |= e_scene_flags::invalidate_hierarchy;
+
             zero_entity_components(scene, temp);
         }
 
+        template <typename T>
+        T* sb_clone(const T* src)
+        {
+            T*  dst = nullptr;
+            u32 count = sb_count(src);
+            if (count)
+                memcpy(sb_add(dst, count), src, count * sizeof(T));
+            return dst;
+        }
+
+        // the memcpy of components shares the controllers stretchy buffers with the source entity, they are written
+        // to while animating in parallel so the clone must own its instances and joint data
+        void clone_anim_controller(cmp_anim_controller_v2& controller)
+        {
+            controller.anim_instances = sb_clone(controller.anim_instances);
+            controller.anim_instance_handles = sb_clone(controller.anim_instance_handles);
+            controller.anim_instance_ids = sb_clone(controller.anim_instance_ids);
+            controller.joint_indices = sb_clone(controller.joint_indices);
+            controller.joint_flags = sb_clone(controller.joint_flags);
+            controller.joint_depths = sb_clone(controller.joint_depths);
+
+            u32 num_instances = sb_count(controller.anim_instances);
+            for (u32 i = 0; i < num_instances; ++i)
+            {
+                anim_instance& instance = controller.anim_instances[i];
+                instance.targets = sb_clone(instance.targets);
+                instance.joints = sb_clone(instance.joints);
+                instance.samplers = sb_clone(instance.samplers);
+            }
+
+            // the lod pose is re-evaluated on the next update
+            controller.lod.pose[0] = nullptr;
+            controller.lod.pose[1] = nullptr;
+            controller.lod.pose_valid = false;
+        }
+
         u32 clone_entity(ecs_scene* scene, u32 src, s32 dst, s32 parent, clone_mode mode, vec3f offset, const c8* suffix)
         {
+            wait_for_scene_jobs(scene);
+
             if (dst == -1)
             {
                 dst = get_new_entity(scene);
@@ -324,6 +375,9 @@ namespace put
             vec3f translation = p_sn->local_matrices[dst].get_translation();
             p_sn->local_matrices[dst].set_translation(translation + offset);
 
+            if (mode != e_clone_mode::move && (p_sn->entities[dst] & e_cmp::anim_controller))
+                clone_anim_controller(p_sn->anim_controller_v2[dst]);
+
             if (mode == e_clone_mode::instantiate)
             {
                 // todo, clone / instantiate constraint
@@ -351,6 +405,8 @@ namespace put
 
         void init()
         {
+            simd_init();
+
             // create view renderers
             put::scene_view_renderer svr_main;
             svr_main.name = "ecs_render_scene";
@@ -451,10 +507,53 @@ namespace put
             return new_instance.scene;
         }
 
+        void free_visibility(std::vector<view_visibility>& list)
+        {
+            for (auto& vis : list)
+            {
+                for (u32 c = 0; c < sb_count(vis.chunks); ++c)
+                    sb_free(vis.chunks[c]);
+
+                sb_free(vis.chunks);
+                sb_free(vis.entities);
+            }
+
+            list.clear();
+        }
+
         void destroy_scene(ecs_scene* scene)
         {
+            wait_for_scene_jobs(scene);
+
             free_scene_buffers(scene);
 
+            sb_free(scene->hierarchy_levels);
+            sb_free(scene->hierarchy_level_offsets);
+            sb_free(scene->draw_call_caches);
+            scene->hierarchy_levels = nullptr;
+            scene->hierarchy_level_offsets = nullptr;
+            scene->draw_call_caches = nullptr;
+
+            free_visibility(scene->shadow_visibility);
+            free_visibility(scene->omni_shadow_visibility);
+            free_visibility(scene->camera_visibility);
+            sb_free(scene->cull_tasks);
+            scene->cull_tasks = nullptr;
+            bvh_clear(scene->bvh);
+
+            if (is_valid(scene->auto_instance_buffer))
+                pen::renderer_release_buffer(scene->auto_instance_buffer);
+            scene->auto_instance_buffer = PEN_INVALID_HANDLE;
+            scene->auto_instance_capacity = 0;
+            scene->auto_instance_offset = 0;
+
+            if (is_valid(scene->bone_palette_buffer))
+                pen::renderer_release_buffer(scene->bone_palette_buffer);
+            scene->bone_palette_buffer = PEN_INVALID_HANDLE;
+            scene->bone_palette_capacity = 0;
+            sb_free(scene->bone_palette);
+            scene->bone_palette = nullptr;
+
             // todo release resource refs
             // geom
             // anim
@@ -570,6 +669,175 @@ namespace put
             }
         }
 
+        void render_scene_entities(const scene_view& view, const u32* entities, u32 num_entities);
+
+        // main views split the bvh into this many subtrees and cull them across workers
+        static const u32 k_max_cull_subtrees = 32;
+
+        struct cull_subtree_job
+        {
+            view_visibility* vis;
+            const s32*       roots;
+        };
+
+        void remove_hidden(const ecs_scene* scene, u32* entities)
+        {
+            u32 count = sb_count(entities);
+            u32 visible = 0;
+            for (u32 i = 0; i < count; ++i)
+                if (!(scene->state_flags[entities[i]] & e_state::hidden))
+                    entities[visible++] = entities[i];
+
+            if (entities)
+                stb__sbn(entities) = visible;
+        }
+
+        void cull_view(void* user_data)
+        {
+            view_visibility* vis = (view_visibility*)user_data;
+
+            if (vis->entities)
+                stb__sbn(vis->entities) = 0;
+
+            bvh_query_frustum(vis->scene, &vis->cam, &vis->entities);
+            remove_hidden(vis->scene, vis->entities);
+        }
+
+        void cull_subtrees(u32 start, u32 end, void* user_data)
+        {
+            cull_subtree_job* job = (cull_subtree_job*)user_data;
+            view_visibility*  vis = job->vis;
+
+            for (u32 i = start; i < end; ++i)
+            {
+                bvh_query_frustum(vis->scene, vis->key, &vis->chunks[i], job->roots[i]);
+                remove_hidden(vis->scene, vis->chunks[i]);
+            }
+        }
+
+        view_visibility& get_visibility(ecs_scene* scene, std::vector<view_visibility>& list, u32 index)
+        {
+            if (index >= list.size())
+                list.resize(index + 1);
+
+            list[index].scene = scene;
+            return list[index];
+        }
+
+        void cull_scene_views(ecs_scene* scene)
+        {
+            // shadow cameras only depend on the scene so they can be culled before rendering
+            u32 num_shadows = 0;
+            u32 num_omni = 0;
+            for (u32 n = 0; n < scene->num_entities; ++n)
+            {
+                if (!(scene->entities[n] & e_cmp::light))
+                    continue;
+
+                if (scene->lights[n].flags & (e_light_flags::shadow_map | e_light_flags::global_illumination))
+                {
+                    view_visibility& vis = get_visibility(scene, scene->shadow_visibility, num_shadows++);
+                    vis.entity = n;
+                    shadow_camera_from_entity(vis.cam, scene, n);
+                }
+
+                if (scene->lights[n].flags & e_light_flags::omni_shadow_map)
+                {
+                    for (u32 f = 0; f < 6; ++f)
+                    {
+                        view_visibility& vis = get_visibility(scene, scene->omni_shadow_visibility, num_omni++);
+                        vis.entity = n;
+                        vis.cam.pos = scene->transforms[n].translation;
+                        put::camera_create_cubemap(&vis.cam, 0.1f, scene->lights[n].radius * 2.0f);
+                        put::camera_set_cubemap_face(&vis.cam, f);
+                        put::camera_update_frustum(&vis.cam);
+                    }
+                }
+            }
+
+            scene->num_shadow_visibility = num_shadows;
+            scene->num_omni_shadow_visibility = num_omni;
+
+            // one task per view, render_shadow_views waits on the counter
+            if (scene->cull_tasks)
+                stb__sbn(scene->cull_tasks) = 0;
+
+            pen::task t;
+            t.func = cull_view;
+            for (u32 i = 0; i < num_shadows; ++i)
+            {
+                t.user_data = &scene->shadow_visibility[i];
+                sb_push(scene->cull_tasks, t);
+            }
+
+            for (u32 i = 0; i < num_omni; ++i)
+            {
+                t.user_data = &scene->omni_shadow_visibility[i];
+                sb_push(scene->cull_tasks, t);
+            }
+
+            pen::jobs_run_tasks(scene->cull_tasks, sb_count(scene->cull_tasks), &scene->cull_counter);
+        }
+
+        const view_visibility* get_shadow_visibility(ecs_scene* scene, const std::vector<view_visibility>& list, u32 count,
+                                                     u32 index, u32 light)
+        {
+            pen::jobs_wait_for_counter(&scene->cull_counter);
+
+            // lights may have changed since update_scene, in which case the view is culled on demand
+            if (index >= count || list[index].entity != light)
+                return nullptr;
+
+            return &list[index];
+        }
+
+        view_visibility& cull_camera_view(ecs_scene* scene, camera* cam)
+        {
+            view_visibility* vis = nullptr;
+            for (auto& cv : scene->camera_visibility)
+            {
+                if (cv.key == cam)
+                {
+                    vis = &cv;
+                    break;
+                }
+            }
+
+            if (!vis)
+            {
+                vis = &get_visibility(scene, scene->camera_visibility, (u32)scene->camera_visibility.size());
+                vis->key = cam;
+            }
+
+            // one chunk list per subtree, reset rather than freed so they do not reallocate
+            s32 roots[k_max_cull_subtrees];
+            u32 num_roots = bvh_subtrees(scene->bvh, roots, k_max_cull_subtrees);
+            while (sb_count(vis->chunks) < num_roots)
+                sb_push(vis->chunks, nullptr);
+
+            for (u32 c = 0; c < num_roots; ++c)
+                if (vis->chunks[c])
+                    stb__sbn(vis->chunks[c]) = 0;
+
+            cull_subtree_job job;
+            job.vis = vis;
+            job.roots = roots;
+            pen::parallel_for(num_roots, 1, cull_subtrees, &job);
+
+            // gather chunks in subtree order so the result is deterministic
+            if (vis->entities)
+                stb__sbn(vis->entities) = 0;
+
+            for (u32 c = 0; c < num_roots; ++c)
+            {
+                u32 cc = sb_count(vis->chunks[c]);
+                if (cc)
+                    memcpy(sb_add(vis->entities, cc), vis->chunks[c], cc * sizeof(u32));
+            }
+
+            return *vis;
+        }
+
         void render_shadow_views(const scene_view& view)
         {
             ecs_scene* scene = view.scene;
@@ -600,9 +868,15 @@ namespace put
                 if (shadow_index++ != view.array_index)
                     continue;
 
-                // create a shadow camera
+                // shadow camera and visible entities were prepared at the end of update_scene
+                const view_visibility* vis = get_shadow_visibility(scene, scene->shadow_visibility,
+                                                                   scene->num_shadow_visibility, shadow_index - 1, n);
+
                 camera cam;
-                shadow_camera_from_entity(cam, scene, n);
+                if (vis)
+                    cam = vis->cam;
+                else
+                    shadow_camera_from_entity(cam, scene, n);
 
                 // update view and camera
                 scene_view vv = view;
@@ -651,7 +925,10 @@ namespace put
                     pen::renderer_set_constant_buffer(cb_light, 10, pen::CBUFFER_BIND_PS);
                 }
 
-                render_scene_view(vv);
+                if (vis)
+                    render_scene_entities(vv, vis->entities, sb_count(vis->entities));
+                else
+                    render_scene_view(vv);
             }
 
             // update cbuffer
@@ -696,6 +973,10 @@ namespace put
                 if (omni_light_index++ != target_omni_light_index)
                     continue;
 
+                const view_visibility* vis =
+                    get_shadow_visibility(scene, scene->omni_shadow_visibility, scene->num_omni_shadow_visibility,
+                                          target_omni_light_index * 6 + array_face, n);
+
                 cam_omni_shadow.pos = scene->transforms[n].translation;
                 put::camera_create_cubemap(&cam_omni_shadow, 0.1f, scene->lights[n].radius * 2.0f);
                 put::camera_set_cubemap_face(&cam_omni_shadow, array_face);
@@ -710,7 +991,10 @@ namespace put
                 vv.camera = &cam_omni_shadow;
                 vv.cb_view = cam_omni_shadow.cbuffer;
 
-                render_scene_view(vv);
+                if (vis)
+                    render_scene_entities(vv, vis->entities, sb_count(vis->entities));
+                else
+                    render_scene_view(vv);
             }
         }
 
@@ -898,10 +1182,271 @@ namespace put
             pen::renderer_set_texture(0, 0, 2, pen::TEXTURE_BIND_CS);
         }
 
-        void render_scene_view(const scene_view& view)
+        struct draw_key
         {
-            // PEN_PERF_SCOPE_PRINT(render_scene_view);
+            u64 key;
+            u32 entity;
+        };
+
+        // lsd radix sort 8 bits at a time, passes where every key has the same digit are skipped so keys that only use
+        // a few bits sort in a few passes. result is written back into keys, tmp must be at least count in size.
+        void radix_sort_draw_keys(draw_key* keys, draw_key* tmp, u32 count)
+        {
+            if (count < 2)
+                return;
+
+            u32 histogram[8][256] = {{0}};
+            for (u32 i = 0; i < count; ++i)
+                for (u32 p = 0; p < 8; ++p)
+                    histogram[p][(keys[i].key >> (p * 8)) & 0xff]++;
+
+            draw_key* src = keys;
+            draw_key* dst = tmp;
+            for (u32 p = 0; p < 8; ++p)
+            {
+                u32* h = histogram[p];
+                if (h[(src[0].key >> (p * 8)) & 0xff] == count)
+                    continue;
+
+                u32 offset = 0;
+                for (u32 d = 0; d < 256; ++d)
+                {
+                    u32 c = h[d];
+                    h[d] = offset;
+                    offset += c;
+                }
+
+                for (u32 i = 0; i < count; ++i)
+                    dst[h[(src[i].key >> (p * 8)) & 0xff]++] = src[i];
+
+                std::swap(src, dst);
+            }
+
+            if (src != keys)
+                memcpy(keys, src, count * sizeof(draw_key));
+        }
+
+        // keys pack pipeline state (shader, technique, permutation), material id, vertex / index buffer and view depth.
+        // fields are truncated to fit so unrelated state may collide, which only costs a redundant bind because the
+        // submission loop still tracks the real state.
+        // opaque:        | shader 8 | technique 6 | permutation 10 | material 12 | vb / ib 12 | depth 16 | front to back
+        // alpha_blended: | inverse depth 16 | shader 8 | technique 6 | permutation 10 | material 12 | vb / ib 12 | back to front
+        void build_draw_keys(const scene_view& view, const u32* entities, u32 num_entities, draw_key* keys_out)
+        {
+            ecs_scene* scene = view.scene;
+            bool       alpha_blended = view.render_flags & pmfx::e_scene_render_flags::alpha_blended;
+            bool       shadow_map = view.render_flags & pmfx::e_scene_render_flags::shadow_map;
+
+            // view space depth along the camera forward (-z) normalised to the far plane
+            vec4f z_row = vec4f::zero();
+            f32   inv_far = 0.0f;
+            if (view.camera)
+            {
+                z_row = view.camera->view.get_row(2);
+                inv_far = view.camera->far_plane > 0.0f ? 1.0f / view.camera->far_plane : 0.0f;
+            }
+
+            for (u32 i = 0; i < num_entities; ++i)
+            {
+                u32 n = entities[i];
+
+                const cmp_geometry* p_geom = &scene->geometries[n];
+                if (!(scene->entities[n] & e_cmp::skinned))
+                    if (shadow_map)
+                        p_geom = &scene->position_geometries[n];
+
+                const cmp_material& mat = scene->materials[n];
+                u32                 shader = mat.shader;
+                u32                 technique = mat.technique_index;
+                if (is_valid(view.pmfx_shader))
+                {
+                    // per pass shader, only the permutation changes per entity
+                    shader = view.pmfx_shader;
+                    technique = 0;
+                }
+
+                u64 state = (u64)(shader & 0xff) << 28;
+                state |= (u64)(technique & 0x3f) << 22;
+                state |= (u64)(scene->material_permutation[n] & 0x3ff) << 12;
+                state |= (u64)(scene->id_material[n] & 0xfff);
+
+                u64 buffers = (u64)(((p_geom->vertex_buffer & 0x3f) << 6) | (p_geom->index_buffer & 0x3f));
+
+                vec3f pos = scene->pos_extent[n].pos.xyz;
+                f32   z = -(dot((vec3f)z_row.xyz, pos) + z_row.w) * inv_far;
+                u64   depth = (u64)(std::min(std::max(z, 0.0f), 1.0f) * 65535.0f);
+
+                u64 key;
+                if (alpha_blended)
+                    key = ((0xffff - depth) << 48) | (state << 12) | buffers;
+                else
+                    key = (state << 28) | (buffers << 16) | depth;
+
+                keys_out[i].key = key;
+                keys_out[i].entity = n;
+            }
+        }
+
+        struct instance_batch
+        {
+            u32 start;     // index into the sorted draw keys
+            u32 count;     // number of entities drawn by the batch
+            u32 technique; // instanced technique index for the batch
+        };
+
+        bool can_auto_instance(ecs_scene* scene, u32 n)
+        {
+            static const u64 k_exclude = e_cmp::skinned | e_cmp::master_instance | e_cmp::sub_instance;
+            return !(scene->entities[n] & k_exclude) && is_valid(scene->materials[n].shader);
+        }
+
+        bool same_auto_instance(const scene_view& view, u32 a, u32 b)
+        {
+            ecs_scene* scene = view.scene;
+
+            if (scene->id_geometry[a] != scene->id_geometry[b] || scene->id_material[a] != scene->id_material[b])
+                return false;
+
+            if (scene->material_permutation[a] != scene->material_permutation[b])
+                return false;
+
+            const cmp_material& ma = scene->materials[a];
+            const cmp_material& mb = scene->materials[b];
+            if (!is_valid(view.pmfx_shader))
+                if (ma.shader != mb.shader || ma.technique_index != mb.technique_index)
+                    return false;
+
+            // the batch binds the heads material cbuffer and textures, so their contents must match
+            if (is_valid(ma.material_cbuffer) != is_valid(mb.material_cbuffer))
+                return false;
+
+            if (is_valid(ma.material_cbuffer))
+            {
+                if (ma.material_cbuffer_size != mb.material_cbuffer_size)
+                    return false;
+
+                if (scene->draw_call_caches[a].material_hash != scene->draw_call_caches[b].material_hash)
+                    return false;
+            }
+
+            if (memcmp(&scene->samplers[a], &scene->samplers[b], sizeof(cmp_samplers)) != 0)
+                return false;
+
+            // shadow passes draw from position only geometry
+            bool                shadow_map = view.render_flags & pmfx::e_scene_render_flags::shadow_map;
+            const cmp_geometry& ga = shadow_map ? scene->position_geometries[a] : scene->geometries[a];
+            const cmp_geometry& gb = shadow_map ? scene->position_geometries[b] : scene->geometries[b];
+            return ga.vertex_buffer == gb.vertex_buffer && ga.index_buffer == gb.index_buffer;
+        }
+
+        // returns the instanced permutation of the technique entity n would draw with, or invalid if the shader has none
+        u32 auto_instance_technique(const scene_view& view, u32 n)
+        {
+            ecs_scene* scene = view.scene;
+            u32        permutation = scene->material_permutation[n];
+
+            u32     shader = view.pmfx_shader;
+            hash_id id_technique = view.id_technique;
+            if (!is_valid(shader))
+            {
+                shader = scene->materials[n].shader;
+                id_technique = scene->material_resources[n].id_technique;
+            }
+
+            // techniques without an instanced option mask the flag away and return the non instanced technique.
+            // batching is skipped while the instanced permutation is pending async compile
+            u32 single = pmfx::get_loaded_technique_index_perm(shader, id_technique, permutation);
+            u32 instanced =
+                pmfx::get_loaded_technique_index_perm(shader, id_technique, permutation | e_shader_permutation::instanced);
+            if (!is_valid(instanced) || instanced == single)
+                return PEN_INVALID_HANDLE;
+
+            return instanced;
+        }
+
+        // finds contiguous runs of instanceable entities in the sorted keys and copies their draw call data into the scenes
+        // instance buffer, runs are only formed from neighbours so the sorted order (and blending order) is preserved.
+        // the first instance of the views region of the buffer is written to instance_base_out
+        u32 build_instance_batches(const scene_view& view, const draw_key* keys, u32 num_keys, instance_batch** batches_out,
+                                   u32& instance_base_out)
+        {
+            ecs_scene* scene = view.scene;
+            if (scene->auto_instance_min_batch == 0)
+                return 0;
+
+            static cmp_draw_call* instance_data = nullptr;
+            if (instance_data)
+                stb__sbn(instance_data) = 0;
+
+            u32 min_batch = std::max<u32>(scene->auto_instance_min_batch, 2);
+
+            for (u32 i = 0; i < num_keys;)
+            {
+                u32 head = keys[i].entity;
+                u32 end = i + 1;
+
+                if (can_auto_instance(scene, head))
+                    while (end < num_keys && can_auto_instance(scene, keys[end].entity) &&
+                           same_auto_instance(view, head, keys[end].entity))
+                        ++end;
+
+                u32 count = end - i;
+                if (count >= min_batch)
+                {
+                    u32 technique = auto_instance_technique(view, head);
+                    if (is_valid(technique))
+                    {
+                        instance_batch b;
+                        b.start = i;
+                        b.count = count;
+                        b.technique = technique;
+                        sb_push(*batches_out, b);
+
+                        cmp_draw_call* dst = sb_add(instance_data, count);
+                        for (u32 j = 0; j < count; ++j)
+                            dst[j] = scene->draw_call_data[keys[i + j].entity];
+                    }
+                }
+
+                i = end;
+            }
+
+            u32 num_instances = sb_count(instance_data);
+            if (num_instances == 0)
+                return 0;
+
+            // grow the buffer, releases are queued behind any draws from earlier views this frame
+            u32 required = scene->auto_instance_offset + num_instances;
+            if (required > scene->auto_instance_capacity)
+            {
+                if (is_valid(scene->auto_instance_buffer))
+                    pen::renderer_release_buffer(scene->auto_instance_buffer);
+
+                scene->auto_instance_capacity = std::max<u32>(required, scene->auto_instance_capacity * 2);
+
+                pen::buffer_creation_params bcp;
+                bcp.usage_flags = PEN_USAGE_DYNAMIC;
+                bcp.bind_flags = PEN_BIND_VERTEX_BUFFER;
+                bcp.buffer_size = sizeof(cmp_draw_call) * scene->auto_instance_capacity;
+                bcp.data = nullptr;
+                bcp.cpu_access_flags = PEN_CPU_ACCESS_WRITE;
+
+                scene->auto_instance_buffer = pen::renderer_create_buffer(bcp);
+            }
+
+            // views write disjoint regions, backends which keep a single copy of large buffers per frame do not
+            // preserve earlier writes to the same range within a frame
+            instance_base_out = scene->auto_instance_offset;
+            pen::renderer_update_buffer(scene->auto_instance_buffer, instance_data, num_instances * sizeof(cmp_draw_call),
+                                        instance_base_out * sizeof(cmp_draw_call));
+
+            scene->auto_instance_offset = required;
+
+            return sb_count(*batches_out);
+        }
 
+        void render_scene_entities(const scene_view& view, const u32* entities, u32 num_entities)
+        {
             ecs_scene* scene = view.scene;
             if (scene->view_flags & e_scene_view_flags::hide)
                 return;
@@ -953,25 +1498,44 @@ namespace put
             static u32     blue_noise = put::load_texture("data/textures/noise/blue_noise_ldr_rgba_0.dds");
             pen::renderer_set_texture(blue_noise, wrap_point, 5, pen::TEXTURE_BIND_PS);
 
-            // filter and cull
-            u32* filtered_entities = nullptr;
-            u32* culled_entities = nullptr;
-            filter_entities_scalar(scene, &filtered_entities);
-            frustum_cull_aabb_scalar(scene, view.camera, filtered_entities, &culled_entities);
-            
             // track to prevent redundant state changes.
             u32 cur_shader = -1;
             u32 cur_technique = -1;
             u32 cur_permutation = -1;
             u32 cur_vb = -1;
             u32 cur_ib = -1;
-            u32 vc = sb_count(culled_entities);
-            
+
+            // sort by draw key to minimise state changes and order depth for the pass
+            static draw_key* keys = nullptr;
+            static draw_key* keys_tmp = nullptr;
+            if (sb_count(keys) < num_entities)
+            {
+                u32 grow = num_entities - sb_count(keys);
+                sb_add(keys, grow);
+                sb_add(keys_tmp, grow);
+            }
+
+            build_draw_keys(view, entities, num_entities, keys);
+            radix_sort_draw_keys(keys, keys_tmp, num_entities);
+
+            // collapse runs of matching entities into instanced draws
+            static instance_batch* batches = nullptr;
+            if (batches)
+                stb__sbn(batches) = 0;
+
+            u32 instance_offset = 0;
+            u32 num_batches = build_instance_batches(view, keys, num_entities, &batches, instance_offset);
+            u32 batch = 0;
+
             // render
-            for (u32 i = 0; i < vc; ++i)
+            for (u32 i = 0; i < num_entities; ++i)
             {
-                u32 n = culled_entities[i];
-                
+                u32 n = keys[i].entity;
+
+                const instance_batch* p_batch = nullptr;
+                if (batch < num_batches && batches[batch].start == i)
+                    p_batch = &batches[batch++];
+
                 // skip 0 instance buffers
                 if (scene->entities[n] & e_cmp::master_instance)
                     if(scene->master_instances[n].num_instances == 0)
@@ -985,8 +1549,17 @@ namespace put
                 cmp_material* p_mat = &scene->materials[n];
                 u32           permutation = scene->material_permutation[n];
 
-                // set shader / technique only if we need to change
-                if (p_mat->shader != cur_shader || p_mat->technique_index != cur_technique || permutation != cur_permutation)
+                if (p_batch)
+                {
+                    // instanced permutation, invalidate tracking so the next single draw rebinds
+                    pmfx::set_technique(is_valid(view.pmfx_shader) ? view.pmfx_shader : p_mat->shader, p_batch->technique);
+                    cur_shader = -1;
+                    cur_technique = -1;
+                    cur_permutation = -1;
+                    cur_vb = -1;
+                    cur_ib = -1;
+                }
+                else if (p_mat->shader != cur_shader || p_mat->technique_index != cur_technique || permutation != cur_permutation)
                 {
                     if (!is_valid(view.pmfx_shader))
                     {
@@ -1010,10 +1583,11 @@ namespace put
                     cur_ib = -1;
                 }
 
-                // bind skinning
+                // bind skinning, the offset of the entities bones is in the draw call
                 if (scene->entities[n] & e_cmp::skinned)
                 {
-                    pen::renderer_set_constant_buffer(scene->bone_cbuffer[n], 2, pen::CBUFFER_BIND_VS);
+                    pen::renderer_set_structured_buffer(scene->bone_palette_buffer, e_global_textures::bone_palette,
+                                                        pen::SBUFFER_BIND_VS | pen::SBUFFER_BIND_READ);
                 }
 
                 // set material cbs
@@ -1041,7 +1615,16 @@ namespace put
                 }
 
                 // set vertex buffer
-                if (scene->entities[n] & e_cmp::master_instance)
+                if (p_batch)
+                {
+                    u32 vbs[2] = {p_geom->vertex_buffer, scene->auto_instance_buffer};
+                    u32 strides[2] = {p_geom->vertex_size, sizeof(cmp_draw_call)};
+                    u32 offsets[2] = {0, instance_offset * (u32)sizeof(cmp_draw_call)};
+
+                    pen::renderer_set_vertex_buffers(vbs, 2, 0, strides, offsets);
+                    cur_vb = vbs[0];
+                }
+                else if (scene->entities[n] & e_cmp::master_instance)
                 {
                     u32 vbs[2] = {p_geom->vertex_buffer, scene->master_instances[n].instance_buffer};
                     u32 strides[2] = {p_geom->vertex_size, scene->master_instances[n].instance_stride};
@@ -1066,6 +1649,15 @@ namespace put
                     cur_ib = p_geom->index_buffer;
                 }
 
+                // auto instances, step over the rest of the batch
+                if (p_batch)
+                {
+                    pen::renderer_draw_indexed_instanced(p_batch->count, 0, p_geom->num_indices, 0, 0, PEN_PT_TRIANGLELIST);
+                    instance_offset += p_batch->count;
+                    i += p_batch->count - 1;
+                    continue;
+                }
+
                 // instances
                 if (scene->entities[n] & e_cmp::master_instance)
                 {
@@ -1081,299 +1673,1168 @@ namespace put
                 // single
                 pen::renderer_draw_indexed(p_geom->num_indices, 0, 0, PEN_PT_TRIANGLELIST);
             }
+        }
 
-            if (filtered_entities)
-            {
-                sb_free(filtered_entities);
-            }
+        void render_scene_view(const scene_view& view)
+        {
+            // PEN_PERF_SCOPE_PRINT(render_scene_view);
+
+            ecs_scene* scene = view.scene;
+            if (scene->view_flags & e_scene_view_flags::hide)
+                return;
 
-            if (culled_entities)
+            // camera frustums are only final at render time, cull across workers into the views visibility list
+            if (view.camera)
             {
-                sb_free(culled_entities);
+                view_visibility& vis = cull_camera_view(scene, view.camera);
+                render_scene_entities(view, vis.entities, sb_count(vis.entities));
+                return;
             }
+
+            // no camera to cull with
+            static u32* filtered_entities = nullptr;
+            if (filtered_entities)
+                stb__sbn(filtered_entities) = 0;
+
+            filter_entities_scalar(scene, &filtered_entities);
+            render_scene_entities(view, filtered_entities, sb_count(filtered_entities));
         }
 
-        void update_animations(ecs_scene* scene, f32 dt)
-        {
-            for (u32 n = 0; n < scene->num_entities; ++n)
-            {
-                if (!(scene->entities[n] & e_cmp::anim_controller))
-                    continue;
+        // controllers are evaluated in parallel, each worker gathers the blends of a controller into soa lanes
+        // which are evaluated 4 or 8 at a time by slerp_soa and lerp_soa
+        static const u32 k_anim_grain = 4;
+        static const u32 k_anim_linear_seek = 4;
+        static const f32 k_anim_lod_min_distance = 0.0001f;
 
-                cmp_anim_controller_v2 controller = scene->anim_controller_v2[n];
-                u32 root = ecs::get_index_from_ref(scene, controller.root_joint_ref);
-                
-                // rig may be scaled
-                u32 p = scene->parents[n];
-                vec3f parent_scale = scene->transforms[p].scale;
+        struct anim_batch
+        {
+            // quaternion lanes, components are stored the lane count apart
+            f32* qa = nullptr;
+            f32* qb = nullptr;
+            f32* qt = nullptr;
+            u32* q_joint = nullptr;
+            u32* q_flags = nullptr;
+
+            // float lanes, written back through l_dest
+            f32*  la = nullptr;
+            f32*  lb = nullptr;
+            f32*  lt = nullptr;
+            f32** l_dest = nullptr;
+        };
+        thread_local anim_batch t_anim_batch;
+
+        // root motion is applied to the controllers parent which other controllers may share, so it is deferred
+        struct anim_root_motion
+        {
+            quat  rotation;
+            vec3f translation;
+            u32   parent;
+            bool  valid;
+        };
+
+        struct anim_lod_result
+        {
+            u32  band;
+            u32  joints; // joints evaluated
+            bool evaluated;
+        };
+
+        struct anim_job
+        {
+            ecs_scene*             scene;
+            f32                    dt;
+            const u32*             controllers;
+            anim_root_motion*      root_motion;
+            anim_lod_result*       results;
+            const camera*          cam;
+            const anim_lod_params* params;
+        };
+
+        template <typename T>
+        void sb_reserve_count(T*& sb, u32 count)
+        {
+            u32 cur = sb_count(sb);
+            if (cur < count)
+                sb_add(sb, count - cur);
+        }
+
+        void anim_batch_reserve(anim_batch& batch, u32 num_quats, u32 num_lerps)
+        {
+            sb_reserve_count(batch.qa, num_quats * 4);
+            sb_reserve_count(batch.qb, num_quats * 4);
+            sb_reserve_count(batch.qt, num_quats);
+            sb_reserve_count(batch.q_joint, num_quats);
+            sb_reserve_count(batch.q_flags, num_quats);
+
+            sb_reserve_count(batch.la, num_lerps);
+            sb_reserve_count(batch.lb, num_lerps);
+            sb_reserve_count(batch.lt, num_lerps);
+            sb_reserve_count(batch.l_dest, num_lerps);
+        }
+
+        // returns the key before t in channel c, or an index outside the channel if t is before the first key or after
+        // the last. playback moves forward a key or two per frame so we step on from the cursor of the previous update
+        // and fall back to a binary search when time jumps or moves backwards.
+        u32 anim_seek_key(const soa_anim& soa, u32 c, u32 num_frames, u32 cursor, f32 t)
+        {
+            u32 k = cursor < num_frames ? cursor : 0;
+            u32 lo, hi;
+
+            if (t <= soa.info[k][c].time)
+            {
+                lo = 0;
+                hi = k;
+            }
+            else
+            {
+                u32 end = min(k + 1 + k_anim_linear_seek, num_frames);
+                for (++k; k < end; ++k)
+                    if (t <= soa.info[k][c].time)
+                        return k - 1;
+
+                lo = end;
+                hi = num_frames;
+            }
+
+            // first key at or after t, hi if there is none
+            while (lo < hi)
+            {
+                u32 mid = (lo + hi) / 2;
+                if (t <= soa.info[mid][c].time)
+                    hi = mid;
+                else
+                    lo = mid + 1;
+            }
+
+            return lo == num_frames ? num_frames : lo - 1;
+        }
+
+        // returns the key before t in a compressed track, clamped so the key after it is also in the track.
+        // t is in the normalised u16 time of the clip, seeks step on from the cursor like anim_seek_key
+        u32 anim_seek_compressed_key(const u16* times, u32 num_keys, u32 cursor, f32 t)
+        {
+            u32 last = num_keys - 2;
+            u32 k = min(cursor, last);
+            u32 lo, hi;
+
+            if (t < times[k])
+            {
+                lo = 0;
+                hi = k;
+            }
+            else
+            {
+                u32 end = min(k + k_anim_linear_seek, last);
+                for (; k < end; ++k)
+                    if (t < times[k + 1])
+                        return k;
+
+                if (end == last)
+                    return last;
+
+                lo = end + 1;
+                hi = num_keys;
+            }
+
+            // first key after t
+            while (lo < hi)
+            {
+                u32 mid = (lo + hi) / 2;
+                if (t < times[mid])
+                    hi = mid;
+                else
+                    lo = mid + 1;
+            }
+
+            return lo == 0 ? 0 : min(lo - 1, last);
+        }
+
+        // joints deeper than max_depth below the root joint are skipped by lower lod bands, 0 evaluates all joints
+        inline bool anim_joint_skipped(u32 joint, const u8* depths, u32 max_depth)
+        {
+            return max_depth && depths[joint] > max_depth;
+        }
 
-                u32 num_anims = sb_count(controller.anim_instances);
-                for (u32 ai = 0; ai < num_anims; ++ai)
+        void gather_soa_anim(anim_batch& batch, anim_instance& instance, f32 anim_t, bool looped, const u8* depths,
+                             u32 max_depth, u32& num_quats, u32& num_lerps)
+        {
+            soa_anim& soa = instance.soa;
+            u32       num_channels = soa.num_channels;
+
+            // find the frame we are on for each channel and count the blends
+            num_quats = 0;
+            num_lerps = 0;
+            for (u32 c = 0; c < num_channels; ++c)
+            {
+                anim_sampler& sampler = instance.samplers[c];
+                anim_channel& channel = soa.channels[c];
+
+                if (sampler.joint == PEN_INVALID_HANDLE || anim_joint_skipped(sampler.joint, depths, max_depth))
+                    continue;
+
+                sampler.pos = anim_seek_key(soa, c, channel.num_frames, sampler.pos, anim_t);
+
+                //reset flag
+                sampler.flags &= ~e_anim_flags::looped;
+
+                if (sampler.pos >= channel.num_frames || looped)
                 {
-                    anim_instance& instance = controller.anim_instances[ai];
+                    sampler.pos = 0;
+                    sampler.flags = e_anim_flags::looped;
+                }
 
-                    if (instance.flags & e_anim_flags::paused)
-                        continue;
+                u32 next = (sampler.pos + 1) % channel.num_frames;
 
-                    soa_anim& soa = instance.soa;
-                    u32       num_channels = soa.num_channels;
-                    f32       anim_t = instance.time;
+                f32 a = (anim_t - soa.info[sampler.pos][c].time);
+                f32 b = (soa.info[next][c].time - soa.info[sampler.pos][c].time);
 
-                    bool looped = false;
+                sampler.prev_t = sampler.cur_t;
+                sampler.cur_t = min(max(a / b, 0.0f), 1.0f);
 
-                    // roll on time
-                    instance.time += dt * controller.playback_rate;
-                    
-                    //
-                    if (instance.flags & e_anim_flags::clamp)
+                for (u32 e = 0; e < channel.element_count; ++e)
+                {
+                    if (channel.element_offset[e] == e_anim_output::quaternion)
                     {
-                        instance.time = min(instance.time, instance.length);
+                        ++num_quats;
+                        e += 3;
                     }
                     else
                     {
-                        if (instance.time >= instance.length)
+                        ++num_lerps;
+                    }
+                }
+            }
+
+            // gather anim data into lanes
+            anim_batch_reserve(batch, num_quats, num_lerps);
+
+            u32 qi = 0;
+            u32 li = 0;
+            for (u32 c = 0; c < num_channels; ++c)
+            {
+                anim_sampler& sampler = instance.samplers[c];
+                anim_channel& channel = soa.channels[c];
+
+                if (sampler.joint == PEN_INVALID_HANDLE || anim_joint_skipped(sampler.joint, depths, max_depth))
+                    continue;
+
+                u32 next = (sampler.pos + 1) % channel.num_frames;
+
+                f32* d1 = &soa.data[sampler.pos][soa.info[sampler.pos][c].offset];
+                f32* d2 = &soa.data[next][soa.info[next][c].offset];
+
+                for (u32 e = 0; e < channel.element_count; ++e)
+                {
+                    u32 eo = channel.element_offset[e];
+
+                    if (eo == e_anim_output::quaternion)
+                    {
+                        for (u32 k = 0; k < 4; ++k)
                         {
-                            instance.time = 0.0f;
-                            looped = true;
+                            batch.qa[k * num_quats + qi] = d1[e + k];
+                            batch.qb[k * num_quats + qi] = d2[e + k];
                         }
-                    }
 
-                    if (instance.flags & e_anim_flags::looped)
+                        batch.qt[qi] = sampler.cur_t;
+                        batch.q_joint[qi] = sampler.joint;
+                        batch.q_flags[qi] = channel.flags;
+                        ++qi;
+                        e += 3;
+                    }
+                    else
                     {
-                        instance.flags &= ~e_anim_flags::looped;
-                        looped = true;
+                        // translation / scale
+                        batch.la[li] = d1[e];
+                        batch.lb[li] = d2[e];
+                        batch.lt[li] = sampler.cur_t;
+                        batch.l_dest[li] = &instance.targets[sampler.joint].t[eo];
+                        ++li;
                     }
+                }
+            }
+        }
 
-                    u32 num_joints = sb_count(instance.joints);
+        // compressed tracks are decoded straight into the lanes, only the 2 keys either side of t are touched and the
+        // cursors walk forward through each track's contiguous keys during playback
+        void gather_compressed_anim(anim_batch& batch, anim_instance& instance, f32 anim_t, bool looped, const u8* depths,
+                                    u32 max_depth, u32& num_quats, u32& num_lerps)
+        {
+            const compressed_anim& clip = *instance.compressed;
+            u32                    num_channels = clip.num_channels;
+            f32                    kt = clip.length > 0.0f ? anim_t / clip.length * 65535.0f : 0.0f;
+
+            // count the blends
+            num_quats = 0;
+            num_lerps = 0;
+            for (u32 c = 0; c < num_channels; ++c)
+            {
+                u32 joint = instance.samplers[c].joint;
+                if (joint == PEN_INVALID_HANDLE || anim_joint_skipped(joint, depths, max_depth))
+                    continue;
 
-                    // reset rotations
-                    for (u32 j = 0; j < num_joints; ++j)
-                        instance.targets[j].q = quat(0.0f, 0.0f, 0.0f);
+                const compressed_anim_channel& channel = clip.channels[c];
 
-                    for (u32 c = 0; c < num_channels; ++c)
-                    {
-                        anim_sampler& sampler = instance.samplers[c];
-                        anim_channel& channel = soa.channels[c];
+                if (channel.tracks[e_anim_track::rotate].num_keys)
+                    ++num_quats;
 
-                        if (sampler.joint == PEN_INVALID_HANDLE)
-                            continue;
+                for (u32 tr = e_anim_track::translate; tr <= e_anim_track::scale; ++tr)
+                    if (channel.tracks[tr].num_keys)
+                        for (u32 i = 0; i < 3; ++i)
+                            if (channel.tracks[tr].mask & (1 << i))
+                                ++num_lerps;
+            }
+
+            anim_batch_reserve(batch, num_quats, num_lerps);
 
-                        // find the frame we are on..
-                        for (; sampler.pos < channel.num_frames; sampler.pos++)
-                            if (anim_t <= soa.info[sampler.pos][c].time)
-                            {
-                                sampler.pos -= 1;
-                                break;
-                            }
+            u32 qi = 0;
+            u32 li = 0;
+            for (u32 c = 0; c < num_channels; ++c)
+            {
+                anim_sampler& sampler = instance.samplers[c];
 
-                        //reset flag
-                        sampler.flags &= ~e_anim_flags::looped;
+                if (sampler.joint == PEN_INVALID_HANDLE || anim_joint_skipped(sampler.joint, depths, max_depth))
+                    continue;
 
-                        if (sampler.pos >= channel.num_frames || looped)
-                        {
-                            sampler.pos = 0;
-                            sampler.flags = e_anim_flags::looped;
-                        }
+                const compressed_anim_channel& channel = clip.channels[c];
 
-                        u32 next = (sampler.pos + 1) % channel.num_frames;
+                sampler.flags = looped ? e_anim_flags::looped : 0;
+                sampler.prev_t = sampler.cur_t;
 
-                        // get anim data
-                        anim_info& info1 = soa.info[sampler.pos][c];
-                        anim_info& info2 = soa.info[next][c];
+                for (u32 tr = 0; tr < e_anim_track::COUNT; ++tr)
+                {
+                    const anim_track& track = channel.tracks[tr];
+                    if (!track.num_keys)
+                        continue;
 
-                        f32* d1 = &soa.data[sampler.pos][info1.offset];
-                        f32* d2 = &soa.data[next][info2.offset];
+                    const u16* times = &clip.key_times[track.first_key];
+                    const u16* keys = &clip.key_data[track.first_key * 3];
 
-                        f32 a = (anim_t - info1.time);
-                        f32 b = (info2.time - info1.time);
+                    // constant tracks blend their single key with itself
+                    u32 k = 0;
+                    u32 next = 0;
+                    f32 t = 0.0f;
+                    if (track.num_keys > 1)
+                    {
+                        k = anim_seek_compressed_key(times, track.num_keys, sampler.key[tr], kt);
+                        next = k + 1;
 
-                        f32 it = min(max(a / b, 0.0f), 1.0f);
+                        f32 span = (f32)times[next] - (f32)times[k];
+                        t = span > 0.0f ? (kt - (f32)times[k]) / span : 0.0f;
 
-                        sampler.prev_t = sampler.cur_t;
-                        sampler.cur_t = it;
+                        // outside the keys of the track, flagged like the soa sampler for root motion
+                        if (t < 0.0f || t > 1.0f)
+                            sampler.flags |= e_anim_flags::looped;
 
-                        for (u32 e = 0; e < channel.element_count; ++e)
+                        t = min(max(t, 0.0f), 1.0f);
+                    }
+
+                    sampler.key[tr] = k;
+                    sampler.cur_t = t;
+
+                    f32 a[4], b[4];
+                    decode_anim_key(track, tr, &keys[k * 3], a);
+                    decode_anim_key(track, tr, &keys[next * 3], b);
+
+                    if (tr == e_anim_track::rotate)
+                    {
+                        for (u32 e = 0; e < 4; ++e)
                         {
-                            u32 eo = channel.element_offset[e];
-
-                            // slerp quats
-                            if (eo == e_anim_output::quaternion)
-                            {
-                                quat q1;
-                                quat q2;
-
-                                memcpy(&q1.v[0], &d1[e], 16);
-                                memcpy(&q2.v[0], &d2[e], 16);
-
-                                quat ql = slerp(q1, q2, it);
-
-                                instance.targets[sampler.joint].q = ql * instance.targets[sampler.joint].q;
-                                instance.targets[sampler.joint].flags |= channel.flags;
-                                e += 3;
-                            }
-                            else
-                            {
-                                // lerp translation / scale
-                                f32 lf = (1 - it) * d1[e] + it * d2[e];
-                                instance.targets[sampler.joint].t[eo] = lf;
-                            }
+                            batch.qa[e * num_quats + qi] = a[e];
+                            batch.qb[e * num_quats + qi] = b[e];
                         }
-                    }
 
-                    // bake anim target into a cmp transform for joint
-                    u32 tj = PEN_INVALID_HANDLE;
-                    for (u32 j = 0; j < num_joints; ++j)
+                        batch.qt[qi] = t;
+                        batch.q_joint[qi] = sampler.joint;
+                        batch.q_flags[qi] = channel.flags;
+                        ++qi;
+                    }
+                    else
                     {
-                        u32 jnode = controller.joint_indices[j] + root;
+                        u32 eo = tr == e_anim_track::translate ? e_anim_output::translate_x : e_anim_output::scale_x;
 
-                        if (scene->entities[jnode] & e_cmp::anim_trajectory)
+                        for (u32 i = 0; i < 3; ++i)
                         {
-                            tj = j;
-                            continue;
+                            if (!(track.mask & (1 << i)))
+                                continue;
+
+                            batch.la[li] = a[i];
+                            batch.lb[li] = b[i];
+                            batch.lt[li] = t;
+                            batch.l_dest[li] = &instance.targets[sampler.joint].t[eo + i];
+                            ++li;
                         }
+                    }
+                }
+            }
+        }
 
-                        f32* f = &instance.targets[j].t[0];
+        void sample_anim_instance(ecs_scene* scene, cmp_anim_controller_v2& controller, anim_instance& instance, u32 root,
+                                  const vec3f& parent_scale, f32 dt, u32 max_depth)
+        {
+            anim_batch& batch = t_anim_batch;
 
-                        instance.joints[j].translation = vec3f(f[e_anim_output::translate_x], f[e_anim_output::translate_y],
-                                                               f[e_anim_output::translate_z]);
+            f32 anim_t = instance.time;
 
-                        instance.joints[j].scale =
-                            vec3f(f[e_anim_output::scale_x], f[e_anim_output::scale_y], f[e_anim_output::scale_z]);
+            bool looped = false;
 
-                        if (instance.targets[j].flags & e_anim_flags::baked_quaternion)
-                            instance.joints[j].rotation = instance.targets[j].q;
-                        else
-                            instance.joints[j].rotation = scene->initial_transform[jnode].rotation * instance.targets[j].q;
-                    }
+            // roll on time
+            instance.time += dt * controller.playback_rate;
 
-                    // root motion.. todo rotation
-                    if (tj != PEN_INVALID_HANDLE)
-                    {
-                        f32*  f = &instance.targets[tj].t[0];
-                        vec3f tt = vec3f(f[0], f[1], f[2]) * parent_scale;
+            //
+            if (instance.flags & e_anim_flags::clamp)
+            {
+                instance.time = min(instance.time, instance.length);
+            }
+            else
+            {
+                if (instance.time >= instance.length)
+                {
+                    instance.time = 0.0f;
+                    looped = true;
+                }
+            }
 
-                        if (instance.samplers[0].flags & e_anim_flags::looped)
-                        {
-                            // inherit prev root motion
-                            instance.root_translation = tt;
-                        }
-                        else
-                        {
-                            instance.root_delta = tt - instance.root_translation;
-                            instance.root_translation = tt;
-                        }
+            if (instance.flags & e_anim_flags::looped)
+            {
+                instance.flags &= ~e_anim_flags::looped;
+                looped = true;
+            }
+
+            u32       num_joints = sb_count(instance.joints);
+            const u8* depths = controller.joint_depths;
+
+            // reset rotations, skipped joints keep their last pose
+            for (u32 j = 0; j < num_joints; ++j)
+                if (!anim_joint_skipped(j, depths, max_depth))
+                    instance.targets[j].q = quat(0.0f, 0.0f, 0.0f);
+
+            u32 num_quats = 0;
+            u32 num_lerps = 0;
+            if (instance.compressed)
+                gather_compressed_anim(batch, instance, anim_t, looped, depths, max_depth, num_quats, num_lerps);
+            else
+                gather_soa_anim(batch, instance, anim_t, looped, depths, max_depth, num_quats, num_lerps);
+
+            slerp_soa(batch.qa, batch.qb, batch.qt, batch.qa, num_quats, num_quats);
+            lerp_soa(batch.la, batch.lb, batch.lt, batch.la, num_lerps);
+
+            // scatter in channel order, rotations of multiple channels targeting a joint are concatenated
+            for (u32 i = 0; i < num_quats; ++i)
+            {
+                quat ql;
+                for (u32 k = 0; k < 4; ++k)
+                    ql.v[k] = batch.qa[k * num_quats + i];
+
+                anim_target& target = instance.targets[batch.q_joint[i]];
+                target.q = ql * target.q;
+                target.flags |= batch.q_flags[i];
+            }
+
+            for (u32 i = 0; i < num_lerps; ++i)
+                *batch.l_dest[i] = batch.la[i];
+
+            // bake anim target into a cmp transform for joint
+            u32 tj = PEN_INVALID_HANDLE;
+            for (u32 j = 0; j < num_joints; ++j)
+            {
+                u32 jnode = controller.joint_indices[j] + root;
+
+                if (scene->entities[jnode] & e_cmp::anim_trajectory)
+                {
+                    tj = j;
+                    continue;
+                }
+
+                if (anim_joint_skipped(j, depths, max_depth))
+                    continue;
+
+                f32* f = &instance.targets[j].t[0];
+
+                instance.joints[j].translation =
+                    vec3f(f[e_anim_output::translate_x], f[e_anim_output::translate_y], f[e_anim_output::translate_z]);
+
+                instance.joints[j].scale =
+                    vec3f(f[e_anim_output::scale_x], f[e_anim_output::scale_y], f[e_anim_output::scale_z]);
+
+                if (instance.targets[j].flags & e_anim_flags::baked_quaternion)
+                    instance.joints[j].rotation = instance.targets[j].q;
+                else
+                    instance.joints[j].rotation = scene->initial_transform[jnode].rotation * instance.targets[j].q;
+            }
+
+            // root motion.. todo rotation
+            if (tj != PEN_INVALID_HANDLE)
+            {
+                f32*  f = &instance.targets[tj].t[0];
+                vec3f tt = vec3f(f[0], f[1], f[2]) * parent_scale;
+
+                if (instance.samplers[0].flags & e_anim_flags::looped)
+                {
+                    // inherit prev root motion
+                    instance.root_translation = tt;
+                }
+                else
+                {
+                    instance.root_delta = tt - instance.root_translation;
+                    instance.root_translation = tt;
+                }
+            }
+        }
+
+        // blends the joints from pose a to b by t into the scene transforms, returns the number of joints written
+        u32 blend_joint_poses(ecs_scene* scene, const cmp_anim_controller_v2& controller, u32 root, const cmp_transform* a,
+                              const cmp_transform* b, f32 t, u32 max_depth, bool additive)
+        {
+            anim_batch& batch = t_anim_batch;
+
+            u32 num_joints = sb_count(controller.joint_indices);
+            anim_batch_reserve(batch, num_joints, num_joints * 6);
+
+            u32 qi = 0;
+            u32 li = 0;
+            for (u32 j = 0; j < num_joints; ++j)
+            {
+                u32 jnode = controller.joint_indices[j] + root;
+
+                if (scene->entities[jnode] & e_cmp::anim_trajectory)
+                    continue;
+
+                if (anim_joint_skipped(j, controller.joint_depths, max_depth))
+                    continue;
+
+                cmp_transform&       tc = scene->transforms[jnode];
+                const cmp_transform& ta = a[j];
+                const cmp_transform& tb = b[j];
+
+                for (u32 k = 0; k < 4; ++k)
+                {
+                    batch.qa[k * num_joints + qi] = ta.rotation.v[k];
+                    batch.qb[k * num_joints + qi] = tb.rotation.v[k];
+                }
+                batch.qt[qi] = t;
+                batch.q_joint[qi] = jnode;
+                ++qi;
+
+                for (u32 k = 0; k < 3; ++k)
+                {
+                    batch.la[li] = ta.translation[k];
+                    batch.lb[li] = tb.translation[k];
+                    batch.l_dest[li++] = &tc.translation[k];
+
+                    batch.la[li] = ta.scale[k];
+                    batch.lb[li] = tb.scale[k];
+                    batch.l_dest[li++] = &tc.scale[k];
+                }
+            }
+
+            for (u32 i = 0; i < li; ++i)
+                batch.lt[i] = t;
+
+            slerp_soa(batch.qa, batch.qb, batch.qt, batch.qa, qi, num_joints);
+            lerp_soa(batch.la, batch.lb, batch.lt, batch.la, li);
+
+            for (u32 i = 0; i < li; ++i)
+                *batch.l_dest[i] = batch.la[i];
+
+            for (u32 i = 0; i < qi; ++i)
+            {
+                u32            jnode = batch.q_joint[i];
+                cmp_transform& tc = scene->transforms[jnode];
+
+                for (u32 k = 0; k < 4; ++k)
+                    tc.rotation.v[k] = batch.qa[k * num_joints + i];
+
+                if (additive && (scene->entities[jnode] & e_cmp::additive_rotation))
+                {
+                    tc.rotation *= scene->additive_rotation[jnode];
+                }
+
+                scene->entities[jnode] |= e_cmp::transform;
+            }
+
+            return qi;
+        }
+
+        u32 update_anim_controller(ecs_scene* scene, u32 n, f32 dt, anim_root_motion& root_motion, u32 max_depth)
+        {
+            cmp_anim_controller_v2& controller = scene->anim_controller_v2[n];
+            u32                     root = ecs::get_index_from_ref(scene, controller.root_joint_ref);
+
+            // rig may be scaled
+            u32   p = scene->parents[n];
+            vec3f parent_scale = scene->transforms[p].scale;
+
+            root_motion.valid = false;
+            root_motion.parent = p;
+            root_motion.translation = vec3f::zero();
+
+            u32 num_anims = sb_count(controller.anim_instances);
+            for (u32 ai = 0; ai < num_anims; ++ai)
+            {
+                anim_instance& instance = controller.anim_instances[ai];
+
+                if (instance.flags & e_anim_flags::paused)
+                    continue;
+
+                sample_anim_instance(scene, controller, instance, root, parent_scale, dt, max_depth);
+            }
+
+            // for active controller.anim_instances, make trans, quat, scale
+            //      blend tree
+            if (num_anims == 0)
+                return 0;
+
+            anim_instance& a = controller.anim_instances[controller.blend.anim_a];
+            anim_instance& b = controller.anim_instances[controller.blend.anim_b];
+            f32            t = controller.blend.ratio;
+
+            u32 num_joints = sb_count(a.joints);
+            for (u32 j = 0; j < num_joints; ++j)
+            {
+                u32 jnode = controller.joint_indices[j] + root;
+
+                if (scene->entities[jnode] & e_cmp::anim_trajectory)
+                {
+                    vec3f lerp_delta = lerp(a.root_delta, b.root_delta, t);
+
+                    mat4 rot_mat;
+                    quat q = scene->initial_transform[jnode].rotation;
+                    q.get_matrix(rot_mat);
+
+                    // apply root motion to the root controller, so we bring along sub or sibling meshes
+                    root_motion.rotation = q;
+                    root_motion.translation += rot_mat.transform_vector(lerp_delta);
+                    root_motion.valid = true;
+                }
+            }
+
+            return blend_joint_poses(scene, controller, root, a.joints, b.joints, t, max_depth, true);
+        }
+
+        void build_joint_depths(ecs_scene* scene, cmp_anim_controller_v2& controller, u32 root)
+        {
+            if (controller.joint_depths)
+                stb__sbn(controller.joint_depths) = 0;
+
+            u32 num_joints = sb_count(controller.joint_indices);
+            for (u32 j = 0; j < num_joints; ++j)
+            {
+                u32 c = controller.joint_indices[j] + root;
+                u32 p = scene->parents[c];
+                u32 depth = 0;
+                while (p != c && (scene->entities[p] & e_cmp::bone))
+                {
+                    ++depth;
+                    c = p;
+                    p = scene->parents[c];
+                }
+
+                sb_push(controller.joint_depths, (u8)std::min<u32>(depth, 255));
+            }
+        }
+
+        void snapshot_joint_pose(const ecs_scene* scene, const cmp_anim_controller_v2& controller, u32 root,
+                                 cmp_transform* pose)
+        {
+            u32 num_joints = sb_count(controller.joint_indices);
+            for (u32 j = 0; j < num_joints; ++j)
+                pose[j] = scene->transforms[controller.joint_indices[j] + root];
+        }
+
+        // projected diameter of the entities pos_extent as a fraction of the viewport height
+        f32 anim_lod_screen_size(const ecs_scene* scene, u32 n, const camera* cam)
+        {
+            const cmp_pos_extent& pe = scene->pos_extent[n];
+
+            f32 radius = mag(pe.extent.xyz);
+            f32 proj_y = cam->proj.m[5];
+
+            if (cam->flags & e_camera_flags::orthographic)
+                return radius * proj_y;
+
+            f32 dist = max(mag(pe.pos.xyz - cam->pos), k_anim_lod_min_distance);
+            return radius * proj_y / dist;
+        }
+
+        u32 anim_lod_band_index(const anim_lod_params& params, f32 screen_size)
+        {
+            for (u32 b = 0; b < k_anim_lod_bands - 1; ++b)
+                if (screen_size >= params.bands[b].min_screen_size)
+                    return b;
+
+            return k_anim_lod_bands - 1;
+        }
+
+        // rigs in bands with an update interval evaluate their pose an interval ahead, and interpolate towards it from
+        // the pose on screen so playback stays in time. root motion of the evaluated pose is spread over the interval
+        void update_anim_controller_lod(const anim_job& job, u32 i)
+        {
+            ecs_scene*              scene = job.scene;
+            u32                     n = job.controllers[i];
+            f32                     dt = job.dt;
+            anim_root_motion&       root_motion = job.root_motion[i];
+            anim_lod_result&        result = job.results[i];
+            cmp_anim_controller_v2& controller = scene->anim_controller_v2[n];
+            anim_lod_state&         lod = controller.lod;
+
+            u32 band = 0;
+            u32 interval = 1;
+            u32 max_depth = 0;
+            if (job.cam)
+            {
+                band = anim_lod_band_index(*job.params, anim_lod_screen_size(scene, n, job.cam));
+                interval = std::max<u32>(job.params->bands[band].update_interval, 1);
+                max_depth = job.params->bands[band].max_joint_depth;
+            }
+
+            u32 root = ecs::get_index_from_ref(scene, controller.root_joint_ref);
+            u32 num_joints = sb_count(controller.joint_indices);
+
+            if (max_depth && sb_count(controller.joint_depths) != num_joints)
+                build_joint_depths(scene, controller, root);
+
+            // restart the interval from the pose on screen when the band changes
+            if (band != lod.band)
+            {
+                lod.band = band;
+                lod.frame = 0;
+                lod.pose_valid = false;
+            }
+
+            result.band = band;
+            result.evaluated = false;
+            result.joints = 0;
+
+            if (interval == 1)
+            {
+                f32 step = max(dt - lod.time_ahead, 0.0f);
+                lod.time_ahead = max(lod.time_ahead - dt, 0.0f);
+                lod.frame = 0;
+                lod.pose_valid = false;
+
+                result.joints = update_anim_controller(scene, n, step, root_motion, max_depth);
+                result.evaluated = true;
+                return;
+            }
+
+            if (lod.frame == 0)
+            {
+                sb_reserve_count(lod.pose[0], num_joints);
+                sb_reserve_count(lod.pose[1], num_joints);
+
+                // the last evaluated pose is due now
+                if (lod.pose_valid)
+                    std::swap(lod.pose[0], lod.pose[1]);
+                else
+                    snapshot_joint_pose(scene, controller, root, lod.pose[0]);
+
+                f32 step = max(dt * interval - lod.time_ahead, 0.0f);
+                lod.time_ahead += step;
+
+                anim_root_motion next_motion;
+                result.joints = update_anim_controller(scene, n, step, next_motion, max_depth);
+                result.evaluated = true;
+
+                snapshot_joint_pose(scene, controller, root, lod.pose[1]);
+                lod.pose_valid = true;
+
+                lod.root_valid = next_motion.valid;
+                lod.root_rotation = next_motion.rotation;
+                lod.root_translation = next_motion.translation;
+            }
+
+            blend_joint_poses(scene, controller, root, lod.pose[0], lod.pose[1], (f32)lod.frame / (f32)interval, max_depth,
+                              false);
+
+            root_motion.valid = lod.root_valid;
+            root_motion.parent = scene->parents[n];
+            root_motion.rotation = lod.root_rotation;
+            root_motion.translation = lod.root_translation / (f32)interval;
+
+            lod.time_ahead = max(lod.time_ahead - dt, 0.0f);
+            lod.frame = (lod.frame + 1) % interval;
+        }
+
+        void update_anim_controllers(u32 start, u32 end, void* user_data)
+        {
+            anim_job* job = (anim_job*)user_data;
+            for (u32 i = start; i < end; ++i)
+                update_anim_controller_lod(*job, i);
+        }
+
+        void update_animations(ecs_scene* scene, f32 dt)
+        {
+            static u32*              controllers = nullptr;
+            static anim_root_motion* root_motion = nullptr;
+            static anim_lod_result*  results = nullptr;
+            if (controllers)
+                stb__sbn(controllers) = 0;
+
+            for (u32 n = 0; n < scene->num_entities; ++n)
+                if (scene->entities[n] & e_cmp::anim_controller)
+                    sb_push(controllers, n);
+
+            u32 num_controllers = sb_count(controllers);
+            sb_reserve_count(root_motion, num_controllers);
+            sb_reserve_count(results, num_controllers);
+
+            // lod from the projected size of each rig, everything runs at full detail without a camera
+            const camera* cam = scene->anim_lod.enabled ? scene->anim_lod.camera : nullptr;
+
+            anim_job job;
+            job.scene = scene;
+            job.dt = dt;
+            job.controllers = controllers;
+            job.root_motion = root_motion;
+            job.results = results;
+            job.cam = cam;
+            job.params = &scene->anim_lod;
+            pen::parallel_for(num_controllers, k_anim_grain, update_anim_controllers, &job);
+
+            anim_lod_stats& stats = scene->anim_stats;
+            stats = anim_lod_stats();
+
+            for (u32 i = 0; i < num_controllers; ++i)
+            {
+                const anim_lod_result& res = results[i];
+                stats.rigs[res.band]++;
+                stats.joints_evaluated += res.joints;
+                stats.joints_total += sb_count(scene->anim_controller_v2[controllers[i]].joint_indices);
+
+                if (res.evaluated)
+                    stats.evaluated++;
+                else
+                    stats.interpolated++;
+
+                const anim_root_motion& rm = root_motion[i];
+                if (!rm.valid)
+                    continue;
+
+                scene->transforms[rm.parent].rotation = rm.rotation;
+                scene->transforms[rm.parent].translation += rm.translation;
+                scene->entities[rm.parent] |= e_cmp::transform;
+            }
+        }
+
+        void update(f32 dt)
+        {
+            //PEN_PERF_SCOPE_PRINT(ecs_update);
+
+            // allow run time switching between dynamic and fixed timestep
+            static f32 fft = 1.0f / 60.0f;
+            bool       bdt = dev_ui::get_program_preference("dynamic_timestep").as_bool(true);
+            f32        ft = dev_ui::get_program_preference("fixed_timestep").as_f32(fft);
+            if (!bdt)
+            {
+                dt = ft;
+            }
+
+            for (auto& si : s_scenes)
+            {
+                update_scene(si.scene, dt);
+            }
+        }
+
+        std::vector<ecs_scene_instance>* get_scenes()
+        {
+            return &s_scenes;
+        }
+
+        void reset(ecs_scene* scene)
+        {
+            // reset physics positions
+            for (s32 i = 0; i < scene->num_entities; ++i)
+            {
+                if (scene->entities[i] & e_cmp::physics)
+                {
+                    if (scene->physics_data[i].type != e_physics_type::rigid_body)
+                        continue;
+
+                    vec3f t = scene->physics_data[i].rigid_body.position;
+                    quat  q = scene->physics_data[i].rigid_body.rotation;
+
+                    physics::set_transform(scene->physics_handles[i], t, q);
+
+                    scene->transforms[i].translation = t;
+                    scene->transforms[i].rotation = q;
+
+                    scene->entities[i] |= e_cmp::transform;
+
+                    // reset velocity
+                    physics::set_v3(scene->physics_handles[i], vec3f::zero(), physics::e_cmd::set_linear_velocity);
+                    physics::set_v3(scene->physics_handles[i], vec3f::zero(), physics::e_cmd::set_angular_velocity);
+                }
+            }
+        }
+
+        // entity transforms are computed in chunks of this many entities per task
+        static const u32 k_transform_grain = 256;
+
+        struct transform_job
+        {
+            ecs_scene* scene;
+            const u32* indices;
+        };
+
+        void build_hierarchy_levels(ecs_scene* scene)
+        {
+            u32 ne = (u32)scene->num_entities;
+
+            sb_clear(scene->hierarchy_levels);
+            sb_clear(scene->hierarchy_level_offsets);
+            scene->hierarchy_num_entities = ne;
+
+            if (ne == 0)
+                return;
+
+            // depth of each node, parents may be at any index so walk up until we hit a known depth
+            u32* depth = nullptr;
+            u32* chain = nullptr;
+            sb_add(depth, ne);
+            for (u32 n = 0; n < ne; ++n)
+                depth[n] = PEN_INVALID_HANDLE;
+
+            u32 max_depth = 0;
+            for (u32 n = 0; n < ne; ++n)
+            {
+                if (depth[n] != PEN_INVALID_HANDLE)
+                    continue;
+
+                u32 cur = n;
+                if (chain)
+                    stb__sbn(chain) = 0;
+
+                while (depth[cur] == PEN_INVALID_HANDLE)
+                {
+                    u32 p = scene->parents[cur];
+                    if (p == cur || p >= ne || (u32)sb_count(chain) > ne)
+                    {
+                        // root, or a broken link which we treat as a root
+                        depth[cur] = 0;
+                        break;
                     }
+
+                    sb_push(chain, cur);
+                    cur = p;
                 }
-                
 
-                // for active controller.anim_instances, make trans, quat, scale
-                //      blend tree
-                if (num_anims > 0)
+                u32 d = depth[cur];
+                for (s32 c = sb_count(chain) - 1; c >= 0; --c)
+                    depth[chain[c]] = ++d;
+
+                max_depth = max(max_depth, d);
+            }
+
+            // counting sort entities into levels, keeping index order within a level
+            sb_add(scene->hierarchy_level_offsets, max_depth + 2);
+            memset(scene->hierarchy_level_offsets, 0x0, sizeof(u32) * (max_depth + 2));
+
+            for (u32 n = 0; n < ne; ++n)
+                scene->hierarchy_level_offsets[depth[n] + 1]++;
+
+            for (u32 l = 1; l < max_depth + 2; ++l)
+                scene->hierarchy_level_offsets[l] += scene->hierarchy_level_offsets[l - 1];
+
+            sb_add(scene->hierarchy_levels, ne);
+
+            u32* cursor = nullptr;
+            sb_add(cursor, max_depth + 1);
+            memcpy(cursor, scene->hierarchy_level_offsets, sizeof(u32) * (max_depth + 1));
+
+            for (u32 n = 0; n < ne; ++n)
+                scene->hierarchy_levels[cursor[depth[n]]++] = n;
+
+            sb_free(depth);
+            sb_free(chain);
+            sb_free(cursor);
+        }
+
+        void update_transforms(u32 start, u32 end, void* user_data)
+        {
+            transform_job* tj = (transform_job*)user_data;
+            ecs_scene*     scene = tj->scene;
+
+            for (u32 i = start; i < end; ++i)
+            {
+                u32  n = tj->indices[i];
+                bool dirty = scene->state_flags[n] & e_state::transform_dirty;
+
+                // controlled transform
+                if (scene->entities[n] & e_cmp::transform)
+                {
+                    cmp_transform& t = scene->transforms[n];
+
+                    // generate matrix from transform
+                    mat4 rot_mat;
+                    t.rotation.get_matrix(rot_mat);
+
+                    mat4 translation_mat = mat::create_translation(t.translation);
+
+                    mat4 scale_mat = mat::create_scale(t.scale);
+
+                    scene->local_matrices[n] = translation_mat * rot_mat * scale_mat;
+
+                    // local matrix will be baked
+                    scene->entities[n] &= ~e_cmp::transform;
+                    dirty = true;
+                }
+                else if (scene->entities[n] & e_cmp::physics)
                 {
-                    anim_instance& a = controller.anim_instances[controller.blend.anim_a];
-                    anim_instance& b = controller.anim_instances[controller.blend.anim_b];
-                    f32            t = controller.blend.ratio;
+                    if (!physics::has_rb_matrix(n))
+                        continue;
 
-                    u32 num_joints = sb_count(a.joints);
-                    for (u32 j = 0; j < num_joints; ++j)
+                    cmp_transform& t = scene->transforms[n];
+                    cmp_transform& pt = scene->physics_offset[n];
+
+                    cmp_transform prev = t;
+                    t = physics::get_rb_transform(scene->physics_handles[n]);
+                    t.scale = prev.scale;
+
+                    // sleeping or static bodies do not need to rebuild
+                    if (memcmp(&prev, &t, sizeof(cmp_transform)) != 0)
+                        dirty = true;
+
+                    if (dirty)
                     {
-                        u32 jnode = controller.joint_indices[j] + root;
+                        mat4 scale_mat = mat::create_scale(t.scale);
 
-                        cmp_transform& tc = scene->transforms[jnode];
-                        cmp_transform& ta = a.joints[j];
-                        cmp_transform& tb = b.joints[j];
+                        mat4 rot_mat;
+                        t.rotation.get_matrix(rot_mat);
 
-                        if (scene->entities[jnode] & e_cmp::anim_trajectory)
-                        {
-                            vec3f lerp_delta = lerp(a.root_delta, b.root_delta, t);
+                        mat4 translation_mat = mat::create_translation(t.translation - pt.translation);
 
-                            mat4 rot_mat;
-                            quat q = scene->initial_transform[jnode].rotation;
-                            q.get_matrix(rot_mat);
+                        scene->local_matrices[n] = translation_mat * rot_mat * scale_mat;
+                    }
+                }
 
-                            vec3f transform_translation = rot_mat.transform_vector(lerp_delta);
-                            
-                            // apply to parent so we bring along sub or sibling meshes
-                            u32 p = scene->parents[n];
+                // parents are in lower levels and have already updated their dirty state this frame
+                u32 parent = scene->parents[n];
+                if (parent != n && (scene->state_flags[parent] & e_state::transform_dirty))
+                    dirty = true;
+
+                if (!dirty)
+                    continue;
+
+                // heirarchical scene transform
+                if (parent == n)
+                    scene->world_matrices[n] = scene->local_matrices[n];
+                else
+                    scene->world_matrices[n] = scene->world_matrices[parent] * scene->local_matrices[n];
+
+                scene->state_flags[n] |= e_state::transform_dirty | e_state::bounds_dirty;
+            }
+        }
+
+        void update_bounds(u32 start, u32 end, void* user_data)
+        {
+            transform_job* tj = (transform_job*)user_data;
+            transform_bounds(tj->scene, &tj->indices[start], end - start);
+        }
+
+        static const u32 k_bone_palette_grain = 16;
+
+        struct bone_palette_job
+        {
+            ecs_scene* scene;
+            const u32* entities;
+        };
 
-                            // apply root motion to the root controller, so we bring along the meshes
-                            scene->transforms[p].rotation = q;
-                            scene->transforms[p].translation += transform_translation;
-                            scene->entities[p] |= e_cmp::transform;
+        void fill_bone_palette(u32 start, u32 end, void* user_data)
+        {
+            bone_palette_job* job = (bone_palette_job*)user_data;
+            ecs_scene*        scene = job->scene;
 
-                            continue;
-                        }
+            for (u32 i = start; i < end; ++i)
+            {
+                u32       n = job->entities[i];
+                cmp_skin* skin = scene->geometries[n].p_skin;
 
-                        tc.translation = lerp(ta.translation, tb.translation, t);
-                        tc.rotation = slerp(ta.rotation, tb.rotation, t);
-                        tc.scale = lerp(ta.scale, tb.scale, t);
-                        
-                        if(scene->entities[jnode] & e_cmp::additive_rotation)
-                        {
-                            tc.rotation *= scene->additive_rotation[jnode];
-                        }
+                u32 rjr = scene->anim_controller_v2[n].root_joint_ref;
+                u32 joints_offset = ecs::get_index_from_ref(scene, rjr) + skin->bone_offset;
 
-                        scene->entities[jnode] |= e_cmp::transform;
-                    }
-                }
+                mat4* bones = &scene->bone_palette[scene->bone_palette_offset[n]];
+                for (u32 j = 0; j < skin->num_joints; ++j)
+                    bones[j] = scene->world_matrices[joints_offset + j] * skin->joint_bind_matrices[j];
             }
         }
 
-        void update(f32 dt)
+        // packs the world * bind matrices of every skinned entity into one structured buffer, only the joints each
+        // skin has are uploaded. sub geometry shares the bones of its parent
+        void update_bone_palette(ecs_scene* scene)
         {
-            //PEN_PERF_SCOPE_PRINT(ecs_update);
+            static u32* entities = nullptr;
+            if (entities)
+                stb__sbn(entities) = 0;
 
-            // allow run time switching between dynamic and fixed timestep
-            static f32 fft = 1.0f / 60.0f;
-            bool       bdt = dev_ui::get_program_preference("dynamic_timestep").as_bool(true);
-            f32        ft = dev_ui::get_program_preference("fixed_timestep").as_f32(fft);
-            if (!bdt)
+            u32 num_bones = 0;
+            for (u32 n = 0; n < scene->num_entities; ++n)
             {
-                dt = ft;
+                if (!(scene->entities[n] & (e_cmp::skinned | e_cmp::pre_skinned)))
+                    continue;
+
+                if (scene->entities[n] & e_cmp::sub_geometry)
+                    continue;
+
+                cmp_skin* skin = scene->geometries[n].p_skin;
+                if (!skin)
+                    continue;
+
+                scene->bone_palette_offset[n] = num_bones;
+                num_bones += skin->num_joints;
+                sb_push(entities, n);
             }
 
-            for (auto& si : s_scenes)
+            // offsets go to the shader in the draw call
+            for (u32 n = 0; n < scene->num_entities; ++n)
             {
-                update_scene(si.scene, dt);
+                if (!(scene->entities[n] & (e_cmp::skinned | e_cmp::pre_skinned)))
+                    continue;
+
+                if (scene->entities[n] & e_cmp::sub_geometry)
+                    scene->bone_palette_offset[n] = scene->bone_palette_offset[scene->parents[n]];
+
+                scene->draw_call_data[n].v1.w = (f32)scene->bone_palette_offset[n];
             }
-        }
 
-        std::vector<ecs_scene_instance>* get_scenes()
-        {
-            return &s_scenes;
-        }
+            if (num_bones == 0)
+                return;
 
-        void reset(ecs_scene* scene)
-        {
-            // reset physics positions
-            for (s32 i = 0; i < scene->num_entities; ++i)
-            {
-                if (scene->entities[i] & e_cmp::physics)
-                {
-                    if (scene->physics_data[i].type != e_physics_type::rigid_body)
-                        continue;
+            sb_reserve_count(scene->bone_palette, num_bones);
 
-                    vec3f t = scene->physics_data[i].rigid_body.position;
-                    quat  q = scene->physics_data[i].rigid_body.rotation;
+            bone_palette_job job;
+            job.scene = scene;
+            job.entities = entities;
+            pen::parallel_for(sb_count(entities), k_bone_palette_grain, fill_bone_palette, &job);
 
-                    physics::set_transform(scene->physics_handles[i], t, q);
+            // grow the buffer, releases are queued behind any draws which still reference it
+            if (num_bones > scene->bone_palette_capacity)
+            {
+                if (is_valid(scene->bone_palette_buffer))
+                    pen::renderer_release_buffer(scene->bone_palette_buffer);
 
-                    scene->transforms[i].translation = t;
-                    scene->transforms[i].rotation = q;
+                scene->bone_palette_capacity = std::max<u32>(num_bones, scene->bone_palette_capacity * 2);
 
-                    scene->entities[i] |= e_cmp::transform;
+                pen::buffer_creation_params bcp;
+                bcp.usage_flags = PEN_USAGE_DYNAMIC;
+                bcp.bind_flags = PEN_BIND_SHADER_RESOURCE;
+                bcp.cpu_access_flags = PEN_CPU_ACCESS_WRITE;
+                bcp.buffer_size = sizeof(mat4) * scene->bone_palette_capacity;
+                bcp.stride = sizeof(mat4);
+                bcp.data = nullptr;
 
-                    // reset velocity
-                    physics::set_v3(scene->physics_handles[i], vec3f::zero(), physics::e_cmd::set_linear_velocity);
-                    physics::set_v3(scene->physics_handles[i], vec3f::zero(), physics::e_cmd::set_angular_velocity);
-                }
+                scene->bone_palette_buffer = pen::renderer_create_buffer(bcp);
             }
+
+            pen::renderer_update_buffer(scene->bone_palette_buffer, scene->bone_palette, num_bones * sizeof(mat4));
         }
 
         void update_scene(ecs_scene* scene, f32 dt)
         {
-            // static anim time to pass into draw calls etc..
-            f32 anim_time = pen::get_time_ms() / 1000.0f;
+            // culling from the previous frame reads scene data, it must finish before we modify it
+            wait_for_scene_jobs(scene);
+
+            // views rendered this frame append to the auto instance buffer from the start
+            scene->auto_instance_offset = 0;
 
             u32 num_controllers = sb_count(scene->controllers);
             u32 num_extensions = sb_count(scene->extensions);
@@ -1401,7 +2862,24 @@ namespace put
             static pen::timer* timer = pen::timer_create();
             pen::timer_start(timer);
 
-            // scene node transform
+            // rebuild hierarchy levels so each depth can be transformed in parallel
+            if ((scene->flags & e_scene_flags::invalidate_hierarchy) || scene->hierarchy_num_entities != scene->num_entities)
+            {
+                build_hierarchy_levels(scene);
+                scene->flags &= ~e_scene_flags::invalidate_hierarchy;
+
+                // entity indices may have been swapped, so the bvh leaves are rebuilt
+                bvh_clear(scene->bvh);
+
+                // structure changed, so everything must update once and re-upload
+                sb_clear(scene->draw_call_caches);
+                sb_add(scene->draw_call_caches, (u32)scene->num_entities);
+
+                for (size_t n = 0; n < scene->num_entities; ++n)
+                    scene->state_flags[n] |= e_state::transform_dirty | e_state::bounds_dirty;
+            }
+
+            // physics commands are not thread safe, sync controlled transforms to physics before the parallel pass
             for (size_t n = 0; n < scene->num_entities; ++n)
             {
                 // force physics entity to sync and ignore controlled transform
@@ -1411,85 +2889,95 @@ namespace put
                     scene->entities[n] &= ~e_cmp::transform;
                 }
 
-                // controlled transform
-                if (scene->entities[n] & e_cmp::transform)
-                {
-                    cmp_transform& t = scene->transforms[n];
-
-                    // generate matrix from transform
-                    mat4 rot_mat;
-                    t.rotation.get_matrix(rot_mat);
-
-                    mat4 translation_mat = mat::create_translation(t.translation);
-
-                    mat4 scale_mat = mat::create_scale(t.scale);
-
-                    scene->local_matrices[n] = translation_mat * rot_mat * scale_mat;
-
-                    if (scene->entities[n] & e_cmp::physics)
-                    {
-                        if (scene->physics_data[n].type == e_physics_type::rigid_body)
-                        {
-                            cmp_transform& pt = scene->physics_offset[n];
-                            physics::set_transform(scene->physics_handles[n], t.translation + pt.translation, t.rotation);
-                            physics::set_v3(scene->physics_handles[n], vec3f::zero(), physics::e_cmd::set_angular_velocity);
-                            physics::set_v3(scene->physics_handles[n], vec3f::zero(), physics::e_cmd::set_linear_velocity);
-                        }
-                    }
+                if (!(scene->entities[n] & e_cmp::physics) || !(scene->entities[n] & e_cmp::transform))
+                    continue;
 
-                    // local matrix will be baked
-                    scene->entities[n] &= ~e_cmp::transform;
-                }
-                else if (scene->entities[n] & e_cmp::physics)
+                if (scene->physics_data[n].type == e_physics_type::rigid_body)
                 {
-                    if (!physics::has_rb_matrix(n))
-                        continue;
-
                     cmp_transform& t = scene->transforms[n];
                     cmp_transform& pt = scene->physics_offset[n];
+                    physics::set_transform(scene->physics_handles[n], t.translation + pt.translation, t.rotation);
+                    physics::set_v3(scene->physics_handles[n], vec3f::zero(), physics::e_cmd::set_angular_velocity);
+                    physics::set_v3(scene->physics_handles[n], vec3f::zero(), physics::e_cmd::set_linear_velocity);
+                }
+            }
 
-                    mat4 scale_mat = mat::create_scale(t.scale);
+            // scene node transform, level by level parents are complete before their children
+            u32 num_levels = sb_count(scene->hierarchy_level_offsets);
+            for (u32 l = 0; l + 1 < num_levels; ++l)
+            {
+                u32 start = scene->hierarchy_level_offsets[l];
+                u32 end = scene->hierarchy_level_offsets[l + 1];
 
-                    vec3f os = t.scale;
-                    t = physics::get_rb_transform(scene->physics_handles[n]);
-                    t.scale = os;
+                transform_job tj;
+                tj.scene = scene;
+                tj.indices = &scene->hierarchy_levels[start];
 
-                    mat4 rot_mat;
-                    t.rotation.get_matrix(rot_mat);
+                pen::parallel_for(end - start, k_transform_grain, update_transforms, &tj);
+            }
 
-                    mat4 translation_mat = mat::create_translation(t.translation - pt.translation);
+            scene->renderable_extents.min = vec3f::flt_max();
+            scene->renderable_extents.max = -vec3f::flt_max();
 
-                    scene->local_matrices[n] = translation_mat * rot_mat * scale_mat;
-                }
+            // batch entities which moved to transform their bounds with simd
+            static u32* moved = nullptr;
+            if (moved)
+                stb__sbn(moved) = 0;
 
-                // heirarchical scene transform
-                u32 parent = scene->parents[n];
-                if (parent == n)
-                    scene->world_matrices[n] = scene->local_matrices[n];
-                else
-                    scene->world_matrices[n] = scene->world_matrices[parent] * scene->local_matrices[n];
-            }
+            for (size_t n = 0; n < scene->num_entities; ++n)
+            {
+                if (scene->entities[n] & e_cmp::bone)
+                    continue;
 
-            // bounding volume transform
-            static vec3f corners[] = {vec3f(0.0f, 0.0f, 0.0f),
+                u32 dirty = e_state::transform_dirty | e_state::bounds_dirty;
 
-                                      vec3f(1.0f, 0.0f, 0.0f), vec3f(0.0f, 1.0f, 0.0f), vec3f(0.0f, 0.0f, 1.0f),
+                // extents edited without moving the entity must also rebuild its pos extent
+                draw_call_cache&           cache = scene->draw_call_caches[n];
+                const cmp_bounding_volume& bv = scene->bounding_volumes[n];
+                if (memcmp(&bv.min_extents, &cache.min_extents, sizeof(vec3f)) != 0 ||
+                    memcmp(&bv.max_extents, &cache.max_extents, sizeof(vec3f)) != 0)
+                    scene->state_flags[n] |= dirty;
 
-                                      vec3f(1.0f, 1.0f, 0.0f), vec3f(0.0f, 1.0f, 1.0f), vec3f(1.0f, 0.0f, 1.0f),
+                if ((scene->state_flags[n] & dirty) == dirty)
+                {
+                    sb_push(moved, (u32)n);
+                    cache.min_extents = bv.min_extents;
+                    cache.max_extents = bv.max_extents;
+                }
+            }
 
-                                      vec3f(1.0f, 1.0f, 1.0f)};
+            // children which moved invalidate the expanded bounds of all their ancestors
+            u32* levels = scene->hierarchy_levels;
+            for (s32 i = sb_count(levels) - 1; i >= 0; --i)
+            {
+                u32 n = levels[i];
+                u32 p = scene->parents[n];
+                if (p != n && (scene->state_flags[n] & e_state::bounds_dirty))
+                    scene->state_flags[p] |= e_state::bounds_dirty;
+            }
 
-            scene->renderable_extents.min = vec3f::flt_max();
-            scene->renderable_extents.max = -vec3f::flt_max();
+            transform_job bj;
+            bj.scene = scene;
+            bj.indices = moved;
+            pen::parallel_for(sb_count(moved), k_transform_grain, update_bounds, &bj);
 
-            // transform extents by transform
+            // reset bounds and gather scene extents
             for (size_t n = 0; n < scene->num_entities; ++n)
             {
-                vec3f min = scene->bounding_volumes[n].min_extents;
-                vec3f max = scene->bounding_volumes[n].max_extents - min;
-
                 vec3f& tmin = scene->bounding_volumes[n].transformed_min_extents;
                 vec3f& tmax = scene->bounding_volumes[n].transformed_max_extents;
+                auto&  pe = scene->pos_extent[n];
+
+                if (!(scene->state_flags[n] & e_state::bounds_dirty))
+                {
+                    // unchanged, pos extent holds the entities own bounds before child expansion
+                    if (scene->entities[n] & e_cmp::geometry)
+                    {
+                        scene->renderable_extents.min = min_union(pe.pos.xyz - pe.extent.xyz, scene->renderable_extents.min);
+                        scene->renderable_extents.max = max_union(pe.pos.xyz + pe.extent.xyz, scene->renderable_extents.max);
+                    }
+                    continue;
+                }
 
                 if (scene->entities[n] & e_cmp::bone)
                 {
@@ -1497,26 +2985,13 @@ namespace put
                     continue;
                 }
 
-                tmax = -vec3f::flt_max();
-                tmin = vec3f::flt_max();
-
-                for (s32 c = 0; c < 8; ++c)
+                if (!(scene->state_flags[n] & e_state::transform_dirty))
                 {
-                    vec3f p = scene->world_matrices[n].transform_vector(min + max * corners[c]);
-
-                    tmax = max_union(tmax, p);
-                    tmin = min_union(tmin, p);
+                    // only a child moved, reset to our own bounds before expanding again
+                    tmin = pe.pos.xyz - pe.extent.xyz;
+                    tmax = pe.pos.xyz + pe.extent.xyz;
                 }
 
-                f32& trad = scene->bounding_volumes[n].radius;
-                trad = mag(tmax - tmin) * 0.5f;
-
-                // pos extent for faster aabb and sphere culling
-                auto& pe = scene->pos_extent[n];
-                pe.pos.xyz = tmin + (tmax - tmin) * 0.5f;
-                pe.extent.xyz = tmax - pe.pos.xyz;
-                pe.extent.w = trad;
-
                 if (!(scene->entities[n] & e_cmp::geometry))
                     continue;
 
@@ -1525,9 +3000,10 @@ namespace put
                 scene->renderable_extents.max = max_union(tmax, scene->renderable_extents.max);
             }
 
-            // reverse iterate over scene and expand parents extents by children
-            for (intptr_t n = scene->num_entities - 1; n > 0; --n)
+            // reverse iterate over the hierarchy levels and expand parents extents by children
+            for (s32 i = sb_count(levels) - 1; i >= 0; --i)
             {
+                u32 n = levels[i];
                 if (!(scene->entities[n] & e_cmp::allocated))
                     continue;
 
@@ -1535,6 +3011,10 @@ namespace put
                 if (p == n)
                     continue;
 
+                // clean parents already contain their children from a previous frame
+                if (!(scene->state_flags[p] & e_state::bounds_dirty))
+                    continue;
+
                 vec3f& parent_tmin = scene->bounding_volumes[p].transformed_min_extents;
                 vec3f& parent_tmax = scene->bounding_volumes[p].transformed_max_extents;
 
@@ -1555,6 +3035,9 @@ namespace put
                 }
             }
 
+            // refit the bvh for entities which moved, were added or removed
+            bvh_update(scene);
+
             // Forward light buffer
             static forward_light_buffer light_buffer;
             s32                         pos = 0;
@@ -1719,7 +3202,6 @@ namespace put
                 for (u32 c = 0; c < 4; ++c)
                     al_buffer.lights[num_area_lights].corners[c] = wm.transform_vector(corners_al[c]);
 
-                scene->draw_call_data[n].v1.y = (f32)anim_time; // time
                 al_buffer.lights[num_area_lights].colour = vec4f(l.colour, num_textured_area_lights);
                 scene->draw_call_data[n].v1.z = (f32)num_textured_area_lights;
                 ++num_textured_area_lights;
@@ -1837,163 +3319,109 @@ namespace put
                 }
             }
 
-            // update pre skinned vertex buffers
+            // pack skinning matrices into the bone palette
+            update_bone_palette(scene);
+
+            // update draw call data, only entities which moved or had their data changed are uploaded
             for (size_t n = 0; n < scene->num_entities; ++n)
             {
-                if (!(scene->entities[n] & e_cmp::pre_skinned))
-                    continue;
-                
-                u32 cbuffer = -1;
-                cmp_geometry& geom = scene->geometries[n];
-                cmp_geometry& pos_geom = scene->position_geometries[n];
-                
-                if(scene->entities[n] & e_cmp::sub_geometry)
-                {
-                    // sub geom share bones with parent
-                    u32 p = scene->parents[n];
-                    cbuffer = scene->geometries[p].p_skin->bone_cbuffer;
-                }
-                else
+                draw_call_cache& cache = scene->draw_call_caches[n];
+
+                if (scene->entities[n] & e_cmp::material)
                 {
-                    // create bone cbuffer
-                    static mat4 bb[85];
-                    if (geom.p_skin->bone_cbuffer == PEN_INVALID_HANDLE)
+                    // per node material cbuffer
+                    if (is_valid(scene->materials[n].material_cbuffer))
                     {
-                        pen::buffer_creation_params bcp;
-                        bcp.usage_flags = PEN_USAGE_DYNAMIC;
-                        bcp.bind_flags = PEN_BIND_CONSTANT_BUFFER;
-                        bcp.cpu_access_flags = PEN_CPU_ACCESS_WRITE;
-                        bcp.buffer_size = sizeof(mat4) * 85;
-                        bcp.data = nullptr;
-
-                        geom.p_skin->bone_cbuffer = pen::renderer_create_buffer(bcp);
+                        u32     size = scene->materials[n].material_cbuffer_size;
+                        hash_id mh = pen::hashMurmur2A(&scene->material_data[n].data[0], size);
+                        if (mh != cache.material_hash)
+                        {
+                            pen::renderer_update_buffer(scene->materials[n].material_cbuffer, &scene->material_data[n].data[0],
+                                                        size);
+                            cache.material_hash = mh;
+                        }
                     }
+                }
 
-                    // update bone cbuffer
-                    u32 rjr = scene->anim_controller_v2[n].root_joint_ref;
-                    s32 joints_offset = ecs::get_index_from_ref(scene, rjr);
-                    joints_offset += geom.p_skin->bone_offset;
-                    
-                    for (u32 i = 0; i < geom.p_skin->num_joints; ++i)
-                        bb[i] = scene->world_matrices[joints_offset + i] * geom.p_skin->joint_bind_matrices[i];
+                cmp_draw_call& dc = scene->draw_call_data[n];
+                bool           dirty = scene->state_flags[n] & e_state::transform_dirty;
 
-                    pen::renderer_update_buffer(geom.p_skin->bone_cbuffer, bb, sizeof(bb));
-                    
-                    cbuffer = geom.p_skin->bone_cbuffer;
-                }
-                
-                // bind shaders, skin position and full vertex buffer
-                static u32 shader = pmfx::load_shader("forward_render");
-            
-                static hash_id id_pre_skin[] = {
-                    PEN_HASH("pre_skin"),
-                    PEN_HASH("pre_skin_position")
-                };
-                
-                u32 pre_skin_target[2] = {
-                    geom.vertex_buffer,
-                    pos_geom.vertex_buffer
-                };
-
-                for(u32 b = 0; b < 2; ++b)
-                {
-                    // set pre skin technique
-                    pmfx::set_technique_perm(shader, id_pre_skin[b]);
-                    
-                    // bind stream out targets
-                    cmp_pre_skin& pre_skin = scene->pre_skin[n];
-                    pen::renderer_set_stream_out_target(pre_skin_target[b]);
-                    
-                    pen::renderer_set_vertex_buffer(pre_skin.vertex_buffer, 0, pre_skin.vertex_size, 0);
-                    pen::renderer_set_constant_buffer(cbuffer, 2, pen::CBUFFER_BIND_VS);
+                if (dirty)
+                    dc.world_matrix = scene->world_matrices[n];
 
-                    // render point list
-                    pen::renderer_draw(pre_skin.num_verts, 0, PEN_PT_POINTLIST);
-                    pen::renderer_set_stream_out_target(0);
-                }
-            }
-            
-            // update skinning buffers
-            for (size_t n = 0; n < scene->num_entities; ++n)
-            {
-                if (scene->entities[n] & e_cmp::pre_skinned)
+                // store node index in v1.x
+                dc.v1.x = (f32)n;
+
+                // time is per frame in the view cbuffer so unchanged draw calls can skip the upload
+                bool data_changed =
+                    memcmp(&dc.v1, &cache.v1, sizeof(vec4f)) != 0 || memcmp(&dc.v2, &cache.v2, sizeof(vec4f)) != 0;
+                if (!dirty && !data_changed)
                     continue;
-                    
-                if (scene->entities[n] & e_cmp::skinned)
+
+                cache.v1 = dc.v1;
+                cache.v2 = dc.v2;
+
+                // flag the change so master instance buffers pick up modified sub instances
+                scene->state_flags[n] |= e_state::transform_dirty;
+
+                if (is_invalid_or_null(scene->cbuffer[n]))
+                    continue;
+
+                if (scene->entities[n] & e_cmp::sub_instance)
+                    continue;
+
+                // matrices of entities which only changed user data are kept from a previous frame
+                if (dirty)
                 {
-                    // sub geom share bones with parent
-                    if(scene->entities[n] & e_cmp::sub_geometry)
-                    {
-                        u32 p = scene->parents[n];
-                        scene->bone_cbuffer[n] = scene->bone_cbuffer[p];
-                        continue;
-                    }
-                    
-                    static mat4 bb[85];
-                    cmp_geometry* p_geom = &scene->geometries[n];
-                    if (!scene->bone_cbuffer[n])
-                    {
-                        pen::buffer_creation_params bcp;
-                        bcp.usage_flags = PEN_USAGE_DYNAMIC;
-                        bcp.bind_flags = PEN_BIND_CONSTANT_BUFFER;
-                        bcp.cpu_access_flags = PEN_CPU_ACCESS_WRITE;
-                        bcp.buffer_size = sizeof(mat4) * 85;
-                        bcp.data = nullptr;
+                    // skinned meshes have the world matrix baked into the bones
+                    if (scene->entities[n] & e_cmp::skinned || scene->entities[n] & e_cmp::pre_skinned)
+                        dc.world_matrix = mat4::create_identity();
 
-                        scene->bone_cbuffer[n] = pen::renderer_create_buffer(bcp);
-                    }
-                    
-                    u32 rjr = scene->anim_controller_v2[n].root_joint_ref;
-                    s32 joints_offset = ecs::get_index_from_ref(scene, rjr);
-                    joints_offset += p_geom->p_skin->bone_offset;
-                    
-                    for (u32 i = 0; i < p_geom->p_skin->num_joints; ++i)
-                    {
-                        mat4& joint_matrix = scene->world_matrices[joints_offset + i];
-                        mat4& bind_matrix = p_geom->p_skin->joint_bind_matrices[i];
-                        bb[i] = joint_matrix * bind_matrix;
-                    }
+                    mat4 invt = scene->world_matrices[n];
+
+                    invt = invt.transposed();
+                    invt = mat::inverse4x4(invt);
 
-                    pen::renderer_update_buffer(scene->bone_cbuffer[n], bb, sizeof(bb));
+                    dc.world_matrix_inv_transpose = invt;
                 }
+
+                pen::renderer_update_buffer(scene->cbuffer[n], &dc, sizeof(cmp_draw_call));
             }
 
-            // update draw call data
+            // update pre skinned vertex buffers, after the draw calls which carry the bone palette offset
             for (size_t n = 0; n < scene->num_entities; ++n)
             {
-                if (scene->entities[n] & e_cmp::material)
-                {
-                    // per node material cbuffer
-                    if (is_valid(scene->materials[n].material_cbuffer))
-                        pen::renderer_update_buffer(scene->materials[n].material_cbuffer, &scene->material_data[n].data[0],
-                                                    scene->materials[n].material_cbuffer_size);
-                }
-
-                scene->draw_call_data[n].world_matrix = scene->world_matrices[n];
+                if (!(scene->entities[n] & e_cmp::pre_skinned))
+                    continue;
 
-                // store node index in v1.x
-                scene->draw_call_data[n].v1.x = (f32)n;
-                scene->draw_call_data[n].v1.y = pen::get_time_ms();
+                cmp_geometry& geom = scene->geometries[n];
+                cmp_geometry& pos_geom = scene->position_geometries[n];
 
-                if (is_invalid_or_null(scene->cbuffer[n]))
-                    continue;
+                // bind shaders, skin position and full vertex buffer
+                static u32 shader = pmfx::load_shader("forward_render");
 
-                if (scene->entities[n] & e_cmp::sub_instance)
-                    continue;
+                static hash_id id_pre_skin[] = {PEN_HASH("pre_skin"), PEN_HASH("pre_skin_position")};
 
-                // skinned meshes have the world matrix baked into the bones
-                if (scene->entities[n] & e_cmp::skinned || scene->entities[n] & e_cmp::pre_skinned)
-                    scene->draw_call_data[n].world_matrix = mat4::create_identity();
+                u32 pre_skin_target[2] = {geom.vertex_buffer, pos_geom.vertex_buffer};
 
-                mat4 invt = scene->world_matrices[n];
+                for (u32 b = 0; b < 2; ++b)
+                {
+                    // set pre skin technique
+                    pmfx::set_technique_perm(shader, id_pre_skin[b]);
 
-                invt = invt.transposed();
-                invt = mat::inverse4x4(invt);
+                    // bind stream out targets
+                    cmp_pre_skin& pre_skin = scene->pre_skin[n];
+                    pen::renderer_set_stream_out_target(pre_skin_target[b]);
 
-                scene->draw_call_data[n].world_matrix_inv_transpose = invt;
+                    pen::renderer_set_vertex_buffer(pre_skin.vertex_buffer, 0, pre_skin.vertex_size, 0);
+                    pen::renderer_set_structured_buffer(scene->bone_palette_buffer, e_global_textures::bone_palette,
+                                                        pen::SBUFFER_BIND_VS | pen::SBUFFER_BIND_READ);
+                    pen::renderer_set_constant_buffer(scene->cbuffer[n], 1, pen::CBUFFER_BIND_VS);
 
-                // todo mark dirty?
-                pen::renderer_update_buffer(scene->cbuffer[n], &scene->draw_call_data[n], sizeof(cmp_draw_call));
+                    // render point list
+                    pen::renderer_draw(pre_skin.num_verts, 0, PEN_PT_POINTLIST);
+                    pen::renderer_set_stream_out_target(0);
+                }
             }
 
             // update instance buffers
@@ -2007,13 +3435,31 @@ namespace put
 
                 cmp_master_instance& master = scene->master_instances[n];
 
-                u32 instance_data_size = master.num_instances * master.instance_stride;
-                pen::renderer_update_buffer(master.instance_buffer, &scene->draw_call_data[n + 1], instance_data_size);
+                // only upload if any of the instances changed
+                bool changed = false;
+                for (u32 i = 0; i < master.num_instances; ++i)
+                {
+                    if (scene->state_flags[n + 1 + i] & e_state::transform_dirty)
+                    {
+                        changed = true;
+                        break;
+                    }
+                }
+
+                if (changed)
+                {
+                    u32 instance_data_size = master.num_instances * master.instance_stride;
+                    pen::renderer_update_buffer(master.instance_buffer, &scene->draw_call_data[n + 1], instance_data_size);
+                }
 
                 // stride over sub instances
                 n += scene->master_instances[n].num_instances;
             }
 
+            // dirty state has been consumed
+            for (size_t n = 0; n < scene->num_entities; ++n)
+                scene->state_flags[n] &= ~(e_state::transform_dirty | e_state::bounds_dirty);
+
             // update physics running 1 frame behind to allow the sets to take effect
             physics::step(dt);
             physics::physics_consume_command_buffer();
@@ -2023,6 +3469,9 @@ namespace put
                 if (scene->controllers[c].funcs.post_update_func)
                     scene->controllers[c].funcs.post_update_func(scene->controllers[c], scene, dt);
 
+            // kick culling for shadow views, it runs on workers while the rest of the frame continues
+            cull_scene_views(scene);
+
             f64 elapsed = pen::timer_elapsed_ms(timer);
             PEN_UNUSED(elapsed);
             // PEN_LOG("scene update: %f(ms)", elapsed);
@@ -2349,7 +3798,9 @@ namespace put
 
         void load_scene(const c8* filename, ecs_scene* scene, bool merge)
         {
-            scene->flags |= e_scene_flags::invalidate_scene_tree;
+            wait_for_scene_jobs(scene);
+
+            scene->flags |= e_scene_flags::invalidate_scene_tree | e_scene_flags::invalidate_hierarchy;
             bool      error = false;
             const c8* wd = pen::os_get_user_info().working_directory;
             Str       project_dir = dev_ui::get_program_preference_filename("project_dir", wd);
@@ -5,12 +5,14 @@
 #pragma once
 
 #include "camera.h"
+#include "ecs/ecs_bvh.h"
 #include "loader.h"
 #include "physics/physics.h"
 #include "pmfx.h"
 
 #include "data_struct.h"
 #include "pen.h"
+#include "threads.h"
 
 #include "maths/maths.h"
 #include "maths/quat.h"
@@ -61,7 +63,8 @@ namespace put
             {
                 none = 0,
                 invalidate_scene_tree = 1 << 1,
-                pause_update = 1 << 2
+                pause_update = 1 << 2,
+                invalidate_hierarchy = 1 << 3 // rebuild transform hierarchy levels
             };
         }
         typedef u32 scene_flags;
@@ -78,6 +81,8 @@ namespace put
                 samplers_initialised = (1 << 5),
                 apply_anim_transform = (1 << 6),
                 sync_physics_transform = (1 << 7),
+                transform_dirty = (1 << 8), // world matrix changed this frame, propagates down to children
+                bounds_dirty = (1 << 9),    // transformed bounds need rebuilding, propagates up to parents
                 alpha_blended = (1 << 0)
             };
         }
@@ -115,7 +120,8 @@ namespace put
             {
                 shadow_map = 15,
                 sdf_shadow = 14,
-                omni_shadow_map = 13
+                omni_shadow_map = 13,
+                bone_palette = 6 // structured buffer of skinning matrices
             };
         }
 
@@ -191,11 +197,10 @@ namespace put
 
         struct cmp_skin
         {
-            u32  num_joints;
-            mat4 bind_shape_matrix;
-            mat4 joint_bind_matrices[85];
-            u32  bone_cbuffer = PEN_INVALID_HANDLE;
-            u32  bone_offset = 0;
+            u32   num_joints;
+            mat4  bind_shape_matrix;
+            mat4* joint_bind_matrices = nullptr; // num_joints
+            u32   bone_offset = 0;
         };
 
         // contains handles and data to re-create a material from scratch
@@ -301,6 +306,46 @@ namespace put
             f32 ratio = 0.0f;
         };
 
+        // rigs are banded by the projected size of their pos_extent, lower bands evaluate their pose every
+        // update_interval frames and interpolate in between, and only evaluate joints up to max_joint_depth
+        static const u32 k_anim_lod_bands = 4;
+
+        struct anim_lod_band
+        {
+            f32 min_screen_size; // projected diameter as a fraction of the viewport height
+            u32 update_interval; // evaluate every n frames
+            u32 max_joint_depth; // joints deeper below the root joint keep their last pose, 0 evaluates all joints
+        };
+
+        struct anim_lod_params
+        {
+            bool               enabled = false; // opt in, lod changes animation output for small rigs
+            const put::camera* camera = nullptr; // when null lod is skipped and rigs run at full detail
+            anim_lod_band      bands[k_anim_lod_bands] = {
+                {0.25f, 1, 0}, {0.1f, 2, 0}, {0.03f, 4, 6}, {0.0f, 8, 3}}; // in descending min_screen_size
+        };
+
+        struct anim_lod_stats
+        {
+            u32 rigs[k_anim_lod_bands] = {0};
+            u32 evaluated = 0;    // rigs which evaluated their pose this frame
+            u32 interpolated = 0; // rigs which interpolated between evaluated poses
+            u32 joints_evaluated = 0;
+            u32 joints_total = 0;
+        };
+
+        struct anim_lod_state
+        {
+            u32               band = 0;
+            u32               frame = 0;         // frames since the pose was last evaluated
+            f32               time_ahead = 0.0f; // poses are evaluated an interval ahead of the scene time
+            maths::transform* pose[2] = {nullptr, nullptr}; // previous and next evaluated pose of the joints
+            bool              pose_valid = false;
+            quat              root_rotation;
+            vec3f             root_translation = vec3f::zero(); // root motion of the next pose, applied over the interval
+            bool              root_valid = false;
+        };
+
         struct cmp_anim_controller_v2
         {
             anim_instance* anim_instances = nullptr;
@@ -308,9 +353,11 @@ namespace put
             hash_id*       anim_instance_ids = nullptr;
             u32*           joint_indices = nullptr; // indices offset from the root_joint
             u8*            joint_flags = nullptr;
+            u8*            joint_depths = nullptr; // depth below the root joint, built on first update
             anim_blend     blend = {};
             ecs_ref        root_joint_ref = -1;
             f32            playback_rate = 1.0f;
+            anim_lod_state lod;
         };
 
         struct cmp_light
@@ -395,6 +442,27 @@ namespace put
             vec4f volume_size;
         };
 
+        // last uploaded per draw call data, used to skip redundant updates for unchanged entities
+        struct draw_call_cache
+        {
+            vec4f   v1;
+            vec4f   v2;
+            hash_id material_hash;
+            vec3f   min_extents; // bounds the pos extent was last built from
+            vec3f   max_extents;
+        };
+
+        // visible entities for a single view, lists are reset and reused each frame so they do not reallocate
+        struct view_visibility
+        {
+            const ecs_scene* scene = nullptr;
+            const camera*    key = nullptr; // main views are keyed by their camera
+            u32              entity = 0;    // shadow views are generated from a light entity
+            camera           cam;
+            u32*             entities = nullptr;
+            u32**            chunks = nullptr; // per chunk results when culling across workers
+        };
+
         struct free_node_list
         {
             u32             node;
@@ -507,7 +575,7 @@ namespace put
             cmp_array<area_light_resource>      area_light_resources;
             cmp_array<pmfx::scene_render_flags> render_flags;
             cmp_array<cmp_pos_extent>           pos_extent;           // version 10
-            cmp_array<u32>                      bone_cbuffer;
+            cmp_array<u32>                      bone_palette_offset; // first bone of the entity in bone_palette
             cmp_array<ecs_ref>                  ref_slot;
             cmp_array<quat>                     additive_rotation;
 
@@ -536,9 +604,41 @@ namespace put
             extents          renderable_extents;
             extents          shadow_extent_constraints = {{0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}};
             u32*             selection_list = nullptr;
+            u32*             hierarchy_levels = nullptr;        // entity indices ordered by depth in the hierarchy
+            u32*             hierarchy_level_offsets = nullptr; // start of each level in hierarchy_levels, +1 end entry
+            size_t           hierarchy_num_entities = 0;
+            draw_call_cache* draw_call_caches = nullptr;
             u32              version = k_version;
             Str              filename = "";
 
+            // visibility, shadow views are culled on workers at the end of update_scene
+            std::vector<view_visibility> shadow_visibility;
+            std::vector<view_visibility> omni_shadow_visibility; // 6 faces per omni shadow light
+            std::vector<view_visibility> camera_visibility;
+            u32                          num_shadow_visibility = 0;
+            u32                          num_omni_shadow_visibility = 0;
+            pen::task*                   cull_tasks = nullptr;
+            pen::task_counter            cull_counter;
+            ecs_bvh                      bvh;
+
+            // automatic instancing, runs of visible entities sharing geometry, material and permutation are drawn
+            // instanced from draw_call_data copied into a dynamic buffer. set auto_instance_min_batch to 0 to disable.
+            // each view writes its own region of the buffer, auto_instance_offset is reset every update
+            u32 auto_instance_buffer = PEN_INVALID_HANDLE;
+            u32 auto_instance_capacity = 0;
+            u32 auto_instance_offset = 0;
+            u32 auto_instance_min_batch = 2;
+
+            // world * bind matrices of all skinned entities packed in one structured buffer each frame, the offset of an
+            // entities first bone is in bone_palette_offset and passed to the shader in draw_call_data v1.w
+            mat4* bone_palette = nullptr;
+            u32   bone_palette_buffer = PEN_INVALID_HANDLE;
+            u32   bone_palette_capacity = 0;
+
+            // animation lod, see anim_lod_params
+            anim_lod_params anim_lod;
+            anim_lod_stats  anim_stats;
+
             generic_cmp_array& get_component_array(u32 index);
         };
 
@@ -569,6 +669,10 @@ namespace put
         void clear_scene(ecs_scene* scene);
         void default_scene(ecs_scene* scene);
 
+        // shadow views are culled on workers after update_scene, reading bounds, the bvh and state flags. anything which
+        // resizes or mutates the scene outside of update_scene must wait for them first
+        void wait_for_scene_jobs(ecs_scene* scene);
+
         void resize_scene_buffers(ecs_scene* scene, s32 size = 1024);
         void zero_entity_components(ecs_scene* scene, u32 node_index);
 
@@ -131,7 +131,7 @@ namespace put
 
             //fully update free list
             initialise_free_list(scene);
-            scene->flags |= e_scene_flags::invalidate_scene_tree;
+            scene->flags |= e_scene_flags::invalidate_scene_tree | e_scene_flags::invalidate_hierarchy;
         }
 
         void get_new_entities_append(ecs_scene* scene, s32 num, s32& start, s32& end)
@@ -234,6 +234,8 @@ namespace put
 
         u32 get_new_entity(ecs_scene* scene)
         {
+            wait_for_scene_jobs(scene);
+
             // o(1) using free list
 
             if (!scene->free_list_head)
@@ -245,7 +247,7 @@ namespace put
 
             u32 i = ii;
 
-            scene->flags |= e_scene_flags::invalidate_scene_tree;
+            scene->flags |= e_scene_flags::invalidate_scene_tree | e_scene_flags::invalidate_hierarchy;
 
             scene->num_entities = std::max<u32>(i + 1, scene->num_entities);
 
@@ -391,6 +393,7 @@ namespace put
                 return;
 
             scene->parents[child] = parent;
+            scene->flags |= e_scene_flags::invalidate_hierarchy;
 
             mat4 parent_mat = scene->world_matrices[parent];
 
@@ -486,7 +489,7 @@ namespace put
                 // pen::renderer_consume_cmd_buffer();
             }
 
-            scene->flags |= e_scene_flags::invalidate_scene_tree;
+            scene->flags |= e_scene_flags::invalidate_scene_tree | e_scene_flags::invalidate_hierarchy;
         }
 
         void instance_entity_range(ecs_scene* scene, u32 master_node, u32 num_nodes)
@@ -691,6 +694,7 @@ namespace put
             animation_resource* anim = get_animation_resource(anim_handle);
             anim_instance       anim_instance;
             anim_instance.soa = anim->soa;
+            anim_instance.compressed = anim->compressed;
             anim_instance.length = anim->length;
 
             cmp_anim_controller_v2& controller = scene->anim_controller_v2[node_index];
@@ -726,8 +730,6 @@ namespace put
             for (u32 c = 0; c < anim->num_channels; ++c)
             {
                 anim_sampler sampler;
-                sampler.joint = PEN_INVALID_HANDLE;
-                sampler.pos = 0;
 
                 // find bone for channel
                 for (u32 j = 0; j < num_joints; ++j)
@@ -17,6 +17,7 @@
 #include "renderer.h"
 #include "str/Str.h"
 #include "str_utilities.h"
+#include "threads.h"
 #include "timer.h"
 
 #include <fstream>
@@ -301,23 +302,20 @@ namespace
         return pf;
     }
 
-    u32 load_texture_internal(const c8* filename, hash_id hh, pen::texture_creation_params& tcp)
+    // maps a dds file and fills out tcp with data pointing into the mapping, returns an error message on failure.
+    // does not log or touch shared state so it can be called from worker threads.
+    const c8* map_dds(const c8* filename, pen::mapped_file& file, pen::texture_creation_params& tcp)
     {
-        // load a texture file from disk.
-        void* file_data = nullptr;
-        u32   file_data_size = 0;
-
-        u32 pen_err = pen::filesystem_read_file_to_buffer(filename, &file_data, file_data_size);
+        u32 pen_err = pen::filesystem_map_file(filename, file);
 
-        if (pen_err != PEN_ERR_OK)
+        if (pen_err != PEN_ERR_OK || file.size < sizeof(dds_header))
         {
-            dev_console_log_level(dev_ui::console_level::error, "[error] texture - unabled to find file: %s", filename);
-            pen::memory_free(file_data);
-            return 0;
+            pen::filesystem_unmap_file(file);
+            return "unabled to find file";
         }
 
         // parse dds header
-        dds_header* ddsh = (dds_header*)file_data;
+        dds_header* ddsh = (dds_header*)file.data;
 
         bool dx10_header_present;
         bool compressed;
@@ -325,7 +323,7 @@ namespace
 
         u32 format = dds_pixel_format_to_texture_format(ddsh, compressed, block_size, dx10_header_present);
 
-        u8* top_image_start = (u8*)file_data + sizeof(dds_header);
+        u8* top_image_start = (u8*)file.data + sizeof(dds_header);
         u32 array_size = 1;
         if (dx10_header_present)
         {
@@ -394,18 +392,32 @@ namespace
             tcp.data_size += data_size + ext_data_size;
         }
 
-        // allocate mem and copy
-        tcp.data = pen::memory_alloc(tcp.data_size);
+        // truncated files would read past the end of the mapping
+        if ((size_t)(top_image_start - (u8*)file.data) + tcp.data_size > file.size)
+        {
+            pen::filesystem_unmap_file(file);
+            return "truncated file";
+        }
 
-        // copy texture data into the tcp storage
-        memcpy(tcp.data, top_image_start, tcp.data_size);
+        tcp.data = top_image_start;
+        return nullptr;
+    }
 
-        // free the files contents
-        pen::memory_free(file_data);
+    u32 load_texture_internal(const c8* filename, hash_id hh, pen::texture_creation_params& tcp)
+    {
+        // map the texture file, the image data is copied straight from the mapping into the renderer payload
+        pen::mapped_file file;
+        const c8*        error = map_dds(filename, file, tcp);
+        if (error)
+        {
+            dev_console_log_level(dev_ui::console_level::error, "[error] texture - %s: %s", error, filename);
+            return 0;
+        }
 
         u32 texture_index = pen::renderer_create_texture(tcp);
 
-        pen::memory_free(tcp.data);
+        tcp.data = nullptr;
+        pen::filesystem_unmap_file(file);
 
         return texture_index;
     }
@@ -494,6 +506,218 @@ namespace
             }
         }
     }
+
+    //
+    // Streaming
+    //
+
+    struct stream_entry
+    {
+        u32                   handle;
+        u32                   order; // fifo within a priority
+        stream_request_params params;
+        bool                  success = false;
+        a_u32                 cancelled = {0};
+        pen::task_counter     counter;
+    };
+
+    // kept per handle so state can be queried after the request has finished, grows by one record per request
+    struct stream_record
+    {
+        u32 state;
+        u32 resource;
+    };
+
+    stream_record*  s_stream_records = nullptr;
+    stream_entry**  s_stream_queue = nullptr;
+    stream_entry**  s_stream_in_flight = nullptr;
+    u32             s_stream_max_in_flight = 0;
+    u32             s_stream_finalise_budget = 4;
+    stream_progress s_stream_progress;
+
+    void stream_task(void* user_data)
+    {
+        stream_entry* entry = (stream_entry*)user_data;
+        if (entry->cancelled)
+            return;
+
+        entry->success = entry->params.load(entry->params.data);
+    }
+
+    void stream_finish(stream_entry* entry, u32 state, u32 resource)
+    {
+        s_stream_records[entry->handle].state = state;
+        s_stream_records[entry->handle].resource = resource;
+
+        if (entry->params.release)
+            entry->params.release(entry->params.data);
+
+        s_stream_progress.finished++;
+
+        if (entry->params.callback)
+            entry->params.callback(entry->handle, state, resource, entry->params.user_data);
+
+        delete entry;
+    }
+
+    void stream_dispatch()
+    {
+        u32 max_in_flight = s_stream_max_in_flight;
+        if (max_in_flight == 0)
+            max_in_flight = std::max<u32>(pen::jobs_get_num_workers(), 1);
+
+        while (s_stream_queue && sb_count(s_stream_queue) && sb_count(s_stream_in_flight) < max_in_flight)
+        {
+            // highest priority first, then in request order
+            u32 num_queued = sb_count(s_stream_queue);
+            u32 best = 0;
+            for (u32 i = 1; i < num_queued; ++i)
+            {
+                const stream_entry* a = s_stream_queue[i];
+                const stream_entry* b = s_stream_queue[best];
+                if (a->params.priority > b->params.priority ||
+                    (a->params.priority == b->params.priority && a->order < b->order))
+                    best = i;
+            }
+
+            stream_entry* entry = s_stream_queue[best];
+            for (u32 i = best; i < num_queued - 1; ++i)
+                s_stream_queue[i] = s_stream_queue[i + 1];
+            stb__sbn(s_stream_queue)--;
+
+            s_stream_records[entry->handle].state = e_stream_state::loading;
+
+            if (entry->params.load)
+            {
+                pen::task task;
+                task.func = stream_task;
+                task.user_data = entry;
+                pen::jobs_run_tasks(&task, 1, &entry->counter);
+            }
+            else
+            {
+                entry->success = true;
+            }
+
+            sb_push(s_stream_in_flight, entry);
+        }
+    }
+
+    void stream_update_internal(u32 budget)
+    {
+        stream_dispatch();
+
+        u32 num_in_flight = sb_count(s_stream_in_flight);
+        if (num_in_flight == 0)
+            return;
+
+        // finished entries are removed before callbacks run, callbacks may make new requests
+        stream_entry** finished = nullptr;
+
+        u32 remaining = 0;
+        for (u32 i = 0; i < num_in_flight; ++i)
+        {
+            stream_entry* entry = s_stream_in_flight[i];
+
+            if (!pen::jobs_counter_complete(&entry->counter))
+            {
+                s_stream_in_flight[remaining++] = entry;
+                continue;
+            }
+
+            if (entry->success && !entry->cancelled)
+            {
+                if (budget == 0)
+                {
+                    s_stream_records[entry->handle].state = e_stream_state::loaded;
+                    s_stream_in_flight[remaining++] = entry;
+                    continue;
+                }
+
+                --budget;
+            }
+
+            sb_push(finished, entry);
+        }
+
+        stb__sbn(s_stream_in_flight) = remaining;
+
+        u32 num_finished = sb_count(finished);
+        for (u32 i = 0; i < num_finished; ++i)
+        {
+            stream_entry* entry = finished[i];
+
+            if (entry->cancelled)
+                stream_finish(entry, e_stream_state::cancelled, PEN_INVALID_HANDLE);
+            else if (!entry->success)
+                stream_finish(entry, e_stream_state::failed, PEN_INVALID_HANDLE);
+            else
+                stream_finish(entry, e_stream_state::complete, entry->params.finalise(entry->params.data));
+        }
+
+        sb_free(finished);
+
+        // refill slots freed this update
+        stream_dispatch();
+    }
+
+    struct texture_stream
+    {
+        Str                          filename;
+        hash_id                      id_name;
+        pen::texture_creation_params tcp;
+        const c8*                    error = nullptr;
+    };
+
+    bool texture_stream_load(void* data)
+    {
+        texture_stream* ts = (texture_stream*)data;
+
+        pen::mapped_file file;
+        ts->error = map_dds(ts->filename.c_str(), file, ts->tcp);
+        if (ts->error)
+            return false;
+
+        // copy out of the mapping here so page faults happen on the worker and not on the main thread
+        void* pixels = pen::memory_alloc(ts->tcp.data_size);
+        memcpy(pixels, ts->tcp.data, ts->tcp.data_size);
+        ts->tcp.data = pixels;
+
+        pen::filesystem_unmap_file(file);
+        return true;
+    }
+
+    u32 texture_stream_finalise(void* data)
+    {
+        texture_stream* ts = (texture_stream*)data;
+
+        // another request or load_texture may have loaded it in the meantime
+        for (auto& t : k_texture_references)
+            if (t.id_name == ts->id_name)
+                return t.handle;
+
+        add_file_watcher(ts->filename.c_str(), texture_build, texture_hotload);
+
+        u32 texture_index = pen::renderer_create_texture(ts->tcp);
+
+        pen::texture_creation_params tcp = ts->tcp;
+        tcp.data = nullptr;
+        k_texture_references.push_back({ts->id_name, ts->filename, texture_index, tcp});
+
+        return texture_index;
+    }
+
+    void texture_stream_release(void* data)
+    {
+        texture_stream* ts = (texture_stream*)data;
+
+        if (ts->error)
+            dev_console_log_level(dev_ui::console_level::error, "[error] texture - %s: %s", ts->error,
+                                  ts->filename.c_str());
+
+        pen::memory_free(ts->tcp.data);
+        delete ts;
+    }
 } // namespace
 
 namespace put
@@ -741,4 +965,135 @@ namespace put
             }
         }
     }
+
+    u32 stream_request(const stream_request_params& params)
+    {
+        // progress covers everything requested since the streamer was last idle
+        if (!sb_count(s_stream_queue) && !sb_count(s_stream_in_flight))
+            s_stream_progress = stream_progress();
+
+        static u32 s_order = 0;
+
+        stream_entry* entry = new stream_entry();
+        entry->handle = sb_count(s_stream_records);
+        entry->order = s_order++;
+        entry->params = params;
+
+        stream_record record = {e_stream_state::queued, PEN_INVALID_HANDLE};
+        sb_push(s_stream_records, record);
+        sb_push(s_stream_queue, entry);
+
+        s_stream_progress.total++;
+
+        return entry->handle;
+    }
+
+    u32 stream_texture(const c8* filename, u32 priority, stream_callback cb, void* user_data)
+    {
+        texture_stream* ts = new texture_stream();
+        ts->filename = filename;
+        ts->id_name = PEN_HASH(filename);
+
+        stream_request_params params;
+        params.load = texture_stream_load;
+        params.finalise = texture_stream_finalise;
+        params.release = texture_stream_release;
+        params.data = ts;
+        params.priority = priority;
+        params.callback = cb;
+        params.user_data = user_data;
+
+        // already loaded textures skip the worker and complete on the next update
+        for (auto& t : k_texture_references)
+            if (t.id_name == ts->id_name)
+                params.load = nullptr;
+
+        return stream_request(params);
+    }
+
+    bool stream_cancel(u32 stream)
+    {
+        if (stream >= (u32)sb_count(s_stream_records))
+            return false;
+
+        u32 state = s_stream_records[stream].state;
+
+        if (state == e_stream_state::queued)
+        {
+            u32 num_queued = sb_count(s_stream_queue);
+            for (u32 i = 0; i < num_queued; ++i)
+            {
+                stream_entry* entry = s_stream_queue[i];
+                if (entry->handle != stream)
+                    continue;
+
+                for (u32 j = i; j < num_queued - 1; ++j)
+                    s_stream_queue[j] = s_stream_queue[j + 1];
+                stb__sbn(s_stream_queue)--;
+
+                stream_finish(entry, e_stream_state::cancelled, PEN_INVALID_HANDLE);
+                return true;
+            }
+        }
+        else if (state == e_stream_state::loading || state == e_stream_state::loaded)
+        {
+            // in flight requests are released once the worker has finished with them
+            u32 num_in_flight = sb_count(s_stream_in_flight);
+            for (u32 i = 0; i < num_in_flight; ++i)
+            {
+                if (s_stream_in_flight[i]->handle == stream)
+                {
+                    s_stream_in_flight[i]->cancelled = 1;
+                    return true;
+                }
+            }
+        }
+
+        return false;
+    }
+
+    u32 stream_get_state(u32 stream)
+    {
+        if (stream >= (u32)sb_count(s_stream_records))
+            return e_stream_state::invalid;
+
+        return s_stream_records[stream].state;
+    }
+
+    u32 stream_get_resource(u32 stream)
+    {
+        if (stream >= (u32)sb_count(s_stream_records))
+            return PEN_INVALID_HANDLE;
+
+        return s_stream_records[stream].resource;
+    }
+
+    stream_progress stream_get_progress()
+    {
+        stream_progress p = s_stream_progress;
+        p.ratio = p.total ? (f32)p.finished / (f32)p.total : 1.0f;
+        return p;
+    }
+
+    void stream_set_limits(u32 max_in_flight, u32 finalise_per_update)
+    {
+        s_stream_max_in_flight = max_in_flight;
+        s_stream_finalise_budget = std::max<u32>(finalise_per_update, 1);
+    }
+
+    void stream_update()
+    {
+        stream_update_internal(s_stream_finalise_budget);
+    }
+
+    void stream_flush()
+    {
+        while (sb_count(s_stream_queue) || sb_count(s_stream_in_flight))
+        {
+            stream_update_internal(-1);
+
+            if (sb_count(s_stream_in_flight))
+                pen::jobs_wait_for_counter(&s_stream_in_flight[0]->counter);
+        }
+    }
 } // namespace put
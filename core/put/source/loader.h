@@ -20,6 +20,71 @@ namespace put
     Str  get_texture_filename(u32 handle);
     void texture_browser_ui();
 
+    // Streaming
+    // requests return a handle immediately, load runs on the task system (file io and decoding) and finalise runs on the
+    // main thread in stream_update, where gpu resources are created and the callback is called.
+    // higher priority requests are dispatched first and requests can be cancelled until they are finalised.
+    // handles are never reused so the state of any request can be queried at any time, this costs 8 bytes per request
+    // for the lifetime of the program.
+    namespace e_stream_priority
+    {
+        enum stream_priority_t
+        {
+            low,
+            normal,
+            high,
+            COUNT
+        };
+    }
+
+    namespace e_stream_state
+    {
+        enum stream_state_t
+        {
+            invalid,
+            queued,
+            loading,
+            loaded, // waiting to be finalised on the main thread
+            complete,
+            failed,
+            cancelled
+        };
+    }
+
+    typedef bool (*stream_load_func)(void* data);    // worker thread, null if there is nothing to load
+    typedef u32 (*stream_finalise_func)(void* data); // main thread, returns the resource handle
+    typedef void (*stream_release_func)(void* data); // main thread, after finalise, failure or cancellation
+    typedef void (*stream_callback)(u32 stream, u32 state, u32 resource, void* user_data);
+
+    struct stream_request_params
+    {
+        stream_load_func     load = nullptr;
+        stream_finalise_func finalise = nullptr;
+        stream_release_func  release = nullptr;
+        void*                data = nullptr;
+        u32                  priority = e_stream_priority::normal;
+        stream_callback      callback = nullptr;
+        void*                user_data = nullptr;
+    };
+
+    struct stream_progress
+    {
+        u32 total = 0;    // requests made since the streamer was last idle
+        u32 finished = 0; // complete, failed or cancelled
+        f32 ratio = 1.0f;
+    };
+
+    u32             stream_request(const stream_request_params& params);
+    u32             stream_texture(const c8* filename, u32 priority = e_stream_priority::normal, stream_callback cb = nullptr,
+                                   void* user_data = nullptr);
+    bool            stream_cancel(u32 stream);
+    u32             stream_get_state(u32 stream);
+    u32             stream_get_resource(u32 stream);
+    stream_progress stream_get_progress();
+    void            stream_set_limits(u32 max_in_flight, u32 finalise_per_update); // 0 in flight = num task workers
+    void            stream_update(); // call once per frame on the main thread
+    void            stream_flush();  // blocks until all requests have finished
+
     // Hot loading
     void init_hot_loader();
     void poll_hot_loader();
@@ -171,7 +171,11 @@ namespace put
                 aux = 1 << 1,
                 aux_used = 1 << 2,
                 write_only = 1 << 3,
-                resolve = 1 << 4
+                resolve = 1 << 4,
+                transient = 1 << 5, // contents only live within a frame, the render graph may alias or cull the target
+                aliased = 1 << 6,   // shares the handle of another transient target with a disjoint lifetime
+                culled = 1 << 7,    // only used by culled views, the target is not allocated
+                external = 1 << 8   // transient target accessed outside of the views, cannot be aliased or culled
             };
         }
 
@@ -238,6 +242,8 @@ namespace put
             hash_id   id_sub_type;
             Str       name;
             bool      loaded = false;
+            bool      pending = false; // queued for async compile
+            hash_id   id_inputs;       // hash of the vertex and instance inputs, placeholders must match
             pen::json info;
 
             u32 vertex_shader;
@@ -289,6 +295,18 @@ namespace put
             const c8* format = nullptr;
         };
 
+        struct render_graph_stats
+        {
+            u32    num_passes = 0;
+            u32    num_culled_passes = 0;
+            u32    num_transient_targets = 0; // transient targets used by live passes
+            u32    num_physical_targets = 0;  // allocations backing the transient targets after aliasing
+            size_t transient_bytes = 0;       // transient target memory without aliasing
+            size_t physical_bytes = 0;        // transient target memory allocated after aliasing
+            size_t peak_bytes = 0;            // largest amount of transient target memory live during a single pass
+            size_t culled_bytes = 0;          // memory of targets released because all of their views were culled
+        };
+
         // pmfx renderer ---------------------------------------------------------------------------------------------------
 
         void init(const c8* filename);
@@ -307,11 +325,15 @@ namespace put
         void resize_render_target(hash_id target, const rt_resize_params& params);
         void resize_viewports();
 
+        // views are compiled into a graph from their targets and sampler bindings after loading, views which only write
+        // transient targets nobody reads are culled and transient targets with disjoint lifetimes share allocations.
+        render_graph_stats get_render_graph_stats();
+
         void set_view_set(const c8* name);
 
         camera*              get_camera(hash_id id_name);
         camera**             get_cameras(); // call sb_free on return value when done
-        const render_target* get_render_target(hash_id h);
+        const render_target* get_render_target(hash_id h); // pins transient targets, see e_rt_flags::external
         void                 get_render_target_dimensions(const render_target* rt, f32& w, f32& h);
         u32                  get_render_state(hash_id id_name, u32 type);
         Str                  get_render_state_name(u32 handle);
@@ -352,6 +374,18 @@ namespace put
         bool has_technique_samplers(u32 shader, u32 technique_index);
         bool has_technique_params(u32 shader, u32 technique_index);
 
+        // async compile, byte code is read on the task system and techniques are created over subsequent frames.
+        // while pending a loaded permutation of the same technique with matching vertex inputs is used as a placeholder,
+        // when there is no compatible placeholder the technique is loaded synchronously.
+        void set_async_shader_compile(bool enable, u32 techniques_per_frame = 4);
+        u32  get_technique_index_perm_async(u32 shader, hash_id id_technique, u32 permutation = 0);
+        u32  get_loaded_technique_index_perm(u32 shader, hash_id id_technique, u32 permutation = 0); // invalid if pending
+        void warm_up_shader_techniques(u32 shader);
+        void warm_up_shader_techniques(ecs::ecs_scene* scene); // queues the material and instanced permutations
+        void update_shader_compile_queue();                    // called from render
+        void flush_shader_compile_queue();                     // blocks until all queued techniques are created
+        u32  get_num_pending_shader_techniques();
+
         void poll_for_changes();
     } // namespace pmfx
 } // namespace put
@@ -22,6 +22,7 @@
 #include "str_utilities.h"
 #include "timer.h"
 
+#include <algorithm>
 #include <fstream>
 
 #include "shader_structs/post_process.h"
@@ -300,6 +301,10 @@ namespace
         bool stash_output = false;
         u32  stashed_output_rt = PEN_INVALID_HANDLE;
         f32  stashed_rt_aspect = 0.0f;
+
+        // render graph
+        bool culled = false;
+        bool pinned = false; // targets were taken out of the graph by an explicit render_view
     };
 
     struct edited_post_process
@@ -374,6 +379,7 @@ namespace
     geometry_utility                     s_geometry;
     std::vector<Str>                     s_script_files;
     bool                                 s_reload = false;
+    bool                                 s_render_graph_dirty = false;
 
     // ids
 } // namespace
@@ -453,6 +459,25 @@ namespace put
             }
         }
 
+        u32 find_render_target_index(hash_id h)
+        {
+            size_t num = s_render_targets.size();
+            for (u32 i = 0; i < num; ++i)
+                if (s_render_targets[i].id_name == h)
+                    return i;
+
+            return PEN_INVALID_HANDLE;
+        }
+
+        render_target* find_render_target(hash_id h)
+        {
+            u32 i = find_render_target_index(h);
+            if (!is_valid(i))
+                return nullptr;
+
+            return &s_render_targets[i];
+        }
+
         u32 mode_from_string(const mode_map* map, const c8* str, u32 default_value)
         {
             if (!str)
@@ -602,7 +627,7 @@ namespace put
 
                 // texture id and handle from render targets.. todo add global textures
                 sb.id_texture = binding["texture"].as_hash_id();
-                const render_target* rt = get_render_target(sb.id_texture);
+                const render_target* rt = find_render_target(sb.id_texture);
 
                 if (!rt)
                 {
@@ -1271,6 +1296,11 @@ namespace put
                         tcp.sample_count = r["samples"].as_u32(1);
                         tcp.sample_quality = 0;
 
+                        // ping pong and cpu readable targets live across frames
+                        if (r["transient"].as_bool(false))
+                            if (new_info.pp != e_vrt_mode::write && tcp.cpu_access_flags == 0)
+                                new_info.flags |= e_rt_flags::transient;
+
                         new_info.samples = tcp.sample_count;
                         new_info.handle = pen::renderer_create_render_target(tcp);
                         new_info.bind_flags = tcp.bind_flags;
@@ -1279,18 +1309,456 @@ namespace put
             }
         }
 
-        const render_target* get_render_target(hash_id h)
+        namespace
         {
-            size_t num = s_render_targets.size();
-            for (u32 i = 0; i < num; ++i)
+            struct graph_pass
             {
-                if (s_render_targets[i].id_name == h)
+                Str              name;
+                std::vector<u32> reads; // render target indices
+                std::vector<u32> writes;
+                std::vector<u32> deps; // passes which last wrote the targets this pass reads or writes
+                bool             post_process;
+                bool             cullable;
+                bool             culled = false;
+            };
+
+            struct graph_target
+            {
+                u32  rt_index;
+                u32  first; // first and last live pass using the target
+                u32  last;
+                u32  slot;
+                bool first_write; // if the first use is a read the contents carry over from the previous frame
+            };
+
+            struct graph_slot
+            {
+                u32 owner; // render target index of the allocation
+                u32 last;  // last pass using the allocation, PEN_INVALID_HANDLE if it cannot be shared
+            };
+
+            struct render_graph
+            {
+                std::vector<graph_pass>   passes;
+                std::vector<graph_target> targets; // transient targets used by live passes
+                std::vector<graph_slot>   slots;
+                std::vector<u32>          culled_targets;
+            };
+            render_graph s_render_graph;
+
+            bool is_transient(const render_target& rt)
+            {
+                if (rt.flags & (e_rt_flags::aux | e_rt_flags::external))
+                    return false;
+
+                return rt.flags & e_rt_flags::transient;
+            }
+
+            size_t render_target_bytes(u32 rt_index)
+            {
+                const render_target&                rt = s_render_targets[rt_index];
+                const pen::texture_creation_params& tcp = s_render_target_tcp[rt_index];
+
+                f32 w, h;
+                get_rt_dimensions(rt.width, rt.height, rt.ratio, w, h);
+
+                size_t pixels = (size_t)w * (size_t)h * std::max<u32>(tcp.num_arrays, 1);
+                if (tcp.num_mips > 1)
+                    pixels += pixels / 3;
+
+                // msaa targets also have a resolve surface
+                size_t bytes = pixels * tcp.block_size / 8;
+                return bytes * tcp.sample_count + (tcp.sample_count > 1 ? bytes : 0);
+            }
+
+            bool render_targets_compatible(u32 a, u32 b)
+            {
+                const pen::texture_creation_params& ta = s_render_target_tcp[a];
+                const pen::texture_creation_params& tb = s_render_target_tcp[b];
+
+                bool match = true;
+                match &= ta.width == tb.width;
+                match &= ta.height == tb.height;
+                match &= ta.format == tb.format;
+                match &= ta.num_mips == tb.num_mips;
+                match &= ta.num_arrays == tb.num_arrays;
+                match &= ta.sample_count == tb.sample_count;
+                match &= ta.collection_type == tb.collection_type;
+                match &= ta.bind_flags == tb.bind_flags;
+                return match;
+            }
+
+            void patch_view_target(view_params& v, hash_id id, u32 handle)
+            {
+                for (u32 i = 0; i < v.num_colour_targets; ++i)
+                    if (v.id_render_target[i] == id)
+                        v.render_targets[i] = handle;
+
+                if (v.id_depth_target == id)
+                    v.depth_target = handle;
+
+                for (auto& sb : v.sampler_bindings)
+                    if (sb.id_texture == id)
+                        sb.handle = handle;
+
+                for (auto& pv : v.post_process_views)
+                    patch_view_target(pv, id, handle);
+            }
+
+            void set_render_target_handle(u32 rt_index, u32 handle)
+            {
+                render_target& rt = s_render_targets[rt_index];
+                rt.handle = handle;
+
+                for (auto& v : s_views)
+                    patch_view_target(v, rt.id_name, handle);
+            }
+
+            void restore_transient_targets()
+            {
+                // give aliased and culled targets back their own allocation, aux targets have no creation params
+                u32 num = (u32)s_render_target_tcp.size();
+                for (u32 i = 0; i < num; ++i)
+                {
+                    render_target& rt = s_render_targets[i];
+                    if (!(rt.flags & (e_rt_flags::aliased | e_rt_flags::culled)))
+                        continue;
+
+                    rt.flags &= ~(e_rt_flags::aliased | e_rt_flags::culled);
+                    set_render_target_handle(i, pen::renderer_create_render_target(s_render_target_tcp[i]));
+                }
+            }
+
+            void pin_render_target(u32 rt_index)
+            {
+                render_target& rt = s_render_targets[rt_index];
+                if (!is_transient(rt))
+                    return;
+
+                dev_console_log_level(dev_ui::console_level::warning,
+                                      "[warning] pmfx: transient render target '%s' is accessed outside of the render graph, "
+                                      "it will not be aliased or culled",
+                                      rt.name.c_str());
+
+                rt.flags |= e_rt_flags::external;
+                restore_transient_targets();
+                s_render_graph_dirty = true;
+            }
+
+            void pin_view_targets(const view_params& v)
+            {
+                std::vector<hash_id> ids;
+                for (u32 i = 0; i < v.num_colour_targets; ++i)
+                    ids.push_back(v.id_render_target[i]);
+
+                ids.push_back(v.id_depth_target);
+
+                for (auto& sb : v.sampler_bindings)
+                    ids.push_back(sb.id_texture);
+
+                for (hash_id id : ids)
                 {
-                    return &s_render_targets[i];
+                    u32 i = find_render_target_index(id);
+                    if (is_valid(i))
+                        pin_render_target(i);
                 }
             }
 
-            return nullptr;
+            void add_graph_resource(std::vector<u32>& list, hash_id id)
+            {
+                u32 i = find_render_target_index(id);
+                if (is_valid(i))
+                    list.push_back(i);
+            }
+
+            void add_graph_pass(view_params& v, bool post_process, std::vector<view_params*>& pass_views)
+            {
+                v.culled = false;
+
+                graph_pass p;
+                p.name = v.name.empty() ? v.group : v.name;
+                p.post_process = post_process;
+
+                // abstract views have no declared targets, compute views can write to buffers and post process chains
+                // are baked as a whole, so none of them can be culled
+                p.cullable = !post_process;
+                p.cullable &= !(v.view_flags & (e_view_flags::abstract | e_view_flags::compute));
+                p.cullable &= !(v.post_process_flags & e_pp_flags::enabled);
+
+                for (u32 i = 0; i < v.num_colour_targets; ++i)
+                    add_graph_resource(p.writes, v.id_render_target[i]);
+
+                if (v.id_depth_target)
+                    add_graph_resource(p.writes, v.id_depth_target);
+
+                for (auto& sb : v.sampler_bindings)
+                    add_graph_resource(p.reads, sb.id_texture);
+
+                s_render_graph.passes.push_back(p);
+                pass_views.push_back(&v);
+            }
+
+            void add_graph_target_use(u32 pass, const std::vector<u32>& list, bool write, std::vector<u32>& graph_index,
+                                      const std::vector<bool>& transient)
+            {
+                for (u32 r : list)
+                {
+                    if (!transient[r])
+                        continue;
+
+                    if (!is_valid(graph_index[r]))
+                    {
+                        graph_index[r] = (u32)s_render_graph.targets.size();
+
+                        graph_target gt;
+                        gt.rt_index = r;
+                        gt.first = pass;
+                        gt.first_write = write;
+                        s_render_graph.targets.push_back(gt);
+                    }
+
+                    s_render_graph.targets[graph_index[r]].last = pass;
+                }
+            }
+
+            void compile_render_graph()
+            {
+                restore_transient_targets();
+
+                s_render_graph = render_graph();
+                s_render_graph_dirty = false;
+
+                // passes in the order render dispatches them
+                std::vector<view_params*> pass_views;
+                for (auto& v : s_views)
+                {
+                    if (v.view_flags & e_view_flags::template_view)
+                        continue;
+
+                    add_graph_pass(v, false, pass_views);
+
+                    if (v.post_process_flags & e_pp_flags::enabled)
+                        for (auto& pv : v.post_process_views)
+                            add_graph_pass(pv, true, pass_views);
+                }
+
+                u32 num_rt = (u32)s_render_targets.size();
+                u32 num_passes = (u32)s_render_graph.passes.size();
+
+                // targets used by templates are rendered from elsewhere, post process writes may go to aux copies and
+                // init_read targets are read before they are written, none of them can be aliased or culled
+                std::vector<bool> transient(num_rt, false);
+                for (u32 i = 0; i < num_rt; ++i)
+                    transient[i] = is_transient(s_render_targets[i]);
+
+                for (u32 i = 0; i < num_rt; ++i)
+                    if (is_valid(s_render_targets[i].pp_read))
+                        transient[s_render_targets[i].pp_read] = false;
+
+                for (auto& v : s_views)
+                {
+                    if (!(v.view_flags & e_view_flags::template_view))
+                        continue;
+
+                    std::vector<view_params*> template_views;
+                    add_graph_pass(v, false, template_views);
+
+                    graph_pass& tp = s_render_graph.passes.back();
+                    for (u32 r : tp.reads)
+                        transient[r] = false;
+                    for (u32 w : tp.writes)
+                        transient[w] = false;
+
+                    s_render_graph.passes.pop_back();
+                }
+
+                for (auto& gp : s_render_graph.passes)
+                    if (gp.post_process)
+                        for (u32 w : gp.writes)
+                            transient[w] = false;
+
+                // dependencies on the last writer of anything a pass reads or writes
+                std::vector<u32> last_writer(num_rt, PEN_INVALID_HANDLE);
+                for (u32 p = 0; p < num_passes; ++p)
+                {
+                    graph_pass& gp = s_render_graph.passes[p];
+
+                    for (u32 i = 0; i < 2; ++i)
+                    {
+                        for (u32 r : i == 0 ? gp.reads : gp.writes)
+                        {
+                            u32 lw = last_writer[r];
+                            if (is_valid(lw) && std::find(gp.deps.begin(), gp.deps.end(), lw) == gp.deps.end())
+                                gp.deps.push_back(lw);
+                        }
+                    }
+
+                    for (u32 w : gp.writes)
+                        last_writer[w] = p;
+                }
+
+                // walk back from the passes which must run keeping the writers of anything they use, writes may be
+                // partial so earlier writers of the same target are kept too
+                std::vector<bool> live(num_rt, false);
+                for (s32 p = num_passes - 1; p >= 0; --p)
+                {
+                    graph_pass& gp = s_render_graph.passes[p];
+
+                    bool keep = !gp.cullable || gp.writes.empty();
+                    for (u32 w : gp.writes)
+                        keep = keep || live[w] || !transient[w];
+
+                    if (!keep)
+                    {
+                        gp.culled = true;
+                        pass_views[p]->culled = true;
+                        continue;
+                    }
+
+                    for (u32 r : gp.reads)
+                        live[r] = true;
+
+                    for (u32 w : gp.writes)
+                        live[w] = true;
+                }
+
+                // lifetimes of the transient targets over the live passes
+                std::vector<u32> graph_index(num_rt, PEN_INVALID_HANDLE);
+                for (u32 p = 0; p < num_passes; ++p)
+                {
+                    graph_pass& gp = s_render_graph.passes[p];
+                    if (gp.culled)
+                        continue;
+
+                    add_graph_target_use(p, gp.reads, false, graph_index, transient);
+                    add_graph_target_use(p, gp.writes, true, graph_index, transient);
+                }
+
+                // release targets which are only used by culled passes
+                for (auto& gp : s_render_graph.passes)
+                {
+                    if (!gp.culled)
+                        continue;
+
+                    for (u32 i = 0; i < 2; ++i)
+                    {
+                        for (u32 r : i == 0 ? gp.reads : gp.writes)
+                        {
+                            render_target& rt = s_render_targets[r];
+                            if (!transient[r] || is_valid(graph_index[r]) || (rt.flags & e_rt_flags::culled))
+                                continue;
+
+                            pen::renderer_release_render_target(rt.handle);
+                            rt.flags |= e_rt_flags::culled;
+                            set_render_target_handle(r, PEN_INVALID_HANDLE);
+                            s_render_graph.culled_targets.push_back(r);
+                        }
+                    }
+                }
+
+                // assign targets to allocations in order of first use, reusing any compatible allocation whose last
+                // use has passed. targets read before they are written this frame keep an allocation to themselves
+                for (auto& gt : s_render_graph.targets)
+                {
+                    if (!gt.first_write)
+                    {
+                        gt.first = 0;
+                        gt.last = num_passes - 1;
+                    }
+
+                    u32 slot = PEN_INVALID_HANDLE;
+                    if (gt.first_write)
+                    {
+                        u32 num_slots = (u32)s_render_graph.slots.size();
+                        for (u32 s = 0; s < num_slots; ++s)
+                        {
+                            graph_slot& gs = s_render_graph.slots[s];
+                            if (gs.last < gt.first && render_targets_compatible(gs.owner, gt.rt_index))
+                            {
+                                slot = s;
+                                break;
+                            }
+                        }
+                    }
+
+                    if (!is_valid(slot))
+                    {
+                        slot = (u32)s_render_graph.slots.size();
+                        s_render_graph.slots.push_back({gt.rt_index, gt.first_write ? gt.last : PEN_INVALID_HANDLE});
+                    }
+                    else
+                    {
+                        graph_slot& gs = s_render_graph.slots[slot];
+                        gs.last = gt.last;
+
+                        render_target& rt = s_render_targets[gt.rt_index];
+                        pen::renderer_release_render_target(rt.handle);
+                        rt.flags |= e_rt_flags::aliased;
+                        set_render_target_handle(gt.rt_index, s_render_targets[gs.owner].handle);
+                    }
+
+                    gt.slot = slot;
+                }
+
+                if (s_render_graph.targets.empty() && s_render_graph.culled_targets.empty())
+                    return;
+
+                render_graph_stats stats = get_render_graph_stats();
+                dev_console_log_level(dev_ui::console_level::message,
+                                      "[pmfx] render graph: %i passes (%i culled), %i transient targets in %i allocations, "
+                                      "peak %.2fmb, allocated %.2fmb, unaliased %.2fmb",
+                                      stats.num_passes, stats.num_culled_passes, stats.num_transient_targets,
+                                      stats.num_physical_targets, (f32)stats.peak_bytes / 1024.0f / 1024.0f,
+                                      (f32)stats.physical_bytes / 1024.0f / 1024.0f,
+                                      (f32)stats.transient_bytes / 1024.0f / 1024.0f);
+            }
+        } // namespace
+
+        render_graph_stats get_render_graph_stats()
+        {
+            render_graph_stats stats;
+
+            u32 num_passes = (u32)s_render_graph.passes.size();
+            stats.num_passes = num_passes;
+            for (auto& gp : s_render_graph.passes)
+                if (gp.culled)
+                    ++stats.num_culled_passes;
+
+            stats.num_transient_targets = (u32)s_render_graph.targets.size();
+            stats.num_physical_targets = (u32)s_render_graph.slots.size();
+
+            // sizes are evaluated here because ratio targets follow the window size
+            std::vector<size_t> live_bytes(num_passes, 0);
+            for (auto& gt : s_render_graph.targets)
+            {
+                size_t bytes = render_target_bytes(gt.rt_index);
+                stats.transient_bytes += bytes;
+
+                for (u32 p = gt.first; p <= gt.last; ++p)
+                    live_bytes[p] += bytes;
+            }
+
+            for (size_t b : live_bytes)
+                stats.peak_bytes = std::max<size_t>(stats.peak_bytes, b);
+
+            for (auto& gs : s_render_graph.slots)
+                stats.physical_bytes += render_target_bytes(gs.owner);
+
+            for (u32 r : s_render_graph.culled_targets)
+                stats.culled_bytes += render_target_bytes(r);
+
+            return stats;
+        }
+
+        const render_target* get_render_target(hash_id h)
+        {
+            u32 i = find_render_target_index(h);
+            if (!is_valid(i))
+                return nullptr;
+
+            // callers outside of the views may read the target at any time
+            pin_render_target(i);
+            return &s_render_targets[i];
         }
 
         void resize_render_target(hash_id target, const rt_resize_params& params)
@@ -1312,6 +1780,12 @@ namespace put
                 }
             }
 
+            if (!current_target)
+                return;
+
+            // a resized transient target can no longer share an allocation
+            pin_render_target(ii);
+
             s32 new_format = current_target->format;
             u32 format_index = 0;
 
@@ -1423,7 +1897,7 @@ namespace put
                     if (s_views[i].id_render_target[j] == 0)
                         continue;
 
-                    const render_target* rt = get_render_target(s_views[i].id_render_target[j]);
+                    const render_target* rt = find_render_target(s_views[i].id_render_target[j]);
 
                     if (!first)
                     {
@@ -2531,6 +3005,8 @@ namespace put
                 }
             }
 
+            compile_render_graph();
+
             // rebake material handles
             ecs::bake_material_handles();
         }
@@ -2623,6 +3099,10 @@ namespace put
                 if (rt.id_name == k_id_main_depth)
                     continue;
 
+                // aliased targets share another targets handle and culled targets have none
+                if (rt.flags & (e_rt_flags::aliased | e_rt_flags::culled))
+                    continue;
+
                 pen::renderer_release_render_target(rt.handle);
             }
 
@@ -2641,6 +3121,7 @@ namespace put
             s_post_process_names.clear();
             s_virtual_rt.clear();
             s_partial_blend_states.clear();
+            s_render_graph = render_graph();
 
             clear_render_states();
         }
@@ -3056,6 +3537,15 @@ namespace put
             {
                 if (v.id_name == view)
                 {
+                    // explicitly rendered views are live, so their targets are taken out of the graph
+                    if (!v.pinned)
+                    {
+                        pin_view_targets(v);
+                        v.pinned = true;
+                    }
+
+                    v.culled = false;
+
                     render_view(v);
                     return;
                 }
@@ -3079,12 +3569,19 @@ namespace put
         void render()
         {
             reload();
+            update_shader_compile_queue();
+
+            if (s_render_graph_dirty)
+                compile_render_graph();
 
             for (auto& v : s_views)
             {
                 if (v.view_flags & e_view_flags::template_view)
                     continue;
 
+                if (v.culled)
+                    continue;
+
                 if (v.view_flags & e_view_flags::abstract)
                 {
                     render_abstract_view(v);
@@ -3128,6 +3625,52 @@ namespace put
             }
 
             ImGui::Text("Size: %f (mb)", (f32)image_size / 1024.0f / 1024.0f);
+
+            if (rt.flags & e_rt_flags::transient)
+            {
+                const c8* state = "";
+                if (rt.flags & e_rt_flags::external)
+                    state = " (external)";
+                else if (rt.flags & e_rt_flags::aliased)
+                    state = " (aliased)";
+                else if (rt.flags & e_rt_flags::culled)
+                    state = " (culled)";
+
+                ImGui::Text("Transient%s", state);
+            }
+        }
+
+        void render_graph_ui()
+        {
+            render_graph_stats stats = get_render_graph_stats();
+
+            ImGui::Text("Passes: %i (%i culled)", stats.num_passes, stats.num_culled_passes);
+            ImGui::Text("Transient Targets: %i in %i allocations", stats.num_transient_targets, stats.num_physical_targets);
+            ImGui::Text("Peak Transient: %f (mb)", (f32)stats.peak_bytes / 1024.0f / 1024.0f);
+            ImGui::Text("Allocated: %f (mb)", (f32)stats.physical_bytes / 1024.0f / 1024.0f);
+            ImGui::Text("Unaliased: %f (mb)", (f32)stats.transient_bytes / 1024.0f / 1024.0f);
+            ImGui::Text("Culled: %f (mb)", (f32)stats.culled_bytes / 1024.0f / 1024.0f);
+
+            ImGui::Separator();
+
+            u32 num_passes = (u32)s_render_graph.passes.size();
+            for (u32 p = 0; p < num_passes; ++p)
+            {
+                const graph_pass& gp = s_render_graph.passes[p];
+
+                Str deps = "";
+                for (u32 d : gp.deps)
+                {
+                    if (!deps.empty())
+                        deps.append(", ");
+
+                    deps.append(s_render_graph.passes[d].name.c_str());
+                }
+
+                ImGui::Text("%i: %s%s", p, gp.name.c_str(), gp.culled ? " (culled)" : "");
+                if (!deps.empty())
+                    ImGui::Text("    depends on: %s", deps.c_str());
+            }
         }
 
         void view_info_ui(const view_params& v)
@@ -3137,20 +3680,20 @@ namespace put
 
             for (u32 i = 0; i < v.num_colour_targets; ++i)
             {
-                const render_target* rt = get_render_target(v.id_render_target[i]);
+                const render_target* rt = find_render_target(v.id_render_target[i]);
                 ImGui::Text("colour target %i: %s (%i)", i, rt->name.c_str(), v.render_targets[i]);
             }
 
             if (is_valid(v.depth_target) && v.depth_target)
             {
-                const render_target* rt = get_render_target(v.id_depth_target);
+                const render_target* rt = find_render_target(v.id_depth_target);
                 ImGui::Text("depth target: %s (%i)", rt->name.c_str(), v.depth_target);
             }
 
             int isb = 0;
             for (auto& sb : v.sampler_bindings)
             {
-                const render_target* rt = get_render_target(sb.id_texture);
+                const render_target* rt = find_render_target(sb.id_texture);
                 ImGui::Text("input sampler %i: %s (%i)", isb, rt->name.c_str(), sb.handle);
                 ++isb;
             }
@@ -3538,6 +4081,7 @@ namespace put
 
                     bool unsupported_display = rt.id_name == k_id_main_colour || rt.id_name == k_id_main_depth;
                     unsupported_display |= rt.format == PEN_TEX_FORMAT_R32_UINT;
+                    unsupported_display |= !is_valid(rt.handle);
 
                     if (!unsupported_display)
                     {
@@ -3587,6 +4131,11 @@ namespace put
                     ImGui::Unindent();
                 }
 
+                if (ImGui::CollapsingHeader("Render Graph"))
+                {
+                    render_graph_ui();
+                }
+
                 if (ImGui::CollapsingHeader("Post Processing"))
                 {
                     pp_ui();
@@ -20,6 +20,7 @@
 #include "pen_json.h"
 #include "pen_string.h"
 #include "renderer.h"
+#include "threads.h"
 
 using namespace put;
 using namespace pmfx;
@@ -45,11 +46,95 @@ namespace
         u32             rebuild_ts = 0;
     };
 
-    pmfx_shader*  s_pmfx_list = nullptr;
-    const char**  s_shader_names = nullptr;
-    const char*** s_technique_names = nullptr;
-    hash_id**     s_technique_id_names = nullptr;
-    u32           s_num_shader_names = 0;
+    namespace e_technique_file
+    {
+        enum technique_file_t
+        {
+            vs,
+            ps,
+            cs,
+            COUNT
+        };
+    }
+
+    // shader byte code for a technique, filenames are resolved on the main thread so the files can be read on a worker
+    struct technique_byte_code
+    {
+        Str   filename[e_technique_file::COUNT];
+        void* data[e_technique_file::COUNT] = {nullptr};
+        u32   size[e_technique_file::COUNT] = {0};
+    };
+
+    struct compile_request
+    {
+        u32                 shader = 0;
+        u32                 technique_index = 0;
+        technique_byte_code byte_code;
+        pen::task_counter   counter;
+    };
+
+    pmfx_shader*      s_pmfx_list = nullptr;
+    const char**      s_shader_names = nullptr;
+    const char***     s_technique_names = nullptr;
+    hash_id**         s_technique_id_names = nullptr;
+    u32               s_num_shader_names = 0;
+    compile_request** s_compile_queue = nullptr;
+    bool              s_async_compile = false;
+    u32               s_compile_budget = 4; // techniques created per frame
+
+    void get_technique_byte_code_filenames(technique_byte_code& bc, const c8* fx_filename, pen::json& j_technique)
+    {
+        static const c8* keys[] = {"vs_file", "ps_file", "cs_file"};
+        static_assert(PEN_ARRAY_SIZE(keys) == e_technique_file::COUNT, "mismatched array size");
+
+        const c8* sfp = pen::renderer_get_shader_platform();
+
+        // compute techniques only have a cs, traditional techniques always read a vs and ps
+        bool compute = !j_technique["cs"].as_str().empty();
+
+        for (u32 i = 0; i < e_technique_file::COUNT; ++i)
+        {
+            if (compute != (i == e_technique_file::cs))
+                continue;
+
+            c8  buf[256];
+            Str file = j_technique[keys[i]].as_str();
+            pen::string_format(buf, 256, "data/pmfx/%s/%s/%s", sfp, fx_filename, file.c_str());
+            bc.filename[i] = buf;
+        }
+    }
+
+    void read_technique_byte_code(technique_byte_code& bc)
+    {
+        for (u32 i = 0; i < e_technique_file::COUNT; ++i)
+        {
+            if (bc.filename[i].empty())
+                continue;
+
+            pen_error err = pen::filesystem_read_file_to_buffer(bc.filename[i].c_str(), &bc.data[i], bc.size[i]);
+            if (err != PEN_ERR_OK)
+            {
+                pen::memory_free(bc.data[i]);
+                bc.data[i] = nullptr;
+                bc.size[i] = 0;
+            }
+        }
+    }
+
+    void free_technique_byte_code(technique_byte_code& bc)
+    {
+        for (u32 i = 0; i < e_technique_file::COUNT; ++i)
+        {
+            pen::memory_free(bc.data[i]);
+            bc.data[i] = nullptr;
+        }
+    }
+
+    void read_byte_code_task(void* user_data)
+    {
+        compile_request* req = (compile_request*)user_data;
+        read_technique_byte_code(req->byte_code);
+    }
 } // namespace
 
 namespace put
@@ -276,6 +361,13 @@ namespace put
             }
         }
 
+        hash_id get_technique_inputs_hash(pen::json& j_technique)
+        {
+            Str inputs = j_technique["vs_inputs"].dumps();
+            inputs.append(j_technique["instance_inputs"].dumps().c_str());
+            return PEN_HASH(inputs.c_str());
+        }
+
         shader_program preload_shader_technique(const c8* fx_filename, pen::json& j_technique, pen::json& j_info)
         {
             shader_program program = {};
@@ -287,12 +379,13 @@ namespace put
             program.id_sub_type = PEN_HASH("");
             program.permutation_id = j_technique["permutation_id"].as_u32();
             program.permutation_option_mask = j_technique["permutation_option_mask"].as_u32();
+            program.id_inputs = get_technique_inputs_hash(j_technique);
             program.info = j_technique;
 
             return program;
         }
 
-        shader_program load_shader_technique(const c8* fx_filename, pen::json& j_technique, pen::json& j_info)
+        shader_program load_shader_technique(pen::json& j_technique, pen::json& j_info, const technique_byte_code& bc)
         {
             shader_program program = {};
 
@@ -303,30 +396,20 @@ namespace put
             program.id_sub_type = PEN_HASH("");
             program.permutation_id = j_technique["permutation_id"].as_u32();
             program.permutation_option_mask = j_technique["permutation_option_mask"].as_u32();
+            program.id_inputs = get_technique_inputs_hash(j_technique);
             program.info = j_technique;
 
-            const c8* sfp = pen::renderer_get_shader_platform();
-
             // compute shader
             Str cs_name = j_technique["cs"].as_str();
             if (!cs_name.empty())
             {
-                c8* cs_file_buf = (c8*)pen::memory_alloc(256);
-                Str cs_filename_str = j_technique["cs_file"].as_str();
-                pen::string_format(cs_file_buf, 256, "data/pmfx/%s/%s/%s", sfp, fx_filename, cs_filename_str.c_str());
+                if (!bc.data[e_technique_file::cs])
+                    return program;
 
                 pen::shader_load_params cs_slp;
                 cs_slp.type = PEN_SHADER_TYPE_CS;
-
-                pen_error err = pen::filesystem_read_file_to_buffer(cs_file_buf, &cs_slp.byte_code, cs_slp.byte_code_size);
-
-                pen::memory_free(cs_file_buf);
-
-                if (err != PEN_ERR_OK)
-                {
-                    pen::memory_free(cs_slp.byte_code);
-                    return program;
-                }
+                cs_slp.byte_code = bc.data[e_technique_file::cs];
+                cs_slp.byte_code_size = bc.size[e_technique_file::cs];
 
                 program.compute_shader = pen::renderer_load_shader(cs_slp);
 
@@ -334,22 +417,13 @@ namespace put
             }
 
             // vertex shader
-            c8* vs_file_buf = (c8*)pen::memory_alloc(256);
-            Str vs_filename_str = j_technique["vs_file"].as_str();
-            pen::string_format(vs_file_buf, 256, "data/pmfx/%s/%s/%s", sfp, fx_filename, vs_filename_str.c_str());
+            if (!bc.data[e_technique_file::vs])
+                return program;
 
             pen::shader_load_params vs_slp;
             vs_slp.type = PEN_SHADER_TYPE_VS;
-
-            pen_error err = pen::filesystem_read_file_to_buffer(vs_file_buf, &vs_slp.byte_code, vs_slp.byte_code_size);
-
-            pen::memory_free(vs_file_buf);
-
-            if (err != PEN_ERR_OK)
-            {
-                pen::memory_free(vs_slp.byte_code);
-                return program;
-            }
+            vs_slp.byte_code = bc.data[e_technique_file::vs];
+            vs_slp.byte_code_size = bc.size[e_technique_file::vs];
 
             // vertex stream out shader
             bool stream_out = j_technique["stream_out"].as_bool();
@@ -425,23 +499,13 @@ namespace put
             pen::memory_free(vs_slp.so_decl_entries);
 
             // pixel shader
-            c8* ps_file_buf = (c8*)pen::memory_alloc(256);
-            Str ps_filename_str = j_technique["ps_file"].as_str();
-
-            pen::string_format(ps_file_buf, 256, "data/pmfx/%s/%s/%s", sfp, fx_filename, ps_filename_str.c_str());
+            if (!bc.data[e_technique_file::ps])
+                return program;
 
             pen::shader_load_params ps_slp;
             ps_slp.type = PEN_SHADER_TYPE_PS;
-
-            err = pen::filesystem_read_file_to_buffer(ps_file_buf, &ps_slp.byte_code, ps_slp.byte_code_size);
-
-            pen::memory_free(ps_file_buf);
-
-            if (err != PEN_ERR_OK)
-            {
-                pen::memory_free(ps_slp.byte_code);
-                return program;
-            }
+            ps_slp.byte_code = bc.data[e_technique_file::ps];
+            ps_slp.byte_code_size = bc.size[e_technique_file::ps];
 
             program.pixel_shader = pen::renderer_load_shader(ps_slp);
 
@@ -580,13 +644,24 @@ namespace put
             return program;
         }
 
-        void lazy_load_shader_technique(shader_program& t, u32 shader)
+        void create_shader_technique(shader_program& t, u32 shader, const technique_byte_code& bc)
         {
             auto& s = s_pmfx_list[shader];
+            t = load_shader_technique(t.info, s.info, bc);
+            t.loaded = true;
+        }
+
+        void lazy_load_shader_technique(shader_program& t, u32 shader)
+        {
             if (!t.loaded)
             {
-                t = load_shader_technique(s.filename.c_str(), t.info, s.info);
-                t.loaded = true;
+                technique_byte_code bc;
+                get_technique_byte_code_filenames(bc, s_pmfx_list[shader].filename.c_str(), t.info);
+                read_technique_byte_code(bc);
+
+                create_shader_technique(t, shader, bc);
+
+                free_technique_byte_code(bc);
             }
         }
 
@@ -769,6 +844,224 @@ namespace put
             return PEN_INVALID_HANDLE;
         }
 
+        void queue_shader_technique(u32 shader, u32 technique_index)
+        {
+            auto& t = s_pmfx_list[shader].techniques[technique_index];
+            if (t.loaded || t.pending)
+                return;
+
+            if (!s_async_compile)
+            {
+                lazy_load_shader_technique(t, shader);
+                return;
+            }
+
+            t.pending = true;
+
+            compile_request* req = new compile_request();
+            req->shader = shader;
+            req->technique_index = technique_index;
+            get_technique_byte_code_filenames(req->byte_code, s_pmfx_list[shader].filename.c_str(), t.info);
+
+            pen::task task;
+            task.func = read_byte_code_task;
+            task.user_data = req;
+            pen::jobs_run_tasks(&task, 1, &req->counter);
+
+            sb_push(s_compile_queue, req);
+        }
+
+        // a placeholder must consume the same vertex and instance streams as the pending technique
+        u32 get_placeholder_technique(u32 shader, u32 technique_index)
+        {
+            const shader_program& pending = s_pmfx_list[shader].techniques[technique_index];
+
+            u32 num_techniques = sb_count(s_pmfx_list[shader].techniques);
+            for (u32 i = 0; i < num_techniques; ++i)
+            {
+                auto& t = s_pmfx_list[shader].techniques[i];
+
+                if (!t.loaded || t.id_name != pending.id_name)
+                    continue;
+
+                if (t.id_inputs != pending.id_inputs)
+                    continue;
+
+                return i;
+            }
+
+            return PEN_INVALID_HANDLE;
+        }
+
+        u32 get_technique_index_perm_async(u32 shader, hash_id id_technique, u32 permutation)
+        {
+            if (!s_async_compile)
+                return get_technique_index_perm(shader, id_technique, permutation);
+
+            u32 num_techniques = sb_count(s_pmfx_list[shader].techniques);
+            for (u32 i = 0; i < num_techniques; ++i)
+            {
+                auto& t = s_pmfx_list[shader].techniques[i];
+
+                if (t.id_name != id_technique)
+                    continue;
+
+                u32 masked_permutation = permutation & t.permutation_option_mask;
+
+                if (t.permutation_id != masked_permutation)
+                    continue;
+
+                if (t.loaded)
+                    return i;
+
+                u32 placeholder = get_placeholder_technique(shader, i);
+                if (!is_valid(placeholder))
+                {
+                    lazy_load_shader_technique(t, shader);
+                    return i;
+                }
+
+                queue_shader_technique(shader, i);
+                return placeholder;
+            }
+
+            return PEN_INVALID_HANDLE;
+        }
+
+        u32 get_loaded_technique_index_perm(u32 shader, hash_id id_technique, u32 permutation)
+        {
+            u32 num_techniques = sb_count(s_pmfx_list[shader].techniques);
+            for (u32 i = 0; i < num_techniques; ++i)
+            {
+                auto& t = s_pmfx_list[shader].techniques[i];
+
+                if (t.id_name != id_technique)
+                    continue;
+
+                u32 masked_permutation = permutation & t.permutation_option_mask;
+
+                if (t.permutation_id != masked_permutation)
+                    continue;
+
+                // loads in place when async compile is disabled
+                queue_shader_technique(shader, i);
+
+                return t.loaded ? i : PEN_INVALID_HANDLE;
+            }
+
+            return PEN_INVALID_HANDLE;
+        }
+
+        void set_async_shader_compile(bool enable, u32 techniques_per_frame)
+        {
+            if (!enable)
+                flush_shader_compile_queue();
+
+            s_async_compile = enable;
+            s_compile_budget = std::max<u32>(techniques_per_frame, 1);
+        }
+
+        void warm_up_shader_techniques(u32 shader)
+        {
+            if (shader >= (u32)sb_count(s_pmfx_list))
+                return;
+
+            u32 num_techniques = sb_count(s_pmfx_list[shader].techniques);
+            for (u32 i = 0; i < num_techniques; ++i)
+                queue_shader_technique(shader, i);
+        }
+
+        void warm_up_shader_techniques(ecs::ecs_scene* scene)
+        {
+            for (u32 n = 0; n < scene->soa_size; ++n)
+            {
+                if (!(scene->entities[n] & e_cmp::material))
+                    continue;
+
+                u32 shader = pmfx::load_shader(scene->material_resources[n].shader_name.c_str());
+                if (!is_valid(shader))
+                    continue;
+
+                hash_id id_technique = scene->material_resources[n].id_technique;
+                u32     permutation = scene->material_permutation[n];
+
+                // the instanced permutation is selected per frame by auto instancing
+                u32 perms[] = {permutation, permutation | e_shader_permutation::instanced};
+                for (u32 p = 0; p < PEN_ARRAY_SIZE(perms); ++p)
+                {
+                    u32 num_techniques = sb_count(s_pmfx_list[shader].techniques);
+                    for (u32 i = 0; i < num_techniques; ++i)
+                    {
+                        auto& t = s_pmfx_list[shader].techniques[i];
+                        if (t.id_name == id_technique && t.permutation_id == (perms[p] & t.permutation_option_mask))
+                            queue_shader_technique(shader, i);
+                    }
+                }
+            }
+        }
+
+        void update_compile_queue(u32 budget, bool wait)
+        {
+            u32 num_requests = sb_count(s_compile_queue);
+            if (num_requests == 0)
+                return;
+
+            u32 created = 0;
+            u32 remaining = 0;
+            for (u32 i = 0; i < num_requests; ++i)
+            {
+                compile_request* req = s_compile_queue[i];
+
+                if (wait)
+                    pen::jobs_wait_for_counter(&req->counter);
+
+                if (created >= budget || !pen::jobs_counter_complete(&req->counter))
+                {
+                    s_compile_queue[remaining++] = req;
+                    continue;
+                }
+
+                // the shader may have been released or hot reloaded since the request was made, which clears pending
+                if (req->shader < (u32)sb_count(s_pmfx_list))
+                {
+                    auto& s = s_pmfx_list[req->shader];
+                    if (req->technique_index < (u32)sb_count(s.techniques))
+                    {
+                        auto& t = s.techniques[req->technique_index];
+                        if (t.pending)
+                        {
+                            create_shader_technique(t, req->shader, req->byte_code);
+                            ++created;
+                        }
+                    }
+                }
+
+                free_technique_byte_code(req->byte_code);
+                delete req;
+            }
+
+            stb__sbn(s_compile_queue) = remaining;
+
+            // swap placeholders for the newly created techniques
+            if (created)
+                ecs::bake_material_handles();
+        }
+
+        void update_shader_compile_queue()
+        {
+            update_compile_queue(s_compile_budget, false);
+        }
+
+        void flush_shader_compile_queue()
+        {
+            update_compile_queue(-1, true);
+        }
+
+        u32 get_num_pending_shader_techniques()
+        {
+            return sb_count(s_compile_queue);
+        }
+
         Str get_pmfx_info_filename(const c8* pmfx_filename)
         {
             Str fn = "data/pmfx/";
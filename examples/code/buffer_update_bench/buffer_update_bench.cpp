@@ -0,0 +1,234 @@
+#include "pmfx.h"
+
+#include "console.h"
+#include "memory.h"
+#include "os.h"
+#include "pen.h"
+#include "renderer.h"
+#include "threads.h"
+
+using namespace pen;
+using namespace put;
+
+// update heavy throughput benchmark, every draw updates a constant buffer the way update_scene does for entities.
+// by default each draw has its own cbuffer, with -shared a single cbuffer is updated before every draw. after a few
+// warm up frames the render thread command profile is recorded and reported, then the app exits.
+// usage: buffer_update_bench [num_draws] [-shared]
+// on linux the vulkan build runs without a gpu on a software icd such as lavapipe:
+// VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json ./buffer_update_bench 10000
+
+namespace
+{
+    void*  user_setup(void* params);
+    loop_t user_update();
+    void   user_shutdown();
+
+    u32  s_num_draws = 10000;
+    bool s_shared = false;
+} // namespace
+
+namespace pen
+{
+    pen_creation_params pen_entry(int argc, char** argv)
+    {
+        for (s32 i = 1; i < argc; ++i)
+        {
+            if (strcmp(argv[i], "-shared") == 0)
+                s_shared = true;
+            else
+                s_num_draws = (u32)atoi(argv[i]);
+        }
+
+        pen::pen_creation_params p;
+        p.window_width = 1280;
+        p.window_height = 720;
+        p.window_title = "buffer_update_bench";
+        p.window_sample_count = 1;
+        p.user_thread_function = user_setup;
+        p.flags = pen::e_pen_create_flags::renderer;
+        p.max_renderer_commands = 1 << 20;
+        return p;
+    }
+} // namespace pen
+
+namespace
+{
+    struct vertex
+    {
+        f32 x, y, z, w;
+    };
+
+    struct draw_call
+    {
+        f32 x, y, z, w;
+        f32 r, g, b, a;
+    };
+
+    const u32 k_warmup_frames = 30;
+    const u32 k_profile_frames = 300;
+
+    job_thread_params* s_job_params;
+    job*               s_thread_info;
+    u32                s_clear_state = 0;
+    u32                s_raster_state = 0;
+    u32                s_shader = 0;
+    u32                s_quad_vertex_buffer = 0;
+    u32                s_quad_index_buffer = 0;
+    u32*               s_cbuffers = nullptr;
+    draw_call*         s_draw_calls = nullptr;
+    u32                s_frame = 0;
+
+    void* user_setup(void* params)
+    {
+        // unpack the params passed to the thread and signal to the engine it ok to proceed
+        s_job_params = (pen::job_thread_params*)params;
+        s_thread_info = s_job_params->job_info;
+        pen::semaphore_post(s_thread_info->p_sem_continue, 1);
+
+        static pen::clear_state cs = {
+            0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0x00, PEN_CLEAR_COLOUR_BUFFER | PEN_CLEAR_DEPTH_BUFFER,
+        };
+
+        s_clear_state = pen::renderer_create_clear_state(cs);
+
+        pen::raster_state_creation_params rcp;
+        pen::memory_zero(&rcp, sizeof(raster_state_creation_params));
+        rcp.fill_mode = PEN_FILL_SOLID;
+        rcp.cull_mode = PEN_CULL_NONE;
+
+        s_raster_state = pen::renderer_create_raster_state(rcp);
+
+        // the buffer_multi_update shader offsets and colours a quad from a single cbuffer
+        s_shader = pmfx::load_shader("buffer_multi_update");
+
+        f32    size = 0.01f;
+        vertex quad_vertices[] = {
+            -size, -size, 0.5f, 1.0f, // p1
+            -size, size,  0.5f, 1.0f, // p2
+            size,  size,  0.5f, 1.0f, // p3
+            size,  -size, 0.5f, 1.0f  // p4
+        };
+
+        pen::buffer_creation_params bcp;
+        bcp.usage_flags = PEN_USAGE_DEFAULT;
+        bcp.bind_flags = PEN_BIND_VERTEX_BUFFER;
+        bcp.cpu_access_flags = 0;
+        bcp.buffer_size = sizeof(quad_vertices);
+        bcp.data = (void*)&quad_vertices[0];
+
+        s_quad_vertex_buffer = pen::renderer_create_buffer(bcp);
+
+        u16 indices[] = {0, 1, 2, 2, 3, 0};
+
+        bcp.usage_flags = PEN_USAGE_IMMUTABLE;
+        bcp.bind_flags = PEN_BIND_INDEX_BUFFER;
+        bcp.buffer_size = sizeof(indices);
+        bcp.data = (void*)&indices[0];
+
+        s_quad_index_buffer = pen::renderer_create_buffer(bcp);
+
+        // cbuffers
+        bcp.usage_flags = PEN_USAGE_DYNAMIC;
+        bcp.bind_flags = PEN_BIND_CONSTANT_BUFFER;
+        bcp.cpu_access_flags = PEN_CPU_ACCESS_WRITE;
+        bcp.buffer_size = sizeof(draw_call);
+        bcp.data = nullptr;
+
+        u32 num_cbuffers = s_shared ? 1 : s_num_draws;
+        for (u32 i = 0; i < num_cbuffers; ++i)
+            sb_push(s_cbuffers, pen::renderer_create_buffer(bcp));
+
+        // scatter the quads over the screen
+        for (u32 i = 0; i < s_num_draws; ++i)
+        {
+            f32       t = (f32)i / (f32)s_num_draws;
+            draw_call dc = {(f32)(i % 100) / 50.0f - 1.0f, (f32)((i / 100) % 100) / 50.0f - 1.0f, 0.0f, 1.0f, t, 1.0f - t,
+                            0.5f, 1.0f};
+
+            sb_push(s_draw_calls, dc);
+        }
+
+        PEN_LOG("buffer_update_bench: %i draws, %s cbuffer\n", s_num_draws, s_shared ? "shared" : "per draw");
+
+        pen_main_loop(user_update);
+        return PEN_THREAD_OK;
+    }
+
+    void user_shutdown()
+    {
+        pen::renderer_new_frame();
+
+        pmfx::release_shader(s_shader);
+        pen::renderer_release_clear_state(s_clear_state);
+        pen::renderer_release_raster_state(s_raster_state);
+        pen::renderer_release_buffer(s_quad_vertex_buffer);
+        pen::renderer_release_buffer(s_quad_index_buffer);
+
+        u32 num_cbuffers = sb_count(s_cbuffers);
+        for (u32 i = 0; i < num_cbuffers; ++i)
+            pen::renderer_release_buffer(s_cbuffers[i]);
+
+        sb_free(s_cbuffers);
+        sb_free(s_draw_calls);
+
+        pen::renderer_present();
+        pen::renderer_consume_cmd_buffer();
+
+        pen::semaphore_post(s_thread_info->p_sem_terminated, 1);
+    }
+
+    loop_t user_update()
+    {
+        // the profile takes effect from the next new frame, two extra frames flush it like cmd_replay
+        if (s_frame == k_warmup_frames)
+            pen::renderer_enable_cmd_profile(true);
+        else if (s_frame == k_warmup_frames + k_profile_frames)
+            pen::renderer_enable_cmd_profile(false);
+        else if (s_frame == k_warmup_frames + k_profile_frames + 2)
+        {
+            pen::renderer_report_cmd_profile();
+            pen::os_terminate(0);
+        }
+
+        pen::renderer_new_frame();
+
+        pen::renderer_set_raster_state(s_raster_state);
+
+        pen::viewport vp = {0.0f, 0.0f, PEN_BACK_BUFFER_RATIO, 1.0f, 0.0f, 1.0f};
+        pen::renderer_set_viewport(vp);
+        pen::renderer_set_scissor_rect(rect{vp.x, vp.y, vp.width, vp.height});
+
+        pen::renderer_set_targets(PEN_BACK_BUFFER_COLOUR, PEN_BACK_BUFFER_DEPTH);
+        pen::renderer_clear(s_clear_state);
+
+        pmfx::set_technique(s_shader, 0);
+        pen::renderer_set_vertex_buffer(s_quad_vertex_buffer, 0, sizeof(vertex), 0);
+        pen::renderer_set_index_buffer(s_quad_index_buffer, PEN_FORMAT_R16_UINT, 0);
+
+        for (u32 i = 0; i < s_num_draws; ++i)
+        {
+            u32 cb = s_shared ? s_cbuffers[0] : s_cbuffers[i];
+
+            // animate so every update writes new data
+            draw_call dc = s_draw_calls[i];
+            dc.z = (f32)(s_frame % 60) / 60.0f;
+
+            pen::renderer_update_buffer(cb, &dc, sizeof(draw_call));
+            pen::renderer_set_constant_buffer(cb, 0, pen::CBUFFER_BIND_VS | pen::CBUFFER_BIND_PS);
+            pen::renderer_draw_indexed(6, 0, 0, PEN_PT_TRIANGLELIST);
+        }
+
+        pen::renderer_present();
+        pen::renderer_consume_cmd_buffer();
+        ++s_frame;
+
+        // msg from the engine we want to terminate
+        if (pen::semaphore_try_wait(s_thread_info->p_sem_exit))
+        {
+            user_shutdown();
+            pen_main_loop_exit();
+        }
+
+        pen_main_loop_continue();
+    }
+} // namespace
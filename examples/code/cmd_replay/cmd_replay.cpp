@@ -0,0 +1,118 @@
+#include "console.h"
+#include "os.h"
+#include "pen.h"
+#include "renderer.h"
+#include "threads.h"
+
+// replays a command capture made with -capture <filename> <num_frames> as fast as the backend allows and reports
+// render thread throughput per command type and frame time percentiles.
+// usage: cmd_replay <filename>
+
+namespace
+{
+    void*  user_setup(void* params);
+    loop_t user_update();
+    void   user_shutdown();
+
+    const c8* s_capture_filename = nullptr;
+} // namespace
+
+namespace pen
+{
+    pen_creation_params pen_entry(int argc, char** argv)
+    {
+        if (argc > 1)
+            s_capture_filename = argv[1];
+
+        pen::pen_creation_params p;
+        p.window_width = 1280;
+        p.window_height = 720;
+        p.window_title = "cmd_replay";
+        p.window_sample_count = 4;
+        p.user_thread_function = user_setup;
+        p.flags = pen::e_pen_create_flags::renderer;
+        p.max_renderer_commands = 1 << 20; // the first frame contains all resource creation
+        return p;
+    }
+} // namespace pen
+
+namespace
+{
+    pen::job_thread_params* job_params;
+    pen::job*               p_thread_info;
+
+    pen::cmd_capture s_capture = nullptr;
+    u32              s_num_frames = 0;
+    u32              s_frame = 0;
+
+    void* user_setup(void* params)
+    {
+        // unpack the params passed to the thread and signal to the engine it ok to proceed
+        job_params = (pen::job_thread_params*)params;
+        p_thread_info = job_params->job_info;
+        pen::semaphore_post(p_thread_info->p_sem_continue, 1);
+
+        if (s_capture_filename)
+            s_capture = pen::renderer_load_capture(s_capture_filename);
+
+        if (!s_capture)
+        {
+            PEN_LOG("usage: cmd_replay <capture filename>\n");
+            pen::os_terminate(1);
+        }
+        else
+        {
+            s_num_frames = pen::renderer_capture_num_frames(s_capture);
+            PEN_LOG("replaying %i frames from %s\n", s_num_frames, s_capture_filename);
+            pen::renderer_enable_cmd_profile(true);
+        }
+
+        pen_main_loop(user_update);
+        return PEN_THREAD_OK;
+    }
+
+    void user_shutdown()
+    {
+        if (s_capture)
+            pen::renderer_release_capture(s_capture);
+
+        pen::semaphore_post(p_thread_info->p_sem_terminated, 1);
+    }
+
+    loop_t user_update()
+    {
+        // two empty frames flush the profile, the first stops it and the second waits for the last replayed frame
+        if (s_frame == s_num_frames)
+            pen::renderer_enable_cmd_profile(false);
+
+        pen::renderer_new_frame();
+
+        if (s_capture && s_frame < s_num_frames)
+        {
+            // the captured frame ends with its own present
+            pen::renderer_replay_capture_frame(s_capture, s_frame);
+        }
+        else
+        {
+            if (s_capture && s_frame == s_num_frames + 2)
+            {
+                pen::renderer_report_cmd_profile();
+                pen::os_terminate(0);
+            }
+
+            pen::renderer_present();
+        }
+
+        pen::renderer_consume_cmd_buffer();
+        ++s_frame;
+
+        // msg from the engine we want to terminate
+        if (pen::semaphore_try_wait(p_thread_info->p_sem_exit))
+        {
+            user_shutdown();
+            pen_main_loop_exit();
+        }
+
+        pen_main_loop_continue();
+    }
+} // namespace
@@ -59,6 +59,10 @@ namespace
 
         put::camera_create_perspective(&main_camera, 60.0f, put::k_use_window_aspect, 0.1f, 1000.0f);
 
+        // with -async_shaders techniques compile on the task system, pending techniques draw with a loaded permutation
+        if (pen::renderer_async_shaders_enabled())
+            pmfx::set_async_shader_compile(true);
+
         // init systems
         put::dev_ui::init();
         put::init_hot_loader();
@@ -78,6 +82,10 @@ namespace
 
         example_setup(main_scene, main_camera);
 
+        // queue the permutations the scene will use, including instanced ones selected by auto instancing
+        if (pen::renderer_async_shaders_enabled())
+            pmfx::warm_up_shader_techniques(main_scene);
+
         frame_timer = pen::timer_create();
         pen::timer_start(frame_timer);
 
@@ -128,6 +136,7 @@ namespace
 
         pmfx::poll_for_changes();
         put::poll_hot_loader();
+        put::stream_update();
 
         if (pen::semaphore_try_wait(p_thread_info->p_sem_exit))
         {
@@ -0,0 +1,127 @@
+#include "console.h"
+#include "hash.h"
+#include "memory.h"
+#include "os.h"
+#include "pen.h"
+#include "threads.h"
+
+#include <type_traits>
+
+// checks the compile time PEN_HASH of string literals against the runtime hashMurmur2A of the same bytes, through both
+// the aligned and unaligned readers. covers every tail length, strings longer than a block and bytes >= 0x80.
+// exits with the number of mismatches.
+// usage: hash_test
+
+namespace
+{
+    void*  user_setup(void* params);
+    loop_t user_update();
+    void   user_shutdown();
+} // namespace
+
+namespace pen
+{
+    pen_creation_params pen_entry(int argc, char** argv)
+    {
+        pen::pen_creation_params p;
+        p.window_width = 1280;
+        p.window_height = 720;
+        p.window_title = "hash_test";
+        p.window_sample_count = 1;
+        p.user_thread_function = user_setup;
+        p.flags = pen::e_pen_create_flags::console_app;
+        return p;
+    }
+} // namespace pen
+
+namespace
+{
+    pen::job_thread_params* job_params;
+    pen::job*               p_thread_info;
+    u32                     s_failures = 0;
+
+    struct hash_case
+    {
+        const c8* str;
+        u32       len;
+        hash_id   id_literal;
+    };
+
+// the literal is hashed at compile time, the runtime hash reads the same bytes through a pointer
+#define HASH_CASE(S)                                                                                                         \
+    {                                                                                                                        \
+        S, sizeof(S) - 1, std::integral_constant<hash_id, PEN_HASH(S)>::value                                               \
+    }
+
+    const hash_case k_cases[] = {
+        HASH_CASE(""),
+        HASH_CASE("a"),
+        HASH_CASE("ab"),
+        HASH_CASE("abc"),
+        HASH_CASE("abcd"),
+        HASH_CASE("abcde"),
+        HASH_CASE("main_colour"),
+        HASH_CASE("the quick brown fox jumps over the lazy dog"),
+        HASH_CASE("\x80"),
+        HASH_CASE("\xff\xfe"),
+        HASH_CASE("\x80\x81\x82"),
+        HASH_CASE("\xc3\xa9t\xc3\xa9"),
+        HASH_CASE("\x80\x81\x82\x83\x84\x85\x86\x87\x88"),
+        HASH_CASE("\xf0\x9f\x98\x80 multi block with a tail \xff"),
+    };
+
+#undef HASH_CASE
+
+    void check(const hash_case& c, u32 offset)
+    {
+        // copy to an offset so the unaligned reader is used when offset is not a multiple of 4
+        u8* buf = (u8*)pen::memory_alloc(c.len + offset + 1);
+        memcpy(buf + offset, c.str, c.len + 1);
+
+        hash_id id_runtime = pen::hashMurmur2A(buf + offset, c.len);
+        if (id_runtime != c.id_literal)
+        {
+            PEN_LOG("[error] hash mismatch len %u offset %u: PEN_HASH %08x != hashMurmur2A %08x\n", c.len, offset,
+                    c.id_literal, id_runtime);
+            ++s_failures;
+        }
+
+        pen::memory_free(buf);
+    }
+
+    void* user_setup(void* params)
+    {
+        // unpack the params passed to the thread and signal to the engine it ok to proceed
+        job_params = (pen::job_thread_params*)params;
+        p_thread_info = job_params->job_info;
+        pen::semaphore_post(p_thread_info->p_sem_continue, 1);
+
+        u32 num_cases = PEN_ARRAY_SIZE(k_cases);
+        for (u32 i = 0; i < num_cases; ++i)
+            for (u32 offset = 0; offset < 4; ++offset)
+                check(k_cases[i], offset);
+
+        PEN_LOG("hash_test: %u cases, %u failures\n", num_cases * 4, s_failures);
+
+        pen_main_loop(user_update);
+        return PEN_THREAD_OK;
+    }
+
+    void user_shutdown()
+    {
+        pen::semaphore_post(p_thread_info->p_sem_terminated, 1);
+    }
+
+    loop_t user_update()
+    {
+        // msg from the engine we want to terminate
+        if (pen::semaphore_try_wait(p_thread_info->p_sem_exit))
+        {
+            user_shutdown();
+            pen_main_loop_exit();
+        }
+
+        pen::os_terminate(s_failures);
+        pen_main_loop_continue();
+    }
+} // namespace
@@ -0,0 +1,217 @@
+#include "console.h"
+#include "data_struct.h"
+#include "os.h"
+#include "pen.h"
+#include "pen_json.h"
+#include "threads.h"
+#include "timer.h"
+
+// compares pen::json against the non allocating json_doc / json_view on the render configs.
+// parse loads and tokenises the file, walk visits every member and reads the leaves, lookup reads the view keys by name
+// from every view the way pmfx parse_views does.
+// usage: json_bench [config filenames...]
+
+namespace
+{
+    void*  user_setup(void* params);
+    loop_t user_update();
+    void   user_shutdown();
+
+    const c8** s_filenames = nullptr;
+} // namespace
+
+namespace pen
+{
+    pen_creation_params pen_entry(int argc, char** argv)
+    {
+        for (s32 i = 1; i < argc; ++i)
+            sb_push(s_filenames, argv[i]);
+
+        pen::pen_creation_params p;
+        p.window_width = 1280;
+        p.window_height = 720;
+        p.window_title = "json_bench";
+        p.window_sample_count = 4;
+        p.user_thread_function = user_setup;
+        p.flags = pen::e_pen_create_flags::console_app;
+        return p;
+    }
+} // namespace pen
+
+namespace
+{
+    pen::job_thread_params* job_params;
+    pen::job*               p_thread_info;
+
+    const u32 k_passes = 32;
+
+    const c8* k_default_configs[] = {"data/configs/editor_renderer.jsn", "data/configs/basic_renderer.jsn",
+                                     "data/configs/deferred_renderer.jsn"};
+
+    const c8* k_view_keys[] = {"target",    "clear_colour", "clear_depth",  "viewport",      "camera",
+                               "scene_views", "depth_test", "blend_state", "raster_state", "technique",
+                               "pmfx_shader", "sampler_bindings", "inherit"};
+
+    struct bench_result
+    {
+        f64 parse_us = 0.0;
+        f64 walk_us = 0.0;
+        f64 lookup_us = 0.0;
+        u32 checksum = 0;
+    };
+
+    u32 walk_json(const pen::json& j)
+    {
+        u32 n = 1;
+        u32 num = j.size();
+        for (u32 i = 0; i < num; ++i)
+        {
+            pen::json c = j[i];
+            if (c.type() == JSMN_OBJECT || c.type() == JSMN_ARRAY)
+                n += walk_json(c);
+            else
+                n += c.as_hash_id() != 0 ? 1 : 0;
+        }
+        return n;
+    }
+
+    u32 walk_view(const pen::json_view& j)
+    {
+        u32 n = 1;
+        for (pen::json_view c : j)
+        {
+            if (c.type() == JSMN_OBJECT || c.type() == JSMN_ARRAY)
+                n += walk_view(c);
+            else
+                n += c.as_hash_id() != 0 ? 1 : 0;
+        }
+        return n;
+    }
+
+    bench_result bench_json(const c8* filename)
+    {
+        bench_result r;
+
+        f64 start = pen::get_time_us();
+        for (u32 p = 0; p < k_passes; ++p)
+            pen::json::load_from_file(filename);
+        r.parse_us = (pen::get_time_us() - start) / k_passes;
+
+        pen::json config = pen::json::load_from_file(filename);
+
+        start = pen::get_time_us();
+        for (u32 p = 0; p < k_passes; ++p)
+            r.checksum += walk_json(config);
+        r.walk_us = (pen::get_time_us() - start) / k_passes;
+
+        start = pen::get_time_us();
+        for (u32 p = 0; p < k_passes; ++p)
+        {
+            u32 num_views = config["views"].size();
+            for (u32 v = 0; v < num_views; ++v)
+            {
+                pen::json view = config["views"][v];
+                for (u32 k = 0; k < PEN_ARRAY_SIZE(k_view_keys); ++k)
+                    r.checksum += view[k_view_keys[k]].as_hash_id();
+            }
+        }
+        r.lookup_us = (pen::get_time_us() - start) / k_passes;
+
+        return r;
+    }
+
+    bench_result bench_view(const c8* filename)
+    {
+        bench_result r;
+
+        f64 start = pen::get_time_us();
+        for (u32 p = 0; p < k_passes; ++p)
+            pen::json_doc::release(pen::json_doc::load_from_file(filename));
+        r.parse_us = (pen::get_time_us() - start) / k_passes;
+
+        pen::json_doc* doc = pen::json_doc::load_from_file(filename);
+        pen::json_view config = doc->root();
+
+        start = pen::get_time_us();
+        for (u32 p = 0; p < k_passes; ++p)
+            r.checksum += walk_view(config);
+        r.walk_us = (pen::get_time_us() - start) / k_passes;
+
+        hash_id id_keys[PEN_ARRAY_SIZE(k_view_keys)];
+        for (u32 k = 0; k < PEN_ARRAY_SIZE(k_view_keys); ++k)
+            id_keys[k] = PEN_HASH(k_view_keys[k]);
+
+        start = pen::get_time_us();
+        for (u32 p = 0; p < k_passes; ++p)
+        {
+            for (pen::json_view view : config["views"])
+                for (u32 k = 0; k < PEN_ARRAY_SIZE(id_keys); ++k)
+                    r.checksum += view.find(id_keys[k]).as_hash_id();
+        }
+        r.lookup_us = (pen::get_time_us() - start) / k_passes;
+
+        pen::json_doc::release(doc);
+        return r;
+    }
+
+    void* user_setup(void* params)
+    {
+        // unpack the params passed to the thread and signal to the engine it ok to proceed
+        job_params = (pen::job_thread_params*)params;
+        p_thread_info = job_params->job_info;
+        pen::semaphore_post(p_thread_info->p_sem_continue, 1);
+
+        if (!s_filenames)
+            for (u32 i = 0; i < PEN_ARRAY_SIZE(k_default_configs); ++i)
+                sb_push(s_filenames, k_default_configs[i]);
+
+        PEN_LOG("%-40s %8s %10s %10s %8s\n", "config (us per pass)", "", "json", "view", "speedup");
+
+        u32 num_files = sb_count(s_filenames);
+        for (u32 i = 0; i < num_files; ++i)
+        {
+            pen::json_doc* doc = pen::json_doc::load_from_file(s_filenames[i]);
+            if (!doc)
+            {
+                PEN_LOG("failed to load %s\n", s_filenames[i]);
+                continue;
+            }
+            pen::json_doc::release(doc);
+
+            bench_result rj = bench_json(s_filenames[i]);
+            bench_result rv = bench_view(s_filenames[i]);
+
+            PEN_LOG("%-40s %8s %10.2f %10.2f %7.1fx\n", s_filenames[i], "parse", rj.parse_us, rv.parse_us,
+                    rj.parse_us / rv.parse_us);
+            PEN_LOG("%-40s %8s %10.2f %10.2f %7.1fx\n", "", "walk", rj.walk_us, rv.walk_us, rj.walk_us / rv.walk_us);
+            PEN_LOG("%-40s %8s %10.2f %10.2f %7.1fx\n", "", "lookup", rj.lookup_us, rv.lookup_us,
+                    rj.lookup_us / rv.lookup_us);
+
+            // both apis must visit the same members and read the same values
+            if (rj.checksum != rv.checksum)
+                PEN_LOG("checksum mismatch %u != %u\n", rj.checksum, rv.checksum);
+        }
+
+        pen_main_loop(user_update);
+        return PEN_THREAD_OK;
+    }
+
+    void user_shutdown()
+    {
+        sb_free(s_filenames);
+        pen::semaphore_post(p_thread_info->p_sem_terminated, 1);
+    }
+
+    loop_t user_update()
+    {
+        // msg from the engine we want to terminate
+        if (pen::semaphore_try_wait(p_thread_info->p_sem_exit))
+        {
+            user_shutdown();
+            pen_main_loop_exit();
+        }
+
+        pen::os_terminate(0);
+        pen_main_loop_continue();
+    }
+} // namespace
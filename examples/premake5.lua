@@ -71,6 +71,10 @@ create_app_example( "ik", script_path() ) -- hide
 create_app_example( "stencil_shadows", script_path() )
 create_app_example( "compute_demo", script_path() ) -- hide
 create_app_example( "global_illumination", script_path() )
+create_app_example( "cmd_replay", script_path() ) -- hide
+create_app_example( "json_bench", script_path() ) -- hide
+create_app_example( "buffer_update_bench", script_path() ) -- hide
+create_app_example( "hash_test", script_path() )
 create_app_example( "game", script_path() ) -- hide
 create_app_example( "curl_example", script_path() ) -- hide
 
@@ -0,0 +1,408 @@
+#include "ecs/ecs_cull.h"
+#include "ecs/ecs_resources.h"
+
+#include "console.h"
+#include "file_system.h"
+#include "pen.h"
+#include "threads.h"
+#include "timer.h"
+#include "os.h"
+
+#include <algorithm>
+
+using namespace pen;
+using namespace put;
+using namespace ecs;
+
+static Str* s_args = nullptr;
+
+namespace pen
+{
+    pen_creation_params pen_entry(int argc, char** argv)
+    {
+        // unpack args
+        for(u32 i = 0; i < argc; ++i)
+            sb_push(s_args, argv[i]);
+
+        pen::pen_creation_params p;
+        p.window_width = 1280;
+        p.window_height = 720;
+        p.window_title = "anim_optimiser";
+        p.window_sample_count = 4;
+        p.user_thread_function = user_entry;
+        p.flags = pen::e_pen_create_flags::console_app;
+        return p;
+    }
+} // namespace pen
+
+namespace
+{
+    const f32 k_sample_rate = 240.0f;
+    const u32 k_timing_passes = 16;
+
+    struct anim_error
+    {
+        f32 max_error = 0.0f;
+        f64 total_error = 0.0;
+        u32 samples = 0;
+    };
+
+    // samples track tr of source channel ch at time, rotations are concatenated like the runtime concatenates them
+    bool sample_source(const animation_channel& ch, u32 tr, f32 time, f32* out)
+    {
+        if (ch.num_frames == 0)
+            return false;
+
+        if (tr == e_anim_track::rotate && !ch.rotation[0])
+            return false;
+
+        f32* const* src = tr == e_anim_track::translate ? ch.offset : ch.scale;
+        if (tr != e_anim_track::rotate && !src[0] && !src[1] && !src[2])
+            return false;
+
+        u32 next = (u32)(std::upper_bound(ch.times, ch.times + ch.num_frames, time) - ch.times);
+        u32 k = next > 0 ? next - 1 : 0;
+        next = min(next, ch.num_frames - 1);
+
+        f32 span = ch.times[next] - ch.times[k];
+        f32 t = span > 0.0f ? min(max((time - ch.times[k]) / span, 0.0f), 1.0f) : 0.0f;
+
+        if (tr == e_anim_track::rotate)
+        {
+            quat q[2];
+            u32  keys[2] = {k, next};
+            for (u32 i = 0; i < 2; ++i)
+            {
+                q[i] = ch.rotation[0][keys[i]];
+                for (u32 r = 1; r < 3; ++r)
+                    if (ch.rotation[r])
+                        q[i] = ch.rotation[r][keys[i]] * q[i];
+            }
+
+            slerp_soa_scalar(&q[0].v[0], &q[1].v[0], &t, out, 1, 1);
+        }
+        else
+        {
+            for (u32 i = 0; i < 3; ++i)
+                out[i] = src[i] ? src[i][k] + (src[i][next] - src[i][k]) * t : 0.0f;
+        }
+
+        return true;
+    }
+
+    // samples track tr of compressed channel c at time, cursor keeps the position in the track between calls
+    bool sample_compressed(const compressed_anim& clip, u32 c, u32 tr, f32 time, u32& cursor, f32* out)
+    {
+        const anim_track& track = clip.channels[c].tracks[tr];
+        if (!track.num_keys)
+            return false;
+
+        const u16* times = &clip.key_times[track.first_key];
+        const u16* keys = &clip.key_data[track.first_key * 3];
+
+        f32 kt = clip.length > 0.0f ? time / clip.length * 65535.0f : 0.0f;
+
+        u32 k = 0;
+        u32 next = 0;
+        f32 t = 0.0f;
+        if (track.num_keys > 1)
+        {
+            if (cursor > track.num_keys - 2 || kt < times[cursor])
+                cursor = 0;
+
+            while (cursor < track.num_keys - 2 && kt >= times[cursor + 1])
+                ++cursor;
+
+            k = cursor;
+            next = k + 1;
+
+            f32 span = (f32)times[next] - (f32)times[k];
+            t = span > 0.0f ? min(max((kt - (f32)times[k]) / span, 0.0f), 1.0f) : 0.0f;
+        }
+
+        f32 a[4], b[4];
+        decode_anim_key(track, tr, &keys[k * 3], a);
+        decode_anim_key(track, tr, &keys[next * 3], b);
+
+        if (tr == e_anim_track::rotate)
+        {
+            slerp_soa_scalar(a, b, &t, out, 1, 1);
+        }
+        else
+        {
+            for (u32 i = 0; i < 3; ++i)
+                out[i] = a[i] + (b[i] - a[i]) * t;
+        }
+
+        return true;
+    }
+
+    size_t source_size(const animation_resource& anim)
+    {
+        size_t size = 0;
+        for (u32 c = 0; c < anim.num_channels; ++c)
+        {
+            const animation_channel& ch = anim.channels[c];
+            size_t                   nf = ch.num_frames;
+
+            size += nf * sizeof(f32); // times
+            if (ch.interpolation)
+                size += nf * sizeof(u32);
+            if (ch.matrices)
+                size += nf * sizeof(mat4);
+
+            for (u32 i = 0; i < 3; ++i)
+            {
+                if (ch.offset[i])
+                    size += nf * sizeof(f32);
+                if (ch.scale[i])
+                    size += nf * sizeof(f32);
+                if (ch.rotation[i])
+                    size += nf * sizeof(quat);
+            }
+        }
+
+        return size;
+    }
+
+    size_t soa_size(const animation_resource& anim)
+    {
+        const soa_anim& soa = anim.soa;
+
+        size_t size = soa.num_channels * sizeof(anim_channel);
+        for (u32 c = 0; c < soa.num_channels; ++c)
+            size += soa.channels[c].num_frames * (soa.channels[c].element_count * sizeof(f32) + sizeof(anim_info));
+
+        return size;
+    }
+
+    size_t compressed_size(const compressed_anim& clip)
+    {
+        return clip.num_channels * sizeof(compressed_anim_channel) + clip.num_keys * sizeof(u16) * 4;
+    }
+
+    void benchmark(const c8* input_file, const anim_compression_params& params)
+    {
+        anim_handle h = load_pma(input_file);
+        if (!is_valid(h))
+        {
+            PEN_LOG("error: failed to load %s", input_file);
+            return;
+        }
+
+        const animation_resource& anim = *get_animation_resource(h);
+
+        if (anim.compressed)
+        {
+            PEN_LOG("error: %s is already compressed, benchmark the uncompressed source", input_file);
+            return;
+        }
+
+        pen::timer* timer = pen::timer_create();
+
+        pen::timer_start(timer);
+        compressed_anim clip;
+        compress_animation(anim, clip, params);
+        f64 compress_ms = pen::timer_elapsed_ms(timer);
+
+        u32 source_keys = 0;
+        u32 tracks[3] = {0}; // stripped, constant, animated
+        for (u32 c = 0; c < anim.num_channels; ++c)
+        {
+            for (u32 tr = 0; tr < e_anim_track::COUNT; ++tr)
+            {
+                f32 v[4];
+                if (!sample_source(anim.channels[c], tr, 0.0f, v))
+                    continue;
+
+                source_keys += anim.channels[c].num_frames;
+
+                u32 nk = clip.channels[c].tracks[tr].num_keys;
+                ++tracks[min<u32>(nk, 2)];
+            }
+        }
+
+        // accuracy, sampled between the source keys as well as on them
+        anim_error error[e_anim_track::COUNT];
+        u32*       cursors = new u32[anim.num_channels * e_anim_track::COUNT]();
+        u32        num_samples = (u32)(anim.length * k_sample_rate) + 1;
+
+        for (u32 s = 0; s < num_samples; ++s)
+        {
+            f32 time = min((f32)s / k_sample_rate, anim.length);
+
+            for (u32 c = 0; c < anim.num_channels; ++c)
+            {
+                for (u32 tr = 0; tr < e_anim_track::COUNT; ++tr)
+                {
+                    f32 ref[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+                    f32 dec[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+
+                    if (!sample_source(anim.channels[c], tr, time, ref))
+                        continue;
+
+                    // stripped rotations are identity
+                    sample_compressed(clip, c, tr, time, cursors[c * e_anim_track::COUNT + tr], dec);
+
+                    f32 e = anim_key_error(tr, ref, dec);
+                    error[tr].max_error = max(error[tr].max_error, e);
+                    error[tr].total_error += e;
+                    error[tr].samples++;
+                }
+            }
+        }
+
+        // decode throughput against sampling the f32 source
+        f64 sample_ns[2] = {0.0, 0.0};
+        f32 sink = 0.0f;
+        for (u32 p = 0; p < 2; ++p)
+        {
+            memset(cursors, 0x0, anim.num_channels * e_anim_track::COUNT * sizeof(u32));
+
+            pen::timer_start(timer);
+            for (u32 pass = 0; pass < k_timing_passes; ++pass)
+            {
+                for (u32 s = 0; s < num_samples; ++s)
+                {
+                    f32 time = min((f32)s / k_sample_rate, anim.length);
+                    for (u32 c = 0; c < anim.num_channels; ++c)
+                    {
+                        for (u32 tr = 0; tr < e_anim_track::COUNT; ++tr)
+                        {
+                            f32 v[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+                            if (p == 0)
+                                sample_source(anim.channels[c], tr, time, v);
+                            else
+                                sample_compressed(clip, c, tr, time, cursors[c * e_anim_track::COUNT + tr], v);
+
+                            sink += v[0];
+                        }
+                    }
+                }
+            }
+
+            f64 samples = (f64)k_timing_passes * num_samples * anim.num_channels;
+            sample_ns[p] = samples > 0.0 ? pen::timer_elapsed_ns(timer) / samples : 0.0;
+        }
+
+        size_t src = source_size(anim);
+        size_t soa = soa_size(anim);
+        size_t cmp = compressed_size(clip);
+
+        PEN_LOG("%s: %i channels, %.2fs", input_file, anim.num_channels, anim.length);
+        PEN_LOG("    tolerance: translation %g, scale %g, rotation %g rad", params.translation_tolerance,
+                params.scale_tolerance, params.rotation_tolerance);
+        PEN_LOG("    tracks: %i animated, %i constant, %i stripped", tracks[2], tracks[1], tracks[0]);
+        PEN_LOG("    keys: %i source, %i compressed", source_keys, clip.num_keys);
+        PEN_LOG("    memory: source arrays %zu bytes + soa %zu bytes, compressed %zu bytes (%.1fx smaller than soa)", src,
+                soa, cmp, cmp > 0 ? (f64)soa / (f64)cmp : 0.0);
+
+        const c8* track_names[] = {"translation", "scale", "rotation"};
+        for (u32 tr = 0; tr < e_anim_track::COUNT; ++tr)
+        {
+            if (!error[tr].samples)
+                continue;
+
+            PEN_LOG("    %s error: max %g, avg %g", track_names[tr], error[tr].max_error,
+                    error[tr].total_error / error[tr].samples);
+        }
+
+        PEN_LOG("    sample: source %.1f ns per channel, compressed %.1f ns per channel (%g)", sample_ns[0], sample_ns[1],
+                sink);
+        PEN_LOG("    compress time: %.2f ms", compress_ms);
+
+        delete[] cursors;
+        release_compressed_animation(clip);
+        pen::timer_destroy(timer);
+    }
+} // namespace
+
+void show_help()
+{
+    PEN_LOG("anim_opt help");
+    PEN_LOG("    -help <show this dialog>");
+    PEN_LOG("    -i <input file>");
+    PEN_LOG("    -o (optional) <output file>");
+    PEN_LOG("      if -o is not supplied input file will be overwritten in place.");
+    PEN_LOG("    -benchmark (optional) <report size, accuracy and decode time against the uncompressed input>");
+    PEN_LOG("    -translation_tolerance (optional) <max translation error in source units>");
+    PEN_LOG("    -scale_tolerance (optional) <max scale error>");
+    PEN_LOG("    -rotation_tolerance (optional) <max rotation error in radians>");
+}
+
+void* pen::user_entry(void* params)
+{
+    // unpack the params passed to the thread and signal to the engine it ok to proceed
+    pen::job_thread_params* job_params = (pen::job_thread_params*)params;
+    pen::job*               p_thread_info = job_params->job_info;
+    pen::semaphore_post(p_thread_info->p_sem_continue, 1);
+
+    Str input_file = "";
+    Str output_file = "";
+    bool bench = false;
+    anim_compression_params compression_params;
+
+    u32 argc = sb_count(s_args);
+    for(u32 i = 0; i < argc; ++i)
+    {
+        if(s_args[i] == "-help")
+        {
+            break;
+        }
+        else if(s_args[i] == "-i" && i+1 < argc)
+        {
+            input_file = s_args[i+1];
+        }
+        else if(s_args[i] == "-o" && i+1 < argc)
+        {
+            output_file = s_args[i+1];
+        }
+        else if(s_args[i] == "-benchmark")
+        {
+            bench = true;
+        }
+        else if(s_args[i] == "-translation_tolerance" && i+1 < argc)
+        {
+            compression_params.translation_tolerance = (f32)atof(s_args[i+1].c_str());
+        }
+        else if(s_args[i] == "-scale_tolerance" && i+1 < argc)
+        {
+            compression_params.scale_tolerance = (f32)atof(s_args[i+1].c_str());
+        }
+        else if(s_args[i] == "-rotation_tolerance" && i+1 < argc)
+        {
+            compression_params.rotation_tolerance = (f32)atof(s_args[i+1].c_str());
+        }
+    }
+
+    if(input_file.empty())
+    {
+        show_help();
+        goto term;
+    }
+
+    if(bench)
+    {
+        benchmark(input_file.c_str(), compression_params);
+
+        // only write when asked to
+        if(output_file.empty())
+            goto term;
+    }
+
+    // write in place
+    if(output_file.empty())
+    {
+        output_file = input_file;
+    }
+
+    PEN_LOG("compressing: %s", input_file.c_str());
+    optimise_pma(input_file.c_str(), output_file.c_str(), compression_params);
+
+term:
+    // signal to the engine the thread has finished
+    pen::os_terminate(0);
+    pen::semaphore_post(p_thread_info->p_sem_terminated, 1);
+
+    return PEN_THREAD_OK;
+}
@@ -55,11 +55,22 @@ local function setup_linux()
 	add_pmtech_links()
 	links
 	{
-		"pthread",
-		"GLEW",
-		"GLU",
-		"GL",
-		"X11",
+		"pthread"
+	}
+
+	-- the null renderer is headless and needs no gl or x11
+	if renderer_dir ~= "null" then
+		links
+		{
+			"GLEW",
+			"GLU",
+			"GL",
+			"X11"
+		}
+	end
+
+	links
+	{
 		"fmod",
 		"dl"
 	}
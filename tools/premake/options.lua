@@ -9,7 +9,8 @@ newoption
       { "opengl", "OpenGL (macOS, linux, Android)" },
       { "dx11",  "DirectX 11 (Windows only)" },
       { "metal", "Metal (macOS, iOS only)" },
-      { "vulkan", "Vulkan (Windows, linux)" }
+      { "vulkan", "Vulkan (Windows, linux)" },
+      { "null", "Null headless renderer with command stats (linux)" }
    }
 }
 